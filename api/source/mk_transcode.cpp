@@ -29,31 +29,33 @@ std::vector<std::string> toCodecList(const char *codec_name_list[]) {
 
 API_EXPORT mk_decoder API_CALL mk_decoder_create(mk_track track, int thread_num) {
     assert(track);
-    return (mk_decoder)new FFmpegDecoder(*((Track::Ptr *) track), thread_num);
+    return (mk_decoder)new FFmpegDecoder::Ptr(TaskManager::create<FFmpegDecoder>(*((Track::Ptr *) track), thread_num));
 }
 
 API_EXPORT mk_decoder API_CALL mk_decoder_create2(mk_track track, int thread_num, const char *codec_name_list[]) {
     assert(track && codec_name_list);
-    return (mk_decoder)new FFmpegDecoder(*((Track::Ptr *) track), thread_num, toCodecList(codec_name_list));
+    return (mk_decoder)new FFmpegDecoder::Ptr(TaskManager::create<FFmpegDecoder>(*((Track::Ptr *) track), thread_num, toCodecList(codec_name_list)));
 }
 
 API_EXPORT void API_CALL mk_decoder_release(mk_decoder ctx, int flush_frame) {
     assert(ctx);
-    auto decoder = (FFmpegDecoder *) ctx;
+    auto decoder = (FFmpegDecoder::Ptr *) ctx;
     if (flush_frame) {
-        decoder->stopThread(false);
+        (*decoder)->stopThread(false);
     }
+    // 在解码回调中释放时，析构会转移到后台线程执行
+    // When released in the decoding callback, the destruction is moved to a background thread
     delete decoder;
 }
 
 API_EXPORT void API_CALL mk_decoder_decode(mk_decoder ctx, mk_frame frame, int async, int enable_merge) {
     assert(ctx && frame);
-    ((FFmpegDecoder *) ctx)->inputFrame(*((Frame::Ptr *) frame), false, async, enable_merge);
+    (*((FFmpegDecoder::Ptr *) ctx))->inputFrame(*((Frame::Ptr *) frame), false, async, enable_merge);
 }
 
 API_EXPORT void API_CALL mk_decoder_set_max_async_frame_size(mk_decoder ctx, size_t size) {
     assert(ctx && size);
-    ((FFmpegDecoder *) ctx)->setMaxTaskSize(size);
+    (*((FFmpegDecoder::Ptr *) ctx))->setMaxTaskSize(size);
 }
 
 API_EXPORT void API_CALL mk_decoder_set_cb(mk_decoder ctx, on_mk_decode cb, void *user_data) {
@@ -63,14 +65,14 @@ API_EXPORT void API_CALL mk_decoder_set_cb(mk_decoder ctx, on_mk_decode cb, void
 API_EXPORT void API_CALL mk_decoder_set_cb2(mk_decoder ctx, on_mk_decode cb, void *user_data, on_user_data_free user_data_free){
     assert(ctx && cb);
     std::shared_ptr<void> ptr(user_data, user_data_free ? user_data_free : [](void *) {});
-    ((FFmpegDecoder *) ctx)->setOnDecode([cb, ptr](const FFmpegFrame::Ptr &pix_frame) {
+    (*((FFmpegDecoder::Ptr *) ctx))->setOnDecode([cb, ptr](const FFmpegFrame::Ptr &pix_frame) {
         cb(ptr.get(), (mk_frame_pix) &pix_frame);
     });
 }
 
 API_EXPORT const AVCodecContext *API_CALL mk_decoder_get_context(mk_decoder ctx) {
     assert(ctx);
-    return ((FFmpegDecoder *) ctx)->getContext();
+    return (*((FFmpegDecoder::Ptr *) ctx))->getContext();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
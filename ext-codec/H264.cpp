@@ -23,9 +23,27 @@
 
 #include <vector>
 #include <stdexcept>
+#include <cstring>
 #include <climits>
 #include <limits>
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define STARTCODE_ENABLE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define STARTCODE_ENABLE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define STARTCODE_TARGET(arch) __attribute__((target(arch)))
+#else
+#define STARTCODE_TARGET(arch)
+#endif
+
 using namespace std;
 using namespace toolkit;
 
@@ -300,13 +318,154 @@ bool getAVCInfo(const string &strSps, int &iVideoWidth, int &iVideoHeight, float
     return getAVCInfo(strSps.data(), strSps.size(), iVideoWidth, iVideoHeight, iVideoFps);
 }
 
-static const char *memfind(const char *buf, ssize_t len, const char *subbuf, ssize_t sublen) {
-    for (auto i = 0; i < len - sublen; ++i) {
-        if (memcmp(buf + i, subbuf, sublen) == 0) {
-            return buf + i;
+// ---- annexb起始码查找 ----
+// ---- Annex-B start code finder ----
+namespace {
+
+using FindStartCodeFunc = const char *(*)(const char *ptr, const char *end);
+
+inline int countTrailingZero(uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+#if defined(_M_X64) || defined(_M_ARM64)
+    _BitScanForward64(&index, mask);
+#else
+    if (!_BitScanForward(&index, (uint32_t)mask)) {
+        _BitScanForward(&index, (uint32_t)(mask >> 32));
+        index += 32;
+    }
+#endif
+    return (int)index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+const char *findStartCodeScalar(const char *ptr, const char *end) {
+    if (end - ptr < 3) {
+        return nullptr;
+    }
+    // 借助memchr查找起始码的最后一个字节0x01，再回溯确认前两个字节
+    // Use memchr to find the last byte 0x01 of the start code, and then look back to confirm the first two bytes
+    for (auto p = ptr + 2; p < end; ++p) {
+        p = (const char *)memchr(p, 0x01, end - p);
+        if (!p) {
+            return nullptr;
+        }
+        if (p[-1] == 0 && p[-2] == 0) {
+            return p - 2;
+        }
+    }
+    return nullptr;
+}
+
+#if defined(STARTCODE_ENABLE_X86)
+// 每轮比较16个起始位置，需要读取18字节
+// Each round compares 16 start positions and needs to read 18 bytes
+STARTCODE_TARGET("sse2")
+const char *findStartCodeSSE2(const char *ptr, const char *end) {
+    auto zero = _mm_setzero_si128();
+    auto one = _mm_set1_epi8(1);
+    auto p = ptr;
+    while (end - p >= 18) {
+        auto b0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), zero);
+        auto b1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 1)), zero);
+        auto b2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 2)), one);
+        auto mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(b0, b1), b2));
+        if (mask) {
+            return p + countTrailingZero(mask);
         }
+        p += 16;
     }
-    return NULL;
+    return findStartCodeScalar(p, end);
+}
+
+// 每轮比较32个起始位置，需要读取34字节
+// Each round compares 32 start positions and needs to read 34 bytes
+STARTCODE_TARGET("avx2")
+const char *findStartCodeAVX2(const char *ptr, const char *end) {
+    auto zero = _mm256_setzero_si256();
+    auto one = _mm256_set1_epi8(1);
+    auto p = ptr;
+    while (end - p >= 34) {
+        auto b0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), zero);
+        auto b1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 1)), zero);
+        auto b2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 2)), one);
+        auto mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(b0, b1), b2));
+        if (mask) {
+            return p + countTrailingZero(mask);
+        }
+        p += 32;
+    }
+    return findStartCodeSSE2(p, end);
+}
+
+bool cpuSupport(bool avx2) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    if (!avx2) {
+        return (info[3] & (1 << 26)) != 0;
+    }
+    // 还需确认操作系统已开启ymm寄存器保存(OSXSAVE且XCR0的bit1、bit2)
+    // It is also necessary to confirm that the os has enabled ymm register saving (OSXSAVE and bit1, bit2 of XCR0)
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return avx2 ? __builtin_cpu_supports("avx2") : __builtin_cpu_supports("sse2");
+#endif
+}
+#endif // defined(STARTCODE_ENABLE_X86)
+
+#if defined(STARTCODE_ENABLE_NEON)
+// 每轮比较16个起始位置，需要读取18字节
+// Each round compares 16 start positions and needs to read 18 bytes
+const char *findStartCodeNEON(const char *ptr, const char *end) {
+    auto zero = vdupq_n_u8(0);
+    auto one = vdupq_n_u8(1);
+    auto p = ptr;
+    while (end - p >= 18) {
+        auto b0 = vceqq_u8(vld1q_u8((const uint8_t *)p), zero);
+        auto b1 = vceqq_u8(vld1q_u8((const uint8_t *)(p + 1)), zero);
+        auto b2 = vceqq_u8(vld1q_u8((const uint8_t *)(p + 2)), one);
+        auto match = vandq_u8(vandq_u8(b0, b1), b2);
+        // neon没有movemask，每字节压缩为4bit的掩码
+        // Neon has no movemask, each byte is narrowed to a 4-bit mask
+        auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+        if (mask) {
+            return p + (countTrailingZero(mask) >> 2);
+        }
+        p += 16;
+    }
+    return findStartCodeScalar(p, end);
+}
+#endif // defined(STARTCODE_ENABLE_NEON)
+
+FindStartCodeFunc selectFindStartCode() {
+#if defined(STARTCODE_ENABLE_X86)
+    if (cpuSupport(true)) {
+        return findStartCodeAVX2;
+    }
+    if (cpuSupport(false)) {
+        return findStartCodeSSE2;
+    }
+#elif defined(STARTCODE_ENABLE_NEON)
+    return findStartCodeNEON;
+#endif
+    return findStartCodeScalar;
+}
+
+} // namespace
+
+const char *findStartCode(const char *ptr, const char *end) {
+    // 首次调用时根据cpu特性选择实现
+    // Select the implementation according to the cpu features on the first call
+    static auto func = selectFindStartCode();
+    return func(ptr, end);
 }
 
 void splitH264(
@@ -315,11 +474,13 @@ void splitH264(
     auto end = ptr + len;
     size_t next_prefix;
     while (true) {
-        auto next_start = memfind(start, end - start, "\x00\x00\x01", 3);
+        // 起始码之后至少保留一个字节，末尾孤立的起始码归入最后一帧
+        // Keep at least one byte after the start code, a lone start code at the end belongs to the last frame
+        auto next_start = findStartCode(start, end - 1);
         if (next_start) {
             // 找到下一帧  [AUTO-TRANSLATED:7161f54a]
             // Find the next frame
-            if (*(next_start - 1) == 0x00) {
+            if (next_start > ptr && *(next_start - 1) == 0x00) {
                 // 这个是00 00 00 01开头  [AUTO-TRANSLATED:b0d79e9e]
                 // This starts with 00 00 00 01
                 next_start -= 1;
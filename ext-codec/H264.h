@@ -18,6 +18,17 @@
 
 namespace mediakit{
 
+/**
+ * 查找annexb起始码(00 00 01)，根据cpu特性在运行时选择avx2/sse2/neon或标量实现
+ * @param ptr 查找起始位置
+ * @param end 查找结束位置，起始码需完整位于[ptr, end)内
+ * @return 起始码位置，未找到返回nullptr
+ * Find the annexb start code (00 00 01), the avx2/sse2/neon or scalar implementation is selected at runtime according to the cpu features
+ * @param ptr Search start position
+ * @param end Search end position, the start code must be entirely within [ptr, end)
+ * @return The start code position, nullptr if not found
+ */
+const char *findStartCode(const char *ptr, const char *end);
 void splitH264(const char *ptr, size_t len, size_t prefix, const std::function<void(const char *, size_t, size_t)> &cb);
 size_t prefixSize(const char *ptr, size_t len);
 
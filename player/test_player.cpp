@@ -81,7 +81,7 @@ int main(int argc, char *argv[]) {
             auto audioTrack = dynamic_pointer_cast<AudioTrack>(strongPlayer->getTrack(TrackAudio, false));
 
             if (videoTrack) {
-                auto decoder = std::make_shared<FFmpegDecoder>(videoTrack);
+                auto decoder = TaskManager::create<FFmpegDecoder>(videoTrack);
                 decoder->setOnDecode([displayer](const FFmpegFrame::Ptr &yuv) {
                     SDLDisplayerHelper::Instance().doTask([yuv, displayer]() {
                         // sdl要求在main线程渲染
@@ -94,7 +94,7 @@ int main(int argc, char *argv[]) {
 
             if (audioTrack) {
                 try {
-                    auto decoder = std::make_shared<FFmpegDecoder>(audioTrack);
+                    auto decoder = TaskManager::create<FFmpegDecoder>(audioTrack);
                     auto audio_player = std::make_shared<AudioPlayer>();
                     // FFmpeg解码时已经统一转换为16位整型pcm
                     audio_player->setup(audioTrack->getAudioSampleRate(), audioTrack->getAudioChannel(), AUDIO_S16);
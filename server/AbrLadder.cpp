@@ -0,0 +1,453 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
+#include <atomic>
+#include <algorithm>
+#include "AbrLadder.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/NoticeCenter.h"
+#include "Common/config.h"
+#include "Record/Recorder.h"
+#include "Codec/H264Encoder.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// master m3u8中为每路输出估算的音频码率，单位kbps
+// Audio bitrate estimated for each output in the master m3u8, in kbps
+static constexpr int kAudioBitrate = 128;
+
+// master m3u8中CODECS属性的音频部分，未知编码时返回空
+// The audio part of the CODECS attribute in the master m3u8, return empty for unknown codecs
+static string getAudioCodecs(const Track::Ptr &audio) {
+    switch (audio->getCodecId()) {
+        case CodecAAC: {
+            auto extra = audio->ready() ? audio->getExtraData() : nullptr;
+            if (extra && extra->size()) {
+                return "mp4a.40." + to_string((uint8_t)extra->data()[0] >> 3);
+            }
+            return "";
+        }
+        case CodecMP3: return "mp4a.40.34";
+        default: return "";
+    }
+}
+
+static bool isKeyFrame(const AVFrame *frame) {
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(58, 29, 100)
+    return frame->flags & AV_FRAME_FLAG_KEY;
+#else
+    return frame->key_frame;
+#endif
+}
+
+vector<AbrRendition> AbrRendition::parse(const string &str) {
+    vector<AbrRendition> ret;
+    for (auto &item : split(str, ",")) {
+        trim(item);
+        if (item.empty()) {
+            continue;
+        }
+        auto pos = item.find(':');
+        if (pos == string::npos) {
+            throw std::invalid_argument("invalid abr rendition: " + item);
+        }
+        AbrRendition rendition;
+        auto size = item.substr(0, pos);
+        auto x = size.find('x');
+        if (x != string::npos) {
+            rendition.width = atoi(size.substr(0, x).data());
+            rendition.height = atoi(size.substr(x + 1).data());
+        } else {
+            rendition.height = atoi(size.data());
+        }
+        rendition.bitrate = atoi(item.substr(pos + 1).data());
+        // x264的yuv420p输入要求宽高为偶数
+        // The yuv420p input of x264 requires even width and height
+        if (rendition.height < 16 || rendition.height > 4320 || rendition.height % 2 || rendition.width < 0 || rendition.width > 8192 || rendition.width % 2
+            || rendition.bitrate <= 0) {
+            throw std::invalid_argument("invalid abr rendition: " + item);
+        }
+        rendition.name = to_string(rendition.height);
+        for (auto &other : ret) {
+            if (other.name == rendition.name) {
+                throw std::invalid_argument("duplicate abr rendition height: " + rendition.name);
+            }
+        }
+        ret.emplace_back(std::move(rendition));
+    }
+    if (ret.empty()) {
+        throw std::invalid_argument("empty abr renditions");
+    }
+    std::sort(ret.begin(), ret.end(), [](const AbrRendition &a, const AbrRendition &b) { return a.height > b.height; });
+    return ret;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * 一路输出，编码任务在其专属的串行队列中执行
+ * 复用器不是线程安全的，编码结果与音频都切回源流线程再输入复用器
+ * One output, the encoding tasks are executed in its own serial queue
+ * The muxer is not thread safe, both the encoding result and the audio are switched back to the source stream thread before being input to the muxer
+ */
+class AbrLadder::Output : public TaskManager {
+public:
+    using onCodecs = std::function<void(const string &codecs)>;
+
+    ~Output() override {
+        // 先停止编码任务，再释放DevChannel
+        // Stop the encoding tasks first, then release the DevChannel
+        stopThread(true);
+    }
+
+    // 在解码线程中执行
+    // Executed in the decoding thread
+    FFmpegFrame::Ptr scale(const FFmpegFrame::Ptr &frame) { return _sws.inputFrame(frame); }
+
+    // 获取到sps后在源流线程中回调rfc6381 codecs
+    // Callback the rfc6381 codecs in the source stream thread after getting the sps
+    void setOnCodecs(onCodecs cb) { _on_codecs = std::move(cb); }
+
+    // 在解码线程中执行
+    // Executed in the decoding thread
+    void encode(const FFmpegFrame::Ptr &frame, bool key) {
+        auto seq = ++_seq;
+        if (key) {
+            _key_seq = seq;
+        }
+        addEncodeTask([this, frame, seq, key]() {
+            // 编码任务积压时会丢弃最早的任务，关键帧任务被丢弃时在其后第一帧编码IDR
+            // The earliest tasks are dropped when encoding tasks are backlogged, encode IDR at the first frame after a dropped key frame task
+            auto key_seq = _key_seq.load();
+            auto force_idr = key || (key_seq < seq && key_seq > _idr_seq);
+            if (force_idr) {
+                _idr_seq = seq;
+            }
+            H264Encoder::H264Frame *out_frames;
+            auto size = _encoder.inputData((char **)frame->get()->data, frame->get()->linesize, frame->get()->pts, &out_frames, force_idr);
+            if (size <= 0) {
+                return;
+            }
+            string codecs;
+            // 编码结果指向x264内部缓存，下次编码前有效，需拷贝后再切换线程
+            // The encoding result points to the internal buffer of x264 which is valid until the next encoding, it needs to be copied before switching threads
+            auto nals = std::make_shared<std::vector<EncodedNal>>();
+            nals->reserve(size);
+            for (int i = 0; i < size; ++i) {
+                nals->emplace_back(EncodedNal { string((char *)out_frames[i].pucData, out_frames[i].iLength), out_frames[i].dts, out_frames[i].pts });
+                if (!_got_sps && out_frames[i].iType == 7) {
+                    // 跳过起始码，sps负载为[nal头, profile_idc, constraint_flags, level_idc]
+                    // Skip the start code, the sps payload is [nal header, profile_idc, constraint_flags, level_idc]
+                    auto &data = nals->back().data;
+                    size_t prefix = 0;
+                    while (prefix < data.size() && !data[prefix]) {
+                        ++prefix;
+                    }
+                    ++prefix;
+                    if (data.size() >= prefix + 4) {
+                        char buf[16];
+                        snprintf(buf, sizeof(buf), "avc1.%02X%02X%02X", (uint8_t)data[prefix + 1], (uint8_t)data[prefix + 2], (uint8_t)data[prefix + 3]);
+                        codecs = buf;
+                        _got_sps = true;
+                    }
+                }
+            }
+            std::weak_ptr<DevChannel> weak_dev = _dev;
+            auto on_codecs = _on_codecs;
+            _poller->async([weak_dev, nals, codecs, on_codecs]() {
+                auto dev = weak_dev.lock();
+                if (!dev) {
+                    return;
+                }
+                for (auto &nal : *nals) {
+                    dev->inputH264(nal.data.data(), nal.data.size(), nal.dts, nal.pts);
+                }
+                if (!codecs.empty() && on_codecs) {
+                    on_codecs(codecs);
+                }
+            }, false);
+        });
+    }
+
+    void inputAudio(const Frame::Ptr &frame) {
+        std::weak_ptr<DevChannel> weak_dev = _dev;
+        _poller->async([weak_dev, frame]() {
+            if (auto dev = weak_dev.lock()) {
+                dev->inputFrame(frame);
+            }
+        });
+    }
+
+private:
+    friend class TaskManager;
+    Output(const MediaTuple &tuple, const ProtocolOption &option, const VideoInfo &info, const Track::Ptr &audio, EventPoller::Ptr poller)
+        : _sws(AV_PIX_FMT_YUV420P, info.iWidth, info.iHeight), _poller(std::move(poller)) {
+        // 各路输出只在源流关键帧处编码IDR，保证切片边界对齐，播放器才能无缝切换码率
+        // Each output encodes IDR only at the key frames of the source stream to align the segment boundaries, so that players can switch bitrate seamlessly
+        if (!_encoder.init(info.iWidth, info.iHeight, info.iFrameRate, info.iBitRate, true)) {
+            throw std::runtime_error("H264Encoder init failed: " + tuple.shortUrl());
+        }
+        _dev = std::make_shared<DevChannel>(tuple, 0, option);
+        _dev->initVideo(info);
+        if (audio) {
+            _dev->addTrack(audio->clone());
+        }
+        _dev->addTrackCompleted();
+        setTaskName(tuple.shortUrl());
+        startThread("abr encoder");
+    }
+
+    struct EncodedNal {
+        string data;
+        int64_t dts;
+        int64_t pts;
+    };
+
+    FFmpegSws _sws;
+    // 只在编码任务中访问
+    // Accessed only in the encoding tasks
+    H264Encoder _encoder;
+    bool _got_sps = false;
+    uint64_t _idr_seq = 0;
+    // 只在解码线程中修改
+    // Modified only in the decoding thread
+    uint64_t _seq = 0;
+    std::atomic<uint64_t> _key_seq { 0 };
+    EventPoller::Ptr _poller;
+    onCodecs _on_codecs;
+    DevChannel::Ptr _dev;
+};
+
+AbrLadder::AbrLadder(const MediaTuple &tuple, vector<AbrRendition> renditions) : _tuple(tuple), _renditions(std::move(renditions)) {}
+
+AbrLadder::~AbrLadder() {
+    if (!_master_path.empty()) {
+        File::delete_file(_master_path);
+    }
+    InfoL << "abr ladder stopped: " << _tuple.shortUrl();
+}
+
+void AbrLadder::start(const MediaSource::Ptr &src, onStop cb) {
+    auto muxer = src->getMuxer();
+    _video = src->getTrack(TrackVideo);
+    if (!muxer || !_video || !_video->getVideoWidth() || !_video->getVideoHeight()) {
+        throw std::runtime_error("the source stream has no video track or its resolution is unknown: " + _tuple.shortUrl());
+    }
+    _audio = src->getTrack(TrackAudio);
+
+    auto option = muxer->getOption();
+    // 输出流需开启hls才能被master m3u8引用
+    // The output streams need hls enabled to be referenced by the master m3u8
+    option.enable_hls = true;
+    auto fps = _video->getVideoFps() > 0 ? _video->getVideoFps() : 25.0f;
+    for (auto &rendition : _renditions) {
+        if (!rendition.width) {
+            rendition.width = (_video->getVideoWidth() * rendition.height / _video->getVideoHeight() + 1) & ~1;
+        }
+        VideoInfo info;
+        info.codecId = CodecH264;
+        info.iWidth = rendition.width;
+        info.iHeight = rendition.height;
+        info.iFrameRate = fps;
+        info.iBitRate = rendition.bitrate * 1000;
+        MediaTuple tuple { _tuple.vhost, _tuple.app, _tuple.stream + "_" + rendition.name, "" };
+        _outputs.emplace_back(TaskManager::create<Output>(tuple, option, info, _audio, src->getOwnerPoller()));
+    }
+
+    weak_ptr<AbrLadder> weak_self = shared_from_this();
+    _video_codecs.resize(_outputs.size());
+    for (size_t i = 0; i < _outputs.size(); ++i) {
+        _outputs[i]->setOnCodecs([weak_self, i](const string &codecs) {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onCodecs(i, codecs);
+            }
+        });
+    }
+
+    _decoder = TaskManager::create<FFmpegDecoder>(_video);
+    _decoder->setTaskName(_tuple.shortUrl());
+    _decoder->setOnDecode([this](const FFmpegFrame::Ptr &frame) { onDecode(frame); });
+
+    _reader = muxer->getFrameReader();
+    _reader->setDetachCB([weak_self, cb]() {
+        if (weak_self.lock()) {
+            cb();
+        }
+    });
+    _reader->setReadCB([weak_self](const Frame::Ptr &frame) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onFrame(frame);
+        }
+    });
+
+    auto hls_path = Recorder::getRecordPath(Recorder::type_hls, _tuple, option.hls_save_path);
+    _master_path = hls_path.substr(0, hls_path.rfind('/') + 1) + "master.m3u8";
+    auto playlist = makeMasterPlaylist();
+    auto fp = File::create_file(_master_path, "wb");
+    if (fp) {
+        fwrite(playlist.data(), playlist.size(), 1, fp);
+        fclose(fp);
+    } else {
+        WarnL << "create master m3u8 failed: " << _master_path;
+    }
+    InfoL << "abr ladder started: " << _tuple.shortUrl() << ", renditions: " << _outputs.size();
+}
+
+void AbrLadder::onCodecs(size_t index, const string &codecs) {
+    _video_codecs[index] = codecs;
+    for (auto &item : _video_codecs) {
+        if (item.empty()) {
+            return;
+        }
+    }
+    // 所有输出的codecs都已确定，重新生成master m3u8
+    // The codecs of all outputs have been determined, regenerate the master m3u8
+    auto playlist = makeMasterPlaylist();
+    auto fp = File::create_file(_master_path, "wb");
+    if (!fp) {
+        WarnL << "update master m3u8 failed: " << _master_path;
+        return;
+    }
+    fwrite(playlist.data(), playlist.size(), 1, fp);
+    fclose(fp);
+}
+
+string AbrLadder::makeMasterPlaylist() const {
+    string audio_codecs = _audio ? getAudioCodecs(_audio) : "";
+    _StrPrinter printer;
+    printer << "#EXTM3U\n"
+            << "#EXT-X-VERSION:3\n";
+    for (size_t i = 0; i < _renditions.size(); ++i) {
+        auto &rendition = _renditions[i];
+        printer << "#EXT-X-STREAM-INF:BANDWIDTH=" << (rendition.bitrate + (_audio ? kAudioBitrate : 0)) * 1000;
+        if (rendition.width) {
+            printer << ",RESOLUTION=" << rendition.width << "x" << rendition.height;
+        }
+        // 音视频codecs都已知时才输出CODECS，不完整的CODECS会导致播放器过滤掉该输出
+        // CODECS is output only when both audio and video codecs are known, incomplete CODECS will cause players to filter out the output
+        if (i < _video_codecs.size() && !_video_codecs[i].empty() && (!_audio || !audio_codecs.empty())) {
+            printer << ",CODECS=\"" << _video_codecs[i] << (_audio ? "," + audio_codecs : "") << "\"";
+        }
+        printer << "\n../" << _tuple.stream << "_" << rendition.name << "/hls.m3u8\n";
+    }
+    return printer;
+}
+
+void AbrLadder::onFrame(const Frame::Ptr &frame) {
+    if (frame->getIndex() == _video->getIndex()) {
+        // 异步解码，不阻塞源流线程；解码太慢时丢帧直到下一个关键帧
+        // Asynchronous decoding without blocking the source stream thread; drop frames until the next key frame when decoding is too slow
+        _decoder->inputFrame(frame, true, true);
+        return;
+    }
+    if (_audio && frame->getIndex() == _audio->getIndex()) {
+        for (auto &output : _outputs) {
+            output->inputAudio(frame);
+        }
+    }
+}
+
+void AbrLadder::onDecode(const FFmpegFrame::Ptr &frame) {
+    auto input = frame;
+    for (auto &output : _outputs) {
+        auto scaled = output->scale(input);
+        if (!scaled) {
+            continue;
+        }
+        output->encode(scaled, isKeyFrame(frame->get()));
+        // 输出按分辨率从高到低排列，本档缩放结果作为下一档的输入，减少缩放运算量
+        // The outputs are sorted by resolution from high to low, the scaled result of this output is used as the input of the next one to reduce the scaling computation
+        input = scaled;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+AbrLadderManager &AbrLadderManager::Instance() {
+    static AbrLadderManager s_instance;
+    return s_instance;
+}
+
+AbrLadderManager::AbrLadderManager() {
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastMediaChanged, [this](BroadcastMediaChangedArgs) {
+        if (!bRegist) {
+            return;
+        }
+        auto src = sender.shared_from_this();
+        src->getOwnerPoller()->async([this, src]() { startLadder(src); }, false);
+    });
+}
+
+void AbrLadderManager::add(const MediaTuple &tuple, const string &renditions) {
+    auto parsed = AbrRendition::parse(renditions);
+    AbrLadder::Ptr old_ladder;
+    {
+        lock_guard<recursive_mutex> lck(_mtx);
+        auto &item = _items[tuple.shortUrl()];
+        item.renditions = std::move(parsed);
+        // 重新配置，重启转码
+        // Reconfigure and restart the transcoding
+        old_ladder = std::move(item.ladder);
+    }
+    if (auto src = MediaSource::find(tuple.vhost, tuple.app, tuple.stream)) {
+        src->getOwnerPoller()->async([this, src]() { startLadder(src); }, false);
+    }
+}
+
+bool AbrLadderManager::del(const string &key) {
+    AbrLadder::Ptr ladder;
+    {
+        lock_guard<recursive_mutex> lck(_mtx);
+        auto it = _items.find(key);
+        if (it == _items.end()) {
+            return false;
+        }
+        ladder = std::move(it->second.ladder);
+        _items.erase(it);
+    }
+    return true;
+}
+
+void AbrLadderManager::startLadder(const MediaSource::Ptr &src) {
+    auto key = src->getMediaTuple().shortUrl();
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _items.find(key);
+    if (it == _items.end() || it->second.ladder) {
+        // 未配置码率阶梯或已在转码(同一个流的多个协议都会触发注册事件)
+        // No bitrate ladder is configured or it is already transcoding (multiple protocols of the same stream all trigger the registration event)
+        return;
+    }
+    auto ladder = std::make_shared<AbrLadder>(src->getMediaTuple(), it->second.renditions);
+    weak_ptr<AbrLadder> weak_ladder = ladder;
+    try {
+        ladder->start(src, [this, key, weak_ladder]() {
+            // 源流已注销，释放转码，源流重新注册后再启动
+            // The source stream has been unregistered, release the transcoding, and start it again after the source stream is re-registered
+            EventPollerPool::Instance().getPoller()->async([this, key, weak_ladder]() {
+                AbrLadder::Ptr ladder;
+                lock_guard<recursive_mutex> lck(_mtx);
+                auto it = _items.find(key);
+                if (it != _items.end() && it->second.ladder == weak_ladder.lock()) {
+                    ladder = std::move(it->second.ladder);
+                }
+            }, false);
+        });
+    } catch (std::exception &ex) {
+        WarnL << "start abr ladder failed: " << ex.what();
+        return;
+    }
+    it->second.ladder = std::move(ladder);
+}
+
+#endif // defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
@@ -0,0 +1,138 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_ABRLADDER_H
+#define ZLMEDIAKIT_ABRLADDER_H
+
+#if defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Codec/Transcode.h"
+#include "Common/Device.h"
+#include "Common/MultiMediaSourceMuxer.h"
+
+/**
+ * 码率阶梯中的一路输出
+ * One output of the bitrate ladder
+ */
+struct AbrRendition {
+    // 流id后缀，输出流id为<源流id>_<name>
+    // Stream id suffix, the output stream id is <source stream id>_<name>
+    std::string name;
+    // 宽为0时按源流宽高比计算
+    // The width is calculated according to the aspect ratio of the source stream when it is 0
+    int width = 0;
+    int height = 0;
+    // 视频码率，单位kbps
+    // Video bitrate, in kbps
+    int bitrate = 0;
+
+    /**
+     * 解析码率阶梯，格式为[宽x]高:码率(kbps)，多个以逗号分隔，例如 720:2000,1280x720:1500,480:800
+     * 格式错误时抛异常
+     * Parse the bitrate ladder, the format is [width x]height:bitrate(kbps), separated by commas, for example 720:2000,1280x720:1500,480:800
+     * Throw an exception when the format is wrong
+     */
+    static std::vector<AbrRendition> parse(const std::string &str);
+};
+
+/**
+ * 码率阶梯转码：源流只解码一次，缩放后的画面在各路输出间逐级共享(高分辨率缩放结果作为低分辨率的输入)，
+ * 每路输出在共享编解码线程池中独立编码为h264，并作为同级流(如stream_720)注册，音频直接透传
+ * 同时在源流hls目录下生成包含所有输出的master.m3u8
+ * Bitrate ladder transcoding: the source stream is decoded only once, the scaled pictures are shared step by step between outputs
+ * (the scaled result of the higher resolution is used as the input of the lower resolution),
+ * each output is encoded to h264 independently in the shared codec thread pool and registered as a sibling stream (such as stream_720),
+ * and the audio is passed through directly
+ * At the same time, master.m3u8 containing all outputs is generated in the hls directory of the source stream
+ */
+class AbrLadder : public std::enable_shared_from_this<AbrLadder> {
+public:
+    using Ptr = std::shared_ptr<AbrLadder>;
+    using onStop = std::function<void()>;
+
+    AbrLadder(const mediakit::MediaTuple &tuple, std::vector<AbrRendition> renditions);
+    ~AbrLadder();
+
+    /**
+     * 开始转码，必须在源流归属线程中调用，失败时抛异常
+     * @param cb 源流注销后回调
+     * Start transcoding, must be called in the owner thread of the source stream, throw an exception on failure
+     * @param cb Callback after the source stream is unregistered
+     */
+    void start(const mediakit::MediaSource::Ptr &src, onStop cb);
+
+    /**
+     * 生成master m3u8，各输出的地址为相对于源流hls目录的路径
+     * Generate the master m3u8, the url of each output is the path relative to the hls directory of the source stream
+     */
+    std::string makeMasterPlaylist() const;
+
+private:
+    class Output;
+
+    void onFrame(const mediakit::Frame::Ptr &frame);
+    void onDecode(const mediakit::FFmpegFrame::Ptr &frame);
+    void onCodecs(size_t index, const std::string &codecs);
+
+private:
+    mediakit::MediaTuple _tuple;
+    std::vector<AbrRendition> _renditions;
+    std::string _master_path;
+    // 各输出视频的rfc6381 codecs，与_outputs一一对应，只在源流线程中访问
+    // The rfc6381 codecs of the video of each output, corresponding to _outputs one by one, accessed only in the source stream thread
+    std::vector<std::string> _video_codecs;
+    mediakit::Track::Ptr _video;
+    mediakit::Track::Ptr _audio;
+    // 按分辨率从高到低排列，启动后不再修改
+    // Sorted by resolution from high to low, no longer modified after starting
+    std::vector<std::shared_ptr<Output>> _outputs;
+    // 析构时先释放读取器再释放解码器，保证不再有回调访问输出
+    // Release the reader first and then the decoder when destructing, to ensure that no callback accesses the outputs anymore
+    mediakit::FFmpegDecoder::Ptr _decoder;
+    mediakit::MultiMediaSourceMuxer::RingType::RingReader::Ptr _reader;
+};
+
+/**
+ * 码率阶梯管理，源流(重新)注册时自动启动转码
+ * Bitrate ladder management, the transcoding is started automatically when the source stream is (re)registered
+ */
+class AbrLadderManager {
+public:
+    static AbrLadderManager &Instance();
+
+    /**
+     * 添加码率阶梯，源流在线时立即启动，否则在其注册后启动
+     * @param renditions 码率阶梯配置，格式见AbrRendition::parse
+     * Add a bitrate ladder, start immediately if the source stream is online, otherwise start after it is registered
+     * @param renditions Bitrate ladder configuration, see AbrRendition::parse for the format
+     */
+    void add(const mediakit::MediaTuple &tuple, const std::string &renditions);
+    bool del(const std::string &key);
+
+private:
+    AbrLadderManager();
+
+    void startLadder(const mediakit::MediaSource::Ptr &src);
+
+private:
+    struct Item {
+        std::vector<AbrRendition> renditions;
+        AbrLadder::Ptr ladder;
+    };
+
+    std::recursive_mutex _mtx;
+    std::unordered_map<std::string, Item> _items;
+};
+
+#endif // defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
+#endif // ZLMEDIAKIT_ABRLADDER_H
@@ -28,6 +28,9 @@ const string kCmd = FFmpeg_FIELD"cmd";
 const string kLog = FFmpeg_FIELD"log";
 const string kSnap = FFmpeg_FIELD"snap";
 const string kRestartSec = FFmpeg_FIELD"restart_sec";
+const string kSnapInProcess = FFmpeg_FIELD"snap_in_process";
+const string kSnapWorkers = FFmpeg_FIELD"snap_workers";
+const string kSnapCacheSec = FFmpeg_FIELD"snap_cache_sec";
 
 onceToken token([]() {
 #ifdef _WIN32
@@ -44,6 +47,9 @@ onceToken token([]() {
     mINI::Instance()[kCmd] = "%s -re -i %s -c:a aac -strict -2 -ar 44100 -ab 48k -c:v libx264 -f flv %s";
     mINI::Instance()[kSnap] = "%s -i %s -y -f mjpeg -frames:v 1 -an %s";
     mINI::Instance()[kRestartSec] = 0;
+    mINI::Instance()[kSnapInProcess] = 1;
+    mINI::Instance()[kSnapWorkers] = 4;
+    mINI::Instance()[kSnapCacheSec] = 3;
 });
 }
 
@@ -360,6 +366,9 @@ void FFmpegSource::onGetMediaSource(const MediaSource::Ptr &src) {
 }
 
 #if defined(ENABLE_FFMPEG)
+#include <list>
+#include <deque>
+#include <unordered_map>
 #include "Player/MediaPlayer.h"
 #include "Codec/Transcode.h"
 
@@ -380,78 +389,329 @@ static std::string getStreamName(const std::string &input) {
     return input;
 }
 
+/**
+ * 进程内截图引擎：从本机流的gop缓存中取最新的关键帧，在数量有限的后台线程中解码并编码为jpeg，结果按流缓存一段时间
+ * 同一个流的并发截图请求共享同一次解码
+ * In-process snapshot engine: take the latest key frame from the gop cache of a local stream, decode and encode it to jpeg
+ * on a limited number of background threads, and cache the result per stream for a while
+ * Concurrent snapshot requests of the same stream share the same decoding
+ */
+class SnapEngine {
+public:
+    using onJpeg = function<void(const Buffer::Ptr &jpeg, const string &err_msg)>;
+
+    static SnapEngine &Instance() {
+        static SnapEngine s_instance;
+        return s_instance;
+    }
+
+    void getSnap(const MediaSource::Ptr &src, const MultiMediaSourceMuxer::Ptr &muxer, const Track::Ptr &track, float timeout_sec, onJpeg cb) {
+        GET_CONFIG(float, cache_sec, FFmpeg::kSnapCacheSec);
+        auto key = muxer->shortUrl();
+        Buffer::Ptr jpeg;
+        {
+            lock_guard<mutex> lck(_mtx);
+            auto it = _cache.find(key);
+            if (it != _cache.end() && it->second.ticker.elapsedTime() < cache_sec * 1000) {
+                jpeg = it->second.jpeg;
+            }
+        }
+        if (jpeg) {
+            // 命中缓存
+            // Cache hit
+            cb(jpeg, "");
+            return;
+        }
+        {
+            lock_guard<mutex> lck(_mtx);
+            auto &waiters = _waiters[key];
+            waiters.emplace_back(std::move(cb));
+            if (waiters.size() > 1) {
+                // 该流已在截图中，等待其结果即可
+                // The stream is being snapped, just wait for its result
+                return;
+            }
+            auto task = std::make_shared<Task>();
+            task->key = std::move(key);
+            task->poller = src->getOwnerPoller();
+            task->muxer = muxer;
+            task->track = track;
+            task->timeout_ms = timeout_sec * 1000;
+            _queue.emplace_back(std::move(task));
+        }
+        startTasks();
+    }
+
+private:
+    struct Cache {
+        Buffer::Ptr jpeg;
+        Ticker ticker;
+    };
+
+    struct Task {
+        string key;
+        EventPoller::Ptr poller;
+        MultiMediaSourceMuxer::Ptr muxer;
+        Track::Ptr track;
+        uint64_t timeout_ms = 0;
+        // 排队开始计时，超时时间包含排队时长
+        // Timing starts when queued, the timeout includes the queuing time
+        Ticker ticker;
+        atomic<bool> done { false };
+        bool flushing = false;
+        bool have_key = false;
+        bool have_next = false;
+        uint64_t key_dts = 0;
+        // 最新关键帧(及其前的配置帧)与其后的一帧，后者用于触发帧合并输出
+        // The latest key frame (and the config frames before it) and one frame after it, the latter is used to trigger the frame merger output
+        vector<Frame::Ptr> frames;
+        MultiMediaSourceMuxer::RingType::RingReader::Ptr reader;
+        EventPoller::DelayTask::Ptr timer;
+    };
+    using TaskPtr = std::shared_ptr<Task>;
+
+    SnapEngine() = default;
+
+    void startTasks() {
+        GET_CONFIG(size_t, workers, FFmpeg::kSnapWorkers);
+        vector<TaskPtr> tasks;
+        {
+            lock_guard<mutex> lck(_mtx);
+            while (_running < (std::max<size_t>)(workers, 1) && !_queue.empty()) {
+                tasks.emplace_back(std::move(_queue.front()));
+                _queue.pop_front();
+                ++_running;
+            }
+        }
+        for (auto &task : tasks) {
+            startTask(task);
+        }
+    }
+
+    void startTask(const TaskPtr &task) {
+        auto elapsed_ms = task->ticker.elapsedTime();
+        if (elapsed_ms >= task->timeout_ms) {
+            // 后台截图任务太多，排队太久
+            // Too many background snapshot tasks, queued for too long
+            onTaskDone(task, nullptr, "wait snap worker timeout");
+            return;
+        }
+        task->timer = EventPollerPool::Instance().getPoller()->doDelayTask(task->timeout_ms - elapsed_ms, [this, task]() {
+            // 防止流无关键帧或解码失败导致一直等待
+            // Prevent waiting forever because the stream has no key frame or the decoding failed
+            onTaskDone(task, nullptr, "decode frame timeout");
+            return 0;
+        });
+        std::weak_ptr<Task> weak_task = task;
+        task->poller->async([this, weak_task]() {
+            auto task = weak_task.lock();
+            if (!task || task->done) {
+                return;
+            }
+            task->reader = task->muxer->getFrameReader();
+            task->reader->setDetachCB([this, weak_task]() {
+                if (auto task = weak_task.lock()) {
+                    onTaskDone(task, nullptr, "media source released");
+                }
+            });
+            // 设置回调时会同步输出gop缓存，此期间只收集不解码，以便取到最新的关键帧
+            // The gop cache is output synchronously when setting the callback, only collect without decoding during this period to get the latest key frame
+            task->flushing = true;
+            task->reader->setReadCB([this, weak_task](const Frame::Ptr &frame) {
+                if (auto task = weak_task.lock()) {
+                    onFrame(task, frame);
+                }
+            });
+            task->flushing = false;
+            if (task->have_next) {
+                decode(task);
+            }
+        }, false);
+    }
+
+    // 在流的归属线程中执行
+    // Executed in the owner thread of the stream
+    void onFrame(const TaskPtr &task, const Frame::Ptr &frame) {
+        if (task->done || frame->getIndex() != task->track->getIndex()) {
+            return;
+        }
+        auto is_key = frame->keyFrame() || frame->configFrame();
+        if (task->have_next) {
+            if (!is_key || !task->flushing) {
+                // 已收集完毕，等待解码结果
+                // Collection is complete, waiting for the decoding result
+                return;
+            }
+            // gop缓存中还有更新的关键帧，重新收集
+            // There is a newer key frame in the gop cache, collect again
+            task->frames.clear();
+            task->have_key = task->have_next = false;
+        }
+        auto new_dts = task->have_key && frame->dts() != task->key_dts;
+        if (is_key && new_dts && !task->flushing) {
+            // 全I帧流没有非关键帧，关键帧之后的新关键帧即为下一帧
+            // An all-intra stream has no non-key frames, the new key frame after the key frame is the next frame
+            task->have_next = true;
+        } else if (is_key) {
+            if (new_dts) {
+                // gop缓存中还有更新的关键帧，重新收集
+                // There is a newer key frame in the gop cache, collect again
+                task->frames.clear();
+            }
+            task->have_key = true;
+            task->key_dts = frame->dts();
+        } else if (!task->have_key) {
+            return;
+        } else if (frame->dts() != task->key_dts) {
+            task->have_next = true;
+        }
+        task->frames.emplace_back(Frame::getCacheAbleFrame(frame));
+        if (task->have_next && !task->flushing) {
+            decode(task);
+        }
+    }
+
+    void decode(const TaskPtr &task) {
+        auto frames = std::move(task->frames);
+        task->frames.clear();
+        WorkThreadPool::Instance().getPoller()->async([this, task, frames]() {
+            if (task->done) {
+                return;
+            }
+            FFmpegFrame::Ptr out;
+            try {
+                // 只解码一帧，单线程即可
+                // Only one frame is decoded, single thread is enough
+                auto decoder = TaskManager::create<FFmpegDecoder>(task->track, 1);
+                decoder->setOnDecode([&out](const FFmpegFrame::Ptr &frame) {
+                    if (!out) {
+                        out = frame;
+                    }
+                });
+                for (auto &frame : frames) {
+                    decoder->inputFrame(frame, false, false, true);
+                    if (out) {
+                        break;
+                    }
+                }
+                if (!out) {
+                    decoder->flush();
+                }
+            } catch (std::exception &ex) {
+                onTaskDone(task, nullptr, ex.what());
+                return;
+            }
+            if (!out) {
+                onTaskDone(task, nullptr, "decode key frame failed");
+                return;
+            }
+            string data;
+            auto ret = FFmpegUtils::encodeFrame(out, data);
+            if (!std::get<0>(ret) || data.empty()) {
+                onTaskDone(task, nullptr, std::get<1>(ret).empty() ? "encode jpeg failed" : std::get<1>(ret));
+                return;
+            }
+            onTaskDone(task, std::make_shared<BufferString>(std::move(data)), "");
+        });
+    }
+
+    void onTaskDone(const TaskPtr &task, const Buffer::Ptr &jpeg, const string &err_msg) {
+        if (task->done.exchange(true)) {
+            return;
+        }
+        if (task->timer) {
+            task->timer->cancel();
+        }
+        // 在流的归属线程中释放读取器
+        // Release the reader in the owner thread of the stream
+        task->poller->async([task]() {
+            task->reader = nullptr;
+            task->timer = nullptr;
+        }, false);
+
+        GET_CONFIG(float, cache_sec, FFmpeg::kSnapCacheSec);
+        list<onJpeg> waiters;
+        {
+            lock_guard<mutex> lck(_mtx);
+            if (jpeg && cache_sec > 0) {
+                auto &cache = _cache[task->key];
+                cache.jpeg = jpeg;
+                cache.ticker.resetTime();
+            }
+            if (_clear_ticker.elapsedTime() > (std::max)(cache_sec, 1.0f) * 1000) {
+                // 定期清理过期的截图缓存
+                // Periodically clean up expired snapshot caches
+                _clear_ticker.resetTime();
+                for (auto it = _cache.begin(); it != _cache.end();) {
+                    it = it->second.ticker.elapsedTime() >= cache_sec * 1000 ? _cache.erase(it) : std::next(it);
+                }
+            }
+            auto it = _waiters.find(task->key);
+            if (it != _waiters.end()) {
+                waiters.swap(it->second);
+                _waiters.erase(it);
+            }
+            --_running;
+        }
+        for (auto &cb : waiters) {
+            cb(jpeg, err_msg);
+        }
+        startTasks();
+    }
+
+private:
+    mutex _mtx;
+    size_t _running = 0;
+    Ticker _clear_ticker;
+    deque<TaskPtr> _queue;
+    unordered_map<string, Cache> _cache;
+    unordered_map<string, list<onJpeg>> _waiters;
+};
+
 static bool makeSnapAsync(const string &play_url, const string &save_path, float timeout_sec, const FFmpegSnap::onSnap &cb) {
     MediaInfo info(play_url);
     info.stream = getStreamName(info.stream);
     MediaSource::Ptr src;
     Track::Ptr track;
     MultiMediaSourceMuxer::Ptr muxer;
-    if (info.host == "127.0.0.1" || info.host == "localhost" || info.params.find("self=1") != std::string::npos) {
+    if (is_local_ip(info.host) || info.params.find("self=1") != std::string::npos) {
         // 截图zlm本身
         src = MediaSource::find(info.vhost, info.app, info.stream, false);
         track = src ? src->getTrack(TrackVideo) : nullptr;
-        muxer = src ? src->getMuxer() : nullptr;
+        try {
+            muxer = src ? src->getMuxer() : nullptr;
+        } catch (std::exception &) {
+            // 该流无转协议复用器
+            // The stream has no protocol conversion muxer
+        }
     }
-    // 要求开启转码额度
-    if (src && track && muxer) {
-        DebugL << "start snap in fast mode: " << play_url;
-        src->getOwnerPoller()->async([muxer, track, timeout_sec, cb, save_path]() mutable {
-            auto done = std::make_shared<atomic<bool>>(false);
-            auto reader = muxer->getFrameReader();
-            auto timer = EventPollerPool::Instance().getPoller()->doDelayTask(1000 * timeout_sec, [reader, cb, done]() {
-                if (*done) {
-                    return 0;
-                }
-                *done = true;
-                // 防止解码失败导致播放器无法释放
-                cb(false, "decode frame timeout");
-                return 0;
-            });
-
-            // 单线程解码，没必要太快
-            auto decoder = std::make_shared<FFmpegDecoder>(track, 1);
-            decoder->setOnDecode([save_path, cb, done, timer](const FFmpegFrame::Ptr &frame) mutable {
-                if (*done) {
-                    return;
-                }
-                *done = true;
-                timer->cancel();
-
-                auto ret = FFmpegUtils::saveFrame(frame, save_path.data());
-                cb(std::get<0>(ret), std::get<1>(ret));
-            });
-
-            auto decode_poller = WorkThreadPool::Instance().getPoller();
-            reader->setReadCB([decoder, decode_poller, done](const Frame::Ptr &frame) mutable {
-                if (*done) {
-                    // 销毁解码器，防止无谓的解码
-                    decoder = nullptr;
-                    return;
-                }
-                if (frame->getTrackType() == TrackVideo) {
-                    // 异步解码，防止阻塞网络线程
-                    auto copy_frame = Frame::getCacheAbleFrame(frame);
-                    decode_poller->async([decoder, copy_frame, done]() mutable {
-                        if (*done) {
-                            // 销毁解码器，防止无谓的解码
-                            decoder = nullptr;
-                            return;
-                        }
-                        decoder->inputFrame(copy_frame, false, false, true);
-                    });
-                }
-            });
-        });
-        return true;
+    if (!src || !track || !muxer) {
+        return false;
     }
-    return false;
+    DebugL << "start snap in process: " << play_url;
+    SnapEngine::Instance().getSnap(src, muxer, track, timeout_sec, [save_path, cb](const Buffer::Ptr &jpeg, const string &err_msg) {
+        if (!jpeg) {
+            cb(false, err_msg);
+            return;
+        }
+        auto fp = File::create_file(save_path, "wb");
+        if (!fp) {
+            cb(false, "Could not open the file " + save_path);
+            return;
+        }
+        auto ok = fwrite(jpeg->data(), jpeg->size(), 1, fp) == 1;
+        fclose(fp);
+        cb(ok, ok ? "" : "write file failed: " + save_path);
+    });
+    return true;
 }
 
 #endif
 
 void FFmpegSnap::makeSnap(bool async, const string &play_url, const string &save_path, float timeout_sec, const onSnap &cb) {
 #if defined(ENABLE_FFMPEG)
-    if (async) {
+    GET_CONFIG(bool, snap_in_process, FFmpeg::kSnapInProcess);
+    if (async || snap_in_process) {
         if (makeSnapAsync(play_url, save_path, timeout_sec, cb)) {
             return;
         }
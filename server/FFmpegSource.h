@@ -30,6 +30,9 @@ public:
      * 创建截图  [AUTO-TRANSLATED:6d334c49]
      * Create a screenshot
      * @param async 是否使用异步截图方式(非ffmpeg命令行，而是使用zlm api，但是仅限于zlm播放器支持的拉流协议)
+     *              开启ffmpeg.snap_in_process时本机流始终在进程内截图
+     * @param async Whether to use the asynchronous snapshot (zlm api instead of the ffmpeg command line, only for the pull protocols supported by the zlm player)
+     *              local streams are always snapped in process when ffmpeg.snap_in_process is enabled
      * @param play_url 播放url地址，只要FFmpeg支持即可  [AUTO-TRANSLATED:609d4de4]
      * @param play_url The playback URL address, as long as FFmpeg supports it
      * @param save_path 截图jpeg文件保存路径  [AUTO-TRANSLATED:0fc0ac0d]
@@ -4,6 +4,7 @@
 #include "Common/Device.h"
 #include "Util/logger.h"
 #include "Util/util.h"
+#include "Thread/semaphore.h"
 #include "json/value.h"
 #include <Thread/WorkThreadPool.h>
 #include <fstream>
@@ -37,6 +38,52 @@ Param::~Param() {
     VideoStackManager::Instance().unrefChannel(id, width, height, pixfmt); 
 }
 
+static mediakit::FFmpegFrame::Ptr allocFrame(int width, int height, AVPixelFormat pixfmt) {
+    auto frame = std::make_shared<mediakit::FFmpegFrame>();
+    frame->get()->width = width;
+    frame->get()->height = height;
+    frame->get()->format = pixfmt;
+    av_frame_get_buffer(frame->get(), 32);
+    return frame;
+}
+
+// 把通道画面拷贝到拼接画面中的格子
+// Copy the channel picture to the tile in the stacked picture
+static void copyTile(const mediakit::FFmpegFrame::Ptr& buf, const mediakit::FFmpegFrame::Ptr& frame, const Param::Ptr& p) {
+    auto dst = buf->get();
+    auto src = frame->get();
+    // 通道画面与格子同宽高，这里只是防止越界
+    // The channel picture has the same size as the tile, this only prevents out of bounds access
+    int width = MIN(src->width, p->width);
+    int height = MIN(src->height, p->height);
+    switch (p->pixfmt) {
+        case AV_PIX_FMT_YUV420P: {
+            for (int i = 0; i < height; i++) {
+                memcpy(dst->data[0] + dst->linesize[0] * (i + p->posY) + p->posX, src->data[0] + src->linesize[0] * i, width);
+            }
+            // 确保height为奇数时，也能正确的复制到最后一行uv数据  [AUTO-TRANSLATED:69895ea5]
+            // Ensure that the uv data can be copied to the last line correctly when height is odd
+            for (int i = 0; i < (height + 1) / 2; i++) {
+                // U平面  [AUTO-TRANSLATED:8b73dc2d]
+                // U plane
+                memcpy(dst->data[1] + dst->linesize[1] * (i + p->posY / 2) + p->posX / 2, src->data[1] + src->linesize[1] * i, width / 2);
+
+                // V平面  [AUTO-TRANSLATED:8fa72cc7]
+                // V plane
+                memcpy(dst->data[2] + dst->linesize[2] * (i + p->posY / 2) + p->posX / 2, src->data[2] + src->linesize[2] * i, width / 2);
+            }
+            break;
+        }
+        case AV_PIX_FMT_NV12: {
+            // TODO: 待实现  [AUTO-TRANSLATED:247ec1df]
+            // TODO: To be implemented
+            break;
+        }
+
+        default: WarnL << "No support pixformat: " << av_get_pix_fmt_name(p->pixfmt); break;
+    }
+}
+
 Channel::Channel(const std::string& id, int width, int height, AVPixelFormat pixfmt)
     : _id(id), _width(width), _height(height), _pixfmt(pixfmt) {
 #if defined(VIDEOSTACK_KEEP_ASPECT_RATIO)
@@ -46,24 +93,13 @@ Channel::Channel(const std::string& id, int width, int height, AVPixelFormat pix
 #endif
     _lastWidht = 0;
     _lastHeight = 0;
-    _tmp = std::make_shared<mediakit::FFmpegFrame>();
-
-    _tmp->get()->width = _width;
-    _tmp->get()->height = _height;
-    _tmp->get()->format = _pixfmt;
-
-    av_frame_get_buffer(_tmp->get(), 32);
+    _tmp = allocFrame(_width, _height, _pixfmt);
 
     auto frame = VideoStackManager::Instance().getBgImg();
 
     resizeFrame(frame);
 }
 
-void Channel::addParam(const std::weak_ptr<Param>& p) {
-    std::lock_guard<std::recursive_mutex> lock(_mx);
-    _params.push_back(p);
-}
-
 void Channel::onFrame(const mediakit::FFmpegFrame::Ptr& frame) {
     std::weak_ptr<Channel> weakSelf = shared_from_this();
     _poller = _poller ? _poller : toolkit::WorkThreadPool::Instance().getPoller();
@@ -71,53 +107,13 @@ void Channel::onFrame(const mediakit::FFmpegFrame::Ptr& frame) {
         auto self = weakSelf.lock();
         if (!self) { return; }
         self->resizeFrame(frame);
-        self->forEachParam([self](const Param::Ptr& p) { self->fillBuffer(p); });
     });
 }
 
-void Channel::forEachParam(const std::function<void(const Param::Ptr&)>& func) {
-    for (auto& wp : _params) {
-        if (auto sp = wp.lock()) { func(sp); }
-    }
-}
-
-void Channel::fillBuffer(const Param::Ptr& p) {
-    if (auto buf = p->weak_buf.lock()) { copyData(buf, p); }
-}
-
-void Channel::copyData(const mediakit::FFmpegFrame::Ptr& buf, const Param::Ptr& p) {
-
-    switch (p->pixfmt) {
-        case AV_PIX_FMT_YUV420P: {
-            for (int i = 0; i < p->height; i++) {
-                memcpy(buf->get()->data[0] + buf->get()->linesize[0] * (i + p->posY) + p->posX,
-                       _tmp->get()->data[0] + _tmp->get()->linesize[0] * i, _tmp->get()->width);
-            }
-            // 确保height为奇数时，也能正确的复制到最后一行uv数据  [AUTO-TRANSLATED:69895ea5]
-            // Ensure that the uv data can be copied to the last line correctly when height is odd
-            for (int i = 0; i < (p->height + 1) / 2; i++) {
-                // U平面  [AUTO-TRANSLATED:8b73dc2d]
-                // U plane
-                memcpy(buf->get()->data[1] + buf->get()->linesize[1] * (i + p->posY / 2) +
-                           p->posX / 2,
-                       _tmp->get()->data[1] + _tmp->get()->linesize[1] * i, _tmp->get()->width / 2);
-
-                // V平面  [AUTO-TRANSLATED:8fa72cc7]
-                // V plane
-                memcpy(buf->get()->data[2] + buf->get()->linesize[2] * (i + p->posY / 2) +
-                           p->posX / 2,
-                       _tmp->get()->data[2] + _tmp->get()->linesize[2] * i, _tmp->get()->width / 2);
-            }
-            break;
-        }
-        case AV_PIX_FMT_NV12: {
-            // TODO: 待实现  [AUTO-TRANSLATED:247ec1df]
-            // TODO: To be implemented
-            break;
-        }
-
-        default: WarnL << "No support pixformat: " << av_get_pix_fmt_name(p->pixfmt); break;
-    }
+mediakit::FFmpegFrame::Ptr Channel::getFrame(uint64_t& version) {
+    std::lock_guard<std::recursive_mutex> lock(_mx);
+    version = _version;
+    return _tmp;
 }
 
 void Channel::resizeFrame(const mediakit::FFmpegFrame::Ptr &frame) {
@@ -139,7 +135,7 @@ void Channel::resizeFrameImplWithAspectRatio(const mediakit::FFmpegFrame::Ptr &f
     if (srcWidth != _lastWidht || srcHeight != _lastHeight) {
         _lastWidht = srcWidth;
         _lastHeight = srcHeight;
-        fill_yuv_func(_tmp, 16, 128, 128);
+        ++_layout;
 
         int dstWidth = _width;
         int dstHeight = _height;
@@ -163,24 +159,43 @@ void Channel::resizeFrameImplWithAspectRatio(const mediakit::FFmpegFrame::Ptr &f
 
     auto scaledFrame = _sws->inputFrame(frame);
 
+    // 已发布的画面可能正在被拼接线程拷贝，只复用无人引用的备用画面，否则重新申请并填充黑边
+    // The published picture may be being copied by the stacking thread, only the spare picture referenced by no one is reused,
+    // otherwise a new one is allocated and the black borders are filled
+    mediakit::FFmpegFrame::Ptr out;
+    if (_spare && _spare.use_count() == 1) {
+        out = std::move(_spare);
+    } else {
+        _spare = nullptr;
+        out = allocFrame(_width, _height, _pixfmt);
+        fill_yuv_func(out, 16, 128, 128);
+    }
+
     int copyWidth = ((_width) < (scaledFrame->get()->width) ? (_width) : (scaledFrame->get()->width));
     int copyHeight = ((_height) < (scaledFrame->get()->height) ? (_height) : (scaledFrame->get()->height));
 
     for (int i = 0; i < copyHeight; i++) {
         memcpy(
-            _tmp->get()->data[0] + (i + _offsetY) * _tmp->get()->linesize[0] + _offsetX, scaledFrame->get()->data[0] + i * scaledFrame->get()->linesize[0],
+            out->get()->data[0] + (i + _offsetY) * out->get()->linesize[0] + _offsetX, scaledFrame->get()->data[0] + i * scaledFrame->get()->linesize[0],
             copyWidth);
     }
 
     for (int i = 0; i < (copyHeight + 1) / 2; i++) {
         memcpy(
-            _tmp->get()->data[1] + (i + _offsetY / 2) * _tmp->get()->linesize[1] + _offsetX / 2,
+            out->get()->data[1] + (i + _offsetY / 2) * out->get()->linesize[1] + _offsetX / 2,
             scaledFrame->get()->data[1] + i * scaledFrame->get()->linesize[1], copyWidth / 2);
         memcpy(
-            _tmp->get()->data[2] + (i + _offsetY / 2) * _tmp->get()->linesize[2] + _offsetX / 2,
+            out->get()->data[2] + (i + _offsetY / 2) * out->get()->linesize[2] + _offsetX / 2,
             scaledFrame->get()->data[2] + i * scaledFrame->get()->linesize[2], copyWidth / 2);
     }
 
+    std::lock_guard<std::recursive_mutex> lock(_mx);
+    // 布局变化前的画面黑边位置不同，不能再复用
+    // The picture before the layout change has different black border positions and cannot be reused
+    _spare = _tmpLayout == _layout ? std::move(_tmp) : nullptr;
+    _tmp = std::move(out);
+    _tmpLayout = _layout;
+    ++_version;
 }
 
 void Channel::resizeFrameImplWithoutAspectRatio(const mediakit::FFmpegFrame::Ptr &frame) {
@@ -188,7 +203,12 @@ void Channel::resizeFrameImplWithoutAspectRatio(const mediakit::FFmpegFrame::Ptr
         fill_yuv_func(_tmp, 16, 128, 128);
         _sws = std::make_shared<mediakit::FFmpegSws>(_pixfmt, _width, _height);
     }
-    _tmp = _sws->inputFrame(frame);
+    // sws输出帧来自对象池，被拼接线程引用期间不会被复用
+    // The sws output frame comes from an object pool and will not be reused while it is referenced by the stacking thread
+    auto out = _sws->inputFrame(frame);
+    std::lock_guard<std::recursive_mutex> lock(_mx);
+    _tmp = std::move(out);
+    ++_version;
 }
 
 void StackPlayer::addChannel(const std::weak_ptr<Channel>& chn) {
@@ -235,7 +255,8 @@ void StackPlayer::play() {
             // 如果每次不同 可以加个时间戳 time(NULL);
             // TODO:添加使用显卡还是cpu解码的判断逻辑  [AUTO-TRANSLATED:44bef37a]
             // TODO: Add logic to determine whether to use GPU or CPU decoding
-            auto decoder = std::make_shared<mediakit::FFmpegDecoder>(videoTrack, 0, std::vector<std::string> { "h264", "hevc" });
+            auto decoder = mediakit::TaskManager::create<mediakit::FFmpegDecoder>(videoTrack, 0, std::vector<std::string> { "h264", "hevc" });
+            decoder->setTaskName(url);
 
             decoder->setOnDecode([weakSelf](const mediakit::FFmpegFrame::Ptr& frame) mutable {
                 auto self = weakSelf.lock();
@@ -332,23 +353,79 @@ VideoStack::~VideoStack() {
 }
 
 void VideoStack::setParam(const Params& params) {
-    if (_params) {
-        for (auto& p : (*_params)) {
-            if (!p) continue;
-            p->weak_buf.reset();
+    // 新格子的版本均为0，下一帧会全部拷贝一次
+    // The versions of the new tiles are all 0, and they will all be copied once in the next frame
+    std::lock_guard<std::mutex> lock(_mx);
+    initBgColor();
+    _params = params;
+}
+
+void VideoStack::compose() {
+    // 每个任务拷贝的格子数，格子不多时只在当前线程拷贝，避免线程切换开销
+    // Number of tiles copied per task, when there are not many tiles they are only copied in the current thread to avoid the thread switching overhead
+    static constexpr size_t kTilesPerTask = 4;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::pair<Param::Ptr, mediakit::FFmpegFrame::Ptr>> dirty;
+    size_t skipped = 0;
+    std::lock_guard<std::mutex> lock(_mx);
+    if (!_params) {
+        return;
+    }
+    for (auto& p : (*_params)) {
+        if (!p) continue;
+        auto chn = p->weak_chn.lock();
+        if (!chn) continue;
+        uint64_t version;
+        auto frame = chn->getFrame(version);
+        if (!frame || version == p->version) {
+            // 画面自上一帧以来未变化，拼接画面中的内容仍然有效
+            // The picture has not changed since the last frame, the content in the stacked picture is still valid
+            ++skipped;
+            continue;
         }
+        p->version = version;
+        dirty.emplace_back(p, std::move(frame));
     }
 
-    initBgColor();
-    for (auto& p : (*params)) {
-        if (!p) continue;
-        p->weak_buf = _buffer;
-        if (auto chn = p->weak_chn.lock()) {
-            chn->addParam(p);
-            chn->fillBuffer(p);
+    auto blit = [this, &dirty](size_t begin) {
+        auto end = MIN(begin + kTilesPerTask, dirty.size());
+        for (auto i = begin; i < end; ++i) {
+            copyTile(_buffer, dirty[i].second, dirty[i].first);
         }
+    };
+
+    // 各格子互不重叠，可并行拷贝
+    // The tiles do not overlap each other and can be copied in parallel
+    size_t tasks = 0;
+    toolkit::semaphore sem;
+    for (size_t begin = kTilesPerTask; begin < dirty.size(); begin += kTilesPerTask) {
+        ++tasks;
+        toolkit::WorkThreadPool::Instance().getPoller()->async([&blit, &sem, begin]() {
+            blit(begin);
+            sem.post();
+        }, false);
     }
-    _params = params;
+    if (!dirty.empty()) {
+        blit(0);
+    }
+    while (tasks--) {
+        sem.wait();
+    }
+
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> stat_lock(_statMx);
+    ++_stat.frames;
+    _stat.tilesCopied += dirty.size();
+    _stat.tilesSkipped += skipped;
+    _stat.lastMs = ms;
+    _stat.maxMs = MAX(_stat.maxMs, ms);
+    _stat.totalMs += ms;
+}
+
+VideoStack::Statistic VideoStack::getStatistic() {
+    std::lock_guard<std::mutex> lock(_statMx);
+    return _stat;
 }
 
 void VideoStack::start() {
@@ -361,6 +438,8 @@ void VideoStack::start() {
                 std::chrono::milliseconds(frameInterval)) {
                 lastEncTP = std::chrono::steady_clock::now();
 
+                compose();
+                std::lock_guard<std::mutex> lock(_mx);
                 _dev->inputYUV((char**)_buffer->get()->data, _buffer->get()->linesize, pts);
                 pts += frameInterval;
             } else {
@@ -475,6 +554,19 @@ int VideoStackManager::stopVideoStack(const std::string& id) {
     return -1;
 }
 
+std::unordered_map<std::string, VideoStack::Statistic> VideoStackManager::getStatistic() {
+    std::unordered_map<std::string, VideoStack::Ptr> stacks;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mx);
+        stacks = _stackMap;
+    }
+    std::unordered_map<std::string, VideoStack::Statistic> ret;
+    for (auto& pr : stacks) {
+        ret.emplace(pr.first, pr.second->getStatistic());
+    }
+    return ret;
+}
+
 mediakit::FFmpegFrame::Ptr VideoStackManager::getBgImg() { return _bgImg; }
 
 template<typename T> T getJsonValue(const Json::Value& json, const std::string& key) {
@@ -38,7 +38,9 @@ struct Param {
 
     // runtime
     std::weak_ptr<Channel> weak_chn;
-    std::weak_ptr<mediakit::FFmpegFrame> weak_buf;
+    // 最近一次拷贝到拼接画面的通道画面版本，版本未变的格子不再拷贝
+    // The version of the channel picture last copied to the stacked picture, tiles whose version has not changed are not copied again
+    uint64_t version = 0;
 
     ~Param();
 };
@@ -51,17 +53,16 @@ public:
 
     Channel(const std::string& id, int width, int height, AVPixelFormat pixfmt);
 
-    void addParam(const std::weak_ptr<Param>& p);
-
     void onFrame(const mediakit::FFmpegFrame::Ptr& frame);
 
-    void fillBuffer(const Param::Ptr& p);
+    /**
+     * 获取缩放后的最新画面及其版本，画面每更新一次版本加一，返回的画面不会再被修改
+     * Get the latest scaled picture and its version, the version is increased by one each time the picture is updated,
+     * the returned picture will not be modified anymore
+     */
+    mediakit::FFmpegFrame::Ptr getFrame(uint64_t& version);
 
 protected:
-    void forEachParam(const std::function<void(const Param::Ptr&)>& func);
-
-    void copyData(const mediakit::FFmpegFrame::Ptr& buf, const Param::Ptr& p);
-
     void resizeFrame(const mediakit::FFmpegFrame::Ptr &frame);
 
     void resizeFrameImplWithAspectRatio(const mediakit::FFmpegFrame::Ptr &frame);
@@ -80,10 +81,18 @@ private:
     int _offsetX;
     int _offsetY;
 
+    // 保持宽高比时的画面布局版本，布局变化后旧的备用画面的黑边位置不再适用
+    // The picture layout version when keeping the aspect ratio, the black border positions of the old spare picture no longer apply after the layout changes
+    int _layout = 0;
+    int _tmpLayout = 0;
+    uint64_t _version = 0;
+
     mediakit::FFmpegFrame::Ptr _tmp;
+    // 已被替换下来的画面，不再被引用时可复用
+    // The replaced picture, which can be reused when it is no longer referenced
+    mediakit::FFmpegFrame::Ptr _spare;
 
     std::recursive_mutex _mx;
-    std::vector<std::weak_ptr<Param>> _params;
 
     mediakit::FFmpegSws::Ptr _sws;
     toolkit::EventPoller::Ptr _poller;
@@ -123,6 +132,17 @@ class VideoStack {
 public:
     using Ptr = std::shared_ptr<VideoStack>;
 
+    struct Statistic {
+        uint64_t frames = 0;
+        uint64_t tilesCopied = 0;
+        uint64_t tilesSkipped = 0;
+        // 单帧拼接耗时，单位毫秒
+        // Composition time of a single frame, in milliseconds
+        double lastMs = 0;
+        double maxMs = 0;
+        double totalMs = 0;
+    };
+
     VideoStack(const std::string& url, int width = 1920, int height = 1080,
                AVPixelFormat pixfmt = AV_PIX_FMT_YUV420P, float fps = 25.0,
                int bitRate = 2 * 1024 * 1024);
@@ -133,9 +153,17 @@ public:
 
     void start();
 
+    Statistic getStatistic();
+
 protected:
     void initBgColor();
 
+    /**
+     * 把画面有更新的格子拷贝到拼接画面，格子较多时分发到后台线程池并行拷贝
+     * Copy the tiles whose pictures have been updated to the stacked picture, and copy them in parallel in the background thread pool when there are many tiles
+     */
+    void compose();
+
 public:
     Params _params;
 
@@ -154,6 +182,13 @@ private:
     bool _isExit;
 
     std::thread _thread;
+
+    // 保护_params与_buffer
+    // Protect _params and _buffer
+    std::mutex _mx;
+
+    std::mutex _statMx;
+    Statistic _stat;
 };
 
 class VideoStackManager {
@@ -170,6 +205,10 @@ public:
     // You can modify the configuration of the concatenated stream (to switch the content of the concatenated screen) without stopping the stream
     int resetVideoStack(const Json::Value& json);
 
+    // 获取各拼接流的拼接耗时统计
+    // Get the composition time statistics of each stacked stream
+    std::unordered_map<std::string, VideoStack::Statistic> getStatistic();
+
 public:
     static VideoStackManager& Instance();
 
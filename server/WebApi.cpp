@@ -21,6 +21,7 @@
 
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <regex>
 #include "Util/MD5.h"
 #include "Util/util.h"
@@ -42,6 +43,9 @@
 
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/LatencyStat.h"
+#include "Common/MetricsWriter.h"
+#include "Common/UdpBatchSender.h"
 #include "Http/HttpSession.h"
 #include "Http/HttpRequester.h"
 #include "Player/PlayerProxy.h"
@@ -51,6 +55,7 @@
 
 #if defined(ENABLE_RTPPROXY)
 #include "Rtp/RtpServer.h"
+#include "Rtp/RtpBatchReceiver.h"
 #endif
 
 #ifdef ENABLE_WEBRTC
@@ -61,6 +66,7 @@
 #include "../webrtc/WebRtcSignalingSession.h"
 #include "../webrtc/WebRtcProxyPlayer.h"
 #include "../webrtc/WebRtcProxyPlayerImp.h"
+#include "../webrtc/Nack.h"
 #endif
 
 #if defined(ENABLE_VERSION)
@@ -71,6 +77,14 @@
 #include "VideoStack.h"
 #endif
 
+#if defined(ENABLE_FFMPEG)
+#include "Codec/Transcode.h"
+#endif
+
+#if defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
+#include "AbrLadder.h"
+#endif
+
 #include "Onvif/Onvif.h"
 #include "Onvif/SoapUtil.h"
 
@@ -471,6 +485,30 @@ Value ToJson(const PlayerProxy::Ptr& p) {
     return item;
 }
 
+// 延迟直方图转json，单位毫秒
+// Convert the latency histograms to json, in milliseconds
+static Value dumpLatency(const map<string, LatencyStat::Histogram> &histograms) {
+    Value ret(objectValue);
+    for (auto &pr : histograms) {
+        auto &hist = pr.second;
+        auto &obj = ret[pr.first];
+        obj["count"] = (Json::UInt64)hist.count;
+        obj["avgMs"] = hist.count ? (double)hist.sum_ms / hist.count : 0.0;
+        obj["maxMs"] = (Json::UInt64)hist.max_ms;
+        obj["p50Ms"] = (Json::UInt64)hist.percentile(0.5);
+        obj["p90Ms"] = (Json::UInt64)hist.percentile(0.9);
+        obj["p99Ms"] = (Json::UInt64)hist.percentile(0.99);
+        auto &buckets = obj["buckets"];
+        for (size_t i = 0; i < LatencyStat::kBuckets; ++i) {
+            Value bucket;
+            bucket["le"] = i < LatencyStat::kBuckets - 1 ? Value(LatencyStat::kBucketBounds[i]) : Value("+Inf");
+            bucket["count"] = (Json::UInt64)hist.buckets[i];
+            buckets.append(bucket);
+        }
+    }
+    return ret;
+}
+
 Value makeMediaSourceJson(MediaSource &media) {
     Value item;
     item["schema"] = media.getSchema();
@@ -514,6 +552,9 @@ Value makeMediaSourceJson(MediaSource &media) {
         }
     }
     item["tracks"] = std::move(tracks);
+    if (auto latency = LatencyStat::get(media)) {
+        item["latency"] = dumpLatency(latency->getHistograms());
+    }
     return item;
 }
 
@@ -542,29 +583,81 @@ uint16_t openRtpServer(uint16_t local_port, const mediakit::MediaTuple &tuple, i
 
 #endif
 
+// 遍历各类对象的个数统计
+// Traverse the count statistics of each kind of object
+static void forEachObjectCount(const function<void(const char *name, size_t count)> &cb) {
+    cb("MediaSource", ObjectStatistic<MediaSource>::count());
+    cb("MultiMediaSourceMuxer", ObjectStatistic<MultiMediaSourceMuxer>::count());
+
+    cb("TcpServer", ObjectStatistic<TcpServer>::count());
+    cb("TcpSession", ObjectStatistic<TcpSession>::count());
+    cb("UdpServer", ObjectStatistic<UdpServer>::count());
+    cb("UdpSession", ObjectStatistic<UdpSession>::count());
+    cb("TcpClient", ObjectStatistic<TcpClient>::count());
+    cb("Socket", ObjectStatistic<Socket>::count());
+
+    cb("FrameImp", ObjectStatistic<FrameImp>::count());
+    cb("Frame", ObjectStatistic<Frame>::count());
+
+    cb("Buffer", ObjectStatistic<Buffer>::count());
+    cb("BufferRaw", ObjectStatistic<BufferRaw>::count());
+    cb("BufferLikeString", ObjectStatistic<BufferLikeString>::count());
+    cb("BufferList", ObjectStatistic<BufferList>::count());
+
+    cb("RtpPacket", ObjectStatistic<RtpPacket>::count());
+    cb("RtmpPacket", ObjectStatistic<RtmpPacket>::count());
+}
+
 void getStatisticJson(const function<void(Value &val)> &cb) {
     auto obj = std::make_shared<Value>(objectValue);
     auto &val = *obj;
-    val["MediaSource"] = (Json::UInt64)(ObjectStatistic<MediaSource>::count());
-    val["MultiMediaSourceMuxer"] = (Json::UInt64)(ObjectStatistic<MultiMediaSourceMuxer>::count());
-
-    val["TcpServer"] = (Json::UInt64)(ObjectStatistic<TcpServer>::count());
-    val["TcpSession"] = (Json::UInt64)(ObjectStatistic<TcpSession>::count());
-    val["UdpServer"] = (Json::UInt64)(ObjectStatistic<UdpServer>::count());
-    val["UdpSession"] = (Json::UInt64)(ObjectStatistic<UdpSession>::count());
-    val["TcpClient"] = (Json::UInt64)(ObjectStatistic<TcpClient>::count());
-    val["Socket"] = (Json::UInt64)(ObjectStatistic<Socket>::count());
-
-    val["FrameImp"] = (Json::UInt64)(ObjectStatistic<FrameImp>::count());
-    val["Frame"] = (Json::UInt64)(ObjectStatistic<Frame>::count());
-
-    val["Buffer"] = (Json::UInt64)(ObjectStatistic<Buffer>::count());
-    val["BufferRaw"] = (Json::UInt64)(ObjectStatistic<BufferRaw>::count());
-    val["BufferLikeString"] = (Json::UInt64)(ObjectStatistic<BufferLikeString>::count());
-    val["BufferList"] = (Json::UInt64)(ObjectStatistic<BufferList>::count());
-
-    val["RtpPacket"] = (Json::UInt64)(ObjectStatistic<RtpPacket>::count());
-    val["RtmpPacket"] = (Json::UInt64)(ObjectStatistic<RtmpPacket>::count());
+    forEachObjectCount([&](const char *name, size_t count) { val[name] = (Json::UInt64)count; });
+
+    {
+        auto udp = UdpBatchSender::getStatistic();
+        auto &obj = val["UdpBatchSend"];
+        obj["packets"] = (Json::UInt64)udp.packets;
+        obj["syscalls"] = (Json::UInt64)udp.syscalls;
+        obj["gsoPackets"] = (Json::UInt64)udp.gso_packets;
+        obj["fallbackPackets"] = (Json::UInt64)udp.fallback_packets;
+        obj["packetsPerSyscall"] = udp.syscalls ? (double)udp.packets / udp.syscalls : 0.0;
+    }
+#if defined(ENABLE_RTPPROXY)
+    {
+        auto udp = RtpBatchReceiver::getStatistic();
+        auto &obj = val["UdpBatchRecv"];
+        obj["packets"] = (Json::UInt64)udp.packets;
+        obj["syscalls"] = (Json::UInt64)udp.syscalls;
+        obj["groups"] = (Json::UInt64)udp.groups;
+        obj["packetsPerSyscall"] = udp.syscalls ? (double)udp.packets / udp.syscalls : 0.0;
+    }
+#endif
+    {
+        auto cache = HttpFileCache::getStatistic();
+        auto &obj = val["HttpFileCache"];
+        obj["hits"] = (Json::UInt64)cache.hits;
+        obj["misses"] = (Json::UInt64)cache.misses;
+        obj["hitRate"] = cache.hits + cache.misses ? (double)cache.hits / (cache.hits + cache.misses) : 0.0;
+        obj["evictions"] = (Json::UInt64)cache.evictions;
+        obj["invalidations"] = (Json::UInt64)cache.invalidations;
+        obj["files"] = (Json::UInt64)cache.files;
+        obj["bytes"] = (Json::UInt64)cache.bytes;
+        obj["sendFileBytes"] = (Json::UInt64)cache.send_file_bytes;
+    }
+    val["Latency"] = dumpLatency(LatencyStat::getTotalHistograms());
+#if defined(ENABLE_FFMPEG)
+    {
+        auto &arr = val["CodecQueue"] = Value(arrayValue);
+        for (auto &queue : TaskManager::getStatistic()) {
+            Value obj;
+            obj["id"] = (Json::UInt64)queue.id;
+            obj["name"] = queue.name;
+            obj["queueSize"] = (Json::UInt64)queue.queue_size;
+            obj["dropCount"] = (Json::UInt64)queue.drop_count;
+            arr.append(std::move(obj));
+        }
+    }
+#endif
 #ifdef ENABLE_MEM_DEBUG
     auto bytes = getTotalMemUsage();
     val["totalMemUsage"] = (Json::UInt64) bytes;
@@ -627,6 +720,157 @@ void getStatisticJson(const function<void(Value &val)> &cb) {
 #endif
 }
 
+// 每批统计的流个数，分批在后台线程执行，流很多时也不会长时间占用线程
+// Number of streams counted per batch, executed in batches in the background thread, so that the thread is not occupied for a long time
+// even when there are many streams
+static constexpr size_t kMetricsBatchSize = 1000;
+
+static void writeGlobalMetrics(MetricsWriter &writer) {
+    forEachObjectCount([&](const char *name, size_t count) { writer.gauge("zlm_objects", "Number of alive objects by type", { { "type", name } }, count); });
+    {
+        auto udp = UdpBatchSender::getStatistic();
+        writer.counter("zlm_udp_batch_send_packets_total", "Udp packets sent by batch sending", {}, udp.packets);
+        writer.counter("zlm_udp_batch_send_syscalls_total", "System calls made by batch sending", {}, udp.syscalls);
+        writer.counter("zlm_udp_batch_send_gso_packets_total", "Udp packets sent via GSO", {}, udp.gso_packets);
+        writer.counter("zlm_udp_batch_send_fallback_packets_total", "Udp packets falling back to the socket send queue", {}, udp.fallback_packets);
+    }
+#if defined(ENABLE_RTPPROXY)
+    {
+        auto udp = RtpBatchReceiver::getStatistic();
+        writer.counter("zlm_udp_batch_recv_packets_total", "Udp packets received by batch receiving", {}, udp.packets);
+        writer.counter("zlm_udp_batch_recv_syscalls_total", "System calls made by batch receiving", {}, udp.syscalls);
+    }
+#endif
+    {
+        auto cache = HttpFileCache::getStatistic();
+        writer.counter("zlm_http_file_cache_hits_total", "Http file cache hits", {}, cache.hits);
+        writer.counter("zlm_http_file_cache_misses_total", "Http file cache misses", {}, cache.misses);
+        writer.gauge("zlm_http_file_cache_hit_ratio", "Http file cache hit ratio since startup", {},
+                     cache.hits + cache.misses ? (double)cache.hits / (cache.hits + cache.misses) : 0.0);
+        writer.counter("zlm_http_file_cache_evictions_total", "Http file cache evictions", {}, cache.evictions);
+        writer.counter("zlm_http_file_cache_invalidations_total", "Http file cache invalidations", {}, cache.invalidations);
+        writer.gauge("zlm_http_file_cache_files", "Files in the http file cache", {}, cache.files);
+        writer.gauge("zlm_http_file_cache_bytes", "Bytes in the http file cache", {}, cache.bytes);
+        writer.counter("zlm_http_sendfile_bytes_total", "Bytes sent by sendfile", {}, cache.send_file_bytes);
+    }
+#ifdef ENABLE_WEBRTC
+    {
+        auto nack = NackList::getStatistic();
+        writer.counter("zlm_rtc_nack_requested_total", "Rtp packets requested from peers by nack", {}, nack.requested);
+        writer.counter("zlm_rtc_nack_retransmitted_total", "Rtp packets retransmitted on nack from peers", {}, nack.retransmitted);
+        writer.counter("zlm_rtc_nack_missed_total", "Rtp packets requested by peers but no longer cached", {}, nack.missed);
+    }
+#endif
+#if defined(ENABLE_FFMPEG)
+    for (auto &queue : TaskManager::getStatistic()) {
+        MetricsWriter::Labels labels { { "id", to_string(queue.id) }, { "name", queue.name } };
+        writer.gauge("zlm_codec_queue_size", "Tasks waiting in the asynchronous codec queue", labels, queue.queue_size);
+        writer.counter("zlm_codec_queue_drops_total", "Tasks dropped by the asynchronous codec queue", labels, queue.drop_count);
+    }
+#endif
+#if defined(ENABLE_VIDEOSTACK) && defined(ENABLE_X264) && defined(ENABLE_FFMPEG)
+    for (auto &pr : VideoStackManager::Instance().getStatistic()) {
+        auto &stat = pr.second;
+        MetricsWriter::Labels labels { { "id", pr.first } };
+        writer.counter("zlm_stack_frames_total", "Frames composed by the video stack", labels, stat.frames);
+        writer.counter("zlm_stack_compose_ms_total", "Time spent composing video stack frames, in milliseconds", labels, stat.totalMs);
+        writer.gauge("zlm_stack_compose_ms_max", "Maximum composition time of a single video stack frame, in milliseconds", labels, stat.maxMs);
+        writer.counter("zlm_stack_tiles_copied_total", "Video stack tiles copied because their picture changed", labels, stat.tilesCopied);
+        writer.counter("zlm_stack_tiles_skipped_total", "Video stack tiles skipped because their picture did not change", labels, stat.tilesSkipped);
+    }
+#endif
+    vector<double> bounds(LatencyStat::kBucketBounds, LatencyStat::kBucketBounds + LatencyStat::kBuckets - 1);
+    for (auto &pr : LatencyStat::getTotalHistograms()) {
+        auto &hist = pr.second;
+        writer.histogram("zlm_latency_ms", "Latency from receiving to sending by output protocol, in milliseconds", { { "egress", pr.first } }, bounds,
+                         vector<uint64_t>(hist.buckets, hist.buckets + LatencyStat::kBuckets), hist.sum_ms);
+    }
+}
+
+static void writeStreamMetrics(MetricsWriter &writer, unordered_set<const void *> &muxers, MediaSource &media) {
+    auto &tuple = media.getMediaTuple();
+    MetricsWriter::Labels labels { { "vhost", tuple.vhost }, { "app", tuple.app }, { "stream", tuple.stream } };
+    auto schema_labels = labels;
+    schema_labels.emplace_back("schema", media.getSchema());
+    auto speed = media.getBytesSpeed();
+    auto readers = media.readerCount();
+    writer.gauge("zlm_stream_readers", "Players of the stream by protocol", schema_labels, readers);
+    writer.gauge("zlm_stream_bytes_per_second", "Bitrate of the stream by protocol, in bytes per second", schema_labels, speed);
+    writer.counter("zlm_stream_bytes_total", "Bytes of the stream by protocol", schema_labels, media.getTotalBytes());
+    writer.gauge("zlm_stream_egress_bytes_per_second", "Estimated egress bitrate by protocol (bitrate x players), in bytes per second",
+                 schema_labels, (double)speed * readers);
+
+    MultiMediaSourceMuxer::Ptr muxer;
+    try {
+        muxer = media.getMuxer();
+    } catch (std::exception &) {
+    }
+    if (!muxer || !muxers.emplace(muxer.get()).second) {
+        return;
+    }
+    // 以下为各协议共享的指标，每个流只输出一次
+    // The following metrics are shared by all protocols, output only once per stream
+    writer.gauge("zlm_stream_total_readers", "Players of the stream over all protocols", labels, media.totalReaderCount());
+    writer.gauge("zlm_stream_alive_seconds", "Online duration of the stream, in seconds", labels, media.getAliveSecond());
+    writer.counter("zlm_stream_ingest_bytes_total", "Bytes of frames received by the stream", labels, muxer->getIngestBytes());
+    writer.gauge("zlm_stream_gop_cache_bytes", "Estimated bytes of frames in the gop cache of the stream", labels, muxer->getGopCacheBytes());
+    writer.counter("zlm_stream_dropped_frames_total", "Frames dropped because the tracks were not ready", labels, muxer->getDroppedFrames());
+}
+
+static void writePollerMetrics(MetricsWriter &writer, TaskExecutorGetterImp &getter, const char *pool, const vector<int> &delays) {
+    auto loads = getter.getExecutorLoad();
+    size_t i = 0;
+    getter.for_each([&](const TaskExecutor::Ptr &executor) {
+        auto poller = std::static_pointer_cast<EventPoller>(executor);
+        MetricsWriter::Labels labels { { "pool", pool }, { "thread", poller->getThreadName() } };
+        if (i < loads.size()) {
+            writer.gauge("zlm_poller_load", "Load of the poller thread, in percent", labels, loads[i]);
+        }
+        if (i < delays.size()) {
+            writer.gauge("zlm_poller_delay_ms", "Task queue delay of the poller thread, in milliseconds", labels, delays[i]);
+        }
+        writer.gauge("zlm_poller_fds", "File descriptors listened by the poller thread", labels, poller->fdCount());
+        ++i;
+    });
+}
+
+static void writeStreamsInBatch(const EventPoller::Ptr &poller, const std::shared_ptr<MetricsWriter> &writer,
+                                const std::shared_ptr<vector<MediaSource::Ptr>> &medias, const std::shared_ptr<unordered_set<const void *>> &muxers,
+                                size_t offset, const function<void()> &done) {
+    poller->async([=]() {
+        auto end = (std::min)(offset + kMetricsBatchSize, medias->size());
+        for (auto i = offset; i < end; ++i) {
+            writeStreamMetrics(*writer, *muxers, *(*medias)[i]);
+            // 尽早释放流的引用
+            // Release the reference to the stream as early as possible
+            (*medias)[i] = nullptr;
+        }
+        if (end < medias->size()) {
+            writeStreamsInBatch(poller, writer, medias, muxers, end, done);
+        } else {
+            done();
+        }
+    }, false);
+}
+
+void getMetricsText(const function<void(const string &text)> &cb) {
+    auto writer = std::make_shared<MetricsWriter>();
+    writeGlobalMetrics(*writer);
+
+    auto medias = std::make_shared<vector<MediaSource::Ptr>>();
+    MediaSource::for_each_media([&](const MediaSource::Ptr &media) { medias->emplace_back(media); });
+    auto muxers = std::make_shared<unordered_set<const void *>>();
+    writeStreamsInBatch(WorkThreadPool::Instance().getPoller(), writer, medias, muxers, 0, [writer, cb]() {
+        EventPollerPool::Instance().getExecutorDelay([writer, cb](const vector<int> &delays) {
+            writePollerMetrics(*writer, EventPollerPool::Instance(), "event", delays);
+            WorkThreadPool::Instance().getExecutorDelay([writer, cb](const vector<int> &delays) {
+                writePollerMetrics(*writer, WorkThreadPool::Instance(), "work", delays);
+                cb(writer->str());
+            });
+        });
+    });
+}
+
 void updateStreamProxy(const mediakit::MediaTuple &tuple, const std::string &url, const toolkit::mINI &args) {
     auto key = tuple.shortUrl();
     auto player = s_player_proxy.find(key);
@@ -638,6 +882,12 @@ void updateStreamProxy(const mediakit::MediaTuple &tuple, const std::string &url
     });
 }
 
+static void delAbrLadder(const string &key) {
+#if defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
+    AbrLadderManager::Instance().del(key);
+#endif
+}
+
 void addStreamProxy(const MediaTuple &tuple, const string &url, int retry_count, bool force,
                     const ProtocolOption &option, float timeout_sec, const mINI &args,
                     const function<void(const SockException &ex, const string &key)> &cb) {
@@ -648,6 +898,19 @@ void addStreamProxy(const MediaTuple &tuple, const string &url, int retry_count,
         cb(SockException(Err_other, "This stream already exists"), key);
         return;
     }
+#if defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
+    auto abr_ladder = args.find("abr_ladder");
+    if (abr_ladder != args.end() && !abr_ladder->second.empty()) {
+        // 码率阶梯转码，拉流成功(源流注册)后自动启动
+        // Bitrate ladder transcoding, started automatically after the stream is pulled successfully (the source stream is registered)
+        try {
+            AbrLadderManager::Instance().add(tuple, abr_ladder->second);
+        } catch (std::exception &ex) {
+            cb(SockException(Err_other, ex.what()), key);
+            return;
+        }
+    }
+#endif
     // 添加拉流代理  [AUTO-TRANSLATED:aa516f44]
     // Add pull stream proxy
     auto player = s_player_proxy.make(key, tuple, option, retry_count);
@@ -675,6 +938,7 @@ void addStreamProxy(const MediaTuple &tuple, const string &url, int retry_count,
             if (ex) {
                 // 失败则移除记录
                 s_player_proxy.erase(key);
+                delAbrLadder(key);
             }
             cb(ex, key);
         }
@@ -684,6 +948,7 @@ void addStreamProxy(const MediaTuple &tuple, const string &url, int retry_count,
     // The pull stream was actively closed
     player->setOnClose([key](const SockException &ex) {
         s_player_proxy.erase(key);
+        delAbrLadder(key);
     });
     player->play(url);
 };
@@ -1355,7 +1620,11 @@ void installWebApi() {
     api_regist("/index/api/delStreamProxy",[](API_ARGS_MAP){
         CHECK_SECRET();
         CHECK_ARGS("key");
-        val["data"]["flag"] = s_player_proxy.erase(allArgs["key"]) == 1;
+        auto flag = s_player_proxy.erase(allArgs["key"]) == 1;
+        if (flag) {
+            delAbrLadder(allArgs["key"]);
+        }
+        val["data"]["flag"] = flag;
     });
 
     static auto addFFmpegSource = [](const string &ffmpeg_cmd_key,
@@ -2182,6 +2451,18 @@ void installWebApi() {
         });
     });
 
+    // 获取prometheus文本格式的统计指标
+    // Get the metrics in prometheus text format
+    // 测试url http://127.0.0.1/index/api/metrics
+    // Test url http://127.0.0.1/index/api/metrics
+    api_regist("/index/api/metrics", [](API_ARGS_MAP_ASYNC) {
+        CHECK_SECRET();
+        getMetricsText([headerOut, invoker](const string &text) mutable {
+            headerOut["Content-Type"] = "text/plain; version=0.0.4; charset=utf-8";
+            invoker(200, headerOut, text);
+        });
+    });
+
 #ifdef ENABLE_WEBRTC
     api_regist("/index/api/webrtc",[](API_ARGS_STRING_ASYNC){
         CHECK_ARGS("type");
@@ -2604,6 +2885,53 @@ void installWebApi() {
         val["msg"] = ret ? "failed" : "success";
         invoker(200, headerOut, val.toStyledString());
     });
+
+    // 获取各拼接流的拼接耗时与格子拷贝统计
+    // Get the composition time and tile copy statistics of each stacked stream
+    api_regist("/index/api/stack/statistic", [](API_ARGS_MAP) {
+        CHECK_SECRET();
+        for (auto &pr : VideoStackManager::Instance().getStatistic()) {
+            auto &stat = pr.second;
+            Value obj;
+            obj["id"] = pr.first;
+            obj["frames"] = (Json::UInt64)stat.frames;
+            obj["tiles_copied"] = (Json::UInt64)stat.tilesCopied;
+            obj["tiles_skipped"] = (Json::UInt64)stat.tilesSkipped;
+            obj["last_compose_ms"] = stat.lastMs;
+            obj["max_compose_ms"] = stat.maxMs;
+            obj["avg_compose_ms"] = stat.frames ? stat.totalMs / stat.frames : 0;
+            val["data"].append(obj);
+        }
+    });
+#endif
+
+#if defined(ENABLE_FFMPEG) && defined(ENABLE_X264)
+    // 添加码率阶梯转码：源流只解码一次，输出多路h264同级流(如stream_720)，并在源流hls目录下生成master.m3u8
+    // Add bitrate ladder transcoding: the source stream is decoded only once, multiple h264 sibling streams (such as stream_720) are output,
+    // and master.m3u8 is generated in the hls directory of the source stream
+    // http://127.0.0.1/index/api/startAbrLadder?vhost=__defaultVhost__&app=live&stream=test&renditions=720:2000,480:800
+    api_regist("/index/api/startAbrLadder", [](API_ARGS_MAP) {
+        CHECK_SECRET();
+        CHECK_ARGS("app", "stream", "renditions");
+        std::string vhost = DEFAULT_VHOST;
+        if (!allArgs["vhost"].empty()) {
+            vhost = allArgs["vhost"];
+        }
+        AbrLadderManager::Instance().add(MediaTuple { vhost, allArgs["app"], allArgs["stream"], "" }, allArgs["renditions"]);
+    });
+
+    // 停止码率阶梯转码
+    // Stop bitrate ladder transcoding
+    // http://127.0.0.1/index/api/stopAbrLadder?vhost=__defaultVhost__&app=live&stream=test
+    api_regist("/index/api/stopAbrLadder", [](API_ARGS_MAP) {
+        CHECK_SECRET();
+        CHECK_ARGS("app", "stream");
+        std::string vhost = DEFAULT_VHOST;
+        if (!allArgs["vhost"].empty()) {
+            vhost = allArgs["vhost"];
+        }
+        val["data"]["flag"] = AbrLadderManager::Instance().del(MediaTuple { vhost, allArgs["app"], allArgs["stream"], "" }.shortUrl());
+    });
 #endif
 
     // 设置流播放速度
@@ -382,7 +382,7 @@ Value的值就是fps。
  * [AUTO-TRANSLATED:b730fe72]
 } x264_param_t;*/
 
-bool H264Encoder::init(int iWidth, int iHeight, int iFps, int iBitRate) {
+bool H264Encoder::init(int iWidth, int iHeight, int iFps, int iBitRate, bool key_frame_driven) {
     if (_pX264Handle) {
         return true;
     }
@@ -401,6 +401,12 @@ bool H264Encoder::init(int iWidth, int iHeight, int iFps, int iBitRate) {
     pX264Param->i_frame_total = 0; //* 编码总帧数.不知道用0.
     pX264Param->i_keyint_max = iFps * 3; //ffmpeg:gop_size 关键帧最大间隔
     pX264Param->i_keyint_min = iFps * 1; //ffmpeg:keyint_min 关键帧最小间隔
+    if (key_frame_driven) {
+        // 关键帧位置完全由调用者决定，以便多路输出的IDR对齐
+        // The key frame position is entirely decided by the caller, so that the IDRs of multiple outputs are aligned
+        pX264Param->i_keyint_max = X264_KEYINT_MAX_INFINITE;
+        pX264Param->i_scenecut_threshold = 0;
+    }
     //* Rate control Parameters
     pX264Param->rc.i_bitrate = iBitRate / 1000;        //* 码率(比特率,单位Kbps)
     pX264Param->rc.i_qp_step = 1;    //最大的在帧与帧之间进行切变的量化因子的变化量。ffmpeg:max_qdiff
@@ -505,7 +511,7 @@ bool H264Encoder::init(int iWidth, int iHeight, int iFps, int iBitRate) {
     return true;
 }
 
-int H264Encoder::inputData(char *yuv[3], int linesize[3], int64_t cts, H264Frame **out_frame) {
+int H264Encoder::inputData(char *yuv[3], int linesize[3], int64_t cts, H264Frame **out_frame, bool key_frame) {
     //TimeTicker1(5);
     _pPicIn->img.i_stride[0] = linesize[0];
     _pPicIn->img.i_stride[1] = linesize[1];
@@ -514,6 +520,7 @@ int H264Encoder::inputData(char *yuv[3], int linesize[3], int64_t cts, H264Frame
     _pPicIn->img.plane[1] = (uint8_t *) yuv[1];
     _pPicIn->img.plane[2] = (uint8_t *) yuv[2];
     _pPicIn->i_pts = cts;
+    _pPicIn->i_type = key_frame ? X264_TYPE_IDR : X264_TYPE_AUTO;
     int iNal;
     x264_nal_t *pNals;
 
@@ -35,8 +35,21 @@ public:
     H264Encoder();
     ~H264Encoder();
 
-    bool init(int iWidth, int iHeight, int iFps, int iBitRate);
-    int inputData(char *yuv[3], int linesize[3], int64_t cts, H264Frame **out_frame);
+    /**
+     * 初始化编码器
+     * @param key_frame_driven 为true时关闭场景切换检测与固定gop，仅在inputData指定时编码IDR帧
+     * Initialize the encoder
+     * @param key_frame_driven When true, scene cut detection and fixed gop are disabled, IDR frames are encoded only when specified by inputData
+     */
+    bool init(int iWidth, int iHeight, int iFps, int iBitRate, bool key_frame_driven = false);
+
+    /**
+     * 编码一帧yuv
+     * @param key_frame 是否强制编码为IDR帧
+     * Encode one yuv frame
+     * @param key_frame Whether to force encoding as an IDR frame
+     */
+    int inputData(char *yuv[3], int linesize[3], int64_t cts, H264Frame **out_frame, bool key_frame = false);
 
 private:
     x264_t *_pX264Handle = nullptr;
@@ -12,10 +12,16 @@
 #if !defined(_WIN32)
 #include <dlfcn.h>
 #endif
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <condition_variable>
 #include "Util/File.h"
 #include "Util/uv_errno.h"
+#include "Thread/WorkThreadPool.h"
 #include "Transcode.h"
 #include "Common/config.h"
+#include "Extension/Factory.h"
 
 #define MAX_DELAY_SECOND 3
 
@@ -108,74 +114,304 @@ static bool checkIfSupportedNvidia() {
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-bool TaskManager::addEncodeTask(function<void()> task) {
-    {
-        lock_guard<mutex> lck(_task_mtx);
-        _task.emplace_back(std::move(task));
-        if (_task.size() > _max_task) {
-            WarnL << "encoder thread task is too more, now drop frame!";
-            _task.pop_front();
-        }
+/**
+ * 串行任务队列，同一时间最多只有一个编解码线程在执行它的任务
+ * Serial task queue, at most one codec thread executes its tasks at the same time
+ */
+class CodecTaskQueue {
+public:
+    using Ptr = std::shared_ptr<CodecTaskQueue>;
+
+    uint64_t id = 0;
+    string name;
+    size_t max_task = 30;
+    bool decode_drop_start = false;
+    // 已停止，不再接收新任务
+    // Stopped, no longer accept new tasks
+    bool closed = false;
+    // 已在线程池的就绪队列中或正在被执行
+    // Already in the ready queue of the thread pool or being executed
+    bool scheduled = false;
+    atomic<uint64_t> drop_count { 0 };
+    mutex mtx;
+    condition_variable cond;
+    List<function<void()> > tasks;
+};
+
+// 当前线程正在执行的队列
+// The queue being executed by the current thread
+static thread_local CodecTaskQueue *s_current_queue = nullptr;
+
+/**
+ * 全局共享的编解码线程池，以队列为单位调度
+ * 每次最多执行一个队列的kBatchSize个任务后轮转到下一个队列，防止单路流长时间占用线程
+ * Globally shared codec thread pool, scheduled by queue
+ * At most kBatchSize tasks of a queue are executed each time before rotating to the next queue, to prevent a single stream from occupying the thread for a long time
+ */
+class CodecExecutor {
+public:
+    static constexpr size_t kBatchSize = 8;
+
+    static CodecExecutor &Instance() {
+        static CodecExecutor s_instance;
+        return s_instance;
     }
-    _sem.post();
-    return true;
-}
 
-bool TaskManager::addDecodeTask(bool key_frame, function<void()> task) {
-    {
-        lock_guard<mutex> lck(_task_mtx);
-        if (_decode_drop_start) {
-            if (!key_frame) {
-                TraceL << "decode thread drop frame";
+    CodecTaskQueue::Ptr create(const string &name, size_t max_task) {
+        auto ret = std::make_shared<CodecTaskQueue>();
+        ret->name = name;
+        ret->max_task = max_task;
+        lock_guard<mutex> lck(_mtx);
+        ret->id = ++_last_id;
+        _queues.emplace(ret->id, ret);
+        return ret;
+    }
+
+    void remove(uint64_t id) {
+        lock_guard<mutex> lck(_mtx);
+        _queues.erase(id);
+    }
+
+    /**
+     * 添加任务，队列空闲时将其加入就绪队列
+     * Add a task, put the queue into the ready queue if it is idle
+     * @param key_frame 是否为关键帧，仅解码任务有效
+     * @param key_frame Whether it is a key frame, only valid for decoding tasks
+     */
+    bool addTask(const CodecTaskQueue::Ptr &queue, bool decode, bool key_frame, function<void()> task) {
+        {
+            lock_guard<mutex> lck(queue->mtx);
+            if (queue->closed) {
                 return false;
             }
-            _decode_drop_start = false;
-            InfoL << "decode thread stop drop frame";
+            if (decode) {
+                if (queue->decode_drop_start) {
+                    if (!key_frame) {
+                        TraceL << "decode thread drop frame";
+                        ++queue->drop_count;
+                        return false;
+                    }
+                    queue->decode_drop_start = false;
+                    InfoL << "decode thread stop drop frame";
+                }
+                queue->tasks.emplace_back(std::move(task));
+                if (queue->tasks.size() > queue->max_task) {
+                    queue->decode_drop_start = true;
+                    WarnL << "decode thread start drop frame";
+                }
+            } else {
+                queue->tasks.emplace_back(std::move(task));
+                if (queue->tasks.size() > queue->max_task) {
+                    WarnL << "encoder thread task is too more, now drop frame!";
+                    queue->tasks.pop_front();
+                    ++queue->drop_count;
+                }
+            }
+            if (queue->scheduled) {
+                return true;
+            }
+            queue->scheduled = true;
+        }
+        schedule(queue);
+        return true;
+    }
+
+    vector<TaskManager::Statistic> getStatistic() {
+        vector<CodecTaskQueue::Ptr> queues;
+        {
+            lock_guard<mutex> lck(_mtx);
+            for (auto &pr : _queues) {
+                if (auto queue = pr.second.lock()) {
+                    queues.emplace_back(std::move(queue));
+                }
+            }
+        }
+        vector<TaskManager::Statistic> ret;
+        for (auto &queue : queues) {
+            lock_guard<mutex> lck(queue->mtx);
+            ret.emplace_back(TaskManager::Statistic { queue->id, queue->name, queue->tasks.size(), queue->drop_count.load() });
         }
+        return ret;
+    }
 
-        _task.emplace_back(std::move(task));
-        if (_task.size() > _max_task) {
-            _decode_drop_start = true;
-            WarnL << "decode thread start drop frame";
+private:
+    CodecExecutor() {
+        auto size = (std::max)(thread::hardware_concurrency(), 1u);
+        for (unsigned i = 0; i < size; ++i) {
+            _threads.emplace_back([this, i]() { onThreadRun("codec " + to_string(i)); });
         }
+        InfoL << "codec thread pool size: " << size;
     }
-    _sem.post();
-    return true;
+
+    ~CodecExecutor() {
+        {
+            lock_guard<mutex> lck(_mtx);
+            _exit = true;
+        }
+        _cond.notify_all();
+        for (auto &thread : _threads) {
+            thread.join();
+        }
+    }
+
+    void schedule(const CodecTaskQueue::Ptr &queue) {
+        {
+            lock_guard<mutex> lck(_mtx);
+            _ready.emplace_back(queue);
+        }
+        _cond.notify_one();
+    }
+
+    void onThreadRun(const string &name) {
+        setThreadName(name.data());
+        while (true) {
+            CodecTaskQueue::Ptr queue;
+            {
+                unique_lock<mutex> lck(_mtx);
+                _cond.wait(lck, [this]() { return _exit || !_ready.empty(); });
+                if (_exit) {
+                    break;
+                }
+                queue = std::move(_ready.front());
+                _ready.pop_front();
+            }
+            runQueue(queue);
+        }
+        InfoL << name << " exited!";
+    }
+
+    void runQueue(const CodecTaskQueue::Ptr &queue) {
+        s_current_queue = queue.get();
+        for (size_t i = 0; i < kBatchSize; ++i) {
+            function<void()> task;
+            {
+                lock_guard<mutex> lck(queue->mtx);
+                if (queue->tasks.empty()) {
+                    break;
+                }
+                task = std::move(queue->tasks.front());
+                queue->tasks.pop_front();
+            }
+            try {
+                TimeTicker2(50, TraceL);
+                task();
+            } catch (std::exception &ex) {
+                WarnL << ex.what();
+            } catch (...) {
+                WarnL << "catch one unknown exception";
+            }
+        }
+        s_current_queue = nullptr;
+
+        bool again;
+        {
+            lock_guard<mutex> lck(queue->mtx);
+            again = !queue->tasks.empty();
+            queue->scheduled = again;
+        }
+        if (again) {
+            // 排到就绪队列末尾，让其他流的任务先执行
+            // Put it at the end of the ready queue to let the tasks of other streams execute first
+            schedule(queue);
+        } else {
+            queue->cond.notify_all();
+        }
+    }
+
+private:
+    bool _exit = false;
+    uint64_t _last_id = 0;
+    mutex _mtx;
+    condition_variable _cond;
+    vector<thread> _threads;
+    deque<CodecTaskQueue::Ptr> _ready;
+    unordered_map<uint64_t, std::weak_ptr<CodecTaskQueue> > _queues;
+};
+
+bool TaskManager::addEncodeTask(function<void()> task) {
+    return _queue && CodecExecutor::Instance().addTask(_queue, false, false, std::move(task));
+}
+
+bool TaskManager::addDecodeTask(bool key_frame, function<void()> task) {
+    return _queue && CodecExecutor::Instance().addTask(_queue, true, key_frame, std::move(task));
 }
 
 void TaskManager::setMaxTaskSize(size_t size) {
     CHECK(size >= 3 && size <= 1000, "async task size limited to 3 ~ 1000, now size is:", size);
     _max_task = size;
+    if (_queue) {
+        lock_guard<mutex> lck(_queue->mtx);
+        _queue->max_task = size;
+    }
+}
+
+void TaskManager::setTaskName(string name) {
+    _name = std::move(name);
+    if (_queue) {
+        lock_guard<mutex> lck(_queue->mtx);
+        _queue->name = _name;
+    }
+}
+
+size_t TaskManager::getTaskSize() const {
+    if (!_queue) {
+        return 0;
+    }
+    lock_guard<mutex> lck(_queue->mtx);
+    return _queue->tasks.size();
+}
+
+uint64_t TaskManager::getDropCount() const {
+    return _queue ? _queue->drop_count.load() : 0;
+}
+
+vector<TaskManager::Statistic> TaskManager::getStatistic() {
+    return CodecExecutor::Instance().getStatistic();
 }
 
 void TaskManager::startThread(const string &name) {
-    _thread.reset(new thread([this, name]() {
-        onThreadRun(name);
-    }), [](thread *ptr) {
-        if (ptr->joinable()) {
-            ptr->join();
-        }
-        delete ptr;
-    });
+    if (!_queue) {
+        _queue = CodecExecutor::Instance().create(_name.empty() ? name : _name, _max_task);
+    }
 }
 
 void TaskManager::stopThread(bool drop_task) {
     TimeTicker();
-    if (!_thread) {
+    if (auto queue = std::move(_queue)) {
+        {
+            lock_guard<mutex> lck(queue->mtx);
+            queue->closed = true;
+            if (drop_task) {
+                queue->tasks.clear();
+            }
+        }
+        CodecExecutor::Instance().remove(queue->id);
+        _stopped_queue = std::move(queue);
+    }
+    if (!s_current_queue) {
+        waitStopped();
+    }
+}
+
+void TaskManager::waitStopped() {
+    auto queue = std::move(_stopped_queue);
+    if (!queue) {
         return;
     }
-    {
-        lock_guard<mutex> lck(_task_mtx);
-        if (drop_task) {
-            _exit = true;
-            _task.clear();
-        }
-        _task.emplace_back([]() {
-            throw ThreadExitException();
-        });
+    // 等待正在执行的任务(及未丢弃的剩余任务)完成，防止其访问已销毁的对象
+    // Wait for the task being executed (and the remaining tasks not dropped) to complete, to prevent it from accessing destroyed objects
+    unique_lock<mutex> lck(queue->mtx);
+    queue->cond.wait(lck, [&]() { return !queue->scheduled; });
+}
+
+void TaskManager::release(TaskManager *ptr) {
+    if (!s_current_queue) {
+        delete ptr;
+        return;
     }
-    _sem.post(10);
-    _thread = nullptr;
+    // 编解码线程中不能等待，转移到后台线程析构
+    // Can not wait in a codec thread, move the destruction to a background thread
+    WorkThreadPool::Instance().getPoller()->async([ptr]() { delete ptr; }, false);
 }
 
 TaskManager::~TaskManager() {
@@ -183,39 +419,7 @@ TaskManager::~TaskManager() {
 }
 
 bool TaskManager::isEnabled() const {
-    return _thread.operator bool();
-}
-
-void TaskManager::onThreadRun(const string &name) {
-    setThreadName(name.data());
-    function<void()> task;
-    _exit = false;
-    while (!_exit) {
-        _sem.wait();
-        {
-            unique_lock<mutex> lck(_task_mtx);
-            if (_task.empty()) {
-                continue;
-            }
-            task = _task.front();
-            _task.pop_front();
-        }
-
-        try {
-            TimeTicker2(50, TraceL);
-            task();
-            task = nullptr;
-        } catch (ThreadExitException &ex) {
-            break;
-        } catch (std::exception &ex) {
-            WarnL << ex.what();
-            continue;
-        } catch (...) {
-            WarnL << "catch one unknown exception";
-            throw;
-        }
-    }
-    InfoL << name << " exited!";
+    return _queue.operator bool();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -761,17 +965,165 @@ FFmpegFrame::Ptr FFmpegSws::inputFrame(const FFmpegFrame::Ptr &frame, int &ret,
     return nullptr;
 }
 
-std::tuple<bool, std::string> FFmpegUtils::saveFrame(const FFmpegFrame::Ptr &frame, const char *filename, AVPixelFormat fmt, int w, int h, const char *font_path) {
-    std::shared_ptr<AVFilterGraph> _filter_graph;
-    AVFilterContext *buffersrc_ctx = nullptr;
-    AVFilterContext *buffersink_ctx = nullptr;
-    const AVFilter *buffersrc = nullptr;
-    const AVFilter *buffersink = nullptr;
-    // kServerName
-    const string mark = "ZLMediaKit"; 
-    char drawtext_args1[512];
-    _StrPrinter ss;
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 输出时间戳与源时间戳偏差超过该值时重新对齐，单位毫秒
+// Realign when the output timestamp deviates from the source timestamp by more than this value, in milliseconds
+static constexpr int64_t kMaxAudioStampDrift = 500;
+
+FFmpegAudioTranscoder::FFmpegAudioTranscoder(const Track::Ptr &track, CodecId codec, int bit_rate) {
+    setupFFmpeg();
+    auto audio = dynamic_pointer_cast<AudioTrack>(track);
+    if (!audio) {
+        throw std::invalid_argument("转码源不是音频track");
+    }
+    const AVCodec *encoder = nullptr;
+    int sample_rate = 0;
+    int channels = 0;
+    switch (codec) {
+        case CodecOpus:
+            // 优先使用libopus，ffmpeg自带的opus编码器为实验性质，且只支持48000hz
+            // Prefer libopus, the built-in opus encoder of ffmpeg is experimental and only supports 48000hz
+            encoder = getCodec<false>({ { AV_CODEC_ID_OPUS }, { "libopus" } });
+            sample_rate = 48000;
+            channels = 2;
+            break;
+        case CodecAAC:
+            encoder = getCodec<false>({ { AV_CODEC_ID_AAC }, { "libfdk_aac" } });
+            sample_rate = audio->getAudioSampleRate();
+            channels = MAX(1, MIN(audio->getAudioChannel(), 2));
+            break;
+        default: throw std::invalid_argument(StrPrinter << "不支持转码为:" << getCodecName(codec));
+    }
+    if (!encoder) {
+        throw std::runtime_error(StrPrinter << "未找到编码器:" << getCodecName(codec));
+    }
+
+    _context.reset(avcodec_alloc_context3(encoder), [](AVCodecContext *ctx) { avcodec_free_context(&ctx); });
+    if (!_context) {
+        throw std::runtime_error("创建编码器失败");
+    }
+    _context->sample_fmt = encoder->sample_fmts ? encoder->sample_fmts[0] : AV_SAMPLE_FMT_S16;
+    _context->sample_rate = sample_rate;
+    _context->bit_rate = bit_rate;
+    _context->time_base = { 1, sample_rate };
+    // aac的AudioSpecificConfig放在extradata中，而不是每帧的adts头里
+    // The AudioSpecificConfig of aac is put in extradata instead of the adts header of each frame
+    _context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+#if LIBAVCODEC_VERSION_INT >= FF_CODEC_VER_7_1
+    av_channel_layout_default(&_context->ch_layout, channels);
+#else
+    _context->channels = channels;
+    _context->channel_layout = av_get_default_channel_layout(channels);
+#endif
+
+    AVDictionary *dict = nullptr;
+    av_dict_set(&dict, "strict", "-2", 0);
+    auto ret = avcodec_open2(_context.get(), encoder, &dict);
+    av_dict_free(&dict);
+    if (ret < 0) {
+        throw std::runtime_error(StrPrinter << "打开编码器" << encoder->name << "失败:" << ffmpeg_err(ret));
+    }
+    InfoL << "打开编码器成功:" << encoder->name << ", " << sample_rate << "hz, " << channels << " channels";
+
+    _fifo.reset(av_audio_fifo_alloc(_context->sample_fmt, channels, 1), [](AVAudioFifo *fifo) { av_audio_fifo_free(fifo); });
+#if LIBAVCODEC_VERSION_INT >= FF_CODEC_VER_7_1
+    _swr.reset(new FFmpegSwr(_context->sample_fmt, &_context->ch_layout, sample_rate));
+#else
+    _swr.reset(new FFmpegSwr(_context->sample_fmt, channels, _context->channel_layout, sample_rate));
+#endif
+
+    _track = Factory::getTrackByCodecId(codec, sample_rate, channels, 16);
+    if (!_track) {
+        throw std::runtime_error(StrPrinter << "创建track失败:" << getCodecName(codec));
+    }
+    if (_context->extradata_size > 0) {
+        _track->setExtraData(_context->extradata, _context->extradata_size);
+    }
 
+    _decoder = TaskManager::create<FFmpegDecoder>(track);
+    _decoder->setOnDecode([this](const FFmpegFrame::Ptr &frame) { onDecode(frame); });
+    startThread("audio transcoder");
+}
+
+FFmpegAudioTranscoder::~FFmpegAudioTranscoder() {
+    stopThread(true);
+}
+
+void FFmpegAudioTranscoder::setOnOutput(onOutput cb) {
+    _cb = std::move(cb);
+}
+
+bool FFmpegAudioTranscoder::inputFrame(const Frame::Ptr &frame) {
+    // 解码与编码在同一个串行队列中执行，音频帧都可独立解码，积压时直接丢弃最旧的帧
+    // Decoding and encoding are executed in the same serial queue, every audio frame can be decoded independently,
+    // and the oldest frame is discarded directly when backlogged
+    auto frame_cache = Frame::getCacheAbleFrame(frame);
+    return addEncodeTask([this, frame_cache]() { _decoder->inputFrame(frame_cache, false, false, false); });
+}
+
+void FFmpegAudioTranscoder::onDecode(const FFmpegFrame::Ptr &frame) {
+    auto pcm = _swr->inputFrame(frame);
+    if (!pcm || pcm->get()->nb_samples <= 0) {
+        return;
+    }
+    auto sample_rate = _context->sample_rate;
+    auto stamp = frame->get()->pts != AV_NOPTS_VALUE ? frame->get()->pts : 0;
+    // 已进入编码器与fifo的采样对应的时长
+    // Duration corresponding to the samples that have entered the encoder and the fifo
+    auto queued_ms = (_samples + av_audio_fifo_size(_fifo.get())) * 1000 / sample_rate;
+    if (_start_stamp < 0 || std::abs(_start_stamp + queued_ms - stamp) > kMaxAudioStampDrift) {
+        // 首帧或源流时间戳跳变(丢包、断流重连)，以源时间戳重新对齐，保证音画同步
+        // The first frame or the timestamp of the source stream jumps (packet loss, reconnection), realign with the source timestamp to keep audio and video in sync
+        _start_stamp = stamp - queued_ms;
+    }
+
+    av_audio_fifo_write(_fifo.get(), (void **)pcm->get()->data, pcm->get()->nb_samples);
+    auto frame_size = _context->frame_size > 0 ? _context->frame_size : 1024;
+    while (av_audio_fifo_size(_fifo.get()) >= frame_size) {
+        std::shared_ptr<AVFrame> out(av_frame_alloc(), [](AVFrame *ptr) { av_frame_free(&ptr); });
+        out->nb_samples = frame_size;
+        out->format = _context->sample_fmt;
+        out->sample_rate = sample_rate;
+#if LIBAVCODEC_VERSION_INT >= FF_CODEC_VER_7_1
+        av_channel_layout_copy(&out->ch_layout, &_context->ch_layout);
+#else
+        out->channels = _context->channels;
+        out->channel_layout = _context->channel_layout;
+#endif
+        if (av_frame_get_buffer(out.get(), 0) < 0) {
+            WarnL << "av_frame_get_buffer failed";
+            return;
+        }
+        av_audio_fifo_read(_fifo.get(), (void **)out->data, frame_size);
+        out->pts = _samples;
+        _samples += frame_size;
+        encode(out.get());
+    }
+}
+
+void FFmpegAudioTranscoder::encode(AVFrame *frame) {
+    auto ret = avcodec_send_frame(_context.get(), frame);
+    if (ret < 0) {
+        WarnL << "avcodec_send_frame failed:" << ffmpeg_err(ret);
+        return;
+    }
+    auto pkt = alloc_av_packet();
+    while (avcodec_receive_packet(_context.get(), pkt.get()) >= 0) {
+        // pts的单位为采样数，opus编码器的前置填充会使开头的pts为负
+        // The unit of pts is the number of samples, the pre-padding of the opus encoder makes the pts at the beginning negative
+        auto out = FrameImp::create();
+        out->_codec_id = _track->getCodecId();
+        out->_dts = MAX(_start_stamp + MAX(pkt->pts, (int64_t)0) * 1000 / _context->sample_rate, (int64_t)0);
+        out->_buffer.assign((char *)pkt->data, pkt->size);
+        av_packet_unref(pkt.get());
+        if (_cb) {
+            _cb(out);
+        }
+    }
+}
+
+std::tuple<bool, std::string> FFmpegUtils::saveFrame(const FFmpegFrame::Ptr &frame, const char *filename, AVPixelFormat fmt, int w, int h, const char *font_path) {
     std::unique_ptr<FILE, void (*)(FILE *)> tmp_save_file_jpg(File::create_file(filename, "wb"), [](FILE *fp) {
         if (fp) {
             fclose(fp);
@@ -779,11 +1131,31 @@ std::tuple<bool, std::string> FFmpegUtils::saveFrame(const FFmpegFrame::Ptr &fra
     });
 
     if (!tmp_save_file_jpg) {
+        _StrPrinter ss;
         ss << "Could not open the file " << filename;
         DebugL << ss;
         return make_tuple<bool, std::string>(false, ss.data());
     }
 
+    std::string data;
+    auto ret = encodeFrame(frame, data, fmt, w, h, font_path);
+    if (std::get<0>(ret)) {
+        fwrite(data.data(), data.size(), 1, tmp_save_file_jpg.get());
+    }
+    return ret;
+}
+
+std::tuple<bool, std::string> FFmpegUtils::encodeFrame(const FFmpegFrame::Ptr &frame, std::string &out, AVPixelFormat fmt, int w, int h, const char *font_path) {
+    std::shared_ptr<AVFilterGraph> _filter_graph;
+    AVFilterContext *buffersrc_ctx = nullptr;
+    AVFilterContext *buffersink_ctx = nullptr;
+    const AVFilter *buffersrc = nullptr;
+    const AVFilter *buffersink = nullptr;
+    // kServerName
+    const string mark = "ZLMediaKit"; 
+    char drawtext_args1[512];
+    _StrPrinter ss;
+
     std::string fontfile("");
     if (font_path && File::fileExist(font_path)) {
         fontfile = font_path;
@@ -878,7 +1250,7 @@ std::tuple<bool, std::string> FFmpegUtils::saveFrame(const FFmpegFrame::Ptr &fra
     while (av_buffersink_get_frame(buffersink_ctx, new_frame->get()) >= 0) {
         if (avcodec_send_frame(jpeg_codec_ctx.get(), new_frame->get()) == 0) {
             while (avcodec_receive_packet(jpeg_codec_ctx.get(), pkt.get()) == 0) {
-                fwrite(pkt.get()->data, pkt.get()->size, 1, tmp_save_file_jpg.get());
+                out.append((char *)pkt.get()->data, pkt.get()->size);
             }
         }
     }
@@ -84,13 +84,65 @@ private:
     toolkit::ResourcePool<FFmpegFrame> _swr_frame_pool;
 };
 
+class CodecTaskQueue;
+
+/**
+ * 异步编解码任务管理，任务在全局共享的编解码线程池(线程数与cpu核数一致)中执行
+ * 每个TaskManager对应一个串行队列，保证同一路流的任务按顺序执行
+ * Asynchronous codec task management, the tasks are executed in a globally shared codec thread pool (as many threads as cpu cores)
+ * Each TaskManager corresponds to a serial queue, which ensures that the tasks of the same stream are executed in order
+ */
 class TaskManager {
 public:
+    struct Statistic {
+        uint64_t id;
+        std::string name;
+        size_t queue_size;
+        uint64_t drop_count;
+    };
+
     virtual ~TaskManager();
 
+    /**
+     * 创建TaskManager子类对象，在编解码线程中释放时，其析构转移到后台线程执行
+     * 析构需等待队列中正在执行的任务完成，在编解码线程中等待可能阻塞线程池或互相等待导致死锁
+     * 子类构造函数须为私有并声明TaskManager为友元，保证只能通过本方法创建
+     * Create the TaskManager subclass object, its destruction is moved to a background thread when it is released in a codec thread
+     * The destruction needs to wait for the task being executed in the queue to complete, waiting in a codec thread may block the thread pool or cause a deadlock by waiting for each other
+     * The constructor of the subclass must be private and declare TaskManager as a friend, to ensure that it can only be created by this method
+     */
+    template <typename T, typename... ARGS>
+    static std::shared_ptr<T> create(ARGS &&...args) {
+        return std::shared_ptr<T>(new T(std::forward<ARGS>(args)...), [](T *ptr) { release(ptr); });
+    }
+
     void setMaxTaskSize(size_t size);
+
+    /**
+     * 停止队列，在编解码线程中调用时不等待正在执行的任务，由析构时等待
+     * Stop the queue, it does not wait for the task being executed when called in a codec thread, which is waited for when destructing
+     */
     void stopThread(bool drop_task);
 
+    /**
+     * 设置队列名(一般为流的url)，用于统计
+     * Set the queue name (generally the url of the stream), used for statistics
+     */
+    void setTaskName(std::string name);
+
+    /**
+     * 获取队列中等待执行的任务个数与累计丢弃的任务个数
+     * Get the number of tasks waiting in the queue and the accumulated number of dropped tasks
+     */
+    size_t getTaskSize() const;
+    uint64_t getDropCount() const;
+
+    /**
+     * 获取所有异步队列的统计
+     * Get the statistics of all asynchronous queues
+     */
+    static std::vector<Statistic> getStatistic();
+
 protected:
     void startThread(const std::string &name);
     bool addEncodeTask(std::function<void()> task);
@@ -98,22 +150,16 @@ protected:
     bool isEnabled() const;
 
 private:
-    void onThreadRun(const std::string &name);
+    static void release(TaskManager *ptr);
+    void waitStopped();
 
 private:
-    class ThreadExitException : public std::runtime_error {
-    public:
-        ThreadExitException() : std::runtime_error("exit") {}
-    };
-
-private:
-    bool _decode_drop_start = false;
-    bool _exit = false;
     size_t _max_task = 30;
-    std::mutex _task_mtx;
-    toolkit::semaphore _sem;
-    toolkit::List<std::function<void()> > _task;
-    std::shared_ptr<std::thread> _thread;
+    std::string _name;
+    std::shared_ptr<CodecTaskQueue> _queue;
+    // 已停止但可能仍有任务在执行的队列
+    // The stopped queue which may still have a task being executed
+    std::shared_ptr<CodecTaskQueue> _stopped_queue;
 };
 
 class FFmpegDecoder : public TaskManager {
@@ -121,7 +167,6 @@ public:
     using Ptr = std::shared_ptr<FFmpegDecoder>;
     using onDec = std::function<void(const FFmpegFrame::Ptr &)>;
 
-    FFmpegDecoder(const Track::Ptr &track, int thread_num = 2, const std::vector<std::string> &codec_name = {});
     ~FFmpegDecoder() override;
 
     bool inputFrame(const Frame::Ptr &frame, bool live, bool async, bool enable_merge = true);
@@ -130,6 +175,11 @@ public:
     const AVCodecContext *getContext() const;
 
 private:
+    // 通过TaskManager::create创建
+    // Created by TaskManager::create
+    friend class TaskManager;
+    FFmpegDecoder(const Track::Ptr &track, int thread_num = 2, const std::vector<std::string> &codec_name = {});
+
     void onDecode(const FFmpegFrame::Ptr &frame);
     bool inputFrame_l(const Frame::Ptr &frame, bool live, bool enable_merge);
     bool decodeFrame(const char *data, size_t size, uint64_t dts, uint64_t pts, bool live, bool key_frame);
@@ -167,6 +217,66 @@ private:
     toolkit::ResourcePool<FFmpegFrame> _sws_frame_pool;
 };
 
+/**
+ * 音频转码：解码、重采样并编码为目标格式，全过程在共享编解码线程池中该对象的串行队列里执行，不占用源流线程
+ * Audio transcoding: decode, resample and encode to the target format, the whole process is executed in the serial queue of this object
+ * in the shared codec thread pool, without occupying the thread of the source stream
+ */
+class FFmpegAudioTranscoder : public TaskManager {
+public:
+    using Ptr = std::shared_ptr<FFmpegAudioTranscoder>;
+    using onOutput = std::function<void(const Frame::Ptr &)>;
+
+    ~FFmpegAudioTranscoder() override;
+
+    /**
+     * 输入源音频帧，异步转码；队列积压时丢帧
+     * Input the source audio frame, transcoded asynchronously; the frame is dropped when the queue is backlogged
+     */
+    bool inputFrame(const Frame::Ptr &frame);
+
+    /**
+     * 设置转码输出回调，在编解码线程中触发
+     * Set the transcoding output callback, triggered in the codec thread
+     */
+    void setOnOutput(onOutput cb);
+
+    /**
+     * 目标音频track，aac时带有编码器生成的AudioSpecificConfig
+     * Target audio track, with the AudioSpecificConfig generated by the encoder for aac
+     */
+    const Track::Ptr &getTrack() const { return _track; }
+
+private:
+    friend class TaskManager;
+    /**
+     * 通过TaskManager::create创建，失败时抛异常
+     * @param track 源音频track
+     * @param codec 目标编码格式，支持aac与opus；opus固定为48000hz双声道
+     * @param bit_rate 目标码率，单位bps
+     * Created by TaskManager::create, throw an exception on failure
+     * @param track Source audio track
+     * @param codec Target codec, aac and opus are supported; opus is fixed to 48000hz stereo
+     * @param bit_rate Target bitrate, in bps
+     */
+    FFmpegAudioTranscoder(const Track::Ptr &track, CodecId codec, int bit_rate = 64000);
+
+    void onDecode(const FFmpegFrame::Ptr &frame);
+    void encode(AVFrame *frame);
+
+private:
+    // 首帧时间戳，单位毫秒，输出时间戳按采样数在其基础上递增
+    // Timestamp of the first frame, in milliseconds, the output timestamps increase from it by the number of samples
+    int64_t _start_stamp = -1;
+    int64_t _samples = 0;
+    onOutput _cb;
+    Track::Ptr _track;
+    FFmpegDecoder::Ptr _decoder;
+    std::unique_ptr<FFmpegSwr> _swr;
+    std::shared_ptr<AVCodecContext> _context;
+    std::shared_ptr<AVAudioFifo> _fifo;
+};
+
 class FFmpegUtils {
 public:
     /**
@@ -179,6 +289,14 @@ public:
      * @return
      */
     static std::tuple<bool, std::string> saveFrame(const FFmpegFrame::Ptr &frame, const char *filename, AVPixelFormat fmt = AV_PIX_FMT_YUVJ420P, int w = 0, int h = 0, const char *font_path = nullptr);
+
+    /**
+     * 与saveFrame相同，但编码结果追加到内存中而不是写文件
+     * @param out 编码后的jpeg或png数据
+     * Same as saveFrame, but the encoded result is appended to memory instead of being written to a file
+     * @param out Encoded jpeg or png data
+     */
+    static std::tuple<bool, std::string> encodeFrame(const FFmpegFrame::Ptr &frame, std::string &out, AVPixelFormat fmt = AV_PIX_FMT_YUVJ420P, int w = 0, int h = 0, const char *font_path = nullptr);
 };
 
 }//namespace mediakit
@@ -0,0 +1,288 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <set>
+#include <cstring>
+#include "LatencyStat.h"
+#include "MediaSource.h"
+#include "MultiMediaSourceMuxer.h"
+#include "Extension/Factory.h"
+#include "Util/util.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 每个track保留的接收记录个数，25fps下约20秒
+// Number of receiving records kept for each track, about 20 seconds at 25fps
+static constexpr size_t kMaxEntries = 512;
+// user data unregistered sei的uuid
+// The uuid of the user data unregistered sei
+static constexpr char kSeiUuid[] = "ZLMLatencyStamp1";
+static constexpr size_t kSeiUuidSize = 16;
+static constexpr uint8_t kSeiPayloadType = 5;
+static constexpr uint8_t kSeiPayloadSize = kSeiUuidSize + 8;
+
+const uint32_t LatencyStat::kBucketBounds[kBuckets - 1] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+
+void LatencyStat::Histogram::add(uint64_t ms) {
+    ++count;
+    sum_ms += ms;
+    max_ms = (std::max)(max_ms, ms);
+    size_t i = 0;
+    while (i < kBuckets - 1 && ms > kBucketBounds[i]) {
+        ++i;
+    }
+    ++buckets[i];
+}
+
+void LatencyStat::Histogram::add(const Histogram &other) {
+    count += other.count;
+    sum_ms += other.sum_ms;
+    max_ms = (std::max)(max_ms, other.max_ms);
+    for (size_t i = 0; i < kBuckets; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+}
+
+uint64_t LatencyStat::Histogram::percentile(double p) const {
+    if (!count) {
+        return 0;
+    }
+    auto target = (uint64_t)(p * count + 0.5);
+    target = target ? target : 1;
+    uint64_t acc = 0;
+    for (size_t i = 0; i < kBuckets - 1; ++i) {
+        acc += buckets[i];
+        if (acc >= target) {
+            return (std::min)((uint64_t)kBucketBounds[i], max_ms);
+        }
+    }
+    return max_ms;
+}
+
+static bool isSeiNal(CodecId codec, const char *ptr, size_t size) {
+    if (!size) {
+        return false;
+    }
+    switch (codec) {
+        case CodecH264: return (ptr[0] & 0x1F) == 6;
+        case CodecH265: return size > 1 && ((ptr[0] >> 1) & 0x3F) == 39;
+        default: return false;
+    }
+}
+
+static size_t seiHeaderSize(CodecId codec) {
+    return codec == CodecH265 ? 2 : 1;
+}
+
+string LatencyStat::makeSei(CodecId codec, uint64_t stamp_ms) {
+    string rbsp;
+    rbsp.push_back((char)kSeiPayloadType);
+    rbsp.push_back((char)kSeiPayloadSize);
+    rbsp.append(kSeiUuid, kSeiUuidSize);
+    for (int i = 7; i >= 0; --i) {
+        rbsp.push_back((char)(stamp_ms >> (8 * i)));
+    }
+    rbsp.push_back((char)0x80);
+
+    string ret = codec == CodecH265 ? string("\x4E\x01", 2) : string("\x06", 1);
+    // 防竞争处理，时间的字节可能出现00 00 0x(x<=3)
+    // Emulation prevention, the bytes of the time may contain 00 00 0x(x<=3)
+    int zeros = 0;
+    for (auto ch : rbsp) {
+        auto byte = (uint8_t)ch;
+        if (zeros >= 2 && byte <= 3) {
+            ret.push_back(0x03);
+            zeros = 0;
+        }
+        ret.push_back(ch);
+        zeros = byte ? 0 : zeros + 1;
+    }
+    return ret;
+}
+
+bool LatencyStat::parseSei(CodecId codec, const char *ptr, size_t size, uint64_t &stamp_ms) {
+    if ((codec != CodecH264 && codec != CodecH265) || !isSeiNal(codec, ptr, size)) {
+        return false;
+    }
+    string rbsp;
+    int zeros = 0;
+    for (auto i = seiHeaderSize(codec); i < size && rbsp.size() < 2u + kSeiPayloadSize; ++i) {
+        auto byte = (uint8_t)ptr[i];
+        if (zeros >= 2 && byte == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        rbsp.push_back((char)byte);
+        zeros = byte ? 0 : zeros + 1;
+    }
+    if (rbsp.size() != 2u + kSeiPayloadSize || (uint8_t)rbsp[0] != kSeiPayloadType || (uint8_t)rbsp[1] != kSeiPayloadSize
+        || memcmp(rbsp.data() + 2, kSeiUuid, kSeiUuidSize)) {
+        return false;
+    }
+    stamp_ms = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        stamp_ms = (stamp_ms << 8) | (uint8_t)rbsp[2 + kSeiUuidSize + i];
+    }
+    return true;
+}
+
+// 所有存活的流统计，以及已销毁的流统计的汇总，仅在创建、销毁与汇总时加锁
+// All alive stream statistics, and the summary of the destroyed stream statistics, locked only when creating, destroying and summarizing
+static mutex s_total_mtx;
+static set<const LatencyStat *> s_stats;
+static map<string, LatencyStat::Histogram> s_retired_histograms;
+
+LatencyStat::LatencyStat(bool inject_sei) : _inject_sei(inject_sei) {
+    lock_guard<mutex> lck(s_total_mtx);
+    s_stats.emplace(this);
+}
+
+LatencyStat::~LatencyStat() {
+    lock_guard<mutex> lck(s_total_mtx);
+    s_stats.erase(this);
+    for (auto &pr : _histograms) {
+        s_retired_histograms[pr.first].add(pr.second);
+    }
+}
+
+Frame::Ptr LatencyStat::inputFrame(const Frame::Ptr &origin, const Frame::Ptr &frame) {
+    auto type = frame->getTrackType();
+    if (type != TrackVideo && type != TrackAudio) {
+        return nullptr;
+    }
+    auto now = getCurrentMillisecond(true);
+    auto codec = frame->getCodecId();
+    auto prefix = frame->prefixSize();
+    uint64_t upstream_ms;
+    if (type == TrackVideo && parseSei(codec, frame->data() + prefix, frame->size() - prefix, upstream_ms)) {
+        // 上游注入的时间sei，本帧之后同dts的帧不再注入
+        // The timing sei injected by the upstream, the frames with the same dts after it are no longer injected
+        lock_guard<mutex> lck(_mtx);
+        _has_upstream = true;
+        _upstream_dts = frame->dts();
+        _upstream_ms = upstream_ms;
+        return nullptr;
+    }
+
+    bool new_dts = false;
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto &entries = _entries[type];
+        entries.emplace_back(Entry { frame->dts(), frame->pts(), origin->dts(), origin->pts(), now });
+        if (entries.size() > kMaxEntries) {
+            entries.pop_front();
+        }
+        // sps/pps等配置帧与idr同dts，不能由其标记该dts，否则idr不再插入sei也不统计源头延迟
+        // Config frames such as sps/pps have the same dts as the idr, they must not mark the dts, otherwise the idr no longer gets the sei nor measures the origin latency
+        if (type != TrackVideo || frame->configFrame() || frame->dropAble() || (_has_video_dts && _last_video_dts == frame->dts())) {
+            return nullptr;
+        }
+        new_dts = true;
+        _has_video_dts = true;
+        _last_video_dts = frame->dts();
+        if (_has_upstream && _upstream_dts == frame->dts()) {
+            // 源头到本机接收的延迟，依赖各服务器时钟同步
+            // The latency from the origin to the local receiving, relies on the clock synchronization of the servers
+            record("upstream", _upstream_ms, now);
+            return nullptr;
+        }
+    }
+
+    if (!_inject_sei || !new_dts || (codec != CodecH264 && codec != CodecH265)) {
+        return nullptr;
+    }
+    auto sei = Factory::getFrameFromBuffer(codec, std::make_shared<BufferString>(string("\x00\x00\x00\x01", 4) + makeSei(codec, now)), frame->dts(), frame->pts());
+    if (sei) {
+        sei->setIndex(frame->getIndex());
+    }
+    return sei;
+}
+
+bool LatencyStat::findIngest(TrackType type, const function<bool(const Entry &)> &match, uint64_t &ingest_ms) const {
+    lock_guard<mutex> lck(_mtx);
+    auto &entries = _entries[type];
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (match(*it)) {
+            ingest_ms = it->ingest_ms;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LatencyStat::onSend(const string &egress, TrackType type, uint64_t stamp, bool is_pts) {
+    auto near = [stamp](uint64_t val) { return (val > stamp ? val - stamp : stamp - val) <= 1; };
+    uint64_t ingest_ms;
+    auto found = findIngest(type, [&](const Entry &entry) {
+        return is_pts ? (near(entry.pts) || near(entry.origin_pts)) : (near(entry.dts) || near(entry.origin_dts));
+    }, ingest_ms);
+    if (found) {
+        lock_guard<mutex> lck(_mtx);
+        record(egress, ingest_ms, getCurrentMillisecond(true));
+    }
+    return found;
+}
+
+void LatencyStat::onSendRtp(const string &egress, TrackType type, uint32_t stamp, uint32_t sample_rate) {
+    if (!sample_rate) {
+        return;
+    }
+    // 允许1毫秒的取整误差
+    // Allow a rounding error of 1 millisecond
+    auto tolerance = (int64_t)(sample_rate / 1000 + 1);
+    auto near = [&](uint64_t pts) {
+        auto diff = (int64_t)(int32_t)(stamp - (uint32_t)(pts * sample_rate / 1000));
+        return diff <= tolerance && diff >= -tolerance;
+    };
+    uint64_t ingest_ms;
+    if (findIngest(type, [&](const Entry &entry) { return near(entry.pts) || near(entry.origin_pts); }, ingest_ms)) {
+        lock_guard<mutex> lck(_mtx);
+        record(egress, ingest_ms, getCurrentMillisecond(true));
+    }
+}
+
+void LatencyStat::record(const string &name, uint64_t ingest_ms, uint64_t now_ms) {
+    // 时钟回拨或跨服务器时钟偏差时记为0
+    // Recorded as 0 when the clock goes back or the clocks of servers deviate
+    auto ms = now_ms > ingest_ms ? now_ms - ingest_ms : 0;
+    _histograms[name].add(ms);
+}
+
+map<string, LatencyStat::Histogram> LatencyStat::getHistograms() const {
+    lock_guard<mutex> lck(_mtx);
+    return _histograms;
+}
+
+map<string, LatencyStat::Histogram> LatencyStat::getTotalHistograms() {
+    lock_guard<mutex> lck(s_total_mtx);
+    auto ret = s_retired_histograms;
+    for (auto stat : s_stats) {
+        for (auto &pr : stat->getHistograms()) {
+            ret[pr.first].add(pr.second);
+        }
+    }
+    return ret;
+}
+
+LatencyStat::Ptr LatencyStat::get(const MediaSource &src) {
+    try {
+        auto muxer = src.getMuxer();
+        return muxer ? muxer->getLatencyStat() : nullptr;
+    } catch (std::exception &) {
+        // 该流不是由MultiMediaSourceMuxer生成
+        // The stream is not generated by MultiMediaSourceMuxer
+        return nullptr;
+    }
+}
+
+} // namespace mediakit
@@ -0,0 +1,189 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_LATENCYSTAT_H
+#define ZLMEDIAKIT_LATENCYSTAT_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <functional>
+#include "Extension/Frame.h"
+
+namespace mediakit {
+
+class MediaSource;
+
+/**
+ * 单个流的延迟统计：MultiMediaSourceMuxer记录每帧的接收时间(系统时间)，各输出协议发送该帧时按时间戳找回接收时间，
+ * 把接收到发送的耗时计入该协议的直方图；级联时上游注入的时间sei还可以统计源头到本机接收的延迟(upstream)
+ * 线程安全
+ * Latency statistics of a stream: MultiMediaSourceMuxer records the receiving time (system time) of each frame, and each output protocol
+ * finds the receiving time back by the timestamp when sending the frame, and adds the duration from receiving to sending to the histogram of
+ * the protocol; in cascade, the timing sei injected by the upstream can also measure the latency from the origin to the local receiving (upstream)
+ * Thread safe
+ */
+class LatencyStat {
+public:
+    using Ptr = std::shared_ptr<LatencyStat>;
+
+    /**
+     * @param inject_sei 是否在h264/h265视频帧前插入时间sei
+     * @param inject_sei Whether to insert the timing sei before h264/h265 video frames
+     */
+    LatencyStat(bool inject_sei = false);
+    ~LatencyStat();
+
+    static constexpr size_t kBuckets = 10;
+    // 直方图各桶的上限(含)，单位毫秒，最后一个桶不设上限
+    // The upper limit (inclusive) of each bucket of the histogram, in milliseconds, the last bucket has no upper limit
+    static const uint32_t kBucketBounds[kBuckets - 1];
+
+    struct Histogram {
+        uint64_t count = 0;
+        uint64_t sum_ms = 0;
+        uint64_t max_ms = 0;
+        uint64_t buckets[kBuckets] = { 0 };
+
+        void add(uint64_t ms);
+        void add(const Histogram &other);
+        /**
+         * 估算分位数，返回所在桶的上限，落在最后一个桶时返回最大值
+         * Estimate the percentile, return the upper limit of the bucket, return the maximum value when it falls in the last bucket
+         */
+        uint64_t percentile(double p) const;
+    };
+
+    /**
+     * 记录一帧的接收
+     * @param origin 原始帧
+     * @param frame 修正时间戳后、即将输入各协议复用器的帧
+     * @return 需要在该帧前插入的时间sei帧，无需插入时返回空
+     * Record the receiving of a frame
+     * @param origin The original frame
+     * @param frame The frame with revised timestamp which is about to be input to the muxers of each protocol
+     * @return The timing sei frame that needs to be inserted before the frame, null if not needed
+     */
+    Frame::Ptr inputFrame(const Frame::Ptr &origin, const Frame::Ptr &frame);
+
+    /**
+     * 记录发送，stamp为毫秒时间戳
+     * @return 是否找到该帧的接收记录
+     * Record sending, stamp is the timestamp in milliseconds
+     * @return Whether the receiving record of the frame is found
+     */
+    bool onSend(const std::string &egress, TrackType type, uint64_t stamp, bool is_pts);
+
+    /**
+     * 记录rtp发送，stamp为rtp时间戳
+     * Record rtp sending, stamp is the rtp timestamp
+     */
+    void onSendRtp(const std::string &egress, TrackType type, uint32_t stamp, uint32_t sample_rate);
+
+    /**
+     * 获取本流各输出协议(以及upstream)的直方图
+     * Get the histograms of each output protocol (and upstream) of this stream
+     */
+    std::map<std::string, Histogram> getHistograms() const;
+
+    /**
+     * 获取所有流汇总的直方图，获取时遍历各流的统计进行汇总，记录发送时无需全局锁
+     * Get the histograms summarized of all streams, it walks the statistics of each stream to summarize when called,
+     * so no global lock is needed when recording sending
+     */
+    static std::map<std::string, Histogram> getTotalHistograms();
+
+    /**
+     * 获取MediaSource所属流的延迟统计，未开启时返回空
+     * Get the latency statistics of the stream that the MediaSource belongs to, null if not enabled
+     */
+    static Ptr get(const MediaSource &src);
+
+    /**
+     * 生成携带时间(毫秒)的h264/h265 user data unregistered sei，不含起始码
+     * Generate the h264/h265 user data unregistered sei carrying the time (milliseconds), without start code
+     */
+    static std::string makeSei(CodecId codec, uint64_t stamp_ms);
+
+    /**
+     * 解析makeSei生成的sei，ptr不含起始码
+     * Parse the sei generated by makeSei, ptr does not contain the start code
+     */
+    static bool parseSei(CodecId codec, const char *ptr, size_t size, uint64_t &stamp_ms);
+
+private:
+    struct Entry {
+        uint64_t dts;
+        uint64_t pts;
+        uint64_t origin_dts;
+        uint64_t origin_pts;
+        uint64_t ingest_ms;
+    };
+
+    bool findIngest(TrackType type, const std::function<bool(const Entry &)> &match, uint64_t &ingest_ms) const;
+    void record(const std::string &name, uint64_t ingest_ms, uint64_t now_ms);
+
+private:
+    bool _inject_sei = false;
+    // 上游sei所属帧的dts及其携带的时间
+    // The dts of the frame that the upstream sei belongs to and the time it carries
+    bool _has_upstream = false;
+    uint64_t _upstream_dts = 0;
+    uint64_t _upstream_ms = 0;
+    bool _has_video_dts = false;
+    uint64_t _last_video_dts = 0;
+    mutable std::mutex _mtx;
+    std::deque<Entry> _entries[TrackMax];
+    std::map<std::string, Histogram> _histograms;
+};
+
+/**
+ * 输出协议侧的延迟记录器，同一帧的多个包只记录一次
+ * The latency recorder on the output protocol side, multiple packets of the same frame are recorded only once
+ */
+class LatencyRecorder {
+public:
+    LatencyRecorder(std::string egress) : _egress(std::move(egress)) {}
+
+    void attach(const MediaSource &src) { _stat = LatencyStat::get(src); }
+    void attach(LatencyStat::Ptr stat) { _stat = std::move(stat); }
+
+    bool onSend(TrackType type, uint64_t stamp, bool is_pts) {
+        return _stat && isMediaTrack(type) && checkStamp(type, stamp) && _stat->onSend(_egress, type, stamp, is_pts);
+    }
+
+    void onSendRtp(TrackType type, uint32_t stamp, uint32_t sample_rate) {
+        if (_stat && isMediaTrack(type) && checkStamp(type, stamp)) {
+            _stat->onSendRtp(_egress, type, stamp, sample_rate);
+        }
+    }
+
+private:
+    static bool isMediaTrack(TrackType type) { return type == TrackVideo || type == TrackAudio; }
+
+    bool checkStamp(TrackType type, uint64_t stamp) {
+        auto &last = _last_stamp[type];
+        if (last.first && last.second == stamp) {
+            return false;
+        }
+        last = std::make_pair(true, stamp);
+        return true;
+    }
+
+private:
+    std::string _egress;
+    LatencyStat::Ptr _stat;
+    std::pair<bool, uint64_t> _last_stamp[TrackMax];
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_LATENCYSTAT_H
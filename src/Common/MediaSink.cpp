@@ -64,6 +64,7 @@ bool MediaSink::addTrack(const Track::Ptr &track_in) {
         if (frame_unread.size() > kMaxUnreadyFrame) {
             // 未就绪的的track，不能缓存太多的帧，否则可能内存溢出  [AUTO-TRANSLATED:23958376]
             // Unready tracks cannot cache too many frames, otherwise memory may overflow
+            _dropped_frames += frame_unread.size();
             frame_unread.clear();
             WarnL << "Cached frame of unready track(" << frame->getCodecName() << ") is too much, now cleared";
         }
@@ -427,4 +428,26 @@ vector<Track::Ptr> Demuxer::getTracks(bool ready) const {
     }
     return ret;
 }
+
+bool SharedMuxer::isSinkEnabled() {
+    for (auto &weak_sink : _sinks) {
+        auto sink = weak_sink.lock();
+        if (sink && sink->isSinkEnabled()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SharedMuxer::writeToSinks(const toolkit::Buffer::Ptr &buffer, uint64_t timestamp, bool key_pos) {
+    for (auto it = _sinks.begin(); it != _sinks.end();) {
+        auto sink = it->lock();
+        if (!sink) {
+            it = _sinks.erase(it);
+            continue;
+        }
+        sink->inputSharedData(buffer, timestamp, key_pos);
+        ++it;
+    }
+}
 } // namespace mediakit
@@ -11,7 +11,9 @@
 #ifndef ZLMEDIAKIT_MEDIASINK_H
 #define ZLMEDIAKIT_MEDIASINK_H
 
+#include <list>
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include "Util/TimeTicker.h"
 #include "Extension/Frame.h"
@@ -57,6 +59,51 @@ public:
     using Ptr = std::shared_ptr<MediaSinkInterface>;
 };
 
+/**
+ * 共享同一个复用器输出的消费者，例如hls直接使用http-ts/http-fmp4的复用结果切片，避免重复复用
+ * A consumer sharing the output of the same muxer, for example hls segments the muxing result of http-ts/http-fmp4 directly, avoiding repeated muxing
+ */
+class SharedMuxerSink {
+public:
+    virtual ~SharedMuxerSink() = default;
+
+    /**
+     * 是否需要数据，全部消费者都不需要时共享的复用器可停止复用
+     * Whether data is needed, the shared muxer can stop muxing when no consumer needs it
+     */
+    virtual bool isSinkEnabled() = 0;
+
+    /**
+     * 输入共享的复用数据(ts包或fmp4的moof+mdat)，buffer为空时表示重置轨道
+     * @param timestamp 时间戳，单位毫秒
+     * @param key_pos 是否为关键帧开始处，可在此切片
+     * Input the shared muxed data (ts packets or fmp4 moof+mdat), an empty buffer means resetting tracks
+     * @param timestamp Timestamp, in milliseconds
+     * @param key_pos Whether it is the start of a key frame, where segmenting is possible
+     */
+    virtual void inputSharedData(const toolkit::Buffer::Ptr &buffer, uint64_t timestamp, bool key_pos) = 0;
+};
+
+/**
+ * 可被多个SharedMuxerSink共享输出的复用器
+ * A muxer whose output can be shared by multiple SharedMuxerSinks
+ */
+class SharedMuxer {
+public:
+    /**
+     * 添加共享本复用器输出的消费者，消费者销毁后自动移除
+     * Add a consumer sharing the output of this muxer, it is removed automatically after being destroyed
+     */
+    void addSink(const std::weak_ptr<SharedMuxerSink> &sink) { _sinks.emplace_back(sink); }
+
+protected:
+    bool isSinkEnabled();
+    void writeToSinks(const toolkit::Buffer::Ptr &buffer, uint64_t timestamp, bool key_pos);
+
+private:
+    std::list<std::weak_ptr<SharedMuxerSink>> _sinks;
+};
+
 /**
  * aac静音音频添加器
  * AAC mute audio adder
@@ -186,6 +233,12 @@ public:
      */
     bool haveVideo() const;
 
+    /**
+     * 因track未就绪而丢弃的帧数
+     * Number of frames dropped because the tracks were not ready
+     */
+    uint64_t getDroppedFrames() const { return _dropped_frames; }
+
 protected:
     /**
      * 某track已经准备好，其ready()状态返回true，
@@ -250,6 +303,7 @@ private:
     bool _add_mute_audio = true;
     bool _all_track_ready = false;
     size_t _max_track_size = 2;
+    std::atomic<uint64_t> _dropped_frames { 0 };
 
     toolkit::Ticker _ticker;
     MuteAudioMaker::Ptr _mute_audio_maker;
@@ -8,6 +8,8 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 #include <mutex>
+#include <atomic>
+#include <algorithm>
 #include "Util/util.h"
 #include "Util/NoticeCenter.h"
 #include "Network/sockutil.h"
@@ -28,12 +30,72 @@ namespace toolkit {
 
 namespace mediakit {
 
-static recursive_mutex s_media_source_mtx;
-using StreamMap = unordered_map<string/*strema_id*/, weak_ptr<MediaSource> >;
-using AppStreamMap = unordered_map<string/*app*/, StreamMap>;
-using VhostAppStreamMap = unordered_map<string/*vhost*/, AppStreamMap>;
-using SchemaVhostAppStreamMap = unordered_map<string/*schema*/, VhostAppStreamMap>;
-static SchemaVhostAppStreamMap s_media_source_map;
+// 媒体源注册表分片个数，必须为2的n次方
+// Number of media source registry shards, must be a power of 2
+static constexpr size_t kMediaSourceShardCount = 64;
+
+static inline size_t hash_combine(size_t seed, const string &str) {
+    return seed ^ (std::hash<string>()(str) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// 注册表条目，创建后不可修改，以便在多个快照之间共享
+// Registry entry, immutable after creation so that it can be shared among snapshots
+struct MediaSourceEntry {
+    using Ptr = std::shared_ptr<const MediaSourceEntry>;
+    string schema;
+    string vhost;
+    string app;
+    string stream;
+    weak_ptr<MediaSource> media;
+
+    bool match(const string &schema_in, const string &vhost_in, const string &app_in, const string &stream_in) const {
+        return (schema_in.empty() || schema_in == schema) && (vhost_in.empty() || vhost_in == vhost)
+            && (app_in.empty() || app_in == app) && (stream_in.empty() || stream_in == stream);
+    }
+};
+
+// 同一vhost/app/stream下所有schema的媒体源落在同一分片，key为预先计算好的schema+vhost+app+stream hash
+// All schemas of the same vhost/app/stream fall into the same shard, keyed by the pre-computed schema+vhost+app+stream hash
+class MediaSourceShard {
+public:
+    using Map = unordered_multimap<size_t, MediaSourceEntry::Ptr>;
+    using MapPtr = std::shared_ptr<const Map>;
+
+    // 读取当前快照，无需加锁  [读多写少，写时拷贝]
+    // Get the current snapshot without locking [read-mostly, copy-on-write]
+    MapPtr snapshot() const { return std::atomic_load(&_map); }
+
+    // 修改快照，仅写者之间互斥
+    // Modify the snapshot, only writers are mutually exclusive
+    template <typename FUNC>
+    void update(FUNC &&func) {
+        lock_guard<mutex> lck(_mtx);
+        std::shared_ptr<Map> map = std::make_shared<Map>(*_map);
+        if (func(*map)) {
+            std::atomic_store(&_map, MapPtr(std::move(map)));
+        }
+    }
+
+private:
+    mutex _mtx;
+    MapPtr _map = std::make_shared<Map>();
+};
+
+static size_t getStreamHash(const string &vhost, const string &app, const string &stream) {
+    return hash_combine(hash_combine(std::hash<string>()(vhost), app), stream);
+}
+
+static MediaSourceShard &getMediaSourceShard(size_t stream_hash) {
+    static MediaSourceShard s_shards[kMediaSourceShardCount];
+    return s_shards[stream_hash & (kMediaSourceShardCount - 1)];
+}
+
+template <typename FUNC>
+static void for_each_entry(const MediaSourceShard::Map &map, const FUNC &func) {
+    for (auto &pr : map) {
+        func(*pr.second);
+    }
+}
 
 string getOriginTypeString(MediaOriginType type){
 #define SWITCH_CASE(type) case MediaOriginType::type : return #type
@@ -308,52 +370,42 @@ bool MediaSource::stopSendRtp(const string &ssrc) {
     return listener->getMuxer(const_cast<MediaSource &>(*this))->stopSendRtp(ssrc);
 }
 
-template<typename MAP, typename LIST, typename First, typename ...KeyTypes>
-static void for_each_media_l(const MAP &map, LIST &list, const First &first, const KeyTypes &...keys) {
-    if (first.empty()) {
-        for (auto &pr : map) {
-            for_each_media_l(pr.second, list, keys...);
-        }
-        return;
-    }
-    auto it = map.find(first);
-    if (it != map.end()) {
-        for_each_media_l(it->second, list, keys...);
-    }
-}
-
-template<typename LIST, typename Ptr>
-static void emplace_back(LIST &list, const Ptr &ptr) {
-    auto src = ptr.lock();
-    if (src) {
-        list.emplace_back(std::move(src));
-    }
-}
-
-template<typename MAP, typename LIST, typename First>
-static void for_each_media_l(const MAP &map, LIST &list, const First &first) {
-    if (first.empty()) {
-        for (auto &pr : map) {
-            emplace_back(list, pr.second);
-        }
-        return;
-    }
-    auto it = map.find(first);
-    if (it != map.end()) {
-        emplace_back(list, it->second);
-    }
-}
-
 void MediaSource::for_each_media(const function<void(const Ptr &src)> &cb,
                                  const string &schema,
                                  const string &vhost,
                                  const string &app,
                                  const string &stream) {
     deque<Ptr> src_list;
-    {
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        for_each_media_l(s_media_source_map, src_list, schema, vhost, app, stream);
+    auto on_entry = [&](const MediaSourceEntry &entry) {
+        if (!entry.match(schema, vhost, app, stream)) {
+            return;
+        }
+        if (auto src = entry.media.lock()) {
+            src_list.emplace_back(std::move(src));
+        }
+    };
+
+    if (!vhost.empty() && !app.empty() && !stream.empty()) {
+        // 精确查找，只需访问一个分片
+        // Exact lookup, only one shard needs to be accessed
+        auto stream_hash = getStreamHash(vhost, app, stream);
+        auto map = getMediaSourceShard(stream_hash).snapshot();
+        if (!schema.empty()) {
+            auto range = map->equal_range(hash_combine(stream_hash, schema));
+            for (auto it = range.first; it != range.second; ++it) {
+                on_entry(*it->second);
+            }
+        } else {
+            for_each_entry(*map, on_entry);
+        }
+    } else {
+        // 模糊遍历，遍历所有分片的快照，不持有任何锁
+        // Fuzzy traversal, traverse the snapshots of all shards without holding any lock
+        for (size_t i = 0; i < kMediaSourceShardCount; ++i) {
+            for_each_entry(*getMediaSourceShard(i).snapshot(), on_entry);
+        }
     }
+
     for (auto &src : src_list) {
         cb(src);
     }
@@ -509,60 +561,89 @@ void MediaSource::emitEvent(bool regist){
 }
 
 void MediaSource::regist() {
-    {
-        // 减小互斥锁临界区  [AUTO-TRANSLATED:1309d309]
-        // Reduce mutex lock critical area
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        auto &ref = s_media_source_map[_schema][_tuple.vhost][_tuple.app][_tuple.stream];
-        auto src = ref.lock();
-        if (src) {
+    auto stream_hash = getStreamHash(_tuple.vhost, _tuple.app, _tuple.stream);
+    auto key = hash_combine(stream_hash, _schema);
+    bool added = false;
+    getMediaSourceShard(stream_hash).update([&](MediaSourceShard::Map &map) {
+        auto range = map.equal_range(key);
+        for (auto it = range.first; it != range.second;) {
+            auto &entry = *it->second;
+            if (!entry.match(_schema, _tuple.vhost, _tuple.app, _tuple.stream)) {
+                // hash冲突
+                // Hash collision
+                ++it;
+                continue;
+            }
+            auto src = entry.media.lock();
+            if (!src) {
+                // 对象已经销毁，移除之
+                // The object has been destroyed, remove it
+                it = map.erase(it);
+                continue;
+            }
             if (src.get() == this) {
-                return;
+                return false;
             }
             // 增加判断, 防止当前流已注册时再次注册  [AUTO-TRANSLATED:ccc5dcb1]
             // Add judgment to prevent re-registration when the current stream is already registered
             throw std::invalid_argument("media source already existed:" + getUrl());
         }
-        ref = shared_from_this();
-    }
-    emitEvent(true);
-}
-
-template<typename MAP, typename First, typename ...KeyTypes>
-static bool erase_media_source(bool &hit, const MediaSource *thiz, MAP &map, const First &first, const KeyTypes &...keys) {
-    auto it = map.find(first);
-    if (it != map.end() && erase_media_source(hit, thiz, it->second, keys...)) {
-        map.erase(it);
-    }
-    return map.empty();
-}
-
-template<typename MAP, typename First>
-static bool erase_media_source(bool &hit, const MediaSource *thiz, MAP &map, const First &first) {
-    auto it = map.find(first);
-    if (it != map.end()) {
-        auto src = it->second.lock();
-        if (!src || src.get() == thiz) {
-            // 对象已经销毁或者对象就是自己，那么移除之  [AUTO-TRANSLATED:1b9a11d1]
-            // If the object has been destroyed or the object is itself, then remove it
-            map.erase(it);
-            hit = true;
-        }
+        auto entry = std::make_shared<MediaSourceEntry>();
+        entry->schema = _schema;
+        entry->vhost = _tuple.vhost;
+        entry->app = _tuple.app;
+        entry->stream = _tuple.stream;
+        entry->media = shared_from_this();
+        map.emplace(key, std::move(entry));
+        added = true;
+        return true;
+    });
+    if (added) {
+        emitEvent(true);
     }
-    return map.empty();
 }
 
 // 反注册该源  [AUTO-TRANSLATED:682c27ab]
 // Unregister the source
 bool MediaSource::unregist() {
-    bool ret = false;
+    auto stream_hash = getStreamHash(_tuple.vhost, _tuple.app, _tuple.stream);
+    auto key = hash_combine(stream_hash, _schema);
+    auto &shard = getMediaSourceShard(stream_hash);
+
+    auto should_erase = [&](const MediaSourceEntry &entry) {
+        if (!entry.match(_schema, _tuple.vhost, _tuple.app, _tuple.stream)) {
+            return false;
+        }
+        // 对象已经销毁或者对象就是自己，那么移除之  [AUTO-TRANSLATED:1b9a11d1]
+        // If the object has been destroyed or the object is itself, then remove it
+        auto src = entry.media.lock();
+        return !src || src.get() == this;
+    };
+
     {
-        // 减小互斥锁临界区  [AUTO-TRANSLATED:1309d309]
-        // Reduce mutex lock critical area
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        erase_media_source(ret, this, s_media_source_map, _schema, _tuple.vhost, _tuple.app, _tuple.stream);
+        // 先在快照中查找，未命中则无需拷贝  [减小写锁临界区]
+        // Search in the snapshot first, no copy is needed if it misses [reduce write lock critical area]
+        auto map = shard.snapshot();
+        auto range = map->equal_range(key);
+        if (std::none_of(range.first, range.second, [&](const MediaSourceShard::Map::value_type &pr) { return should_erase(*pr.second); })) {
+            return false;
+        }
     }
 
+    bool ret = false;
+    shard.update([&](MediaSourceShard::Map &map) {
+        auto range = map.equal_range(key);
+        for (auto it = range.first; it != range.second;) {
+            if (should_erase(*it->second)) {
+                it = map.erase(it);
+                ret = true;
+            } else {
+                ++it;
+            }
+        }
+        return ret;
+    });
+
     if (ret) {
         emitEvent(false);
     }
@@ -0,0 +1,124 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include "MetricsWriter.h"
+
+using namespace std;
+
+namespace mediakit {
+
+static void appendValue(string &out, double value) {
+    if (std::isnan(value)) {
+        out += "NaN";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+        return;
+    }
+    // 15位有效数字可精确表示2^53以内的计数
+    // 15 significant digits can accurately represent the counts within 2^53
+    char buf[32];
+    auto len = snprintf(buf, sizeof(buf), "%.15g", value);
+    out.append(buf, len);
+}
+
+string MetricsWriter::escapeLabel(const string &value) {
+    string ret;
+    ret.reserve(value.size());
+    for (auto ch : value) {
+        switch (ch) {
+            case '\\': ret += "\\\\"; break;
+            case '"': ret += "\\\""; break;
+            case '\n': ret += "\\n"; break;
+            default: ret.push_back(ch); break;
+        }
+    }
+    return ret;
+}
+
+MetricsWriter::Family &MetricsWriter::getFamily(const string &name, const char *type, const string &help) {
+    auto it = _families.find(name);
+    if (it == _families.end()) {
+        _order.emplace_back(name);
+        it = _families.emplace(name, Family { type, help, "" }).first;
+    }
+    return it->second;
+}
+
+void MetricsWriter::appendSample(string &out, const string &name, const Labels &labels, double value, const pair<string, string> *extra) {
+    out += name;
+    if (!labels.empty() || extra) {
+        out.push_back('{');
+        bool first = true;
+        auto append_label = [&](const pair<string, string> &label) {
+            if (!first) {
+                out.push_back(',');
+            }
+            first = false;
+            out += label.first;
+            out += "=\"";
+            out += escapeLabel(label.second);
+            out.push_back('"');
+        };
+        for (auto &label : labels) {
+            append_label(label);
+        }
+        if (extra) {
+            append_label(*extra);
+        }
+        out.push_back('}');
+    }
+    out.push_back(' ');
+    appendValue(out, value);
+    out.push_back('\n');
+}
+
+void MetricsWriter::gauge(const string &name, const string &help, const Labels &labels, double value) {
+    appendSample(getFamily(name, "gauge", help).samples, name, labels, value);
+}
+
+void MetricsWriter::counter(const string &name, const string &help, const Labels &labels, double value) {
+    appendSample(getFamily(name, "counter", help).samples, name, labels, value);
+}
+
+void MetricsWriter::histogram(const string &name, const string &help, const Labels &labels, const vector<double> &bounds,
+                              const vector<uint64_t> &buckets, double sum) {
+    auto &samples = getFamily(name, "histogram", help).samples;
+    uint64_t count = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        count += buckets[i];
+        string le;
+        if (i < bounds.size()) {
+            appendValue(le, bounds[i]);
+        } else {
+            le = "+Inf";
+        }
+        auto extra = make_pair(string("le"), std::move(le));
+        appendSample(samples, name + "_bucket", labels, (double)count, &extra);
+    }
+    appendSample(samples, name + "_sum", labels, sum);
+    appendSample(samples, name + "_count", labels, (double)count);
+}
+
+string MetricsWriter::str() const {
+    string ret;
+    for (auto &name : _order) {
+        auto &family = _families.at(name);
+        ret += "# HELP " + name + " " + family.help + "\n";
+        ret += "# TYPE " + name + " " + family.type + "\n";
+        ret += family.samples;
+    }
+    return ret;
+}
+
+} // namespace mediakit
@@ -0,0 +1,67 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_METRICSWRITER_H
+#define ZLMEDIAKIT_METRICSWRITER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace mediakit {
+
+/**
+ * Prometheus文本格式(0.0.4)生成器
+ * 同名指标的样本可以分多次、与其他指标交错写入，输出时按指标归组，便于分批遍历大量流
+ * Prometheus text format (0.0.4) generator
+ * Samples of the same metric can be written in several times, interleaved with other metrics, and are grouped by metric on output,
+ * so that a large number of streams can be traversed in batches
+ */
+class MetricsWriter {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    void gauge(const std::string &name, const std::string &help, const Labels &labels, double value);
+    void counter(const std::string &name, const std::string &help, const Labels &labels, double value);
+
+    /**
+     * 写入直方图
+     * @param bounds 各桶上限(不含+Inf)
+     * @param buckets 各桶计数(非累计)，个数为bounds.size() + 1，最后一个为+Inf桶
+     * Write a histogram
+     * @param bounds Upper limit of each bucket (excluding +Inf)
+     * @param buckets Count of each bucket (non-cumulative), the number is bounds.size() + 1, the last one is the +Inf bucket
+     */
+    void histogram(const std::string &name, const std::string &help, const Labels &labels, const std::vector<double> &bounds,
+                   const std::vector<uint64_t> &buckets, double sum);
+
+    std::string str() const;
+
+    static std::string escapeLabel(const std::string &value);
+
+private:
+    struct Family {
+        std::string type;
+        std::string help;
+        std::string samples;
+    };
+
+    Family &getFamily(const std::string &name, const char *type, const std::string &help);
+    static void appendSample(std::string &out, const std::string &name, const Labels &labels, double value,
+                             const std::pair<std::string, std::string> *extra = nullptr);
+
+private:
+    std::vector<std::string> _order;
+    std::unordered_map<std::string, Family> _families;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_METRICSWRITER_H
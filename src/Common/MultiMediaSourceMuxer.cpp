@@ -244,6 +244,12 @@ MultiMediaSourceMuxer::MultiMediaSourceMuxer(const MediaTuple& tuple, float dur_
     _dur_sec = dur_sec;
     setMaxTrackCount(option.max_track);
 
+    GET_CONFIG(bool, latency_enable, Latency::kEnable);
+    GET_CONFIG(bool, latency_inject_sei, Latency::kInjectSei);
+    if (latency_enable) {
+        _latency = std::make_shared<LatencyStat>(latency_inject_sei);
+    }
+
     if (option.enable_rtmp) {
         _rtmp = std::make_shared<RtmpMediaSourceMuxer>(_tuple, option, std::make_shared<TitleMeta>(dur_sec));
     }
@@ -265,6 +271,7 @@ MultiMediaSourceMuxer::MultiMediaSourceMuxer(const MediaTuple& tuple, float dur_
     if (option.enable_fmp4) {
         _fmp4 = dynamic_pointer_cast<FMP4MediaSourceMuxer>(Recorder::createRecorder(Recorder::type_fmp4, _tuple, option));
     }
+    shareMuxer();
 
     // 音频相关设置  [AUTO-TRANSLATED:6ee58d57]
     // Audio related settings
@@ -274,6 +281,19 @@ MultiMediaSourceMuxer::MultiMediaSourceMuxer(const MediaTuple& tuple, float dur_
     NOTICE_EMIT(BroadcastCreateMuxerArgs, Broadcast::kBroadcastCreateMuxer, _delegate, *this);
 }
 
+void MultiMediaSourceMuxer::shareMuxer() {
+    // hls直接对http-ts/http-fmp4的复用结果切片，同时开启两者时只需复用一次
+    // Hls segments the muxing result of http-ts/http-fmp4 directly, when both are enabled, muxing only needs to be done once
+    if (_ts && _hls && !_hls_share_ts) {
+        _ts->addSink(_hls);
+        _hls_share_ts = true;
+    }
+    if (_fmp4 && _hls_fmp4 && !_hls_fmp4_share_fmp4) {
+        _fmp4->addSink(_hls_fmp4);
+        _hls_fmp4_share_fmp4 = true;
+    }
+}
+
 void MultiMediaSourceMuxer::setMediaListener(const std::weak_ptr<MediaSourceEvent> &listener) {
     setDelegate(listener);
 
@@ -352,11 +372,19 @@ bool MultiMediaSourceMuxer::setupRecord(MediaSource &sender, Recorder::type type
                     // Set the event listener for HlsMediaSource
                     hls->setListener(shared_from_this());
                 }
+                // 运行中开启的hls已由gop缓存预先输入数据，使用自己的ts复用器
+                // The hls started at runtime has been pre-fed from the gop cache, so it uses its own ts muxer
                 _hls = hls;
             } else if (!start && _hls) {
                 // 停止录制  [AUTO-TRANSLATED:3dee9292]
                 // Stop recording
                 _hls = nullptr;
+                _hls_share_ts = false;
+                if (_ts && !_ts->isMediaSourceAttached()) {
+                    // http-ts已关闭，仅为hls保留的ts复用器也不再需要
+                    // Http-ts has been stopped, the ts muxer kept only for hls is no longer needed either
+                    _ts = nullptr;
+                }
             }
             return true;
         }
@@ -390,6 +418,12 @@ bool MultiMediaSourceMuxer::setupRecord(MediaSource &sender, Recorder::type type
                 // 停止录制  [AUTO-TRANSLATED:3dee9292]
                 // Stop recording
                 _hls_fmp4 = nullptr;
+                _hls_fmp4_share_fmp4 = false;
+                if (_fmp4 && !_fmp4->isMediaSourceAttached()) {
+                    // http-fmp4已关闭，仅为hls-fmp4保留的fmp4复用器也不再需要
+                    // Http-fmp4 has been stopped, the fmp4 muxer kept only for hls-fmp4 is no longer needed either
+                    _fmp4 = nullptr;
+                }
             }
             return true;
         }
@@ -400,8 +434,17 @@ bool MultiMediaSourceMuxer::setupRecord(MediaSource &sender, Recorder::type type
                     fmp4->setListener(shared_from_this());
                 }
                 _fmp4 = fmp4;
+            } else if (start && !_fmp4->isMediaSourceAttached()) {
+                _fmp4->attachMediaSource();
             } else if (!start && _fmp4) {
-                _fmp4 = nullptr;
+                if (_hls_fmp4_share_fmp4) {
+                    // hls-fmp4正在对其复用结果切片，中途切换数据源会破坏当前切片，只释放FMP4MediaSource，复用器继续为hls-fmp4复用
+                    // Hls-fmp4 is segmenting its muxing result, switching the data source midway would corrupt the current segment,
+                    // so only the FMP4MediaSource is released and the muxer keeps muxing for hls-fmp4
+                    _fmp4->detachMediaSource();
+                } else {
+                    _fmp4 = nullptr;
+                }
             }
             return true;
         }
@@ -411,9 +454,20 @@ bool MultiMediaSourceMuxer::setupRecord(MediaSource &sender, Recorder::type type
                 if (ts) {
                     ts->setListener(shared_from_this());
                 }
+                // 已在运行的hls继续使用自己的ts复用器，避免切片中途切换数据源
+                // The running hls continues to use its own ts muxer, avoiding switching the data source in the middle of a segment
                 _ts = ts;
+            } else if (start && !_ts->isMediaSourceAttached()) {
+                _ts->attachMediaSource();
             } else if (!start && _ts) {
-                _ts = nullptr;
+                if (_hls_share_ts) {
+                    // hls正在对其复用结果切片，中途切换数据源会破坏当前切片，只释放TSMediaSource，复用器继续为hls复用
+                    // Hls is segmenting its muxing result, switching the data source midway would corrupt the current segment,
+                    // so only the TSMediaSource is released and the muxer keeps muxing for hls
+                    _ts->detachMediaSource();
+                } else {
+                    _ts = nullptr;
+                }
             }
             return true;
         }
@@ -574,8 +628,8 @@ bool MultiMediaSourceMuxer::isRecording(Recorder::type type) {
         case Recorder::type_hls: return !!_hls;
         case Recorder::type_mp4: return !!_mp4;
         case Recorder::type_hls_fmp4: return !!_hls_fmp4;
-        case Recorder::type_fmp4: return !!_fmp4;
-        case Recorder::type_ts: return !!_ts;
+        case Recorder::type_fmp4: return _fmp4 && _fmp4->isMediaSourceAttached();
+        case Recorder::type_ts: return _ts && _ts->isMediaSourceAttached();
         default: return false;
     }
 }
@@ -702,6 +756,18 @@ std::shared_ptr<MultiMediaSourceMuxer> MultiMediaSourceMuxer::getMuxer(MediaSour
     return const_cast<MultiMediaSourceMuxer*>(this)->shared_from_this();
 }
 
+const LatencyStat::Ptr &MultiMediaSourceMuxer::getLatencyStat() const {
+    return _latency;
+}
+
+uint64_t MultiMediaSourceMuxer::getGopCacheBytes() const {
+    return _gop_bytes;
+}
+
+uint64_t MultiMediaSourceMuxer::getIngestBytes() const {
+    return _ingest_bytes;
+}
+
 bool MultiMediaSourceMuxer::onTrackReady(const Track::Ptr &track) {
     auto &stamp = _stamps[track->getIndex()];
     if (_dur_sec > 0.01) {
@@ -868,12 +934,20 @@ bool MultiMediaSourceMuxer::onTrackFrame(const Frame::Ptr &frame_in) {
     if (_on_frame) {
         _on_frame(frame_in);
     }
+    _ingest_bytes += frame_in->size();
     auto frame = frame_in;
     if (_option.modify_stamp != ProtocolOption::kModifyStampOff) {
         // 时间戳不采用原始的绝对时间戳  [AUTO-TRANSLATED:8beb3bf7]
         // Timestamp does not use the original absolute timestamp
         frame = std::make_shared<FrameStamp>(frame, _stamps[frame->getIndex()], _option.modify_stamp);
     }
+    if (_latency) {
+        // 记录接收时间，并按需在视频帧前插入时间sei
+        // Record the receiving time, and insert the timing sei before the video frame if needed
+        if (auto sei = _latency->inputFrame(frame_in, frame)) {
+            _paced_sender ? _paced_sender->inputFrame(sei) : onTrackFrame_l(sei);
+        }
+    }
     return _paced_sender ? _paced_sender->inputFrame(frame) : onTrackFrame_l(frame);
 }
 
@@ -890,11 +964,11 @@ bool MultiMediaSourceMuxer::onTrackFrame_l(const Frame::Ptr &frame_in) {
         ret = _ts->inputFrame(frame) ? true : ret;
     }
 
-    if (_hls) {
+    if (_hls && !_hls_share_ts) {
         ret = _hls->inputFrame(frame) ? true : ret;
     }
 
-    if (_hls_fmp4) {
+    if (_hls_fmp4 && !_hls_fmp4_share_fmp4) {
         ret = _hls_fmp4->inputFrame(frame) ? true : ret;
     }
 
@@ -907,6 +981,18 @@ bool MultiMediaSourceMuxer::onTrackFrame_l(const Frame::Ptr &frame_in) {
     if (_delegate) {
         _delegate->inputFrame(frame);
     }
+    if (haveVideo()) {
+        // 各协议的gop缓存从最近的关键帧(或其前的配置帧)开始，据此估算其大小
+        // The gop cache of each protocol starts from the latest key frame (or the config frames before it), estimate its size accordingly
+        if (frame->getTrackType() == TrackVideo && !frame->dropAble()) {
+            auto key_pos = frame->keyFrame() || frame->configFrame();
+            if (key_pos && !_gop_key_pos) {
+                _gop_bytes = 0;
+            }
+            _gop_key_pos = key_pos;
+        }
+        _gop_bytes += frame->size();
+    }
     if (_ring) {
         // 此场景由于直接转发，可能存在切换线程引起的数据被缓存在管道，所以需要CacheAbleFrame  [AUTO-TRANSLATED:528afbb7]
         // In this scenario, due to direct forwarding, there may be data cached in the pipeline due to thread switching, so CacheAbleFrame is needed
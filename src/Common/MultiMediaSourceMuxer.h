@@ -14,6 +14,7 @@
 #include "Common/Stamp.h"
 #include "Common/MediaSource.h"
 #include "Common/MediaSink.h"
+#include "Common/LatencyStat.h"
 #include "Record/Recorder.h"
 #include "Rtp/RtpSender.h"
 #include "Record/HlsRecorder.h"
@@ -189,6 +190,15 @@ public:
 
     const ProtocolOption &getOption() const;
     const MediaTuple &getMediaTuple() const;
+    // 获取延迟统计，未开启时为空
+    // Get the latency statistics, null if not enabled
+    const LatencyStat::Ptr &getLatencyStat() const;
+    // 获取gop缓存的估算大小(帧数据字节数)，线程安全
+    // Get the estimated size of the gop cache (bytes of frame data), thread safe
+    uint64_t getGopCacheBytes() const;
+    // 获取累计输入的帧数据字节数，线程安全
+    // Get the accumulated bytes of input frame data, thread safe
+    uint64_t getIngestBytes() const;
     std::string shortUrl() const;
 #if defined(ENABLE_RTPPROXY)
     void forEachRtpSender(const std::function<void(const std::string &ssrc, const RtpSender &sender)> &cb) const;
@@ -232,15 +242,24 @@ protected:
 
 private:
     void createGopCacheIfNeed();
+    void shareMuxer();
     std::shared_ptr<MediaSinkInterface> makeRecorder(Recorder::type type);
 
 private:
     bool _is_enable = false;
     bool _create_in_poller = false;
     bool _video_key_pos = false;
+    bool _gop_key_pos = false;
+    std::atomic<uint64_t> _gop_bytes { 0 };
+    std::atomic<uint64_t> _ingest_bytes { 0 };
+    // hls是否共享http-ts的ts复用器，hls-fmp4是否共享http-fmp4的fmp4复用器
+    // Whether hls shares the ts muxer of http-ts, and whether hls-fmp4 shares the fmp4 muxer of http-fmp4
+    bool _hls_share_ts = false;
+    bool _hls_fmp4_share_fmp4 = false;
     float _dur_sec;
     std::function<void(const Frame::Ptr &frame)> _on_frame;
     std::shared_ptr<class FramePacedSender> _paced_sender;
+    LatencyStat::Ptr _latency;
     MediaTuple _tuple;
     ProtocolOption _option;
     toolkit::Ticker _last_check;
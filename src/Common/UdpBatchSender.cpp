@@ -0,0 +1,244 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include "UdpBatchSender.h"
+#include "Common/config.h"
+#include "Util/logger.h"
+#include "Network/sockutil.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 单次sendmmsg最大包数
+// Maximum number of packets per sendmmsg
+static constexpr size_t kMaxBatchCount = 64;
+// 单次GSO最大分片数与最大长度
+// Maximum number of segments and maximum length per GSO
+static constexpr size_t kMaxGsoSegments = 64;
+static constexpr size_t kMaxGsoSize = 65000;
+
+static atomic<uint64_t> s_packets { 0 };
+static atomic<uint64_t> s_syscalls { 0 };
+static atomic<uint64_t> s_gso_packets { 0 };
+static atomic<uint64_t> s_fallback_packets { 0 };
+
+UdpBatchSender::UdpBatchSender(Socket::Ptr sock) : _sock(std::move(sock)) {
+    _pkts.reserve(kMaxBatchCount);
+}
+
+void UdpBatchSender::send(Buffer::Ptr buf) {
+    _pkts.emplace_back(std::move(buf));
+}
+
+void UdpBatchSender::flush() {
+    if (_pkts.empty()) {
+        return;
+    }
+    size_t sent = 0;
+#if defined(__linux__) || defined(__linux)
+    GET_CONFIG(int, batchMode, Rtp::kUdpBatchSend);
+    // socket发送队列为空时才能绕过队列直接发送，否则会导致乱序
+    // Only bypass the send queue when it is empty, otherwise it will cause out-of-order
+    if (batchMode && _sock->getSendBufferCount() == 0) {
+        sent = sendBatch();
+    }
+#endif
+    if (sent < _pkts.size()) {
+        s_fallback_packets += _pkts.size() - sent;
+        for (auto i = sent; i < _pkts.size(); ++i) {
+            _sock->send(std::move(_pkts[i]), nullptr, 0, false);
+        }
+        _sock->flushAll();
+    }
+    _pkts.clear();
+}
+
+UdpBatchSender::Statistic UdpBatchSender::getStatistic() {
+    Statistic ret;
+    ret.packets = s_packets.load();
+    ret.syscalls = s_syscalls.load();
+    ret.gso_packets = s_gso_packets.load();
+    ret.fallback_packets = s_fallback_packets.load();
+    return ret;
+}
+
+#if defined(__linux__) || defined(__linux)
+
+size_t UdpBatchSender::sendBatch() {
+    auto fd = _sock->rawFD();
+    if (fd < 0) {
+        return 0;
+    }
+    if (!_peer_addr_len) {
+        auto peer_ip = _sock->get_peer_ip();
+        if (peer_ip.empty()) {
+            return 0;
+        }
+        _peer_addr = SockUtil::make_sockaddr(peer_ip.data(), _sock->get_peer_port());
+        _peer_addr_len = SockUtil::get_sock_len((struct sockaddr *)&_peer_addr);
+    }
+    auto addr = (struct sockaddr *)&_peer_addr;
+    auto addr_len = _peer_addr_len;
+
+    size_t offset = 0;
+    while (offset < _pkts.size()) {
+        ssize_t ret;
+        auto gso_count = getGsoCount(offset);
+        if (gso_count > 1) {
+            ret = sendGso(fd, addr, addr_len, offset, gso_count);
+        } else {
+            // 发送至下一组可GSO的包为止
+            // Send until the next group of packets that can use GSO
+            size_t count = 1;
+            while (offset + count < _pkts.size() && count < kMaxBatchCount && getGsoCount(offset + count) <= 1) {
+                ++count;
+            }
+            ret = sendMMsg(fd, addr, addr_len, offset, count);
+        }
+        if (ret < 0) {
+            // GSO不支持，重试
+            // GSO not supported, retry
+            continue;
+        }
+        if (ret == 0) {
+            // EAGAIN或其他错误，剩余的包交给Socket处理
+            // EAGAIN or other errors, leave the remaining packets to the Socket
+            break;
+        }
+        offset += ret;
+    }
+    return offset;
+}
+
+size_t UdpBatchSender::getGsoCount(size_t offset) const {
+    GET_CONFIG(int, batchMode, Rtp::kUdpBatchSend);
+    if (batchMode < 2 || !_gso_supported) {
+        return 0;
+    }
+    // GSO要求除最后一个分片外所有分片大小相同，最后一个分片可以更小
+    // GSO requires all segments except the last one to have the same size, the last one can be smaller
+    auto seg_size = _pkts[offset]->size();
+    size_t total = seg_size;
+    size_t count = 1;
+    while (offset + count < _pkts.size() && count < kMaxGsoSegments) {
+        auto size = _pkts[offset + count]->size();
+        if (size > seg_size || total + size > kMaxGsoSize) {
+            break;
+        }
+        total += size;
+        ++count;
+        if (size < seg_size) {
+            break;
+        }
+    }
+    return count;
+}
+
+ssize_t UdpBatchSender::sendGso(int fd, const struct sockaddr *addr, socklen_t addr_len, size_t offset, size_t count) {
+    // 每个分片一个iovec，由内核拼接，避免拷贝
+    // One iovec per segment, concatenated by the kernel, avoiding copying
+    struct iovec iovs[kMaxGsoSegments];
+    for (size_t i = 0; i < count; ++i) {
+        auto &pkt = _pkts[offset + i];
+        iovs[i].iov_base = pkt->data();
+        iovs[i].iov_len = pkt->size();
+    }
+
+    char control[CMSG_SPACE(sizeof(uint16_t))] = { 0 };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (void *)addr;
+    msg.msg_namelen = addr_len;
+    msg.msg_iov = iovs;
+    msg.msg_iovlen = count;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    auto cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t seg_size = (uint16_t)_pkts[offset]->size();
+    memcpy(CMSG_DATA(cm), &seg_size, sizeof(seg_size));
+
+    ssize_t ret;
+    do {
+        ret = sendmsg(fd, &msg, 0);
+    } while (ret < 0 && errno == EINTR);
+    ++s_syscalls;
+
+    if (ret < 0) {
+        auto err = errno;
+        if (err == EINVAL || err == EIO || err == EOPNOTSUPP || err == ENOPROTOOPT) {
+            // 内核或网卡(该socket的出口)不支持GSO，对该socket关闭之
+            // The kernel or network card (the egress of this socket) does not support GSO, disable it for this socket
+            WarnL << "udp gso not supported, disable it for " << _sock->get_peer_ip() << ":" << _sock->get_peer_port() << ", " << strerror(err);
+            _gso_supported = false;
+            return -1;
+        }
+        return 0;
+    }
+    s_packets += count;
+    s_gso_packets += count;
+    return count;
+}
+
+ssize_t UdpBatchSender::sendMMsg(int fd, const struct sockaddr *addr, socklen_t addr_len, size_t offset, size_t count) {
+    struct mmsghdr msgs[kMaxBatchCount];
+    struct iovec iovs[kMaxBatchCount];
+    count = std::min(count, kMaxBatchCount);
+    for (size_t i = 0; i < count; ++i) {
+        auto &pkt = _pkts[offset + i];
+        iovs[i].iov_base = pkt->data();
+        iovs[i].iov_len = pkt->size();
+        auto &hdr = msgs[i].msg_hdr;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        hdr.msg_name = (void *)addr;
+        hdr.msg_namelen = addr_len;
+        hdr.msg_iov = &iovs[i];
+        hdr.msg_iovlen = 1;
+    }
+
+    int ret;
+    do {
+        ret = sendmmsg(fd, msgs, count, 0);
+    } while (ret < 0 && errno == EINTR);
+    ++s_syscalls;
+
+    if (ret <= 0) {
+        return 0;
+    }
+    s_packets += ret;
+    return ret;
+}
+
+#else
+
+size_t UdpBatchSender::sendBatch() {
+    return 0;
+}
+
+#endif // defined(__linux__) || defined(__linux)
+
+} // namespace mediakit
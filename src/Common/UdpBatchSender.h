@@ -0,0 +1,95 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_UDPBATCHSENDER_H
+#define ZLMEDIAKIT_UDPBATCHSENDER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "Network/Socket.h"
+
+namespace mediakit {
+
+/**
+ * udp批量发送器，linux下使用sendmmsg与UDP_SEGMENT(GSO)减少系统调用次数
+ * 所有包必须发往同一个对端(即socket绑定的对端地址)，且必须在socket所属poller线程调用
+ * 无法直接发送的包(socket忙、EAGAIN、不支持的平台)会退回到Socket的发送队列，保证发送顺序
+ * Udp batch sender, uses sendmmsg and UDP_SEGMENT (GSO) on linux to reduce the number of system calls
+ * All packets must be sent to the same peer (the peer address bound to the socket), and it must be called in the poller thread of the socket
+ * Packets that cannot be sent directly (socket busy, EAGAIN, unsupported platform) fall back to the send queue of the Socket, keeping the send order
+ */
+class UdpBatchSender {
+public:
+    using Ptr = std::shared_ptr<UdpBatchSender>;
+
+    struct Statistic {
+        // 发送的udp包个数
+        // Number of udp packets sent
+        uint64_t packets = 0;
+        // 批量发送产生的系统调用次数
+        // Number of system calls made by batch sending
+        uint64_t syscalls = 0;
+        // 通过GSO发送的udp包个数
+        // Number of udp packets sent via GSO
+        uint64_t gso_packets = 0;
+        // 退回Socket发送队列的udp包个数
+        // Number of udp packets falling back to the Socket send queue
+        uint64_t fallback_packets = 0;
+    };
+
+    UdpBatchSender(toolkit::Socket::Ptr sock);
+
+    /**
+     * 缓存一个udp包，直到flush时批量发送
+     * Cache a udp packet until flush sends it in batch
+     */
+    void send(toolkit::Buffer::Ptr buf);
+
+    /**
+     * 批量发送所有缓存的udp包
+     * Send all cached udp packets in batch
+     */
+    void flush();
+
+    /**
+     * socket重新绑定对端地址后调用，下次flush时重新获取对端地址
+     * Called after the socket rebinds the peer address, the peer address is fetched again at the next flush
+     */
+    void resetPeerAddr() { _peer_addr_len = 0; }
+
+    const toolkit::Socket::Ptr &getSock() const { return _sock; }
+
+    /**
+     * 获取全局统计信息
+     * Get global statistics
+     */
+    static Statistic getStatistic();
+
+private:
+    size_t sendBatch();
+    size_t getGsoCount(size_t offset) const;
+    ssize_t sendGso(int fd, const struct sockaddr *addr, socklen_t addr_len, size_t offset, size_t count);
+    ssize_t sendMMsg(int fd, const struct sockaddr *addr, socklen_t addr_len, size_t offset, size_t count);
+
+private:
+    // 内核或网卡不支持GSO时对该socket关闭
+    // Disabled for this socket when the kernel or network card does not support GSO
+    bool _gso_supported = true;
+    socklen_t _peer_addr_len = 0;
+    // 缓存的对端地址，避免每次flush都重新解析
+    // The cached peer address, avoiding resolving it again at every flush
+    struct sockaddr_storage _peer_addr;
+    toolkit::Socket::Ptr _sock;
+    std::vector<toolkit::Buffer::Ptr> _pkts;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_UDPBATCHSENDER_H
@@ -199,6 +199,9 @@ const string kVirtualPath = HTTP_FIELD "virtualPath";
 const string kNotFound = HTTP_FIELD "notFound";
 const string kDirMenu = HTTP_FIELD "dirMenu";
 const string kForbidCacheSuffix = HTTP_FIELD "forbidCacheSuffix";
+const string kFileCacheSize = HTTP_FIELD "fileCacheSize";
+const string kFileCacheNum = HTTP_FIELD "fileCacheNum";
+const string kSendFile = HTTP_FIELD "sendFile";
 const string kForwardedIpHeader = HTTP_FIELD "forwarded_ip_header";
 const string kAllowCrossDomains = HTTP_FIELD "allow_cross_domains";
 const string kAllowIPRange = HTTP_FIELD "allow_ip_range";
@@ -224,6 +227,9 @@ static onceToken token([]() {
                                                 "</html>"
                                              << endl;
     mINI::Instance()[kForbidCacheSuffix] = "";
+    mINI::Instance()[kFileCacheSize] = 256;
+    mINI::Instance()[kFileCacheNum] = 512;
+    mINI::Instance()[kSendFile] = false;
     mINI::Instance()[kForwardedIpHeader] = "";
     mINI::Instance()[kAllowCrossDomains] = 1;
     mINI::Instance()[kAllowIPRange] = "::1,127.0.0.1,172.16.0.0-172.31.255.255,192.168.0.0-192.168.255.255,10.0.0.0-10.255.255.255";
@@ -293,6 +299,7 @@ const string kAudioMtuSize = RTP_FIELD "audioMtuSize";
 const string kRtpMaxSize = RTP_FIELD "rtpMaxSize";
 const string kLowLatency = RTP_FIELD "lowLatency";
 const string kH264StapA = RTP_FIELD "h264_stap_a";
+const string kUdpBatchSend = RTP_FIELD "udp_batch_send";
 
 static onceToken token([]() {
     mINI::Instance()[kVideoMtuSize] = 1400;
@@ -300,6 +307,7 @@ static onceToken token([]() {
     mINI::Instance()[kRtpMaxSize] = 10;
     mINI::Instance()[kLowLatency] = 0;
     mINI::Instance()[kH264StapA] = 1;
+    mINI::Instance()[kUdpBatchSend] = 0;
 });
 } // namespace Rtp
 
@@ -359,6 +367,8 @@ const string kBroadcastRecordTs = HLS_FIELD "broadcastRecordTs";
 const string kDeleteDelaySec = HLS_FIELD "deleteDelaySec";
 const string kFastRegister = HLS_FIELD "fastRegister";
 const string kFmp4SegExt = HLS_FIELD "fmp4SegExt";
+const string kPartDuration = HLS_FIELD "partDur";
+const string kMemoryMode = HLS_FIELD "memoryMode";
 
 static onceToken token([]() {
     mINI::Instance()[kSegmentDuration] = 2;
@@ -371,9 +381,37 @@ static onceToken token([]() {
     mINI::Instance()[kDeleteDelaySec] = 10;
     mINI::Instance()[kFastRegister] = false;
     mINI::Instance()[kFmp4SegExt] = ".mp4";
+    mINI::Instance()[kPartDuration] = 0;
+    mINI::Instance()[kMemoryMode] = false;
 });
 } // namespace Hls
 
+namespace Dash {
+#define DASH_FIELD "dash."
+const string kSegmentDuration = DASH_FIELD "segDur";
+const string kSegmentNum = DASH_FIELD "segNum";
+const string kLowLatency = DASH_FIELD "lowLatency";
+const string kTimeoutSec = DASH_FIELD "timeoutSec";
+
+static onceToken token([]() {
+    mINI::Instance()[kSegmentDuration] = 2;
+    mINI::Instance()[kSegmentNum] = 3;
+    mINI::Instance()[kLowLatency] = false;
+    mINI::Instance()[kTimeoutSec] = 30;
+});
+} // namespace Dash
+
+namespace Latency {
+#define LATENCY_FIELD "latency."
+const string kEnable = LATENCY_FIELD "enable";
+const string kInjectSei = LATENCY_FIELD "injectSei";
+
+static onceToken token([]() {
+    mINI::Instance()[kEnable] = false;
+    mINI::Instance()[kInjectSei] = false;
+});
+} // namespace Latency
+
 // //////////Rtp代理相关配置///////////  [AUTO-TRANSLATED:7b285587]
 // //////////Rtp Proxy Related Configuration///////////
 namespace RtpProxy {
@@ -389,6 +427,7 @@ const string kGopCache = RTP_PROXY_FIELD "gop_cache";
 const string kRtpG711DurMs = RTP_PROXY_FIELD "rtp_g711_dur_ms";
 const string kUdpRecvSocketBuffer = RTP_PROXY_FIELD "udp_recv_socket_buffer";
 const std::string kMergeFrame = RTP_PROXY_FIELD "merge_frame";
+const string kUdpBatchRecv = RTP_PROXY_FIELD "udp_batch_recv";
 
 static onceToken token([]() {
     mINI::Instance()[kDumpDir] = "";
@@ -402,6 +441,7 @@ static onceToken token([]() {
     mINI::Instance()[kRtpG711DurMs] = 100;
     mINI::Instance()[kUdpRecvSocketBuffer] = 4 * 1024 * 1024;
     mINI::Instance()[kMergeFrame] = 1;
+    mINI::Instance()[kUdpBatchRecv] = 0;
 });
 } // namespace RtpProxy
 
@@ -382,6 +382,15 @@ extern const std::string kDirMenu;
 // 禁止缓存文件的后缀  [AUTO-TRANSLATED:92bcb7f7]
 // Forbidden cache file suffixes
 extern const std::string kForbidCacheSuffix;
+// 静态文件缓存(打开的文件与mmap)的总大小上限，单位MB，0则不缓存
+// Upper limit of the total size of the static file cache (opened files and mmap), in MB, 0 means no cache
+extern const std::string kFileCacheSize;
+// 静态文件缓存的文件个数上限
+// Upper limit of the number of files in the static file cache
+extern const std::string kFileCacheNum;
+// 非https时是否使用sendfile发送文件
+// Whether to use sendfile to send files when not https
+extern const std::string kSendFile;
 // 可以把http代理前真实客户端ip放在http头中：https://github.com/ZLMediaKit/ZLMediaKit/issues/1388  [AUTO-TRANSLATED:afcd9556]
 // You can put the real client IP address before the HTTP proxy in the HTTP header: https://github.com/ZLMediaKit/ZLMediaKit/issues/1388
 extern const std::string kForwardedIpHeader;
@@ -472,6 +481,9 @@ extern const std::string kLowLatency;
 // H264 rtp打包模式是否采用stap-a模式(为了在老版本浏览器上兼容webrtc)还是采用Single NAL unit packet per H.264 模式  [AUTO-TRANSLATED:30632378]
 // Whether H264 RTP packaging mode uses stap-a mode (for compatibility with webrtc on older browsers) or Single NAL unit packet per H.264 mode
 extern const std::string kH264StapA;
+// rtsp udp播放、组播、ps/ts/es udp发送时的批量发送模式，0：交由Socket发送队列，1：sendmmsg批量发送，2：sendmmsg + UDP GSO(内核不支持时自动退回1)，仅linux有效
+// Batch send mode for rtsp udp playback, multicast and ps/ts/es udp sending, 0: leave it to the Socket send queue, 1: sendmmsg batch, 2: sendmmsg + UDP GSO (automatically falls back to 1 if not supported by the kernel), linux only
+extern const std::string kUdpBatchSend;
 } // namespace Rtp
 
 // //////////组播配置///////////  [AUTO-TRANSLATED:dc39b9d6]
@@ -544,8 +556,40 @@ extern const std::string kFastRegister;
 // fmp4 HLS切片文件的扩展名(例如 .mp4 或 .m4s)；mpegts切片始终为.ts
 // File extension for fMP4 HLS segment files (e.g. .mp4 or .m4s); mpegts segments are always .ts
 extern const std::string kFmp4SegExt;
+// 低延迟hls(LL-HLS)部分切片时长，单位秒，0则不开启
+// Partial segment duration of low-latency hls (LL-HLS), in seconds, 0 means disabled
+extern const std::string kPartDuration;
+// 直播hls切片与m3u8仅保存在内存中，只有开启segKeep或录制时才异步写入磁盘
+// Live hls segments and m3u8 are only kept in memory, and are written to disk asynchronously only when segKeep or recording is enabled
+extern const std::string kMemoryMode;
 } // namespace Hls
 
+// //////////DASH相关配置///////////
+// //////////DASH related configuration///////////
+namespace Dash {
+// DASH切片时长,单位秒
+// DASH segment duration, in seconds
+extern const std::string kSegmentDuration;
+// mpd中的DASH切片个数
+// Number of DASH segments in the mpd
+extern const std::string kSegmentNum;
+// 是否开启低延迟dash(LL-DASH)，正在生成的切片通过http chunked边生成边下发
+// Whether to enable low-latency dash (LL-DASH), the segment being generated is sent by http chunked while it is generated
+extern const std::string kLowLatency;
+// 无dash请求多久后释放切片缓存，单位秒；也是dash播放器鉴权cookie的有效期
+// How long to release the segment cache after no dash request, in seconds; it is also the lifetime of the authentication cookie of a dash player
+extern const std::string kTimeoutSec;
+} // namespace Dash
+
+namespace Latency {
+// 是否统计各输出协议从接收到发送的延迟
+// Whether to measure the latency from receiving to sending of each output protocol
+extern const std::string kEnable;
+// 是否在h264/h265视频帧前插入携带接收时间的sei，供下游级联服务器统计端到端延迟
+// Whether to insert the sei carrying the receiving time before h264/h265 video frames, for downstream cascaded servers to measure end-to-end latency
+extern const std::string kInjectSei;
+} // namespace Latency
+
 // //////////Rtp代理相关配置///////////  [AUTO-TRANSLATED:7b285587]
 // //////////Rtp proxy related configuration///////////
 namespace RtpProxy {
@@ -584,6 +628,10 @@ extern const std::string kRtpG711DurMs;
 extern const std::string kUdpRecvSocketBuffer;
 // ps/ts解析后是否等待下一帧以判断本帧是否完整，开启后提高兼容性，但是可能增加延时
 extern const std::string kMergeFrame;
+// 单端口多路复用的udp端口是否使用recvmmsg批量接收rtp，并按ssrc分组处理(仅linux有效)，开启后所有流在同一线程处理
+// Whether single-port multiplexed udp ports receive rtp in batch with recvmmsg and process it grouped by ssrc (linux only),
+// all streams are processed in the same thread when enabled
+extern const std::string kUdpBatchRecv;
 } // namespace RtpProxy
 
 /**
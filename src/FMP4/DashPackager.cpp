@@ -0,0 +1,582 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <ctime>
+#include <cstring>
+#include "DashPackager.h"
+#include "Util/util.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+static uint32_t loadBE32(const uint8_t *ptr) {
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+}
+
+static uint64_t loadBE64(const uint8_t *ptr) {
+    return ((uint64_t)loadBE32(ptr) << 32) | loadBE32(ptr + 4);
+}
+
+/**
+ * 遍历iso bmff box，回调box类型与负载
+ * Traverse the iso bmff boxes, callback the box type and payload
+ */
+template <typename FUNC>
+static void forEachBox(const uint8_t *ptr, size_t size, FUNC &&func) {
+    while (size >= 8) {
+        uint64_t box_size = loadBE32(ptr);
+        size_t header_size = 8;
+        if (box_size == 1) {
+            if (size < 16) {
+                return;
+            }
+            box_size = loadBE64(ptr + 8);
+            header_size = 16;
+        } else if (box_size == 0) {
+            box_size = size;
+        }
+        if (box_size < header_size || box_size > size) {
+            return;
+        }
+        func(string((const char *)ptr + 4, 4), ptr + header_size, (size_t)box_size - header_size);
+        ptr += box_size;
+        size -= box_size;
+    }
+}
+
+// 读取mpeg4描述符长度
+// Read the mpeg4 descriptor length
+static size_t readDescriptorLength(const uint8_t *&ptr, const uint8_t *end) {
+    size_t ret = 0;
+    for (int i = 0; i < 4 && ptr < end; ++i) {
+        auto byte = *ptr++;
+        ret = (ret << 7) | (byte & 0x7F);
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return ret;
+}
+
+static string getMp4aCodecs(const uint8_t *ptr, size_t size) {
+    // esds: version/flags后为ES_Descriptor(0x03)->DecoderConfigDescriptor(0x04)->DecoderSpecificInfo(0x05)
+    // esds: After version/flags is ES_Descriptor(0x03)->DecoderConfigDescriptor(0x04)->DecoderSpecificInfo(0x05)
+    uint8_t object_type = 0x40;
+    if (size < 4) {
+        return "mp4a.40.2";
+    }
+    const uint8_t *end = ptr + size;
+    ptr += 4;
+    while (ptr + 2 <= end) {
+        auto tag = *ptr++;
+        auto len = readDescriptorLength(ptr, end);
+        if (tag == 0x03) {
+            if (ptr + 3 > end) {
+                break;
+            }
+            auto flags = ptr[2];
+            ptr += 3;
+            if (flags & 0x80) {
+                ptr += 2;
+            }
+            if (flags & 0x40 && ptr < end) {
+                ptr += 1 + *ptr;
+            }
+            if (flags & 0x20) {
+                ptr += 2;
+            }
+        } else if (tag == 0x04) {
+            if (ptr + 13 > end) {
+                break;
+            }
+            object_type = *ptr;
+            ptr += 13;
+        } else if (tag == 0x05) {
+            if (object_type == 0x40 && len && ptr < end) {
+                return "mp4a.40." + to_string(*ptr >> 3);
+            }
+            break;
+        } else {
+            ptr += len;
+        }
+    }
+    char buf[16];
+    snprintf(buf, sizeof(buf), "mp4a.%02X", object_type);
+    return buf;
+}
+
+// rfc6381 codecs参数，参考ISO/IEC 14496-15与av1-isobmff
+// Rfc6381 codecs parameter, refer to ISO/IEC 14496-15 and av1-isobmff
+static string getCodecs(const string &type, const uint8_t *ptr, size_t size) {
+    char buf[64];
+    if ((type == "avc1" || type == "avc3") && size >= 4) {
+        snprintf(buf, sizeof(buf), "%s.%02X%02X%02X", type.data(), ptr[1], ptr[2], ptr[3]);
+        return buf;
+    }
+    if ((type == "hvc1" || type == "hev1") && size >= 13) {
+        static const char *profile_space[] = { "", "A", "B", "C" };
+        // general_profile_compatibility_flags按位反序
+        // General_profile_compatibility_flags in reverse bit order
+        uint32_t flags = loadBE32(ptr + 2), compat = 0;
+        for (int i = 0; i < 32; ++i) {
+            compat |= ((flags >> i) & 1) << (31 - i);
+        }
+        string ret = type + "." + profile_space[ptr[1] >> 6] + to_string(ptr[1] & 0x1F);
+        snprintf(buf, sizeof(buf), ".%X.%c%u", compat, (ptr[1] & 0x20) ? 'H' : 'L', ptr[12]);
+        ret += buf;
+        // 省略末尾为0的general_constraint_indicator_flags
+        // Omit the trailing zero general_constraint_indicator_flags
+        int last = 5;
+        while (last >= 0 && !ptr[6 + last]) {
+            --last;
+        }
+        for (int i = 0; i <= last; ++i) {
+            snprintf(buf, sizeof(buf), ".%02X", ptr[6 + i]);
+            ret += buf;
+        }
+        return ret;
+    }
+    if (type == "av01" && size >= 3) {
+        auto bit_depth = (ptr[2] & 0x40) ? ((ptr[2] & 0x20) ? 12 : 10) : 8;
+        snprintf(buf, sizeof(buf), "av01.%u.%02u%c.%02d", ptr[1] >> 5, ptr[1] & 0x1F, (ptr[2] & 0x80) ? 'H' : 'M', bit_depth);
+        return buf;
+    }
+    if (type == "mp4a") {
+        return getMp4aCodecs(ptr, size);
+    }
+    if (type == "Opus") {
+        return "opus";
+    }
+    if (type == "fLaC") {
+        return "flac";
+    }
+    return type;
+}
+
+static string toIsoTime(uint64_t ms) {
+    char buf[64];
+    time_t tt = ms / 1000;
+    auto len = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", gmtime(&tt));
+    snprintf(buf + len, sizeof(buf) - len, ".%03uZ", (unsigned)(ms % 1000));
+    return buf;
+}
+
+static string toIsoDuration(double sec) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "PT%.3fS", sec);
+    return buf;
+}
+
+static string xmlEscape(const string &str) {
+    string ret;
+    for (auto ch : str) {
+        switch (ch) {
+            case '&': ret += "&amp;"; break;
+            case '<': ret += "&lt;"; break;
+            case '>': ret += "&gt;"; break;
+            case '"': ret += "&quot;"; break;
+            default: ret.push_back(ch); break;
+        }
+    }
+    return ret;
+}
+
+DashPackager::DashPackager(float seg_duration, size_t seg_num, bool low_latency) {
+    _seg_duration = seg_duration > 0 ? seg_duration : 2;
+    _seg_num = seg_num ? seg_num : 1;
+    _low_latency = low_latency;
+}
+
+void DashPackager::setInitSegment(const string &init_segment) {
+    lock_guard<mutex> lck(_mtx);
+    _init_segment = init_segment;
+    _tracks.clear();
+    auto data = (const uint8_t *)_init_segment.data();
+    forEachBox(data, _init_segment.size(), [&](const string &type, const uint8_t *ptr, size_t size) {
+        if (type != "moov") {
+            return;
+        }
+        forEachBox(ptr, size, [&](const string &type, const uint8_t *ptr, size_t size) {
+            if (type != "trak") {
+                return;
+            }
+            Track track;
+            forEachBox(ptr, size, [&](const string &type, const uint8_t *ptr, size_t size) {
+                if (type == "tkhd" && size >= 84) {
+                    track.track_id = loadBE32(ptr + (ptr[0] == 1 ? 20 : 12));
+                    track.width = loadBE32(ptr + size - 8) >> 16;
+                    track.height = loadBE32(ptr + size - 4) >> 16;
+                    return;
+                }
+                if (type != "mdia") {
+                    return;
+                }
+                forEachBox(ptr, size, [&](const string &type, const uint8_t *ptr, size_t size) {
+                    if (type == "mdhd" && size >= 24) {
+                        track.timescale = loadBE32(ptr + (ptr[0] == 1 ? 20 : 12));
+                    } else if (type == "hdlr" && size >= 12) {
+                        track.video = !memcmp(ptr + 8, "vide", 4);
+                    } else if (type == "minf") {
+                        forEachBox(ptr, size, [&](const string &type, const uint8_t *ptr, size_t size) {
+                            if (type != "stbl") {
+                                return;
+                            }
+                            forEachBox(ptr, size, [&](const string &type, const uint8_t *ptr, size_t size) {
+                                if (type != "stsd" || size < 8) {
+                                    return;
+                                }
+                                // 只取第一个sample entry
+                                // Only the first sample entry is taken
+                                bool first = true;
+                                forEachBox(ptr + 8, size - 8, [&](const string &type, const uint8_t *ptr, size_t size) {
+                                    if (!first) {
+                                        return;
+                                    }
+                                    first = false;
+                                    track.codecs = type;
+                                    // VisualSampleEntry头部78字节，AudioSampleEntry头部28字节
+                                    // VisualSampleEntry header is 78 bytes, AudioSampleEntry header is 28 bytes
+                                    size_t skip = track.video ? 78 : 28;
+                                    if (size < skip) {
+                                        return;
+                                    }
+                                    forEachBox(ptr + skip, size - skip, [&](const string &box, const uint8_t *ptr, size_t size) {
+                                        if (box == "avcC" || box == "hvcC" || box == "av1C" || box == "esds") {
+                                            track.codecs = getCodecs(type, ptr, size);
+                                        }
+                                    });
+                                    if (track.codecs == type) {
+                                        track.codecs = getCodecs(type, nullptr, 0);
+                                    }
+                                });
+                            });
+                        });
+                    }
+                });
+            });
+            _tracks.emplace_back(std::move(track));
+        });
+    });
+
+    _ref_track = 0;
+    for (size_t i = 0; i < _tracks.size(); ++i) {
+        if (_tracks[i].video) {
+            _ref_track = i;
+            break;
+        }
+    }
+}
+
+string DashPackager::getInitSegment() const {
+    lock_guard<mutex> lck(_mtx);
+    return _init_segment;
+}
+
+uint64_t DashPackager::getFragmentTime(const Buffer::Ptr &fragment, uint64_t stamp) const {
+    auto &ref = _tracks[_ref_track];
+    uint64_t ret = stamp * ref.timescale / 1000;
+    bool found = false;
+    forEachBox((const uint8_t *)fragment->data(), fragment->size(), [&](const string &type, const uint8_t *ptr, size_t size) {
+        if (type != "moof" || found) {
+            return;
+        }
+        forEachBox(ptr, size, [&](const string &type, const uint8_t *ptr, size_t size) {
+            if (type != "traf" || found) {
+                return;
+            }
+            uint32_t track_id = 0;
+            forEachBox(ptr, size, [&](const string &type, const uint8_t *ptr, size_t size) {
+                if (type == "tfhd" && size >= 8) {
+                    track_id = loadBE32(ptr + 4);
+                } else if (type == "tfdt" && track_id == ref.track_id && size >= 8) {
+                    ret = (ptr[0] == 1 && size >= 12) ? loadBE64(ptr + 4) : loadBE32(ptr + 4);
+                    found = true;
+                }
+            });
+        });
+    });
+    return ret;
+}
+
+uint64_t DashPackager::estimateDuration() const {
+    for (auto it = _segments.rbegin(); it != _segments.rend(); ++it) {
+        if (it->data) {
+            return it->duration;
+        }
+    }
+    return (uint64_t)(_seg_duration * _tracks[_ref_track].timescale);
+}
+
+bool DashPackager::isReady() const {
+    if (_segments.empty()) {
+        return false;
+    }
+    // mpd时间轴至少需要一个完整切片
+    // The mpd timeline needs at least one complete segment
+    return _segments.size() > 1 || _segments.front().data;
+}
+
+void DashPackager::notifyReady(bool ready) {
+    for (auto &cb : _ready_waiters) {
+        cb(ready);
+    }
+    _ready_waiters.clear();
+}
+
+void DashPackager::startSegment(uint64_t time, uint64_t stamp) {
+    if (!_start_time_ms) {
+        // 让首个切片的起始时间对应当前时间
+        // Make the start time of the first segment correspond to the current time
+        _start_time_ms = getCurrentMillisecond(true) - time * 1000 / _tracks[_ref_track].timescale;
+    }
+    Segment segment;
+    segment.number = _next_number++;
+    segment.start = time;
+    segment.stamp = stamp;
+    _segments.emplace_back(std::move(segment));
+}
+
+void DashPackager::finishSegment(uint64_t end_time) {
+    auto &segment = _segments.back();
+    segment.duration = end_time > segment.start ? end_time - segment.start : estimateDuration();
+    auto data = std::make_shared<BufferLikeString>();
+    data->reserve(segment.bytes);
+    for (auto &fragment : segment.fragments) {
+        data->append(fragment->data(), fragment->size());
+    }
+    segment.fragments.clear();
+    segment.data = std::move(data);
+
+    for (auto it = _chunk_readers.begin(); it != _chunk_readers.end();) {
+        if (it->first == segment.number) {
+            it->second(nullptr);
+            it = _chunk_readers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // 多保留一个已移出mpd的切片，供落后的播放器下载
+    // Keep one more segment that has been removed from the mpd, for lagging players to download
+    while (_segments.size() > _seg_num + 1) {
+        _segments.pop_front();
+    }
+}
+
+void DashPackager::inputFragment(const Buffer::Ptr &fragment, uint64_t stamp, bool key) {
+    lock_guard<mutex> lck(_mtx);
+    if (_tracks.empty()) {
+        return;
+    }
+    auto time = getFragmentTime(fragment, stamp);
+    bool generating = !_segments.empty() && !_segments.back().data;
+    if (key && (!generating || stamp >= _segments.back().stamp + _seg_duration * 1000)) {
+        // 在关键帧处切片
+        // Split the segment at the key frame
+        if (generating) {
+            finishSegment(time);
+        }
+        startSegment(time, stamp);
+        generating = true;
+    }
+    if (!generating) {
+        // 等待第一个关键帧
+        // Wait for the first key frame
+        return;
+    }
+    _last_time = time;
+    auto &segment = _segments.back();
+    segment.fragments.emplace_back(fragment);
+    segment.bytes += fragment->size();
+    for (auto &pr : _chunk_readers) {
+        if (pr.first == segment.number) {
+            pr.second(fragment);
+        }
+    }
+    if (!_ready_waiters.empty() && isReady()) {
+        notifyReady(true);
+    }
+}
+
+void DashPackager::flush() {
+    lock_guard<mutex> lck(_mtx);
+    if (!_segments.empty() && !_segments.back().data) {
+        finishSegment(_last_time);
+    }
+    for (auto &pr : _chunk_readers) {
+        pr.second(nullptr);
+    }
+    _chunk_readers.clear();
+    notifyReady(isReady());
+}
+
+void DashPackager::waitReady(onReady cb) {
+    lock_guard<mutex> lck(_mtx);
+    if (isReady()) {
+        cb(true);
+        return;
+    }
+    _ready_waiters.emplace_back(std::move(cb));
+}
+
+Buffer::Ptr DashPackager::getSegment(uint64_t number) const {
+    lock_guard<mutex> lck(_mtx);
+    for (auto &segment : _segments) {
+        if (segment.number == number) {
+            return segment.data;
+        }
+    }
+    return nullptr;
+}
+
+bool DashPackager::readSegment(uint64_t number, onChunk cb) {
+    lock_guard<mutex> lck(_mtx);
+    if (!_low_latency) {
+        return false;
+    }
+    if (number != _next_number) {
+        if (_segments.empty() || _segments.back().data || _segments.back().number != number) {
+            return false;
+        }
+        // 先回调已生成的片段
+        // Callback the generated fragments first
+        for (auto &fragment : _segments.back().fragments) {
+            cb(fragment);
+        }
+    }
+    _chunk_readers.emplace_back(number, std::move(cb));
+    return true;
+}
+
+uint64_t DashPackager::touch() {
+    lock_guard<mutex> lck(_mtx);
+    auto ret = _access.elapsedTime();
+    _access.resetTime();
+    return ret;
+}
+
+string DashPackager::makeMpd(const string &stream_name, const string &params) const {
+    lock_guard<mutex> lck(_mtx);
+    auto &ref = _tracks[_ref_track];
+    // mpd中只列出最近的完整切片，低延迟模式下正在生成的切片由availabilityTimeOffset提前开放下载
+    // Only the latest complete segments are listed in the mpd, in low-latency mode the segment being generated is
+    // opened for download in advance by availabilityTimeOffset
+    auto end = _segments.end();
+    if (!_segments.empty() && !_segments.back().data) {
+        --end;
+    }
+    auto begin = end;
+    size_t complete = 0;
+    while (begin != _segments.begin() && complete < _seg_num) {
+        --begin;
+        if (begin->data) {
+            ++complete;
+        }
+    }
+
+    uint64_t bytes = 0, duration = 0, max_duration = 0;
+    for (auto it = begin; it != end; ++it) {
+        if (it->data) {
+            bytes += it->data->size();
+            duration += it->duration;
+            max_duration = MAX(max_duration, it->duration);
+        }
+    }
+    auto seg_duration = _seg_duration;
+    if (max_duration) {
+        seg_duration = MAX(seg_duration, (float)max_duration / ref.timescale);
+    }
+    auto bandwidth = duration ? bytes * 8 * ref.timescale / duration : 0;
+
+    string codecs, mime_type = "audio/mp4";
+    uint32_t sample_rate = 0;
+    for (auto &track : _tracks) {
+        codecs += (codecs.empty() ? "" : ",") + track.codecs;
+        if (track.video) {
+            mime_type = "video/mp4";
+        } else if (!sample_rate) {
+            sample_rate = track.timescale;
+        }
+    }
+    auto query = params.empty() ? "" : "?" + xmlEscape(params);
+    auto now = getCurrentMillisecond(true);
+
+    _StrPrinter printer;
+    printer << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+            << "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" profiles=\"urn:mpeg:dash:profile:isoff-live:2011"
+            << (_low_latency ? ",http://www.dashif.org/guidelines/low-latency-live-v5" : "") << "\" type=\"dynamic\""
+            << " availabilityStartTime=\"" << toIsoTime(_start_time_ms) << "\""
+            << " publishTime=\"" << toIsoTime(now) << "\""
+            << " minimumUpdatePeriod=\"" << toIsoDuration(_seg_duration) << "\""
+            << " minBufferTime=\"" << toIsoDuration(_low_latency ? _seg_duration / 2 : _seg_duration) << "\""
+            << " timeShiftBufferDepth=\"" << toIsoDuration(seg_duration * _seg_num) << "\""
+            << " maxSegmentDuration=\"" << toIsoDuration(seg_duration) << "\">\n";
+    if (_low_latency) {
+        printer << "  <ServiceDescription id=\"0\">\n"
+                << "    <Latency target=\"" << (uint64_t)(_seg_duration * 1000) << "\"/>\n"
+                << "  </ServiceDescription>\n";
+    }
+    printer << "  <Period id=\"0\" start=\"PT0S\">\n"
+            << "    <AdaptationSet id=\"0\" mimeType=\"" << mime_type << "\" segmentAlignment=\"true\" startWithSAP=\"1\">\n"
+            << "      <Representation id=\"0\" codecs=\"" << codecs << "\" bandwidth=\"" << MAX(bandwidth, (uint64_t)1) << "\"";
+    if (ref.video && ref.width && ref.height) {
+        printer << " width=\"" << ref.width << "\" height=\"" << ref.height << "\"";
+    }
+    if (sample_rate) {
+        printer << " audioSamplingRate=\"" << sample_rate << "\"";
+    }
+    printer << ">\n"
+            << "        <SegmentTemplate timescale=\"" << ref.timescale << "\""
+            << " initialization=\"" << stream_name << ".live.init.m4s" << query << "\""
+            << " media=\"" << stream_name << ".live.$Number$.m4s" << query << "\""
+            << " startNumber=\"" << (begin != end ? begin->number : _next_number) << "\"";
+    if (_low_latency) {
+        // 正在生成的切片在其开始时即可通过chunked下载
+        // The segment being generated can be downloaded by chunked as soon as it starts
+        printer << " availabilityTimeOffset=\"" << (double)estimateDuration() / ref.timescale << "\" availabilityTimeComplete=\"false\"";
+    }
+    printer << ">\n"
+            << "          <SegmentTimeline>\n";
+    for (auto it = begin; it != end; ++it) {
+        printer << "            <S t=\"" << it->start << "\" d=\"" << it->duration << "\"/>\n";
+    }
+    printer << "          </SegmentTimeline>\n"
+            << "        </SegmentTemplate>\n"
+            << "      </Representation>\n"
+            << "    </AdaptationSet>\n"
+            << "  </Period>\n"
+            << "  <UTCTiming schemeIdUri=\"urn:mpeg:dash:utc:direct:2014\" value=\"" << toIsoTime(now) << "\"/>\n"
+            << "</MPD>\n";
+    return printer;
+}
+
+bool DashPackager::parseSegmentName(const string &url, uint64_t &number) {
+    static const string suffix = ".m4s";
+    static const string prefix = ".live.";
+    if (url.size() <= suffix.size() || url.compare(url.size() - suffix.size(), suffix.size(), suffix)) {
+        return false;
+    }
+    auto end = url.size() - suffix.size();
+    auto pos = url.rfind(prefix, end);
+    if (pos == string::npos || pos + prefix.size() >= end) {
+        return false;
+    }
+    number = 0;
+    for (auto i = pos + prefix.size(); i < end; ++i) {
+        if (url[i] < '0' || url[i] > '9') {
+            return false;
+        }
+        number = number * 10 + (url[i] - '0');
+    }
+    return true;
+}
+
+} // namespace mediakit
@@ -0,0 +1,183 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_DASHPACKAGER_H
+#define ZLMEDIAKIT_DASHPACKAGER_H
+
+#include <list>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+#include "Network/Buffer.h"
+#include "Util/TimeTicker.h"
+
+namespace mediakit {
+
+/**
+ * 把fmp4直播的逐帧moof+mdat片段组装为MPEG-DASH切片，并生成SegmentTemplate+SegmentTimeline形式的动态mpd
+ * 切片在关键帧处切分，时间轴取自片段tfdt，与切片内时间戳一致；mpd只列出完整切片；低延迟模式下下一个切片由availabilityTimeOffset提前开放，并可通过http chunked边生成边下发
+ * 线程安全，回调均在锁内触发，回调中不可再调用本对象
+ * Assemble the frame-level moof+mdat fragments of the fmp4 live stream into MPEG-DASH segments, and generate a dynamic mpd
+ * in the form of SegmentTemplate+SegmentTimeline
+ * Segments are split at key frames, the timeline is taken from the tfdt of the fragments and is consistent with the timestamps in the segments;
+ * the mpd only lists complete segments; in low-latency mode the next segment is opened in advance by availabilityTimeOffset
+ * and can be sent by http chunked while it is generated
+ * Thread safe, the callbacks are all triggered inside the lock, and this object must not be called again in the callbacks
+ */
+class DashPackager {
+public:
+    using Ptr = std::shared_ptr<DashPackager>;
+    // 低延迟切片分块回调，chunk为空表示切片结束
+    // Low-latency segment chunk callback, empty chunk means the end of the segment
+    using onChunk = std::function<void(const toolkit::Buffer::Ptr &chunk)>;
+    // mpd就绪回调，ready为false表示流已结束
+    // Mpd ready callback, ready is false means the stream has ended
+    using onReady = std::function<void(bool ready)>;
+
+    /**
+     * @param seg_duration 切片目标时长，单位秒
+     * @param seg_num mpd中保留的切片个数
+     * @param low_latency 是否开启低延迟模式
+     * @param seg_duration Target segment duration, in seconds
+     * @param seg_num Number of segments kept in the mpd
+     * @param low_latency Whether to enable the low-latency mode
+     */
+    DashPackager(float seg_duration, size_t seg_num, bool low_latency);
+
+    /**
+     * 设置fmp4 init segment，从中解析各track的timescale与codecs
+     * Set the fmp4 init segment, parse the timescale and codecs of each track from it
+     */
+    void setInitSegment(const std::string &init_segment);
+
+    /**
+     * 输入一个moof+mdat片段
+     * @param fragment 片段数据
+     * @param stamp 片段时间戳，单位毫秒
+     * @param key 是否为关键帧片段(纯音频时每个片段都是)
+     * Input a moof+mdat fragment
+     * @param fragment Fragment data
+     * @param stamp Fragment timestamp, in milliseconds
+     * @param key Whether it is a key frame fragment (every fragment when there is only audio)
+     */
+    void inputFragment(const toolkit::Buffer::Ptr &fragment, uint64_t stamp, bool key);
+
+    /**
+     * 流结束，结束正在生成的切片并通知所有等待者
+     * The stream ends, finish the segment being generated and notify all waiters
+     */
+    void flush();
+
+    /**
+     * 等待mpd就绪：需有一个完整切片
+     * Wait for the mpd to be ready: a complete segment is required
+     */
+    void waitReady(onReady cb);
+
+    /**
+     * 生成mpd
+     * @param stream_name 切片url前缀，一般为流id
+     * @param params 切片url参数(鉴权参数等)
+     * Generate mpd
+     * @param stream_name Segment url prefix, generally the stream id
+     * @param params Segment url parameters (authentication parameters, etc.)
+     */
+    std::string makeMpd(const std::string &stream_name, const std::string &params) const;
+
+    std::string getInitSegment() const;
+
+    /**
+     * 获取完整切片，不存在或尚未生成完毕时返回空
+     * Get a complete segment, return null if it does not exist or is still being generated
+     */
+    toolkit::Buffer::Ptr getSegment(uint64_t number) const;
+
+    /**
+     * 低延迟模式下读取正在生成或下一个切片，已生成的片段立即回调，后续片段生成时回调，切片结束时回调空
+     * @return false表示该切片不是正在生成或下一个切片
+     * Read the segment being generated or the next segment in low-latency mode, the generated fragments are called back immediately,
+     * the subsequent fragments are called back when they are generated, and null is called back when the segment ends
+     * @return false means the segment is neither being generated nor the next one
+     */
+    bool readSegment(uint64_t number, onChunk cb);
+
+    /**
+     * 刷新访问时间，并返回距上次访问的时长，单位毫秒
+     * Refresh the access time, and return the duration since the last access, in milliseconds
+     */
+    uint64_t touch();
+    uint64_t idleTime() const { return _access.elapsedTime(); }
+
+    bool isLowLatency() const { return _low_latency; }
+
+    /**
+     * 解析切片文件名，格式为xxx.live.<number>.m4s
+     * Parse the segment file name, the format is xxx.live.<number>.m4s
+     */
+    static bool parseSegmentName(const std::string &url, uint64_t &number);
+
+private:
+    struct Track {
+        uint32_t track_id = 0;
+        uint32_t timescale = 1000;
+        bool video = false;
+        std::string codecs;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    struct Segment {
+        uint64_t number = 0;
+        // 起始时间与时长，单位为参考track的timescale
+        // Start time and duration, in the timescale of the reference track
+        uint64_t start = 0;
+        uint64_t duration = 0;
+        uint64_t stamp = 0;
+        size_t bytes = 0;
+        // 生成中的切片的片段
+        // Fragments of the segment being generated
+        std::vector<toolkit::Buffer::Ptr> fragments;
+        // 生成完毕的切片数据
+        // Data of the complete segment
+        toolkit::Buffer::Ptr data;
+    };
+
+    bool isReady() const;
+    uint64_t getFragmentTime(const toolkit::Buffer::Ptr &fragment, uint64_t stamp) const;
+    void startSegment(uint64_t time, uint64_t stamp);
+    void finishSegment(uint64_t end_time);
+    void notifyReady(bool ready);
+    uint64_t estimateDuration() const;
+
+private:
+    bool _low_latency;
+    float _seg_duration;
+    size_t _seg_num;
+    uint64_t _next_number = 1;
+    uint64_t _last_time = 0;
+    // availabilityStartTime，unix时间戳，单位毫秒
+    // AvailabilityStartTime, unix timestamp, in milliseconds
+    uint64_t _start_time_ms = 0;
+    std::string _init_segment;
+    std::vector<Track> _tracks;
+    // 时间轴参考track(首个视频track)的下标
+    // Index of the timeline reference track (the first video track)
+    size_t _ref_track = 0;
+    toolkit::Ticker _access;
+    mutable std::mutex _mtx;
+    std::deque<Segment> _segments;
+    std::list<onReady> _ready_waiters;
+    std::list<std::pair<uint64_t, onChunk>> _chunk_readers;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_DASHPACKAGER_H
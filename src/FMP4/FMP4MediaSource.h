@@ -14,6 +14,7 @@
 #include "Common/MediaSource.h"
 #include "Common/PacketCache.h"
 #include "Util/RingBuffer.h"
+#include "DashPackager.h"
 
 #define FMP4_GOP_SIZE 512
 
@@ -46,6 +47,7 @@ public:
     ~FMP4MediaSource() override {
         try {
             flush();
+            releaseDash();
         } catch (std::exception &ex) {
             WarnL << ex.what();
         }
@@ -86,9 +88,33 @@ public:
      */
     void setInitSegment(std::string str) {
         _init_segment = std::move(str);
+        // track变化后旧的dash切片不再可用
+        // The old dash segments are no longer available after the tracks change
+        releaseDash();
         createRing();
     }
 
+    /**
+     * 获取dash打包器，不存在时创建，并刷新其访问时间
+     * 每个dash播放器各自持有环形缓冲读取器计入观看人数，打包器在长时间无dash请求后释放
+     * Get the dash packager, create it if it does not exist, and refresh its access time
+     * Each dash player holds its own ring buffer reader to be counted as a viewer, the packager is released after no dash request for a long time
+     */
+    DashPackager::Ptr getDashPackager() {
+        std::lock_guard<std::mutex> lck(_mtx_dash);
+        if (!_dash && _ring && !_init_segment.empty()) {
+            GET_CONFIG(float, seg_dur, Dash::kSegmentDuration);
+            GET_CONFIG(uint32_t, seg_num, Dash::kSegmentNum);
+            GET_CONFIG(bool, low_latency, Dash::kLowLatency);
+            _dash = std::make_shared<DashPackager>(seg_dur, seg_num, low_latency);
+            _dash->setInitSegment(_init_segment);
+        }
+        if (_dash) {
+            _dash->touch();
+        }
+        return _dash;
+    }
+
     /**
      * 获取播放器个数
      * Get the number of players
@@ -117,6 +143,7 @@ public:
             _have_video = true;
         }
         _speed[TrackVideo] += packet->size();
+        inputDash(packet, key);
         auto stamp = packet->time_stamp;
         PacketCache<FMP4Packet>::inputPacket(stamp, true, std::move(packet), key);
     }
@@ -133,6 +160,30 @@ public:
     }
 
 private:
+    void inputDash(const FMP4Packet::Ptr &packet, bool key) {
+        std::lock_guard<std::mutex> lck(_mtx_dash);
+        if (!_dash) {
+            return;
+        }
+        GET_CONFIG(uint32_t, timeout_sec, Dash::kTimeoutSec);
+        if (_dash->idleTime() > timeout_sec * 1000) {
+            // 长时间无dash请求，释放切片缓存
+            // No dash request for a long time, release the segment cache
+            _dash->flush();
+            _dash = nullptr;
+            return;
+        }
+        _dash->inputFragment(packet, packet->time_stamp, key);
+    }
+
+    void releaseDash() {
+        std::lock_guard<std::mutex> lck(_mtx_dash);
+        if (_dash) {
+            _dash->flush();
+            _dash = nullptr;
+        }
+    }
+
     void createRing(){
         std::weak_ptr<FMP4MediaSource> weak_self = std::static_pointer_cast<FMP4MediaSource>(shared_from_this());
         _ring = std::make_shared<RingType>(_ring_size, [weak_self](int size) {
@@ -168,6 +219,8 @@ private:
     int _ring_size;
     std::string _init_segment;
     RingType::Ptr _ring;
+    std::mutex _mtx_dash;
+    DashPackager::Ptr _dash;
 };
 
 
@@ -16,12 +16,13 @@
 
 namespace mediakit {
 
-class FMP4MediaSourceMuxer final : public MP4MuxerMemory, public MediaSourceEventInterceptor,
+class FMP4MediaSourceMuxer final : public MP4MuxerMemory, public SharedMuxer, public MediaSourceEventInterceptor,
                                    public std::enable_shared_from_this<FMP4MediaSourceMuxer> {
 public:
     using Ptr = std::shared_ptr<FMP4MediaSourceMuxer>;
 
     FMP4MediaSourceMuxer(const MediaTuple& tuple, const ProtocolOption &option) {
+        _tuple = tuple;
         _option = option;
         _media_src = std::make_shared<FMP4MediaSource>(tuple);
     }
@@ -36,11 +37,42 @@ public:
 
     void setListener(const std::weak_ptr<MediaSourceEvent> &listener){
         setDelegate(listener);
-        _media_src->setListener(shared_from_this());
+        if (_media_src) {
+            _media_src->setListener(shared_from_this());
+        }
     }
 
     int readerCount() const{
-        return _media_src->readerCount();
+        return _media_src ? _media_src->readerCount() : 0;
+    }
+
+    /**
+     * 关闭http-fmp4/ws-fmp4：释放FMP4MediaSource(注销并断开其播放器)，复用器继续为共享消费者(hls-fmp4)复用
+     * Stop http-fmp4/ws-fmp4: release the FMP4MediaSource (unregister it and disconnect its players), the muxer keeps muxing for the sharing consumers (hls-fmp4)
+     */
+    void detachMediaSource() {
+        _media_src = nullptr;
+    }
+
+    /**
+     * 重新开启http-fmp4/ws-fmp4，FMP4MediaSource在写入首个fmp4片段时注册
+     * Restart http-fmp4/ws-fmp4, the FMP4MediaSource is registered when the first fmp4 fragment is written
+     */
+    void attachMediaSource() {
+        if (_media_src) {
+            return;
+        }
+        _enabled = true;
+        _clear_cache = false;
+        _media_src = std::make_shared<FMP4MediaSource>(_tuple);
+        _media_src->setListener(shared_from_this());
+        if (_track_completed) {
+            _media_src->setInitSegment(getInitSegment());
+        }
+    }
+
+    bool isMediaSourceAttached() const {
+        return _media_src.operator bool();
     }
 
     void onReaderChanged(MediaSource &sender, int size) override {
@@ -52,17 +84,25 @@ public:
     }
 
     bool inputFrame(const Frame::Ptr &frame) override {
+        if (!_media_src) {
+            return isSinkEnabled() ? MP4MuxerMemory::inputFrame(frame) : false;
+        }
         if (_clear_cache && _option.fmp4_demand) {
             _clear_cache = false;
             _media_src->clearCache();
         }
-        if (_enabled || !_option.fmp4_demand) {
+        if (_enabled || !_option.fmp4_demand || isSinkEnabled()) {
             return MP4MuxerMemory::inputFrame(frame);
         }
         return false;
     }
 
     bool isEnabled() {
+        if (!_media_src) {
+            // 共享消费者自己计入MultiMediaSourceMuxer::isEnabled
+            // The sharing consumers count themselves in MultiMediaSourceMuxer::isEnabled
+            return false;
+        }
         // 缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存  [AUTO-TRANSLATED:7cfd4d49]
         // The inputFrame function is still allowed to be triggered when the cache has not been cleared, so that the cache can be cleared in time.
         return _option.fmp4_demand ? (_clear_cache ? true : _enabled) : true;
@@ -70,7 +110,15 @@ public:
 
     void addTrackCompleted() override {
         MP4MuxerMemory::addTrackCompleted();
-        _media_src->setInitSegment(getInitSegment());
+        _track_completed = true;
+        if (_media_src) {
+            _media_src->setInitSegment(getInitSegment());
+        }
+    }
+
+    void resetTracks() override {
+        MP4MuxerMemory::resetTracks();
+        _track_completed = false;
     }
 
     MediaSource::Ptr getMediaSource() const {
@@ -84,12 +132,22 @@ protected:
         }
         FMP4Packet::Ptr packet = std::make_shared<FMP4Packet>(std::move(string));
         packet->time_stamp = stamp;
+        // 每帧一个moof+mdat，各消费者共享同一份内存
+        // One moof+mdat per frame, all consumers share the same memory
+        writeToSinks(packet, stamp, key_frame);
+        if (!_media_src || (!_enabled && _option.fmp4_demand)) {
+            // 仅为共享消费者复用时，不写入FMP4MediaSource
+            // When muxing only for the sharing consumers, do not write into FMP4MediaSource
+            return;
+        }
         _media_src->onWrite(std::move(packet), key_frame);
     }
 
 private:
     bool _enabled = true;
     bool _clear_cache = false;
+    bool _track_completed = false;
+    MediaTuple _tuple;
     ProtocolOption _option;
     FMP4MediaSource::Ptr _media_src;
 };
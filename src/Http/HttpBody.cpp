@@ -9,7 +9,9 @@
  */
 
 #include <csignal>
-#include <tuple>
+#include <list>
+#include <atomic>
+#include <unordered_map>
 
 #ifndef _WIN32
 #include <sys/mman.h>
@@ -27,6 +29,7 @@
 #include "HttpBody.h"
 #include "HttpClient.h"
 #include "Common/macros.h"
+#include "Common/config.h"
 
 using namespace std;
 using namespace toolkit;
@@ -54,8 +57,36 @@ Buffer::Ptr HttpStringBody::readData(size_t size) {
 }
 
 //////////////////////////////////////////////////////////////////
+// 文件大小、修改时间与inode，任一改变则说明文件已被修改或替换
+// File size, modification time and inode, any change means the file has been modified or replaced
+struct HttpFileStat {
+    int64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t ino = 0;
+
+    bool operator==(const HttpFileStat &that) const { return size == that.size && mtime == that.mtime && ino == that.ino; }
+};
+
+// 缓存的已打开文件及其mmap
+// The cached opened file and its mmap
+struct HttpCachedFile {
+    using Ptr = std::shared_ptr<HttpCachedFile>;
+    HttpFileStat stat;
+    std::shared_ptr<FILE> fp;
+    std::shared_ptr<char> map_addr;
+};
+
+using HttpFileLru = list<pair<string /*file_path*/, HttpCachedFile::Ptr> >;
+
 static mutex s_mtx;
-static unordered_map<string /*file_path*/, std::tuple<char */*ptr*/, int64_t /*size*/, weak_ptr<char> /*mmap*/ > > s_shared_mmap;
+static HttpFileLru s_file_lru;
+static unordered_map<string /*file_path*/, HttpFileLru::iterator> s_file_index;
+static uint64_t s_file_bytes = 0;
+static atomic<uint64_t> s_cache_hits { 0 };
+static atomic<uint64_t> s_cache_misses { 0 };
+static atomic<uint64_t> s_cache_evictions { 0 };
+static atomic<uint64_t> s_cache_invalidations { 0 };
+static atomic<uint64_t> s_send_file_bytes { 0 };
 
 #if defined(_WIN32)
 static void mmap_close(HANDLE _hfile, HANDLE _hmapping, void *_addr) {
@@ -73,31 +104,38 @@ static void mmap_close(HANDLE _hfile, HANDLE _hmapping, void *_addr) {
 }
 #endif
 
-// 删除mmap记录  [AUTO-TRANSLATED:c956201d]
-// Delete mmap record
-static void delSharedMmap(const string &file_path, char *ptr) {
-    lock_guard<mutex> lck(s_mtx);
-    auto it = s_shared_mmap.find(file_path);
-    if (it != s_shared_mmap.end() && std::get<0>(it->second) == ptr) {
-        s_shared_mmap.erase(it);
+static bool getFileStat(const string &file_path, HttpFileStat &stat) {
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(file_path.data(), &st) != 0) {
+        return false;
     }
+    stat.mtime = st.st_mtime;
+#else
+    struct stat st;
+    if (::stat(file_path.data(), &st) != 0) {
+        return false;
+    }
+#if defined(__APPLE__)
+    stat.mtime = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    stat.mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+#endif
+    stat.size = st.st_size;
+    stat.ino = st.st_ino;
+    return true;
 }
 
-static std::shared_ptr<char> getSharedMmap(const string &file_path, int64_t &file_size) {
-    {
-        lock_guard<mutex> lck(s_mtx);
-        auto it = s_shared_mmap.find(file_path);
-        if (it != s_shared_mmap.end()) {
-            auto ret = std::get<2>(it->second).lock();
-            if (ret) {
-                // 命中mmap缓存  [AUTO-TRANSLATED:95131a66]
-                // Hit mmap cache
-                file_size = std::get<1>(it->second);
-                return ret;
-            }
-        }
-    }
+// 移除缓存，需在锁内调用
+// Remove the cache, must be called inside the lock
+static void eraseCachedFile_l(const HttpFileLru::iterator &it) {
+    s_file_bytes -= it->second->stat.size;
+    s_file_index.erase(it->first);
+    s_file_lru.erase(it);
+}
 
+static HttpCachedFile::Ptr openCachedFile(const string &file_path, const HttpFileStat &stat, int64_t &file_size) {
     // 打开文件  [AUTO-TRANSLATED:55bfe68a]
     // Open file
     std::shared_ptr<FILE> fp(fopen(file_path.data(), "rb"), [](FILE *fp) {
@@ -111,14 +149,11 @@ static std::shared_ptr<char> getSharedMmap(const string &file_path, int64_t &fil
         file_size = -1;
         return nullptr;
     }
-
+    file_size = stat.size;
 
 #if defined(_WIN32)
     auto fd = _fileno(fp.get());
 #else
-    // 获取文件大小  [AUTO-TRANSLATED:82974eea]
-    // Get file size
-    file_size = File::fileSize(fp.get());
     auto fd = fileno(fp.get());
 #endif
 
@@ -133,11 +168,7 @@ static std::shared_ptr<char> getSharedMmap(const string &file_path, int64_t &fil
         return nullptr;
     }
 
-
-    std::shared_ptr<char> ret(ptr, [file_size, fp, file_path](char *ptr) {
-        munmap(ptr, file_size);
-        delSharedMmap(file_path, ptr);
-    });
+    std::shared_ptr<char> map_addr(ptr, [file_size](char *ptr) { munmap(ptr, file_size); });
 
 #else
     auto hfile = ::CreateFileA(file_path.data(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -147,10 +178,6 @@ static std::shared_ptr<char> getSharedMmap(const string &file_path, int64_t &fil
         return nullptr;
     }
 
-     LARGE_INTEGER FileSize;
-     GetFileSizeEx(hfile, &FileSize); //GetFileSize函数的拓展，可用于获取大于4G的文件大小
-     file_size = FileSize.QuadPart;
-
     auto hmapping = ::CreateFileMapping(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
 
     if (hmapping == NULL) {
@@ -167,32 +194,95 @@ static std::shared_ptr<char> getSharedMmap(const string &file_path, int64_t &fil
         return nullptr;
     }
 
-    std::shared_ptr<char> ret((char *)(addr_), [hfile, hmapping, file_path](char *addr_) {
-        mmap_close(hfile, hmapping, addr_);
-        delSharedMmap(file_path, addr_);
-    });
+    std::shared_ptr<char> map_addr((char *)(addr_), [hfile, hmapping](char *addr_) { mmap_close(hfile, hmapping, addr_); });
 
 #endif
+    auto ret = std::make_shared<HttpCachedFile>();
+    ret->stat = stat;
+    ret->fp = std::move(fp);
+    ret->map_addr = std::move(map_addr);
+    return ret;
+}
 
-
-#if 0
-    if (file_size < 10 * 1024 * 1024 && file_path.rfind(".ts") != string::npos) {
-        // 如果是小ts文件，那么尝试先加载到内存  [AUTO-TRANSLATED:0d96c5cd]
-        // If it is a small ts file, try to load it into memory first
-        auto buf = BufferRaw::create();
-        buf->assign(ret.get(), file_size);
-        ret.reset(buf->data(), [buf, file_path](char *ptr) {
-            delSharedMmap(file_path, ptr);
-        });
+/**
+ * 从lru缓存获取已打开并mmap的文件，未命中时打开文件并加入缓存，超出字节或个数上限时淘汰最久未访问的文件
+ * 返回空且file_size不为-1时，说明mmap失败，需回退到fread模式
+ * Get the opened and mmapped file from the lru cache, open the file and add it to the cache when missed,
+ * and evict the least recently accessed files when the byte or number limit is exceeded
+ * When null is returned and file_size is not -1, it means that mmap failed and it needs to fall back to the fread mode
+ */
+static HttpCachedFile::Ptr getCachedFile(const string &file_path, int64_t &file_size) {
+    HttpFileStat stat;
+    if (!getFileStat(file_path, stat)) {
+        // 文件不存在  [AUTO-TRANSLATED:ed160bcf]
+        // File does not exist
+        file_size = -1;
+        return nullptr;
     }
-#endif
     {
         lock_guard<mutex> lck(s_mtx);
-        s_shared_mmap[file_path] = std::make_tuple(ret.get(), file_size, ret);
+        auto it = s_file_index.find(file_path);
+        if (it != s_file_index.end()) {
+            if (it->second->second->stat == stat) {
+                // 命中缓存，移至lru表头
+                // Hit the cache, move to the head of the lru list
+                ++s_cache_hits;
+                s_file_lru.splice(s_file_lru.begin(), s_file_lru, it->second);
+                file_size = stat.size;
+                return s_file_lru.front().second;
+            }
+            // 文件已被修改，缓存失效；正在发送该文件的请求仍持有旧的mmap
+            // The file has been modified and the cache is invalid; the requests sending this file still hold the old mmap
+            ++s_cache_invalidations;
+            eraseCachedFile_l(it->second);
+        }
+    }
+
+    ++s_cache_misses;
+    auto ret = openCachedFile(file_path, stat, file_size);
+    if (!ret) {
+        return nullptr;
+    }
+
+    GET_CONFIG(size_t, cache_size, Http::kFileCacheSize);
+    GET_CONFIG(size_t, cache_num, Http::kFileCacheNum);
+    uint64_t max_bytes = (uint64_t)cache_size << 20;
+    if (!max_bytes || !cache_num || stat.size > (int64_t)max_bytes) {
+        // 缓存关闭或文件过大，不加入缓存
+        // The cache is disabled or the file is too large, do not add it to the cache
+        return ret;
+    }
+
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_file_index.find(file_path);
+    if (it != s_file_index.end()) {
+        // 其他线程已加入缓存
+        // Other threads have added it to the cache
+        eraseCachedFile_l(it->second);
+    }
+    s_file_lru.emplace_front(file_path, ret);
+    s_file_index.emplace(file_path, s_file_lru.begin());
+    s_file_bytes += stat.size;
+    while (s_file_bytes > max_bytes || s_file_lru.size() > cache_num) {
+        ++s_cache_evictions;
+        eraseCachedFile_l(std::prev(s_file_lru.end()));
     }
     return ret;
 }
 
+HttpFileCache::Statistic HttpFileCache::getStatistic() {
+    Statistic ret;
+    ret.hits = s_cache_hits;
+    ret.misses = s_cache_misses;
+    ret.evictions = s_cache_evictions;
+    ret.invalidations = s_cache_invalidations;
+    ret.send_file_bytes = s_send_file_bytes;
+    lock_guard<mutex> lck(s_mtx);
+    ret.files = s_file_lru.size();
+    ret.bytes = s_file_bytes;
+    return ret;
+}
+
 HttpFileBody::HttpFileBody(const string &file_path, bool use_mmap) {
 
     // 判断是否为目录，避免对目录进行mmap操作，导致程序崩溃。
@@ -202,7 +292,12 @@ HttpFileBody::HttpFileBody(const string &file_path, bool use_mmap) {
     }
 
     if (use_mmap ) {
-        _map_addr = getSharedMmap(file_path, _read_to);
+        if (auto file = getCachedFile(file_path, _read_to)) {
+            // 保留文件句柄，以便sendfile
+            // Keep the file handle for sendfile
+            _fp = file->fp;
+            _map_addr = file->map_addr;
+        }
     }
 
     if (!_map_addr && _read_to != -1) {
@@ -244,13 +339,35 @@ int HttpFileBody::sendFile(int fd) {
         return -1;
     }
     static onceToken s_token([]() { signal(SIGPIPE, SIG_IGN); });
+    // 从_file_offset开始发送，支持range请求
+    // Send from _file_offset, support range requests
     off_t off = _file_offset;
-    return sendfile(fd, fileno(_fp.get()), &off, _read_to - _file_offset);
+    auto sent = sendfile(fd, fileno(_fp.get()), &off, remainSize());
+    if (sent <= 0) {
+        if (sent == 0) {
+            // 文件真实长度小于声明长度
+            // The actual length of the file is less than the declared length
+            errno = EIO;
+        }
+        return -1;
+    }
+    _file_offset += sent;
+    _need_seek = true;
+    s_send_file_bytes += sent;
+    return 0;
 #else
     return -1;
 #endif
 }
 
+bool HttpFileBody::supportSendFile() const {
+#if defined(__linux__) || defined(__linux)
+    return _fp != nullptr;
+#else
+    return false;
+#endif
+}
+
 class BufferMmap : public Buffer {
 public:
     using Ptr = std::shared_ptr<BufferMmap>;
@@ -284,6 +401,10 @@ Buffer::Ptr HttpFileBody::readData(size_t size) {
     if (!_map_addr) {
         // fread模式  [AUTO-TRANSLATED:c4dee2a3]
         // fread mode
+        if (_need_seek) {
+            fseek64(_fp.get(), _file_offset, SEEK_SET);
+            _need_seek = false;
+        }
         ssize_t iRead;
         auto ret = _pool.obtain2();
         ret->setCapacity(size + 1);
@@ -97,6 +97,13 @@ public:
         return -1;
     }
 
+    /**
+     * 是否支持sendFile，支持时每次sendFile尽可能多地发送并推进读取位置，socket缓存满时返回-1且错误码为EAGAIN
+     * Whether sendFile is supported, if so each sendFile sends as much as possible and advances the reading position,
+     * and returns -1 with the EAGAIN error code when the socket buffer is full
+     */
+    virtual bool supportSendFile() const { return false; }
+
     /**
      * 写入数据，默认抛出异常表示不支持写入
      * Write data, default throws exception indicating write not supported
@@ -148,6 +155,31 @@ private:
     toolkit::Buffer::Ptr _buffer;
 };
 
+/**
+ * 静态文件缓存，缓存打开的文件、mmap与文件信息，按总字节数与文件个数上限做LRU淘汰
+ * 每次访问时比较文件大小、修改时间与inode，变化后缓存失效
+ * Static file cache, caching the opened files, mmap and file info, with LRU eviction by the upper limits of total bytes and file count
+ * The file size, modification time and inode are compared on each access, and the cache is invalidated after they change
+ */
+class HttpFileCache {
+public:
+    struct Statistic {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+        uint64_t files = 0;
+        uint64_t bytes = 0;
+        uint64_t send_file_bytes = 0;
+    };
+
+    /**
+     * 获取全局统计信息
+     * Get global statistics
+     */
+    static Statistic getStatistic();
+};
+
 class HttpFileBodyBase  : public HttpBody {
 public:
     using Ptr = std::shared_ptr<HttpFileBodyBase>;
@@ -193,8 +225,12 @@ public:
     int64_t remainSize() override;
     toolkit::Buffer::Ptr readData(size_t size) override;
     int sendFile(int fd) override;
+    bool supportSendFile() const override;
 
 private:
+    // sendfile不改变文件读取位置，fread前需要重新seek
+    // Sendfile does not change the file reading position, it needs to seek again before fread
+    bool _need_seek = false;
     int64_t _read_to = 0;
     uint64_t _file_offset = 0;
     std::shared_ptr<FILE> _fp;
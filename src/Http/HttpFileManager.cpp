@@ -13,6 +13,7 @@
 #include "Common/Parser.h"
 #include "Common/config.h"
 #include "Common/strCoding.h"
+#include "Record/HlsMaker.h"
 #include "Record/HlsMediaSource.h"
 #include "HttpConst.h"
 #include "HttpSession.h"
@@ -319,7 +320,22 @@ static bool emitHlsPlayed(const Parser &parser, const MediaInfo &media_info, con
 }
 
 static std::string getUidFromParams(const string &params) {
-    return params;
+    if (params.find("_HLS_") == string::npos) {
+        return params;
+    }
+    // 低延迟hls阻塞请求参数(_HLS_msn等)每次都不同，不能作为用户id
+    // The blocking request parameters of low-latency hls (_HLS_msn, etc.) are different each time and cannot be used as the user id
+    string ret;
+    for (auto &item : split(params, "&")) {
+        if (start_with(item, "_HLS_")) {
+            continue;
+        }
+        if (!ret.empty()) {
+            ret += '&';
+        }
+        ret += item;
+    }
+    return ret;
 }
 
 /**
@@ -477,6 +493,125 @@ static string pathCat(const string &a, const string &b){
 
 static string getFilePath(const Parser &parser,const MediaInfo &media_info, Session *sender, const string &customRootPath = "");
 
+// 低延迟hls阻塞请求的最长等待时间，为3倍切片时长
+// The maximum waiting time of the low-latency hls blocking request, which is 3 times the segment duration
+static uint64_t getHlsBlockingTimeoutMS() {
+    GET_CONFIG(float, segDur, Hls::kSegmentDuration);
+    return (std::max)((uint64_t)(segDur * 3 * 1000), (uint64_t)1000);
+}
+
+/**
+ * 处理低延迟hls的阻塞m3u8请求(_HLS_msn/_HLS_part/_HLS_skip)，m3u8包含指定部分切片后才回复，超时则回复当前m3u8
+ * @return 是否为阻塞请求
+ * Handle the blocking m3u8 request of low-latency hls (_HLS_msn/_HLS_part/_HLS_skip), reply after the m3u8 contains the specified partial segment,
+ * and reply the current m3u8 after timeout
+ * @return Whether it is a blocking request
+ */
+static bool responseBlockingIndex(Session &sender, const Parser &parser, const HlsMediaSource::Ptr &src,
+                                  const function<void(const string &index)> &on_index, const HttpFileManager::invoker &cb) {
+    auto &args = parser.getUrlArgs();
+    auto msn_it = args.find("_HLS_msn");
+    if (msn_it == args.end()) {
+        return false;
+    }
+    auto part_it = args.find("_HLS_part");
+    auto skip_it = args.find("_HLS_skip");
+    auto msn = strtoull(msn_it->second.data(), nullptr, 10);
+    auto part = part_it == args.end() ? HlsMediaSource::kAllParts : (uint32_t)strtoul(part_it->second.data(), nullptr, 10);
+    auto skip = skip_it != args.end() && (skip_it->second == "YES" || skip_it->second == "v2");
+
+    auto timeout = getHlsBlockingTimeoutMS();
+    auto replied = std::make_shared<std::atomic<bool>>(false);
+    auto once = [replied, on_index](const string &index) {
+        if (!replied->exchange(true)) {
+            on_index(index);
+        }
+    };
+    if (!src->getIndexFile(msn, part, skip, getCurrentMillisecond() + timeout, once)) {
+        // 请求的切片序号超前过多
+        // The requested segment sequence number is too far ahead
+        cb(400, "text/html", StrCaseMap(), std::make_shared<HttpStringBody>("_HLS_msn is too far ahead"));
+        return true;
+    }
+    if (!*replied) {
+        weak_ptr<HlsMediaSource> weak_src = src;
+        sender.getPoller()->doDelayTask(timeout, [once, weak_src]() {
+            auto src = weak_src.lock();
+            once(src ? src->getIndexFile() : "");
+            return 0;
+        });
+    }
+    return true;
+}
+
+/**
+ * 从内存回复低延迟hls的部分切片，预加载提示所指的部分切片生成后才回复
+ * Reply the partial segment of low-latency hls from memory, the partial segment pointed to by the preload hint is replied after it is generated
+ */
+static void responsePart(Session &sender, const HlsMediaSource::Ptr &src, uint64_t msn, uint32_t part, const HttpServerCookie::Ptr &cookie,
+                         const string &file_path, const HttpFileManager::invoker &cb) {
+    auto replied = std::make_shared<std::atomic<bool>>(false);
+    auto on_part = [replied, cookie, file_path, cb](const Buffer::Ptr &buffer) {
+        if (replied->exchange(true)) {
+            return;
+        }
+        if (!buffer) {
+            sendNotFound(cb);
+            return;
+        }
+        auto &attach = cookie->getAttach<HttpCookieAttachment>();
+        attach._hls_data->addByteUsage(buffer->size());
+        StrCaseMap header;
+        header["Set-Cookie"] = cookie->getCookie(attach._path);
+        cb(200, HttpFileManager::getContentType(file_path.data()), header, std::make_shared<HttpBufferBody>(buffer));
+    };
+    auto timeout = getHlsBlockingTimeoutMS();
+    src->getPart(msn, part, getCurrentMillisecond() + timeout, on_part);
+    if (!*replied) {
+        sender.getPoller()->doDelayTask(timeout, [on_part]() {
+            on_part(nullptr);
+            return 0;
+        });
+    }
+}
+
+static string httpDateStr(time_t tt) {
+    char buf[64];
+    strftime(buf, sizeof buf, "%a, %d %b %Y %H:%M:%S GMT", gmtime(&tt));
+    return buf;
+}
+
+/**
+ * 判断协商缓存是否命中，If-None-Match优先于If-Modified-Since
+ * Determine whether the negotiated cache is hit, If-None-Match takes precedence over If-Modified-Since
+ */
+static bool isNotModified(const Parser &parser, const string &etag, const string &last_modified) {
+    auto &if_none_match = parser["If-None-Match"];
+    if (!if_none_match.empty()) {
+        return if_none_match == "*" || if_none_match.find(etag) != string::npos;
+    }
+    return !last_modified.empty() && parser["If-Modified-Since"] == last_modified;
+}
+
+/**
+ * 回复hls内存模式下的切片等文件，文件写入后不再修改，故可使用ETag/Last-Modified协商缓存
+ * Reply the segments and other files in hls memory mode, the files are not modified after being written, so ETag/Last-Modified negotiated cache can be used
+ */
+static void responseMemoryFile(const Parser &parser, const HlsMediaSource::MemoryFile &file, const HttpServerCookie::Ptr &cookie,
+                               const string &file_path, const HttpFileManager::invoker &cb) {
+    auto &attach = cookie->getAttach<HttpCookieAttachment>();
+    StrCaseMap header;
+    header["Set-Cookie"] = cookie->getCookie(attach._path);
+    header["ETag"] = StrPrinter << "\"" << hex << file.stamp_ms << "-" << file.data->size() << "\"";
+    header["Last-Modified"] = httpDateStr(file.stamp_ms / 1000);
+    if (isNotModified(parser, header["ETag"], header["Last-Modified"])) {
+        cb(304, HttpFileManager::getContentType(file_path.data()), header, nullptr);
+        return;
+    }
+    attach._hls_data->addByteUsage(file.data->size());
+    cb(200, HttpFileManager::getContentType(file_path.data()), header, std::make_shared<HttpBufferBody>(file.data));
+}
+
 /**
  * 访问文件
  * @param sender 事件触发者
@@ -533,6 +668,15 @@ static void accessFile(Session &sender, const Parser &parser, const MediaInfo &m
             if (cookie) {
                 httpHeader["Set-Cookie"] = cookie->getCookie(cookie->getAttach<HttpCookieAttachment>()._path);
             }
+            if (!file_content.empty()) {
+                // 内存中的m3u8随时可能更新，只根据内容生成ETag，不使用秒级精度的Last-Modified
+                // The m3u8 in memory may be updated at any time, ETag is generated only based on the content, and Last-Modified with second precision is not used
+                httpHeader["ETag"] = StrPrinter << "\"" << hex << std::hash<string>()(file_content) << "-" << file_content.size() << "\"";
+                if (isNotModified(parser, httpHeader["ETag"], "")) {
+                    cb(304, HttpFileManager::getContentType(file_path.data()), httpHeader, nullptr);
+                    return;
+                }
+            }
             HttpSession::HttpResponseInvoker invoker = [&](int code, const StrCaseMap &headerOut, const HttpBody::Ptr &body) {
                 if (cookie && body) {
                     auto& attach = cookie->getAttach<HttpCookieAttachment>();
@@ -562,6 +706,25 @@ static void accessFile(Session &sender, const Parser &parser, const MediaInfo &m
                 const_cast<std::string &>(file_path) = getFilePath(parser, media_info, nullptr, attach._hls_root_path);
             }
         }
+        auto hls_src = !is_hls && cookie && cookie->getAttach<HttpCookieAttachment>()._hls_data
+            ? cookie->getAttach<HttpCookieAttachment>()._hls_data->getMediaSource() : nullptr;
+        if (hls_src) {
+            uint64_t part_msn;
+            uint32_t part_index;
+            if (HlsMaker::parsePartName(file_path, part_msn, part_index)) {
+                // 低延迟hls的部分切片只保存在内存中
+                // The partial segments of low-latency hls are only kept in memory
+                responsePart(*strongSession, hls_src, part_msn, part_index, cookie, file_path, cb);
+                return;
+            }
+            HlsMediaSource::MemoryFile memory_file;
+            if (hls_src->getMemoryFile(file_path, memory_file)) {
+                // hls内存模式，直接从内存回复切片
+                // Hls memory mode, reply the segment directly from memory
+                responseMemoryFile(parser, memory_file, cookie, file_path, cb);
+                return;
+            }
+        }
         if (!is_hls || !cookie) {
             // 不是hls或访问m3u8文件不带cookie, 直接回复文件或404  [AUTO-TRANSLATED:64e5d19b]
             // Not hls or accessing m3u8 files without cookies, directly reply to the file or 404
@@ -575,6 +738,12 @@ static void accessFile(Session &sender, const Parser &parser, const MediaInfo &m
         auto &attach = cookie->getAttach<HttpCookieAttachment>();
         auto src = attach._hls_data->getMediaSource();
         if (src) {
+            auto on_index = [response_file, cookie, cb, file_path, parser](const string &file) {
+                response_file(cookie, cb, file_path, parser, file);
+            };
+            if (responseBlockingIndex(*strongSession, parser, src, on_index, cb)) {
+                return;
+            }
             // 直接从内存获取m3u8索引文件(而不是从文件系统)  [AUTO-TRANSLATED:c772e342]
             // Get the m3u8 index file directly from memory (instead of from the file system)
             response_file(cookie, cb, file_path, parser, src->getIndexFile());
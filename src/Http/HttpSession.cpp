@@ -17,6 +17,7 @@
 #include "HttpConst.h"
 #include "Util/base64.h"
 #include "Util/SHA1.h"
+#include "Util/uv_errno.h"
 
 using namespace std;
 using namespace toolkit;
@@ -485,6 +486,209 @@ bool HttpSession::checkLiveStreamFMP4(const function<void()> &cb) {
     });
 }
 
+static const string kDashCookieName = "ZLM_DASH_COOKIE";
+
+/**
+ * dash播放器的鉴权结果与观看信息，缓存在cookie中，每个播放器持有一个环形缓冲读取器计入观看人数
+ * The authentication result and viewing information of a dash player, cached in the cookie, each player holds a ring buffer reader to be counted as a viewer
+ */
+class DashCookieData {
+public:
+    using Ptr = std::shared_ptr<DashCookieData>;
+
+    DashCookieData(std::string stream_url, const FMP4MediaSource::Ptr &src, const std::shared_ptr<Session> &session) {
+        _stream_url = std::move(stream_url);
+        _src = src;
+        _session = session;
+        addReaderCount();
+    }
+
+    const std::string &getStreamUrl() const { return _stream_url; }
+
+    FMP4MediaSource::Ptr getMediaSource() const { return _src.lock(); }
+
+    void addReaderCount() {
+        if (*_added) {
+            return;
+        }
+        auto src = getMediaSource();
+        if (!src || !src->getRing()) {
+            return;
+        }
+        // 按需生成fmp4时，该读取器使fmp4开始生成；fmp4 track变化重建环形缓冲后再次请求时重新添加
+        // When fmp4 is generated on demand, this reader makes fmp4 start to be generated; it is added again on the next request after the ring buffer is rebuilt for the fmp4 track change
+        *_added = true;
+        _ring_reader = src->getRing()->attach(EventPollerPool::Instance().getPoller());
+        auto added = _added;
+        _ring_reader->setDetachCB([added]() { *added = false; });
+        std::weak_ptr<Session> weak_session = _session;
+        _ring_reader->setGetInfoCB([weak_session]() {
+            Any ret;
+            ret.set(weak_session.lock());
+            return ret;
+        });
+    }
+
+private:
+    std::string _stream_url;
+    std::shared_ptr<bool> _added = std::make_shared<bool>(false);
+    std::weak_ptr<FMP4MediaSource> _src;
+    std::weak_ptr<Session> _session;
+    FMP4MediaSource::RingType::RingReader::Ptr _ring_reader;
+};
+
+// dash 链接格式:http://vhost-url:port/app/streamid.live.mpd?key1=value1&key2=value2
+// 切片链接由mpd中的SegmentTemplate给出，格式为streamid.live.init.m4s与streamid.live.<number>.m4s
+// dash link format: http://vhost-url:port/app/streamid.live.mpd?key1=value1&key2=value2
+// The segment links are given by the SegmentTemplate in the mpd, the format is streamid.live.init.m4s and streamid.live.<number>.m4s
+bool HttpSession::checkLiveStreamDash() {
+    auto &url = _parser.url();
+    auto pos = url.rfind(".live.");
+    if (pos == string::npos) {
+        return false;
+    }
+    auto suffix = url.substr(pos);
+    bool is_mpd = suffix == ".live.mpd";
+    bool is_init = suffix == ".live.init.m4s";
+    uint64_t number = 0;
+    if (!is_mpd && !is_init && !DashPackager::parseSegmentName(url, number)) {
+        return false;
+    }
+    auto slash = url.rfind('/', pos);
+    auto stream_name = url.substr(slash + 1, pos - slash - 1);
+    auto stream_url = url.substr(0, pos);
+    auto cookie_path = url.substr(0, slash + 1);
+    auto params = _parser.params();
+    bool close_flag = !strcasecmp(_parser["Connection"].data(), "close");
+
+    weak_ptr<HttpSession> weak_self = static_pointer_cast<HttpSession>(shared_from_this());
+    auto response = [weak_self, is_mpd, is_init, number, stream_name, params, close_flag, cookie_path](const FMP4MediaSource::Ptr &fmp4_src,
+                                                                                                      const HttpServerCookie::Ptr &cookie) {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        // dash播放器通过多次普通http请求拉流，不按http-fmp4长连接统计
+        // The dash player pulls the stream through multiple ordinary http requests, which is not counted as a http-fmp4 long connection
+        strong_self->_is_live_stream = false;
+        auto dash = fmp4_src->getDashPackager();
+        if (!dash) {
+            strong_self->sendNotFound(close_flag);
+            return;
+        }
+        KeyValue header;
+        header["Set-Cookie"] = cookie->getCookie(cookie_path);
+        if (is_init) {
+            strong_self->sendResponse(200, close_flag, HttpFileManager::getContentType(".m4s").data(), header, std::make_shared<HttpStringBody>(dash->getInitSegment()));
+            return;
+        }
+
+        if (is_mpd) {
+            // 尚无可播放的切片时等待其生成
+            // Wait for it to be generated when there is no playable segment yet
+            dash->waitReady([weak_self, dash, stream_name, params, close_flag, header](bool ready) {
+                auto strong_self = weak_self.lock();
+                if (!strong_self) {
+                    return;
+                }
+                strong_self->async([weak_self, dash, stream_name, params, close_flag, header, ready]() mutable {
+                    auto strong_self = weak_self.lock();
+                    if (!strong_self) {
+                        return;
+                    }
+                    if (!ready) {
+                        strong_self->sendNotFound(close_flag);
+                        return;
+                    }
+                    header["Cache-Control"] = "no-cache";
+                    strong_self->sendResponse(200, close_flag, HttpFileManager::getContentType(".mpd").data(), header,
+                                              std::make_shared<HttpStringBody>(dash->makeMpd(stream_name, params)));
+                }, false);
+            });
+            return;
+        }
+
+        if (auto segment = dash->getSegment(number)) {
+            strong_self->sendResponse(200, close_flag, HttpFileManager::getContentType(".m4s").data(), header, std::make_shared<HttpBufferBody>(segment));
+            return;
+        }
+
+        // 低延迟模式下，正在生成的切片通过http chunked边生成边下发
+        // In low-latency mode, the segment being generated is sent by http chunked while it is generated
+        auto reading = dash->readSegment(number, [weak_self, close_flag](const Buffer::Ptr &chunk) {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            strong_self->async([weak_self, chunk, close_flag]() {
+                auto strong_self = weak_self.lock();
+                if (!strong_self) {
+                    return;
+                }
+                if (!chunk) {
+                    strong_self->onWrite(std::make_shared<BufferString>("0\r\n\r\n"), true);
+                    if (close_flag) {
+                        strong_self->shutdown(SockException(Err_shutdown, "close connection after send dash segment completed"));
+                    }
+                    return;
+                }
+                char size[32];
+                snprintf(size, sizeof(size), "%zX\r\n", chunk->size());
+                strong_self->onWrite(std::make_shared<BufferString>(size), false);
+                strong_self->onWrite(chunk, false);
+                strong_self->onWrite(std::make_shared<BufferString>("\r\n"), true);
+            }, false);
+        });
+        if (!reading) {
+            strong_self->sendNotFound(close_flag);
+            return;
+        }
+        header["Transfer-Encoding"] = "chunked";
+        strong_self->sendResponse(200, false, HttpFileManager::getContentType(".m4s").data(), header, nullptr, true);
+    };
+
+    // 先根据http头中的cookie查找，其次是本连接上次使用的cookie，最后根据url参数查找
+    // First find it by the cookie in the http header, then the cookie used last time on this connection, and finally by the url parameters
+    auto cookie = HttpCookieManager::Instance().getCookie(kDashCookieName, _parser.getHeader());
+    if (!cookie) {
+        cookie = _dash_cookie.lock();
+    }
+    if (cookie && cookie->isExpired()) {
+        cookie = nullptr;
+    }
+    if (!cookie && !params.empty()) {
+        // 无url参数时不能据此查找，否则所有无参数的播放器共用同一个cookie并跳过鉴权
+        // Can not find it by the url parameters when there are none, otherwise all players without parameters share the same cookie and skip the authentication
+        cookie = HttpCookieManager::Instance().getCookieByUid(kDashCookieName, params);
+    }
+    if (cookie) {
+        auto &attach = cookie->getAttach<DashCookieData>();
+        auto src = attach.getStreamUrl() == stream_url ? attach.getMediaSource() : nullptr;
+        if (src) {
+            // 该播放器已鉴权通过，跳过播放鉴权与查找流，并刷新cookie有效期
+            // The player has been authenticated, skip the play authentication and stream finding, and refresh the cookie validity period
+            cookie->updateTime();
+            attach.addReaderCount();
+            _dash_cookie = cookie;
+            response(src, cookie);
+            return true;
+        }
+    }
+
+    return checkLiveStream(FMP4_SCHEMA, suffix, [this, stream_url, params, response](const MediaSource::Ptr &src) {
+        auto fmp4_src = dynamic_pointer_cast<FMP4MediaSource>(src);
+        assert(fmp4_src);
+        // 缓存鉴权结果，播放器超过kTimeoutSec无请求后cookie失效，观看人数随之减少
+        // Cache the authentication result, the cookie expires after the player makes no request for kTimeoutSec, and the number of viewers decreases accordingly
+        GET_CONFIG(uint32_t, timeout_sec, Dash::kTimeoutSec);
+        toolkit::Any attach;
+        attach.set(std::make_shared<DashCookieData>(stream_url, fmp4_src, static_pointer_cast<Session>(shared_from_this())));
+        auto cookie = HttpCookieManager::Instance().addCookie(kDashCookieName, params, timeout_sec, std::move(attach));
+        _dash_cookie = cookie;
+        response(fmp4_src, cookie);
+    });
+}
+
 // http-ts 链接格式:http://vhost-url:port/app/streamid.live.ts?key1=value1&key2=value2  [AUTO-TRANSLATED:aa1a9151]
 // http-ts link format: http://vhost-url:port/app/streamid.live.ts?key1=value1&key2=value2
 bool HttpSession::checkLiveStreamTS(const function<void()> &cb) {
@@ -614,6 +818,12 @@ void HttpSession::onHttpRequest_GET() {
         return;
     }
 
+    if (checkLiveStreamDash()) {
+        // 拦截dash播放器
+        // Intercept dash player
+        return;
+    }
+
     bool bClose = !strcasecmp(_parser["Connection"].data(), "close");
     weak_ptr<HttpSession> weak_self = static_pointer_cast<HttpSession>(shared_from_this());
     HttpFileManager::onAccessPath(*this, _parser, [weak_self, bClose](int code, const string &content_type,
@@ -643,16 +853,18 @@ class AsyncSenderData {
 public:
     friend class AsyncSender;
     using Ptr = std::shared_ptr<AsyncSenderData>;
-    AsyncSenderData(HttpSession::Ptr session, const HttpBody::Ptr &body, bool close_when_complete) {
+    AsyncSenderData(HttpSession::Ptr session, const HttpBody::Ptr &body, bool close_when_complete, bool send_file = false) {
         _session = std::move(session);
         _body = body;
         _close_when_complete = close_when_complete;
+        _send_file = send_file;
     }
 
 private:
     std::weak_ptr<HttpSession> _session;
     HttpBody::Ptr _body;
     bool _close_when_complete;
+    bool _send_file;
     bool _read_complete = false;
 };
 
@@ -669,6 +881,18 @@ public:
             return false;
         }
 
+        if (data->_send_file) {
+            auto session = data->_session.lock();
+            if (!session) {
+                // 本对象已经销毁  [AUTO-TRANSLATED:713e0f23]
+                // This object has been destroyed
+                return false;
+            }
+            if (sendFile(data, session)) {
+                return !data->_read_complete;
+            }
+        }
+
         GET_CONFIG(uint32_t, sendBufSize, Http::kSendBufSize);
         data->_body->readDataAsync(sendBufSize, [data](const Buffer::Ptr &sendBuf) {
             auto session = data->_session.lock();
@@ -691,6 +915,58 @@ public:
     }
 
 private:
+    // 每轮sendfile最多发送的Http::kSendBufSize块数
+    // The maximum number of Http::kSendBufSize blocks sent by sendfile in each round
+    static constexpr int kSendFileBudgetBlocks = 16;
+
+    /**
+     * 通过sendfile发送文件，数据不经过用户态拷贝
+     * @return false表示socket缓存已满或sendfile失败，需通过普通方式发送一块数据，由其等待socket可写后再次触发onSocketFlushed
+     * Send the file by sendfile, the data is not copied to user space
+     * @return false means the socket buffer is full or sendfile failed, a piece of data needs to be sent in the normal way,
+     * which waits for the socket to be writable and then triggers onSocketFlushed again
+     */
+    static bool sendFile(const AsyncSenderData::Ptr &data, const std::shared_ptr<HttpSession> &session) {
+        // sendfile绕过了socket发送缓存，需先发送完缓存中的数据(http头等)
+        // Sendfile bypasses the socket send buffer, the data in the buffer (http header, etc.) must be sent first
+        session->getSock()->flushAll();
+        if (session->isSocketBusy()) {
+            // 等待socket缓存发送完毕
+            // Wait for the socket buffer to be sent
+            return true;
+        }
+        // 每次最多发送若干个发送块，避免高速链路上大文件长时间独占poller线程
+        // Send at most several send blocks each time, to avoid a large file monopolizing the poller thread for a long time on a fast link
+        GET_CONFIG(uint32_t, sendBufSize, Http::kSendBufSize);
+        auto budget = (int64_t)sendBufSize * kSendFileBudgetBlocks;
+        auto fd = session->getSock()->rawFD();
+        while (data->_body->remainSize() > 0) {
+            if (budget <= 0) {
+                // socket仍可写，不会触发onSocketFlushed，让出poller线程后继续发送
+                // The socket is still writable and onSocketFlushed will not be triggered, continue sending after yielding the poller thread
+                session->async([data]() { onSocketFlushed(data); }, false);
+                return true;
+            }
+            auto remain = data->_body->remainSize();
+            if (data->_body->sendFile(fd) != 0) {
+                if (get_uv_error(true) != UV_EAGAIN) {
+                    WarnL << "sendfile failed, fallback to normal sending:" << get_uv_errmsg(true);
+                    data->_send_file = false;
+                }
+                return false;
+            }
+            budget -= remain - data->_body->remainSize();
+            session->_ticker.resetTime();
+        }
+        // 文件写完了  [AUTO-TRANSLATED:a9f8c117]
+        // The file is written
+        data->_read_complete = true;
+        if (data->_close_when_complete) {
+            shutdown(session);
+        }
+        return true;
+    }
+
     static void onRequestData(const AsyncSenderData::Ptr &data, const std::shared_ptr<HttpSession> &session, const Buffer::Ptr &sendBuf) {
         session->_ticker.resetTime();
         if (sendBuf && session->send(sendBuf) != -1) {
@@ -830,16 +1106,6 @@ void HttpSession::sendResponse(int code,
         return;
     }
 
-#if 0
-    // sendfile跟共享mmap相比并没有性能上的优势，相反，sendfile还有功能上的缺陷，先屏蔽  [AUTO-TRANSLATED:4de77827]
-    // Sendfile has no performance advantage over shared mmap, on the contrary, sendfile also has functional defects, so it is blocked first
-    if (typeid(*this) == typeid(HttpSession) && !body->sendFile(getSock()->rawFD())) {
-        // http支持sendfile优化  [AUTO-TRANSLATED:04f691f1]
-        // Http supports sendfile optimization
-        return;
-    }
-#endif
-
     GET_CONFIG(uint32_t, sendBufSize, Http::kSendBufSize);
     if (body->remainSize() > sendBufSize) {
         // 文件下载提升发送性能  [AUTO-TRANSLATED:500922cc]
@@ -849,7 +1115,11 @@ void HttpSession::sendResponse(int code,
 
     // 发送http body  [AUTO-TRANSLATED:e9fc35d6]
     // Send http body
-    AsyncSenderData::Ptr data = std::make_shared<AsyncSenderData>(static_pointer_cast<HttpSession>(shared_from_this()), body, bClose);
+    GET_CONFIG(bool, enable_send_file, Http::kSendFile);
+    // https等需要在用户态加密或封装的会话不能使用sendfile
+    // Sessions that need to encrypt or encapsulate in user space, such as https, cannot use sendfile
+    bool send_file = enable_send_file && typeid(*this) == typeid(HttpSession) && body->supportSendFile();
+    AsyncSenderData::Ptr data = std::make_shared<AsyncSenderData>(static_pointer_cast<HttpSession>(shared_from_this()), body, bClose, send_file);
     getSock()->setOnFlush([data]() { return AsyncSender::onSocketFlushed(data); });
     AsyncSender::onSocketFlushed(data);
 }
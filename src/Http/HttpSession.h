@@ -139,6 +139,7 @@ private:
     bool checkLiveStreamFlv(const std::function<void()> &cb = nullptr);
     bool checkLiveStreamTS(const std::function<void()> &cb = nullptr);
     bool checkLiveStreamFMP4(const std::function<void()> &fmp4_list = nullptr);
+    bool checkLiveStreamDash();
 
     bool checkWebSocket();
     bool emitHttpEvent(bool doInvoke);
@@ -168,6 +169,9 @@ private:
     // 消耗的总流量  [AUTO-TRANSLATED:45ad2785]
     // Total traffic consumed
     uint64_t _total_bytes_usage = 0;
+    // 本连接上次dash请求使用的cookie，兼容不支持cookie的dash播放器
+    // The cookie used by the last dash request on this connection, compatible with dash players that do not support cookies
+    std::weak_ptr<HttpServerCookie> _dash_cookie;
     // http请求中的 Origin字段  [AUTO-TRANSLATED:7b8dd2c0]
     // Origin field in http request
     std::string _origin;
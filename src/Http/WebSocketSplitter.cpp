@@ -15,9 +15,18 @@
 #include <arpa/inet.h>
 #endif //!defined(_WIN32)
 
+#include <cstring>
 #include "Util/logger.h"
 #include "Util/util.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WS_MASK_ENABLE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define WS_MASK_ENABLE_NEON
+#include <arm_neon.h>
+#endif
+
 using namespace std;
 using namespace toolkit;
 
@@ -144,14 +153,49 @@ begin_decode:
     _remain_data.clear();
 }
 
+void maskWebSocketPayload(uint8_t *data, size_t len, const uint8_t *mask, size_t offset) {
+    // 按偏移旋转掩码，使其第一个字节对应data[0]；此后每批字节数均为4的倍数，掩码位置不变
+    // Rotate the mask according to the offset so that its first byte corresponds to data[0];
+    // the number of bytes in each batch is a multiple of 4 afterwards, so the mask position is unchanged
+    uint8_t rotated[4];
+    for (size_t i = 0; i < 4; ++i) {
+        rotated[i] = mask[(i + offset) % 4];
+    }
+    uint32_t mask32;
+    memcpy(&mask32, rotated, 4);
+    size_t i = 0;
+#if defined(WS_MASK_ENABLE_SSE2)
+    auto mask128 = _mm_set1_epi32((int)mask32);
+    for (; i + 16 <= len; i += 16) {
+        auto ptr = (__m128i *)(data + i);
+        _mm_storeu_si128(ptr, _mm_xor_si128(_mm_loadu_si128(ptr), mask128));
+    }
+#elif defined(WS_MASK_ENABLE_NEON)
+    auto mask128 = vreinterpretq_u8_u32(vdupq_n_u32(mask32));
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), mask128));
+    }
+#endif
+    // 高低32位相同，与字节序无关
+    // The high and low 32 bits are the same, independent of the byte order
+    uint64_t mask64 = ((uint64_t)mask32 << 32) | mask32;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        word ^= mask64;
+        memcpy(data + i, &word, 8);
+    }
+    for (; i < len; ++i) {
+        data[i] ^= rotated[i % 4];
+    }
+}
+
 void WebSocketSplitter::onPayloadData(uint8_t *data, size_t len) {
     if(_mask_flag){
-        for(size_t i = 0; i < len ; ++i,++data){
-            *(data) ^= _mask[(i + _mask_offset) % 4];
-        }
+        maskWebSocketPayload(data, len, _mask.data(), _mask_offset);
         _mask_offset = (_mask_offset + len) % 4;
     }
-    onWebSocketDecodePayload(*this, _mask_flag ? data - len : data, len, _payload_offset);
+    onWebSocketDecodePayload(*this, data, len, _payload_offset);
 }
 
 void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &buffer) {
@@ -189,10 +233,7 @@ void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &
 
     if(len > 0){
         if(mask_flag){
-            uint8_t *ptr = (uint8_t*)buffer->data();
-            for(size_t i = 0; i < len ; ++i,++ptr){
-                *(ptr) ^= header._mask[i % 4];
-            }
+            maskWebSocketPayload((uint8_t *)buffer->data(), len, header._mask.data(), 0);
         }
         onWebSocketEncodeData(buffer);
     }
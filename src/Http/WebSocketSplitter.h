@@ -23,6 +23,20 @@
 
 namespace mediakit {
 
+/**
+ * websocket负载掩码/去掩码(异或运算，两者相同)，按16字节(sse2/neon)或8字节批量处理
+ * @param data 负载数据，原地修改
+ * @param len 负载长度
+ * @param mask 4字节掩码
+ * @param offset data[0]在整个负载中的偏移，用于负载分多次到达时衔接掩码位置
+ * Mask/unmask the websocket payload (xor, both are the same), processed in batches of 16 bytes (sse2/neon) or 8 bytes
+ * @param data Payload data, modified in place
+ * @param len Payload length
+ * @param mask 4-byte mask
+ * @param offset Offset of data[0] in the whole payload, used to continue the mask position when the payload arrives in multiple parts
+ */
+void maskWebSocketPayload(uint8_t *data, size_t len, const uint8_t *mask, size_t offset);
+
 class WebSocketHeader {
 public:
     using Ptr = std::shared_ptr<WebSocketHeader>;
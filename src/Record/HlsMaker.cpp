@@ -9,6 +9,7 @@
  */
 
 #include <iomanip>
+#include <cstring>
 #include "HlsMaker.h"
 #include "Common/config.h"
 
@@ -16,13 +17,18 @@ using namespace std;
 
 namespace mediakit {
 
-HlsMaker::HlsMaker(bool is_fmp4, float seg_duration, uint32_t seg_number, bool seg_keep) {
+// 携带部分切片的切片个数(包括正在生成的切片)，部分切片只需覆盖m3u8末尾约3倍目标时长
+// Number of segments carrying partial segments (including the segment being generated), partial segments only need to cover about 3 target durations at the end of m3u8
+static constexpr uint64_t kPartSegments = 3;
+
+HlsMaker::HlsMaker(bool is_fmp4, float seg_duration, uint32_t seg_number, bool seg_keep, float part_duration) {
     _is_fmp4 = is_fmp4;
     // 最小允许设置为0，0个切片代表点播  [AUTO-TRANSLATED:19235e8e]
     // Minimum allowed setting is 0, 0 slices represent on-demand
     _seg_number = seg_number;
     _seg_duration = seg_duration;
     _seg_keep = seg_keep;
+    _part_duration_ms = part_duration > 0 ? (uint32_t)(part_duration * 1000) : 0;
 }
 
 void HlsMaker::makeIndexFile(bool include_delay, bool eof) {
@@ -111,6 +117,9 @@ void HlsMaker::inputData(const char *data, size_t len, uint64_t timestamp, bool
             // 存在切片才写入ts数据  [AUTO-TRANSLATED:ddd46115]
             // Write ts data only if there are slices
             onWriteSegment(data, len);
+            if (_part_duration_ms) {
+                inputPartData(data, len, timestamp, is_idr_fast_packet);
+            }
             _last_timestamp = timestamp;
         }
     } else {
@@ -147,12 +156,30 @@ void HlsMaker::addNewSegment(uint64_t stamp) {
         // Ensure that the slice with sequence number 0 is opened immediately, if the fast registration function is enabled, the slice with sequence number 1 should also be generated immediately when it encounters a keyframe; otherwise, it needs to wait until the slice duration is long enough
         return;
     }
+    if (_part_duration_ms && !_last_file_name.empty()) {
+        // 上一个切片的最后一个部分切片截止到本关键帧
+        // The last partial segment of the previous segment ends at this key frame
+        flushPart(stamp, false);
+    }
     // 关闭并保存上一个切片，如果_seg_number==0,那么是点播。  [AUTO-TRANSLATED:14076b61]
     // Close and save the previous slice, if _seg_number==0, then it is on-demand.
     flushLastSegment(false);
     // 新增切片  [AUTO-TRANSLATED:b8623419]
     // Add a new slice
     _last_file_name = onOpenSegment(_file_index++);
+    if (_part_duration_ms) {
+        _part_index = 0;
+        // 移除较旧切片的部分切片
+        // Remove the partial segments of older segments
+        auto msn = _file_index - 1;
+        while (!_part_list.empty() && _part_list.front().msn + kPartSegments <= msn) {
+            auto old_msn = _part_list.front().msn;
+            while (!_part_list.empty() && _part_list.front().msn == old_msn) {
+                _part_list.pop_front();
+            }
+            onDelPart(old_msn);
+        }
+    }
     // 记录本次切片的起始时间戳  [AUTO-TRANSLATED:8eb776e9]
     // Record the starting timestamp of this slice
     _last_seg_timestamp = _last_timestamp ? _last_timestamp : stamp;
@@ -165,6 +192,9 @@ void HlsMaker::flushLastSegment(bool eof){
         // There is no previous slice
         return;
     }
+    if (_part_duration_ms) {
+        flushPart(_last_timestamp, false);
+    }
     // 文件创建到最后一次数据写入的时间即为切片长度  [AUTO-TRANSLATED:1f85739c]
     // The time from file creation to the last data write is the slice length
     auto seg_dur = _last_timestamp - _last_seg_timestamp;
@@ -184,6 +214,172 @@ void HlsMaker::flushLastSegment(bool eof){
     if (segDelay) {
         makeIndexFile(true, eof);
     }
+    if (_part_duration_ms) {
+        makeLowLatencyIndexFile(eof);
+    } else {
+        onDataPublished(_last_seg_timestamp);
+    }
+}
+
+void HlsMaker::inputPartData(const char *data, size_t len, uint64_t timestamp, bool is_idr_fast_packet) {
+    if (timestamp < _part_timestamp) {
+        // 时间戳回退了，部分切片时长重新计时
+        // Timestamp has been rolled back, the partial segment duration is recalculated
+        _part_timestamp = timestamp;
+    }
+    if (timestamp > _last_timestamp) {
+        _frame_interval = (uint32_t)(timestamp - _last_timestamp);
+    }
+    // 加入本帧后部分切片时长将超过PART-TARGET，则先切出部分切片
+    // If the partial segment duration will exceed PART-TARGET after adding this frame, cut out the partial segment first
+    if (!_part_buffer.empty() && timestamp + _frame_interval > _part_timestamp + _part_duration_ms) {
+        flushPart(timestamp, true);
+    }
+    if (_part_buffer.empty()) {
+        // 以关键帧开头的部分切片可独立解码
+        // A partial segment starting with a key frame can be decoded independently
+        _part_timestamp = timestamp;
+        _part_independent = is_idr_fast_packet;
+    }
+    _part_buffer.append(data, len);
+}
+
+void HlsMaker::flushPart(uint64_t timestamp, bool update_index) {
+    if (_part_buffer.empty()) {
+        return;
+    }
+    auto msn = _file_index - 1;
+    auto duration = (uint32_t)(timestamp > _part_timestamp ? timestamp - _part_timestamp : 0);
+    if (!duration) {
+        duration = (std::min)(100u, _part_duration_ms);
+    }
+    _part_list.emplace_back(PartInfo { msn, _part_index, duration, _part_independent });
+    onWritePart(msn, _part_index++, std::move(_part_buffer));
+    _part_buffer.clear();
+    if (update_index) {
+        makeLowLatencyIndexFile(false);
+    }
+    onDataPublished(_part_timestamp);
+}
+
+void HlsMaker::makeLowLatencyIndexFile(bool eof) {
+    std::deque<std::tuple<int, std::string>> segs(_seg_dur_list);
+    if (_seg_number) {
+        while (segs.size() > _seg_number) {
+            segs.pop_front();
+        }
+    }
+    // 正在生成的切片即为预加载提示所在切片
+    // The segment being generated is the segment of the preload hint
+    bool in_progress = !_last_file_name.empty();
+    uint64_t hint_msn = in_progress ? _file_index - 1 : _file_index;
+    uint32_t hint_part = in_progress ? _part_index : 0;
+
+    int max_duration = 0;
+    for (auto &tp : segs) {
+        max_duration = (std::max)(max_duration, std::get<0>(tp));
+    }
+    if (!max_duration) {
+        max_duration = (int)(_seg_duration * 1000);
+    }
+    int target_duration = (std::max)((max_duration + 999) / 1000, 1);
+
+    // 距m3u8末尾超过CAN-SKIP-UNTIL(6倍目标时长)的旧切片可在增量m3u8中跳过
+    // Old segments farther than CAN-SKIP-UNTIL (6 times the target duration) from the end of m3u8 can be skipped in the delta m3u8
+    uint64_t after_ms = 0;
+    for (auto &part : _part_list) {
+        if (part.msn == hint_msn) {
+            after_ms += part.duration_ms;
+        }
+    }
+    size_t skip = 0;
+    for (size_t i = segs.size(); i > 0; --i) {
+        if (after_ms >= target_duration * 6 * 1000ULL) {
+            skip = i;
+            break;
+        }
+        after_ms += std::get<0>(segs[i - 1]);
+    }
+
+    auto first_msn = hint_msn - segs.size();
+    auto index = makeLowLatencyIndexFile(segs, first_msn, target_duration, 0, eof);
+    auto delta_index = skip ? makeLowLatencyIndexFile(segs, first_msn, target_duration, skip, eof) : std::string();
+    onWriteLowLatencyHls(index, delta_index, hint_msn, hint_part);
+}
+
+std::string HlsMaker::makeLowLatencyIndexFile(const std::deque<std::tuple<int, std::string>> &segs, uint64_t first_msn, int target_duration,
+                                              size_t skip, bool eof) {
+    auto part_target = _part_duration_ms / 1000.0;
+    stringstream ss;
+    ss << "#EXTM3U\n"
+       << "#EXT-X-VERSION:9\n";
+    if (_seg_number == 0) {
+        ss << "#EXT-X-PLAYLIST-TYPE:EVENT\n";
+    }
+    ss << "#EXT-X-TARGETDURATION:" << target_duration << "\n"
+       << "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=" << std::setprecision(3) << part_target * 3
+       << ",CAN-SKIP-UNTIL=" << target_duration * 6 << "\n"
+       << "#EXT-X-PART-INF:PART-TARGET=" << part_target << "\n"
+       << "#EXT-X-MEDIA-SEQUENCE:" << first_msn << "\n";
+    if (_is_fmp4) {
+        ss << "#EXT-X-MAP:URI=\"init.mp4\"\n";
+    }
+    if (skip) {
+        ss << "#EXT-X-SKIP:SKIPPED-SEGMENTS=" << skip << "\n";
+    }
+
+    auto it = _part_list.begin();
+    auto write_parts = [&](uint64_t msn) {
+        for (; it != _part_list.end() && it->msn <= msn; ++it) {
+            if (it->msn < msn) {
+                continue;
+            }
+            ss << "#EXT-X-PART:DURATION=" << it->duration_ms / 1000.0 << ",URI=\"" << getPartUri(it->msn, it->index) << "\""
+               << (it->independent ? ",INDEPENDENT=YES\n" : "\n");
+        }
+    };
+    for (size_t i = skip; i < segs.size(); ++i) {
+        write_parts(first_msn + i);
+        ss << "#EXTINF:" << std::get<0>(segs[i]) / 1000.0 << ",\n" << std::get<1>(segs[i]) << "\n";
+    }
+    // 正在生成的切片只有部分切片
+    // The segment being generated only has partial segments
+    auto hint_msn = first_msn + segs.size();
+    write_parts(hint_msn);
+
+    if (eof) {
+        ss << "#EXT-X-ENDLIST\n";
+    } else {
+        ss << "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"" << getPartUri(hint_msn, _last_file_name.empty() ? 0 : _part_index) << "\"\n";
+    }
+    return ss.str();
+}
+
+std::string HlsMaker::getPartUri(uint64_t msn, uint32_t part) {
+    return makePartName(msn, part, _is_fmp4);
+}
+
+std::string HlsMaker::makePartName(uint64_t msn, uint32_t part, bool is_fmp4) {
+    return "part_" + std::to_string(msn) + "_" + std::to_string(part) + (is_fmp4 ? ".m4s" : ".ts");
+}
+
+bool HlsMaker::parsePartName(const std::string &name, uint64_t &msn, uint32_t &part) {
+    auto pos = name.rfind('/');
+    auto file = name.data() + (pos == std::string::npos ? 0 : pos + 1);
+    if (strncmp(file, "part_", 5)) {
+        return false;
+    }
+    char *end = nullptr;
+    msn = strtoull(file + 5, &end, 10);
+    if (end == file + 5 || *end != '_') {
+        return false;
+    }
+    auto ptr = end + 1;
+    part = (uint32_t)strtoul(ptr, &end, 10);
+    if (end == ptr) {
+        return false;
+    }
+    return !strcmp(end, ".ts") || !strcmp(end, ".m4s");
 }
 
 bool HlsMaker::isLive() const {
@@ -198,12 +394,20 @@ bool HlsMaker::isFmp4() const {
     return _is_fmp4;
 }
 
+bool HlsMaker::isLowLatency() const {
+    return _part_duration_ms != 0;
+}
+
 void HlsMaker::clear() {
     _file_index = 0;
     _last_timestamp = 0;
     _last_seg_timestamp = 0;
     _seg_dur_list.clear();
     _last_file_name.clear();
+    _part_index = 0;
+    _part_timestamp = 0;
+    _part_buffer.clear();
+    _part_list.clear();
 }
 
 }//namespace mediakit
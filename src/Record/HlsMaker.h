@@ -32,7 +32,7 @@ public:
      
      * [AUTO-TRANSLATED:260bbca3]
      */
-    HlsMaker(bool is_fmp4 = false, float seg_duration = 5, uint32_t seg_number = 3, bool seg_keep = false);
+    HlsMaker(bool is_fmp4 = false, float seg_duration = 5, uint32_t seg_number = 3, bool seg_keep = false, float part_duration = 0);
     virtual ~HlsMaker() = default;
 
     /**
@@ -87,6 +87,30 @@ public:
      */
     bool isFmp4() const;
 
+    /**
+     * 是否开启低延迟hls(部分切片)
+     * Whether low-latency hls (partial segments) is enabled
+     */
+    bool isLowLatency() const;
+
+    /**
+     * 生成部分切片文件名，例如part_12_3.ts
+     * @param msn 所属切片序号
+     * @param part 部分切片在所属切片中的序号
+     * Make the partial segment file name, such as part_12_3.ts
+     * @param msn Sequence number of the parent segment
+     * @param part Index of the partial segment in its parent segment
+     */
+    static std::string makePartName(uint64_t msn, uint32_t part, bool is_fmp4);
+
+    /**
+     * 解析部分切片文件名
+     * @return 是否为部分切片文件名
+     * Parse the partial segment file name
+     * @return Whether it is a partial segment file name
+     */
+    static bool parsePartName(const std::string &name, uint64_t &msn, uint32_t &part);
+
     /**
      * 清空记录
      * Clear records
@@ -160,6 +184,52 @@ protected:
      */
     virtual void onFlushLastSegment(uint64_t duration_ms) {};
 
+    /**
+     * 部分切片生成完毕回调
+     * @param msn 所属切片序号
+     * @param part 部分切片在所属切片中的序号
+     * @param data 部分切片内容
+     * Partial segment completed callback
+     * @param msn Sequence number of the parent segment
+     * @param part Index of the partial segment in its parent segment
+     * @param data Partial segment content
+     */
+    virtual void onWritePart(uint64_t msn, uint32_t part, std::string data) {};
+
+    /**
+     * 删除某切片下所有部分切片回调
+     * Delete all partial segments of a segment callback
+     */
+    virtual void onDelPart(uint64_t msn) {};
+
+    /**
+     * 低延迟m3u8更新回调
+     * @param index 完整m3u8
+     * @param delta_index 跳过旧切片的增量m3u8(_HLS_skip=YES)，无可跳过切片时为空
+     * @param msn 预加载提示(EXT-X-PRELOAD-HINT)对应的切片序号
+     * @param part 预加载提示对应的部分切片序号
+     * Low-latency m3u8 updated callback
+     * @param index Full m3u8
+     * @param delta_index Delta m3u8 skipping old segments (_HLS_skip=YES), empty if no segment can be skipped
+     * @param msn Segment sequence number of the preload hint (EXT-X-PRELOAD-HINT)
+     * @param part Partial segment index of the preload hint
+     */
+    virtual void onWriteLowLatencyHls(const std::string &index, const std::string &delta_index, uint64_t msn, uint32_t part) {};
+
+    /**
+     * 数据可被播放器获取回调(切片或低延迟模式下的部分切片生成完毕)
+     * @param timestamp 其首帧的时间戳，单位毫秒
+     * Data available to players callback (a segment, or a partial segment in low-latency mode, is completed)
+     * @param timestamp Timestamp of its first frame, in milliseconds
+     */
+    virtual void onDataPublished(uint64_t timestamp) {};
+
+    /**
+     * 获取部分切片在m3u8中的uri
+     * Get the uri of the partial segment in m3u8
+     */
+    virtual std::string getPartUri(uint64_t msn, uint32_t part);
+
     /**
      * 关闭上个ts切片并且写入m3u8索引
      * @param eof HLS直播是否已结束
@@ -199,7 +269,35 @@ private:
      */
     void addNewSegment(uint64_t timestamp);
 
+    /**
+     * 写入部分切片数据，时长足够时先切出上一个部分切片
+     * Write partial segment data, cut out the previous partial segment first when its duration is enough
+     */
+    void inputPartData(const char *data, size_t len, uint64_t timestamp, bool is_idr_fast_packet);
+
+    /**
+     * 关闭当前部分切片
+     * @param update_index 是否更新低延迟m3u8
+     * Close the current partial segment
+     * @param update_index Whether to update the low-latency m3u8
+     */
+    void flushPart(uint64_t timestamp, bool update_index);
+
+    /**
+     * 生成低延迟m3u8
+     * Generate low-latency m3u8
+     */
+    void makeLowLatencyIndexFile(bool eof);
+    std::string makeLowLatencyIndexFile(const std::deque<std::tuple<int, std::string>> &segs, uint64_t first_msn, int target_duration, size_t skip, bool eof);
+
 private:
+    struct PartInfo {
+        uint64_t msn;
+        uint32_t index;
+        uint32_t duration_ms;
+        bool independent;
+    };
+
     bool _is_fmp4 = false;
     float _seg_duration = 0;
     uint32_t _seg_number = 0;
@@ -209,6 +307,16 @@ private:
     uint64_t _file_index = 0;
     std::string _last_file_name;
     std::deque<std::tuple<int,std::string> > _seg_dur_list;
+
+    // 部分切片时长，单位毫秒，0则不开启低延迟hls
+    // Partial segment duration in milliseconds, 0 means low-latency hls is disabled
+    uint32_t _part_duration_ms = 0;
+    bool _part_independent = false;
+    uint32_t _part_index = 0;
+    uint32_t _frame_interval = 0;
+    uint64_t _part_timestamp = 0;
+    std::string _part_buffer;
+    std::deque<PartInfo> _part_list;
 };
 
 }//namespace mediakit
@@ -16,6 +16,7 @@
 #include "Util/uv_errno.h"
 #include "Util/File.h"
 #include "Common/config.h"
+#include "Thread/WorkThreadPool.h"
 
 using namespace std;
 using namespace toolkit;
@@ -31,8 +32,14 @@ std::string getDelayPath(const std::string& originalPath) {
 }
 
 HlsMakerImp::HlsMakerImp(bool is_fmp4, const string &m3u8_file, const string &params, uint32_t bufSize, float seg_duration,
-                         uint32_t seg_number, bool seg_keep, const string &fmp4_seg_ext) : HlsMaker(is_fmp4, seg_duration, seg_number, seg_keep) {
+                         uint32_t seg_number, bool seg_keep, const string &fmp4_seg_ext, float part_duration, bool memory_mode)
+    : HlsMaker(is_fmp4, seg_duration, seg_number, seg_keep, part_duration)
+    , _latency(is_fmp4 ? "hls.fmp4" : "hls") {
+    _memory_mode = memory_mode;
     _poller = EventPollerPool::Instance().getPoller();
+    if (_memory_mode) {
+        _disk_poller = WorkThreadPool::Instance().getPoller();
+    }
     _path_prefix = m3u8_file.substr(0, m3u8_file.rfind('/'));
     _path_hls = m3u8_file;
     _path_hls_delay = getDelayPath(m3u8_file);
@@ -75,6 +82,14 @@ void HlsMakerImp::clearCache(bool immediately, bool eof) {
     // Recording finished
     flushLastSegment(eof);
     if (!isLive() || isKeep()) {
+        if (_memory_mode && eof && _media_src) {
+            // 保留的切片写入磁盘后已从内存移除，这里移除内存中的init.mp4与延时m3u8
+            // The kept segments have been removed from memory after being written to disk, remove the in-memory init.mp4 and delay m3u8 here
+            _media_src->delMemoryFile(_path_hls_delay);
+            if (!_path_init.empty()) {
+                _media_src->delMemoryFile(_path_init);
+            }
+        }
         return;
     }
 
@@ -89,14 +104,27 @@ void HlsMakerImp::clearCache(bool immediately, bool eof) {
             lst.emplace_back(std::move(pr.second));
         }
 
+        std::weak_ptr<HlsMediaSource> weak_src = _media_src;
+        auto clear = [lst, weak_src]() {
+            clearHls(lst);
+            // 同时删除内存模式下的切片
+            // Also delete the segments in memory mode
+            auto src = weak_src.lock();
+            if (src) {
+                for (auto &file : lst) {
+                    src->delMemoryFile(file);
+                }
+            }
+        };
+
         // hls直播才删除文件  [AUTO-TRANSLATED:81d2aaa5]
         // Delete file only after hls live streaming
         GET_CONFIG(uint32_t, delay, Hls::kDeleteDelaySec);
         if (!delay || immediately) {
-            clearHls(lst);
+            clear();
         } else {
-            _poller->doDelayTask(delay * 1000, [lst]() {
-                clearHls(lst);
+            _poller->doDelayTask(delay * 1000, [clear]() {
+                clear();
                 return 0;
             });
         }
@@ -114,7 +142,7 @@ void HlsMakerImp::saveCurrentDir() {
     }
     if (isFmp4()) {
         // 写入init.mp4文件
-        File::saveFile(_current_dir_init_file, _path_prefix + "/" + _current_dir + "init.mp4");
+        saveFile(_current_dir_init_file, _path_prefix + "/" + _current_dir + "init.mp4");
     }
 
     int maxSegmentDuration = 0;
@@ -144,7 +172,36 @@ void HlsMakerImp::saveCurrentDir() {
     index_str += "#EXT-X-ENDLIST\n";
 
     /** 写入该目录的m3u8文件 **/
-    File::saveFile(index_str, _path_prefix + "/" + _current_dir + (isFmp4() ? "vod.fmp4.m3u8" : "vod.m3u8"));
+    saveFile(index_str, _path_prefix + "/" + _current_dir + (isFmp4() ? "vod.fmp4.m3u8" : "vod.m3u8"));
+}
+
+void HlsMakerImp::saveFile(const string &data, const string &file_path) {
+    if (_memory_mode) {
+        saveFileAsync(file_path, std::make_shared<BufferString>(data));
+    } else {
+        File::saveFile(data, file_path);
+    }
+}
+
+void HlsMakerImp::saveFileAsync(const string &file_path, Buffer::Ptr data, std::function<void()> on_saved) {
+    _disk_poller->async([file_path, data, on_saved]() {
+        auto fp = File::create_file(file_path.data(), "wb");
+        if (!fp) {
+            WarnL << "Create file failed," << file_path << " " << get_uv_errmsg();
+            return;
+        }
+        fwrite(data->data(), data->size(), 1, fp);
+        fclose(fp);
+        if (on_saved) {
+            on_saved();
+        }
+    }, false);
+}
+
+bool HlsMakerImp::saveToDisk() const {
+    // 非内存模式、开启segKeep或录制时才写入磁盘
+    // Write to disk only in non-memory mode, or when segKeep or recording is enabled
+    return !_memory_mode || !isLive() || isKeep();
 }
 
 string HlsMakerImp::onOpenSegment(uint64_t index) {
@@ -168,7 +225,11 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
             _current_dir = std::move(current_dir);
         }
     }
-    _file = makeFile(segment_path, true);
+    if (_memory_mode) {
+        _segment_data.clear();
+    } else {
+        _file = makeFile(segment_path, true);
+    }
 
     // 保存本切片的元数据  [AUTO-TRANSLATED:64e6f692]
     // Save metadata for this slice
@@ -177,7 +238,7 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
     _info.file_path = segment_path;
     _info.url = _info.app + "/" + _info.stream + "/" + segment_name;
 
-    if (!_file) {
+    if (!_file && !_memory_mode) {
         WarnL << "Create file failed," << segment_path << " " << get_uv_errmsg();
     }
     if (_params.empty()) {
@@ -191,7 +252,13 @@ void HlsMakerImp::onDelSegment(uint64_t index) {
     if (it == _segment_file_paths.end()) {
         return;
     }
-    File::delete_file(it->second.data(), true);
+    if (_memory_mode) {
+        if (_media_src) {
+            _media_src->delMemoryFile(it->second);
+        }
+    } else {
+        File::delete_file(it->second.data(), true);
+    }
     _segment_file_paths.erase(it);
 }
 
@@ -200,6 +267,17 @@ void HlsMakerImp::onWriteInitSegment(const char *data, size_t len) {
         _current_dir_init_file.assign(data, len);
     }
     string init_seg_path = _path_prefix + "/init.mp4";
+    if (_memory_mode) {
+        auto buffer = std::make_shared<BufferString>(string(data, len));
+        if (_media_src) {
+            _media_src->setMemoryFile(init_seg_path, buffer);
+        }
+        if (saveToDisk()) {
+            saveFileAsync(init_seg_path, std::move(buffer));
+        }
+        _path_init = std::move(init_seg_path);
+        return;
+    }
     auto file = makeFile(init_seg_path);
     if (file) {
         fwrite(data, len, 1, file.get());
@@ -210,7 +288,9 @@ void HlsMakerImp::onWriteInitSegment(const char *data, size_t len) {
 }
 
 void HlsMakerImp::onWriteSegment(const char *data, size_t len) {
-    if (_file) {
+    if (_memory_mode) {
+        _segment_data.append(data, len);
+    } else if (_file) {
         fwrite(data, len, 1, _file.get());
     }
     if (_media_src) {
@@ -220,11 +300,26 @@ void HlsMakerImp::onWriteSegment(const char *data, size_t len) {
 
 void HlsMakerImp::onWriteHls(const std::string &data, bool include_delay) {
     auto path = include_delay ? _path_hls_delay : _path_hls;
+    if (_memory_mode) {
+        if (_media_src) {
+            if (include_delay) {
+                _media_src->setMemoryFile(path, std::make_shared<BufferString>(data));
+            } else if (!isLowLatency()) {
+                _media_src->setIndexFile(data);
+            }
+        }
+        if (saveToDisk()) {
+            saveFileAsync(path, std::make_shared<BufferString>(data));
+        }
+        return;
+    }
     auto hls = makeFile(path);
     if (hls) {
         fwrite(data.data(), data.size(), 1, hls.get());
         hls.reset();
-        if (_media_src && !include_delay) {
+        // 低延迟hls的内存m3u8由onWriteLowLatencyHls更新
+        // The in-memory m3u8 of low-latency hls is updated by onWriteLowLatencyHls
+        if (_media_src && !include_delay && !isLowLatency()) {
             _media_src->setIndexFile(data);
         }
     } else {
@@ -240,6 +335,39 @@ void HlsMakerImp::onFlushLastSegment(uint64_t duration_ms) {
         _current_dir_seg_list.emplace_back(duration_ms, _info.file_name.erase(0, _current_dir.size()));
     }
     GET_CONFIG(bool, broadcastRecordTs, Hls::kBroadcastRecordTs);
+    if (_memory_mode) {
+        auto size = _segment_data.size();
+        auto buffer = std::make_shared<BufferString>(std::move(_segment_data));
+        // 按本切片的大小为下个切片预分配内存，减少扩容时的内存拷贝
+        // Pre-allocate memory for the next segment according to the size of this segment, reducing memory copying when expanding
+        _segment_data = std::string();
+        _segment_data.reserve(size);
+        if (_media_src) {
+            _media_src->setMemoryFile(_info.file_path, buffer);
+        }
+        _info.time_len = duration_ms / 1000.0f;
+        _info.file_size = buffer->size();
+        auto info = _info;
+        if (!saveToDisk()) {
+            // 切片只在内存中，file_path并无对应文件，不广播切片录制事件
+            // The segment is only in memory and there is no file at file_path, so the record ts event is not broadcast
+            return;
+        }
+        std::weak_ptr<HlsMediaSource> weak_src = _media_src;
+        bool broadcast = broadcastRecordTs;
+        saveFileAsync(info.file_path, std::move(buffer), [info, weak_src, broadcast]() {
+            // 保留的切片写入磁盘后即从内存移除，此后由磁盘回复，避免内存无限增长
+            // The kept segment is removed from memory after being written to disk, and then replied from disk, avoiding unlimited memory growth
+            auto src = weak_src.lock();
+            if (src) {
+                src->delMemoryFile(info.file_path);
+            }
+            if (broadcast) {
+                NOTICE_EMIT(BroadcastRecordTsArgs, Broadcast::kBroadcastRecordTs, info);
+            }
+        });
+        return;
+    }
     if (broadcastRecordTs) {
         _info.time_len = duration_ms / 1000.0f;
         _info.file_size = File::fileSize(_info.file_path.data());
@@ -247,6 +375,41 @@ void HlsMakerImp::onFlushLastSegment(uint64_t duration_ms) {
     }
 }
 
+void HlsMakerImp::onWritePart(uint64_t msn, uint32_t part, std::string data) {
+    if (_media_src) {
+        _media_src->addPart(msn, part, std::make_shared<BufferString>(std::move(data)));
+    }
+}
+
+void HlsMakerImp::onDelPart(uint64_t msn) {
+    if (_media_src) {
+        _media_src->delPart(msn);
+    }
+}
+
+void HlsMakerImp::onWriteLowLatencyHls(const std::string &index, const std::string &delta_index, uint64_t msn, uint32_t part) {
+    if (_media_src) {
+        _media_src->setLowLatencyIndexFile(index, delta_index, msn, part);
+    }
+}
+
+std::string HlsMakerImp::getPartUri(uint64_t msn, uint32_t part) {
+    auto name = HlsMaker::getPartUri(msn, part);
+    return _params.empty() ? name : name + "?" + _params;
+}
+
+void HlsMakerImp::onDataPublished(uint64_t timestamp) {
+    if (!_latency_attached && _media_src) {
+        _latency_attached = true;
+        _latency.attach(*_media_src);
+    }
+    // 有视频时切片以视频关键帧开始，纯音频时按音频匹配
+    // The segment starts with a video key frame when there is video, match by audio when there is only audio
+    if (!_latency.onSend(TrackVideo, timestamp, false)) {
+        _latency.onSend(TrackAudio, timestamp, false);
+    }
+}
+
 std::shared_ptr<FILE> HlsMakerImp::makeFile(const string &file, bool setbuf) {
     auto file_buf = _file_buf;
     auto ret = shared_ptr<FILE>(File::create_file(file.data(), "wb"), [file_buf](FILE *fp) {
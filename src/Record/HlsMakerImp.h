@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include "HlsMaker.h"
 #include "HlsMediaSource.h"
+#include "Common/LatencyStat.h"
 
 namespace mediakit {
 
@@ -23,7 +24,7 @@ class HlsMakerImp : public HlsMaker {
 public:
     HlsMakerImp(bool is_fmp4, const std::string &m3u8_file, const std::string &params, uint32_t bufSize = 64 * 1024,
                 float seg_duration = 5, uint32_t seg_number = 3, bool seg_keep = false,
-                const std::string &fmp4_seg_ext = ".mp4");
+                const std::string &fmp4_seg_ext = ".mp4", float part_duration = 0, bool memory_mode = false);
     ~HlsMakerImp() override;
 
     /**
@@ -60,13 +61,22 @@ protected:
     void onWriteSegment(const char *data, size_t len) override;
     void onWriteHls(const std::string &data, bool include_delay) override;
     void onFlushLastSegment(uint64_t duration_ms) override;
+    void onWritePart(uint64_t msn, uint32_t part, std::string data) override;
+    void onDelPart(uint64_t msn) override;
+    void onWriteLowLatencyHls(const std::string &index, const std::string &delta_index, uint64_t msn, uint32_t part) override;
+    std::string getPartUri(uint64_t msn, uint32_t part) override;
+    void onDataPublished(uint64_t timestamp) override;
 
 private:
     std::shared_ptr<FILE> makeFile(const std::string &file,bool setbuf = false);
     void clearCache(bool immediately, bool eof);
     void saveCurrentDir();
+    void saveFile(const std::string &data, const std::string &file_path);
+    void saveFileAsync(const std::string &file_path, toolkit::Buffer::Ptr data, std::function<void()> on_saved = nullptr);
+    bool saveToDisk() const;
 
 private:
+    bool _memory_mode;
     int _buf_size;
     std::string _params;
     std::string _fmp4_seg_ext;
@@ -76,13 +86,23 @@ private:
     std::string _path_prefix;
     std::string _current_dir;
     std::string _current_dir_init_file;
+    // 内存模式下正在生成的切片
+    // The segment being generated in memory mode
+    std::string _segment_data;
     RecordInfo _info;
     std::shared_ptr<FILE> _file;
     std::shared_ptr<char> _file_buf;
     HlsMediaSource::Ptr _media_src;
     toolkit::EventPoller::Ptr _poller;
+    // 内存模式下写磁盘的后台线程，同一线程保证写入顺序
+    // The background thread writing to disk in memory mode, the same thread ensures the writing order
+    toolkit::EventPoller::Ptr _disk_poller;
     std::map<uint64_t/*index*/,std::string/*file_path*/> _segment_file_paths;
     std::deque<std::tuple<int,std::string> > _current_dir_seg_list;
+    // 切片可被获取时的延迟统计，首次生成切片时才挂载到流上
+    // Latency statistics when the segments are available, attached to the stream when the first segment is generated
+    bool _latency_attached = false;
+    LatencyRecorder _latency;
 };
 
 }//namespace mediakit
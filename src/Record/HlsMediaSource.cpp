@@ -104,8 +104,7 @@ HlsMediaSource::Ptr HlsCookieData::getMediaSource() const {
     return _src.lock();
 }
 
-void HlsMediaSource::setIndexFile(std::string index_file)
-{
+void HlsMediaSource::createRing() {
     if (!_ring) {
         std::weak_ptr<HlsMediaSource> weakSelf = std::static_pointer_cast<HlsMediaSource>(shared_from_this());
         auto lam = [weakSelf](int size) {
@@ -118,11 +117,23 @@ void HlsMediaSource::setIndexFile(std::string index_file)
         _ring = std::make_shared<RingType>(0, std::move(lam));
         regist();
     }
+}
+
+void HlsMediaSource::setIndexFile(std::string index_file)
+{
+    createRing();
 
     // 赋值m3u8索引文件内容  [AUTO-TRANSLATED:c11882b5]
     // Assign m3u8 index file content
     std::lock_guard<std::mutex> lck(_mtx_index);
     _index_file = std::move(index_file);
+    if (_index_file.empty()) {
+        // 清空缓存后切片序号从0开始，低延迟状态需重新建立
+        // After clearing the cache, the segment sequence number starts from 0, and the low-latency state needs to be re-established
+        _low_latency = false;
+        _delta_index_file.clear();
+        _parts.clear();
+    }
 
     if (!_index_file.empty()) {
         _list_cb.for_each([&](const std::function<void(const std::string& str)>& cb) { cb(_index_file); });
@@ -142,4 +153,152 @@ void HlsMediaSource::getIndexFile(std::function<void(const std::string& str)> cb
     _list_cb.emplace_back(std::move(cb));
 }
 
+bool HlsMediaSource::isPartReady(uint64_t msn, uint32_t part) const {
+    // 预加载提示指向尚未生成的部分切片，其之前的部分切片均已写入m3u8
+    // The preload hint points to the partial segment not yet generated, and all the partial segments before it have been written into m3u8
+    return msn < _hint_msn || (msn == _hint_msn && part < _hint_part);
+}
+
+void HlsMediaSource::setLowLatencyIndexFile(std::string index_file, std::string delta_index_file, uint64_t msn, uint32_t part) {
+    createRing();
+
+    std::list<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lck(_mtx_index);
+        _index_file = std::move(index_file);
+        _delta_index_file = std::move(delta_index_file);
+        _low_latency = true;
+        _hint_msn = msn;
+        _hint_part = part;
+
+        auto now = getCurrentMillisecond();
+        for (auto it = _index_waiters.begin(); it != _index_waiters.end();) {
+            if (it->expire_ms < now) {
+                // 已超时并由调用者回复
+                // Timed out and replied by the caller
+                it = _index_waiters.erase(it);
+                continue;
+            }
+            if (!isPartReady(it->msn, it->part)) {
+                ++it;
+                continue;
+            }
+            auto &index = it->skip && !_delta_index_file.empty() ? _delta_index_file : _index_file;
+            auto cb = std::move(it->cb);
+            ready.emplace_back([cb, index]() { cb(index); });
+            it = _index_waiters.erase(it);
+        }
+        _list_cb.for_each([&](const std::function<void(const std::string &str)> &cb) {
+            auto index = _index_file;
+            ready.emplace_back([cb, index]() { cb(index); });
+        });
+        _list_cb.clear();
+    }
+    for (auto &cb : ready) {
+        cb();
+    }
+}
+
+bool HlsMediaSource::getIndexFile(uint64_t msn, uint32_t part, bool skip, uint64_t expire_ms, std::function<void(const std::string &str)> cb) {
+    std::unique_lock<std::mutex> lck(_mtx_index);
+    if (!_low_latency) {
+        // 未开启低延迟hls或尚未生成m3u8，忽略阻塞参数
+        // Low-latency hls is not enabled or m3u8 has not been generated yet, ignore the blocking parameters
+        lck.unlock();
+        getIndexFile(std::move(cb));
+        return true;
+    }
+    if (msn > _hint_msn + 2) {
+        return false;
+    }
+    if (isPartReady(msn, part)) {
+        auto index = skip && !_delta_index_file.empty() ? _delta_index_file : _index_file;
+        lck.unlock();
+        cb(index);
+        return true;
+    }
+    _index_waiters.emplace_back(IndexWaiter { msn, part, skip, expire_ms, std::move(cb) });
+    return true;
+}
+
+void HlsMediaSource::addPart(uint64_t msn, uint32_t part, Buffer::Ptr data) {
+    std::list<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lck(_mtx_index);
+        auto &parts = _parts[msn];
+        if (parts.size() <= part) {
+            parts.resize(part + 1);
+        }
+        parts[part] = data;
+
+        auto now = getCurrentMillisecond();
+        for (auto it = _part_waiters.begin(); it != _part_waiters.end();) {
+            if (it->expire_ms < now) {
+                it = _part_waiters.erase(it);
+                continue;
+            }
+            Buffer::Ptr buffer;
+            if (it->msn == msn && it->part == part) {
+                buffer = data;
+            } else if (it->msn >= msn) {
+                ++it;
+                continue;
+            }
+            // 旧切片已结束，等待的部分切片不会再生成
+            // The old segment has ended, and the waiting partial segment will not be generated any more
+            auto cb = std::move(it->cb);
+            ready.emplace_back([cb, buffer]() { cb(buffer); });
+            it = _part_waiters.erase(it);
+        }
+    }
+    for (auto &cb : ready) {
+        cb();
+    }
+}
+
+void HlsMediaSource::delPart(uint64_t msn) {
+    std::lock_guard<std::mutex> lck(_mtx_index);
+    _parts.erase(_parts.begin(), _parts.upper_bound(msn));
+}
+
+void HlsMediaSource::getPart(uint64_t msn, uint32_t part, uint64_t expire_ms, std::function<void(const Buffer::Ptr &buffer)> cb) {
+    Buffer::Ptr buffer;
+    {
+        std::lock_guard<std::mutex> lck(_mtx_index);
+        auto it = _parts.find(msn);
+        if (it != _parts.end() && part < it->second.size()) {
+            buffer = it->second[part];
+        }
+        if (!buffer && _low_latency && !isPartReady(msn, part) && msn <= _hint_msn + 1) {
+            // 即将生成的部分切片(EXT-X-PRELOAD-HINT)，等待其生成
+            // The upcoming partial segment (EXT-X-PRELOAD-HINT), wait for it to be generated
+            _part_waiters.emplace_back(PartWaiter { msn, part, expire_ms, std::move(cb) });
+            return;
+        }
+    }
+    cb(buffer);
+}
+
+void HlsMediaSource::setMemoryFile(const std::string &file_path, Buffer::Ptr data) {
+    std::lock_guard<std::mutex> lck(_mtx_file);
+    auto &file = _memory_files[file_path];
+    file.data = std::move(data);
+    file.stamp_ms = getCurrentMillisecond(true);
+}
+
+void HlsMediaSource::delMemoryFile(const std::string &file_path) {
+    std::lock_guard<std::mutex> lck(_mtx_file);
+    _memory_files.erase(file_path);
+}
+
+bool HlsMediaSource::getMemoryFile(const std::string &file_path, MemoryFile &file) const {
+    std::lock_guard<std::mutex> lck(_mtx_file);
+    auto it = _memory_files.find(file_path);
+    if (it == _memory_files.end()) {
+        return false;
+    }
+    file = it->second;
+    return true;
+}
+
 } // namespace mediakit
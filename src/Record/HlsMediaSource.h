@@ -15,7 +15,11 @@
 #include "Util/TimeTicker.h"
 #include "Util/RingBuffer.h"
 #include "Network/Session.h"
+#include <map>
+#include <list>
 #include <atomic>
+#include <vector>
+#include <unordered_map>
 
 namespace mediakit {
 
@@ -26,6 +30,8 @@ public:
     using RingType = toolkit::RingBuffer<std::string>;
     using Ptr = std::shared_ptr<HlsMediaSource>;
 
+    static constexpr uint32_t kAllParts = UINT32_MAX;
+
     HlsMediaSource(const std::string &schema, const MediaTuple &tuple) : MediaSource(schema, tuple) {}
 
     /**
@@ -72,6 +78,87 @@ public:
         return _index_file;
     }
 
+    /**
+     * 设置低延迟m3u8索引文件内容，并回复已满足条件的阻塞请求
+     * @param index_file 完整m3u8
+     * @param delta_index_file 增量m3u8，为空时使用完整m3u8
+     * @param msn 预加载提示对应的切片序号
+     * @param part 预加载提示对应的部分切片序号
+     * Set the low-latency m3u8 index file content, and reply to the blocking requests whose conditions are met
+     * @param index_file Full m3u8
+     * @param delta_index_file Delta m3u8, the full m3u8 is used when it is empty
+     * @param msn Segment sequence number of the preload hint
+     * @param part Partial segment index of the preload hint
+     */
+    void setLowLatencyIndexFile(std::string index_file, std::string delta_index_file, uint64_t msn, uint32_t part);
+
+    /**
+     * 阻塞获取低延迟m3u8，直到其包含指定部分切片(_HLS_msn/_HLS_part)
+     * @param msn 切片序号
+     * @param part 部分切片序号，kAllParts表示等待整个切片生成完毕
+     * @param skip 是否获取增量m3u8(_HLS_skip=YES)
+     * @param expire_ms 请求超时时间点，超时后由调用者自行回复
+     * @return false表示请求的切片序号超前过多，应回复400
+     * Get the low-latency m3u8 in a blocking way until it contains the specified partial segment (_HLS_msn/_HLS_part)
+     * @param msn Segment sequence number
+     * @param part Partial segment index, kAllParts means waiting for the whole segment to be generated
+     * @param skip Whether to get the delta m3u8 (_HLS_skip=YES)
+     * @param expire_ms Request timeout time point, the caller replies by itself after timeout
+     * @return false means the requested segment sequence number is too far ahead, and 400 should be replied
+     */
+    bool getIndexFile(uint64_t msn, uint32_t part, bool skip, uint64_t expire_ms, std::function<void(const std::string &str)> cb);
+
+    /**
+     * 添加部分切片
+     * Add a partial segment
+     */
+    void addPart(uint64_t msn, uint32_t part, toolkit::Buffer::Ptr data);
+
+    /**
+     * 删除切片序号不大于msn的所有部分切片
+     * Delete all partial segments whose segment sequence number is not greater than msn
+     */
+    void delPart(uint64_t msn);
+
+    /**
+     * 获取部分切片，预加载提示所指的即将生成的部分切片将等待其生成后回复，不存在时回复nullptr
+     * @param expire_ms 请求超时时间点，超时后由调用者自行回复
+     * Get a partial segment, the upcoming partial segment pointed to by the preload hint will be replied after it is generated, nullptr is replied if it does not exist
+     * @param expire_ms Request timeout time point, the caller replies by itself after timeout
+     */
+    void getPart(uint64_t msn, uint32_t part, uint64_t expire_ms, std::function<void(const toolkit::Buffer::Ptr &buffer)> cb);
+
+    /**
+     * 内存模式下保存的文件(切片、init.mp4、hls_delay.m3u8)，写入后不再修改
+     * File kept in memory mode (segment, init.mp4, hls_delay.m3u8), which is not modified after being written
+     */
+    struct MemoryFile {
+        toolkit::Buffer::Ptr data;
+        // 写入时间，用于生成Last-Modified与ETag
+        // Writing time, used to generate Last-Modified and ETag
+        uint64_t stamp_ms = 0;
+    };
+
+    /**
+     * 保存内存文件，file_path为该文件在磁盘上的绝对路径
+     * Save a memory file, file_path is the absolute path of the file on disk
+     */
+    void setMemoryFile(const std::string &file_path, toolkit::Buffer::Ptr data);
+
+    /**
+     * 删除内存文件
+     * Delete a memory file
+     */
+    void delMemoryFile(const std::string &file_path);
+
+    /**
+     * 获取内存文件
+     * @return 文件是否存在
+     * Get a memory file
+     * @return Whether the file exists
+     */
+    bool getMemoryFile(const std::string &file_path, MemoryFile &file) const;
+
     void onSegmentSize(size_t bytes) { _speed[TrackVideo] += bytes; }
 
     void getPlayerList(const std::function<void(const std::list<toolkit::Any> &info_list)> &cb,
@@ -80,10 +167,42 @@ public:
     }
 
 private:
+    void createRing();
+    bool isPartReady(uint64_t msn, uint32_t part) const;
+
+private:
+    struct IndexWaiter {
+        uint64_t msn;
+        uint32_t part;
+        bool skip;
+        uint64_t expire_ms;
+        std::function<void(const std::string &)> cb;
+    };
+
+    struct PartWaiter {
+        uint64_t msn;
+        uint32_t part;
+        uint64_t expire_ms;
+        std::function<void(const toolkit::Buffer::Ptr &)> cb;
+    };
+
     RingType::Ptr _ring;
     std::string _index_file;
     mutable std::mutex _mtx_index;
     toolkit::List<std::function<void(const std::string &)>> _list_cb;
+
+    // 低延迟hls相关，由_mtx_index保护
+    // Low-latency hls related, protected by _mtx_index
+    bool _low_latency = false;
+    uint64_t _hint_msn = 0;
+    uint32_t _hint_part = 0;
+    std::string _delta_index_file;
+    std::map<uint64_t /*msn*/, std::vector<toolkit::Buffer::Ptr>> _parts;
+    std::list<IndexWaiter> _index_waiters;
+    std::list<PartWaiter> _part_waiters;
+
+    mutable std::mutex _mtx_file;
+    std::unordered_map<std::string /*file_path*/, MemoryFile> _memory_files;
 };
 
 class HlsCookieData {
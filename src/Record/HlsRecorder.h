@@ -19,7 +19,7 @@
 namespace mediakit {
 
 template <typename Muxer>
-class HlsRecorderBase : public MediaSourceEventInterceptor, public Muxer, public std::enable_shared_from_this<HlsRecorderBase<Muxer> > {
+class HlsRecorderBase : public MediaSourceEventInterceptor, public Muxer, public SharedMuxerSink, public std::enable_shared_from_this<HlsRecorderBase<Muxer> > {
 public:
     HlsRecorderBase(bool is_fmp4, const std::string &m3u8_file, const std::string &params, const ProtocolOption &option) {
         GET_CONFIG(uint32_t, hlsNum, Hls::kSegmentNum);
@@ -27,9 +27,11 @@ public:
         GET_CONFIG(uint32_t, hlsBufSize, Hls::kFileBufSize);
         GET_CONFIG(float, hlsDuration, Hls::kSegmentDuration);
         GET_CONFIG(std::string, hlsFmp4SegExt, Hls::kFmp4SegExt);
+        GET_CONFIG(float, hlsPartDuration, Hls::kPartDuration);
+        GET_CONFIG(bool, hlsMemoryMode, Hls::kMemoryMode);
 
         _option = option;
-        _hls = std::make_shared<HlsMakerImp>(is_fmp4, m3u8_file, params, hlsBufSize, hlsDuration, hlsNum, hlsKeep, hlsFmp4SegExt);
+        _hls = std::make_shared<HlsMakerImp>(is_fmp4, m3u8_file, params, hlsBufSize, hlsDuration, hlsNum, hlsKeep, hlsFmp4SegExt, hlsPartDuration, hlsMemoryMode);
         // 清空上次的残余文件  [AUTO-TRANSLATED:e16122be]
         // Clear the residual files from the last time
         _hls->clearCache();
@@ -59,14 +61,7 @@ public:
     }
 
     bool inputFrame(const Frame::Ptr &frame) override {
-        if (_clear_cache && _option.hls_demand) {
-            _clear_cache = false;
-            // 清空旧的m3u8索引文件于ts切片  [AUTO-TRANSLATED:a4ce0664]
-            // Clear the old m3u8 index file and ts slices
-            _hls->clearCache();
-            _hls->getMediaSource()->setIndexFile("");
-        }
-        if (_enabled || !_option.hls_demand) {
+        if (checkEnabled()) {
             return Muxer::inputFrame(frame);
         }
         return false;
@@ -82,6 +77,33 @@ public:
         return _hls ? _hls->getMediaSource() : nullptr;
     }
 
+    bool isSinkEnabled() override { return isEnabled(); }
+
+    /**
+     * 共享http-ts/http-fmp4的复用结果时，由其输入复用数据，关键帧处可直接切片
+     * When sharing the muxing result of http-ts/http-fmp4, it inputs the muxed data, which can be segmented directly at key frames
+     */
+    void inputSharedData(const toolkit::Buffer::Ptr &buffer, uint64_t timestamp, bool key_pos) override {
+        if (!buffer) {
+            // reset tracks
+            _hls->inputData(nullptr, 0, timestamp, key_pos);
+        } else if (checkEnabled()) {
+            _hls->inputData(buffer->data(), buffer->size(), timestamp, key_pos);
+        }
+    }
+
+protected:
+    bool checkEnabled() {
+        if (_clear_cache && _option.hls_demand) {
+            _clear_cache = false;
+            // 清空旧的m3u8索引文件于ts切片  [AUTO-TRANSLATED:a4ce0664]
+            // Clear the old m3u8 index file and ts slices
+            _hls->clearCache();
+            _hls->getMediaSource()->setIndexFile("");
+        }
+        return _enabled || !_option.hls_demand;
+    }
+
 protected:
     bool _enabled = true;
     bool _clear_cache = false;
@@ -172,6 +172,11 @@ FCI_NACK::FCI_NACK(uint16_t pid_h, const vector<bool> &type) {
     pid = htons(pid_h);
 }
 
+FCI_NACK::FCI_NACK(uint16_t pid_h, uint16_t blp_h) {
+    blp = htons(blp_h);
+    pid = htons(pid_h);
+}
+
 void FCI_NACK::check(size_t size) {
     CHECK(size >= kSize);
 }
@@ -457,13 +462,15 @@ FCI_TWCC::TwccPacketStatus FCI_TWCC::getPacketChunkList(size_t total_size) const
     CHECK(ptr < end);
     auto seq = getBaseSeq();
     auto rtp_count = getPacketCount();
+    std::vector<SymbolStatus> symbols;
+    symbols.reserve(rtp_count);
     for (uint16_t i = 0; i < rtp_count;) {
         CHECK(ptr + RunLengthChunk::kSize <= end);
         RunLengthChunk *chunk = (RunLengthChunk *)ptr;
         if (!chunk->type) {
             // RunLengthChunk
             for (auto j = 0; j < chunk->getRunLength(); ++j) {
-                ret.emplace(seq++, std::make_pair((SymbolStatus)chunk->symbol, 0));
+                symbols.emplace_back((SymbolStatus)chunk->symbol);
                 if (++i >= rtp_count) {
                     break;
                 }
@@ -472,7 +479,7 @@ FCI_TWCC::TwccPacketStatus FCI_TWCC::getPacketChunkList(size_t total_size) const
             // StatusVecChunk
             StatusVecChunk *chunk = (StatusVecChunk *)ptr;
             for (auto &symbol : chunk->getSymbolList()) {
-                ret.emplace(seq++, std::make_pair(symbol, 0));
+                symbols.emplace_back(symbol);
                 if (++i >= rtp_count) {
                     break;
                 }
@@ -480,9 +487,12 @@ FCI_TWCC::TwccPacketStatus FCI_TWCC::getPacketChunkList(size_t total_size) const
         }
         ptr += 2;
     }
-    for (auto &pr : ret) {
+    // recv delta按seq发送顺序排列，seq回环时不能按map的顺序读取
+    // Recv deltas are arranged in the order of seq, and cannot be read in the order of the map when seq loops
+    for (auto symbol : symbols) {
         CHECK(ptr <= end);
-        pr.second.second = getRecvDelta(pr.second.first, ptr, end);
+        auto delta = getRecvDelta(symbol, ptr, end);
+        ret.emplace(seq++, std::make_pair(symbol, delta));
     }
     return ret;
 }
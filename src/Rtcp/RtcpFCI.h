@@ -251,6 +251,9 @@ public:
     static constexpr size_t kBitSize = 16;
 
     FCI_NACK(uint16_t pid_h, const std::vector<bool> &type);
+    // blp_h第i位表示pid_h + i + 1是否丢包
+    // Bit i of blp_h indicates whether pid_h + i + 1 is lost
+    FCI_NACK(uint16_t pid_h, uint16_t blp_h);
 
     void check(size_t size);
     uint16_t getPid() const;
@@ -45,7 +45,9 @@ void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr
 
     std::weak_ptr<FlvMuxer> weak_self = getSharedPtr();
     media->pause(false);
+    _flv_tag_cache_ref = media->getFlvTagCacheRef();
     _ring_reader = media->getRing()->attach(poller);
+    _latency.attach(*media);
     _ring_reader->setGetInfoCB([weak_self]() {
         Any ret;
         ret.set(dynamic_pointer_cast<Session>(weak_self.lock()));
@@ -76,6 +78,10 @@ void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr
                 check = false;
             }
             strong_self->onWriteRtmp(rtmp, ++i == size);
+            if (!rtmp->isConfigFrame()) {
+                auto type = rtmp->type_id == MSG_VIDEO ? TrackVideo : (rtmp->type_id == MSG_AUDIO ? TrackAudio : TrackInvalid);
+                strong_self->_latency.onSend(type, rtmp->time_stamp, false);
+            }
         });
     });
 }
@@ -149,10 +155,19 @@ void FlvMuxer::onWriteFlvTag(uint8_t type, const Buffer::Ptr &buffer, uint32_t t
 }
 
 void FlvMuxer::onWriteRtmp(const RtmpPacket::Ptr &pkt, bool flush) {
+    if (pkt->flv_tag_header && pkt->flv_tag_size) {
+        // 媒体源已经生成好flv tag头尾，与rtmp包负载一起直接转发引用
+        // The media source has already generated the flv tag header and trailer, forward their references directly together with the rtmp packet payload
+        onWrite(pkt->flv_tag_header, false);
+        onWrite(pkt, false);
+        onWrite(pkt->flv_tag_size, flush);
+        return;
+    }
     onWriteFlvTag(pkt, pkt->time_stamp, flush);
 }
 
 void FlvMuxer::stop() {
+    _flv_tag_cache_ref = nullptr;
     if (_ring_reader) {
         _ring_reader.reset();
         onDetach();
@@ -13,6 +13,7 @@
 
 #include "Rtmp/Rtmp.h"
 #include "Rtmp/RtmpMediaSource.h"
+#include "Common/LatencyStat.h"
 #include "Poller/EventPoller.h"
 
 namespace mediakit {
@@ -41,7 +42,9 @@ private:
 
 private:
     toolkit::ResourcePool<toolkit::BufferRaw> _packet_pool;
+    std::shared_ptr<void> _flv_tag_cache_ref;
     RtmpMediaSource::RingType::RingReader::Ptr _ring_reader;
+    LatencyRecorder _latency { "flv" };
 };
 
 class FlvRecorder : public FlvMuxer , public std::enable_shared_from_this<FlvRecorder>{
@@ -9,6 +9,7 @@
  */
 
 #include "Rtmp.h"
+#include "utils.h"
 #include "Common/config.h"
 #include "Extension/Factory.h"
 
@@ -177,6 +178,80 @@ void RtmpPacket::clear() {
     ts_field = 0;
     body_size = 0;
     buffer.clear();
+    flv_tag_header = nullptr;
+    flv_tag_size = nullptr;
+    chunk_cache = ChunkCache();
+}
+
+void RtmpPacket::makeFlvTag() {
+    RtmpTagHeader header;
+    header.type = type_id;
+    set_be24(header.data_size, (uint32_t)size());
+    header.timestamp_ex = (time_stamp >> 24) & 0xff;
+    set_be24(header.timestamp, time_stamp & 0xFFFFFF);
+    uint32_t tag_size = htonl((uint32_t)(size() + sizeof(header)));
+
+    auto tag_header = toolkit::BufferRaw::create();
+    tag_header->assign((char *)&header, sizeof(header));
+    auto tag_trailer = toolkit::BufferRaw::create();
+    tag_trailer->assign((char *)&tag_size, sizeof(tag_size));
+    flv_tag_header = std::move(tag_header);
+    flv_tag_size = std::move(tag_trailer);
+}
+
+void RtmpPacket::getPlayChunkInfo(int &chunk_id, uint32_t &stream_index) const {
+    switch (type_id) {
+        case MSG_AUDIO: chunk_id = CHUNK_AUDIO, stream_index = STREAM_MEDIA; break;
+        case MSG_VIDEO: chunk_id = CHUNK_VIDEO, stream_index = STREAM_MEDIA; break;
+        default: chunk_id = this->chunk_id, stream_index = this->stream_index; break;
+    }
+}
+
+void RtmpPacket::makeChunkCache(size_t chunk_size) {
+    int chunk_id;
+    uint32_t stream_index;
+    getPlayChunkInfo(chunk_id, stream_index);
+    if (chunk_id < 2 || chunk_id > 63 || !chunk_size) {
+        // 不支持的块流 ID，交由RtmpProtocol逐会话处理
+        // Unsupported chunk stream ID, left to RtmpProtocol per session
+        return;
+    }
+
+    // 与RtmpProtocol::sendRtmp序列化方式保持一致
+    // Keep consistent with the serialization of RtmpProtocol::sendRtmp
+    // 无负载时没有分块，也就没有扩展时间戳
+    // There is no chunk without payload, so there is no extended timestamp either
+    size_t ext_size = time_stamp >= 0xFFFFFF && size() ? 4 : 0;
+
+    auto header_buf = toolkit::BufferRaw::create();
+    header_buf->setCapacity(sizeof(RtmpHeader) + ext_size);
+    header_buf->setSize(sizeof(RtmpHeader) + ext_size);
+    RtmpHeader *header = (RtmpHeader *)header_buf->data();
+    header->fmt = 0;
+    header->chunk_id = chunk_id;
+    header->type_id = type_id;
+    set_be24(header->time_stamp, time_stamp >= 0xFFFFFF ? 0xFFFFFF : time_stamp);
+    set_be24(header->body_size, (uint32_t)size());
+    set_le32(header->stream_index, stream_index);
+    if (ext_size) {
+        set_be32(header_buf->data() + sizeof(RtmpHeader), time_stamp);
+    }
+
+    auto chunk_header_buf = toolkit::BufferRaw::create();
+    chunk_header_buf->setCapacity(1 + ext_size);
+    chunk_header_buf->setSize(1 + ext_size);
+    header = (RtmpHeader *)chunk_header_buf->data();
+    header->fmt = 3;
+    header->chunk_id = chunk_id;
+    if (ext_size) {
+        set_be32(chunk_header_buf->data() + 1, time_stamp);
+    }
+
+    chunk_cache.chunk_size = chunk_size;
+    chunk_cache.chunk_id = chunk_id;
+    chunk_cache.stream_index = stream_index;
+    chunk_cache.header = std::move(header_buf);
+    chunk_cache.chunk_header = std::move(chunk_header_buf);
 }
 
 bool RtmpPacket::isVideoKeyFrame() const {
@@ -19,6 +19,7 @@
 #include "Extension/Track.h"
 
 #define DEFAULT_CHUNK_LEN	128
+#define SERVER_CHUNK_LEN	60000 /*服务器与推流器发送时协商的chunk大小*/
 #define HANDSHAKE_PLAINTEXT	0x03
 #define RANDOM_LEN		(1536 - 8)
 
@@ -183,6 +184,27 @@ public:
     uint32_t chunk_id;
     size_t body_size;
     toolkit::BufferLikeString buffer;
+    // 预先序列化好的flv tag header与PreviousTagSize，tag data即本包负载，不拷贝；由RtmpMediaSource生成并被所有flv播放器共享
+    // Pre-serialized flv tag header and PreviousTagSize, the tag data is the payload of this packet and is not copied;
+    // generated by RtmpMediaSource and shared by all flv players
+    toolkit::Buffer::Ptr flv_tag_header;
+    toolkit::Buffer::Ptr flv_tag_size;
+    // 预先序列化好的rtmp分块头，分块数据即本包负载的切片，不拷贝；由RtmpMediaSource生成并被所有rtmp播放器共享
+    // 仅当发送会话的(chunk_size, chunk_id, stream_index)与之一致时可用
+    // Pre-serialized rtmp chunk headers, the chunk data are slices of the payload of this packet and are not copied;
+    // generated by RtmpMediaSource and shared by all rtmp players
+    // Only usable when the (chunk_size, chunk_id, stream_index) of the sending session matches
+    struct ChunkCache {
+        size_t chunk_size = 0;
+        int chunk_id = 0;
+        uint32_t stream_index = 0;
+        // 首个分块的fmt0头(含扩展时间戳)
+        // The fmt0 header of the first chunk (including the extended timestamp)
+        toolkit::Buffer::Ptr header;
+        // 后续分块的fmt3头(含扩展时间戳)
+        // The fmt3 header of the subsequent chunks (including the extended timestamp)
+        toolkit::Buffer::Ptr chunk_header;
+    } chunk_cache;
 
 public:
     static Ptr create();
@@ -208,6 +230,18 @@ public:
     // Used to cache decoding configuration information
     bool isConfigFrame() const;
 
+    // 生成flv_tag_header与flv_tag_size，时间戳采用time_stamp  [FlvMuxer直接转发rtmp包时间戳]
+    // Generate flv_tag_header and flv_tag_size with time_stamp [FlvMuxer forwards rtmp packet timestamp directly]
+    void makeFlvTag();
+
+    // 获取rtmp播放器发送该包时使用的chunk id与stream index
+    // Get the chunk id and stream index used by rtmp players when sending this packet
+    void getPlayChunkInfo(int &chunk_id, uint32_t &stream_index) const;
+
+    // 按rtmp播放器的发送参数生成chunk_cache
+    // Generate chunk_cache with the sending parameters of rtmp players
+    void makeChunkCache(size_t chunk_size = SERVER_CHUNK_LEN);
+
     int getRtmpCodecId() const;
     int getAudioSampleRate() const;
     int getAudioSampleBit() const;
@@ -12,6 +12,7 @@
 #define SRC_RTMP_RTMPMEDIASOURCE_H_
 
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <functional>
@@ -156,6 +157,25 @@ public:
         return _have_audio;
     }
 
+    /**
+     * 获取flv tag共享缓存的引用，持有期间每个rtmp包都会在媒体源线程预先序列化成flv tag
+     * 所有http-flv/ws-flv播放器只需转发该flv tag的引用
+     * Get a reference to the shared flv tag cache, while held every rtmp packet is pre-serialized into a flv tag on the media source thread
+     * All http-flv/ws-flv players only need to forward the reference of the flv tag
+     */
+    std::shared_ptr<void> getFlvTagCacheRef();
+
+    /**
+     * 获取rtmp分块共享缓存的引用，持有期间每个rtmp包都会在媒体源线程按SERVER_CHUNK_LEN预先分块
+     * 所有rtmp播放器只需转发分块好的数据
+     * Get a reference to the shared rtmp chunk cache, while held every rtmp packet is pre-chunked by SERVER_CHUNK_LEN on the media source thread
+     * All rtmp players only need to forward the pre-chunked data
+     */
+    std::shared_ptr<void> getRtmpChunkCacheRef();
+
+private:
+    std::shared_ptr<void> getCacheRef(std::atomic<int> &ref);
+
 private:
     /**
     * 批量flush rtmp包时触发该函数
@@ -177,6 +197,8 @@ private:
     bool _have_video = false;
     bool _have_audio = false;
     int _ring_size;
+    std::atomic<int> _flv_tag_cache_ref { 0 };
+    std::atomic<int> _rtmp_chunk_cache_ref { 0 };
     uint32_t _track_stamps[TrackMax] = {0};
     AMFValue _metadata;
     RingType::Ptr _ring;
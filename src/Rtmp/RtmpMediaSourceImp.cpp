@@ -38,6 +38,17 @@ void RtmpMediaSource::onWrite(RtmpPacket::Ptr pkt, bool /*= true*/) {
         default: break;
     }
 
+    if (_flv_tag_cache_ref) {
+        // 存在flv播放器，在rtmp包被共享前一次性生成flv tag供所有播放器使用
+        // There are flv players, generate the flv tag once before the rtmp packet is shared, for all players to use
+        pkt->makeFlvTag();
+    }
+    if (_rtmp_chunk_cache_ref) {
+        // 存在rtmp播放器，一次性分块供所有播放器转发
+        // There are rtmp players, chunk once for all players to forward
+        pkt->makeChunkCache();
+    }
+
     if (pkt->isConfigFrame()) {
         std::lock_guard<std::recursive_mutex> lock(_mtx);
         _config_frame_map[pkt->type_id] = pkt;
@@ -72,6 +83,27 @@ void RtmpMediaSource::onWrite(RtmpPacket::Ptr pkt, bool /*= true*/) {
     PacketCache<RtmpPacket>::inputPacket(stamp, is_video, std::move(pkt), key);
 }
 
+std::shared_ptr<void> RtmpMediaSource::getFlvTagCacheRef() {
+    return getCacheRef(_flv_tag_cache_ref);
+}
+
+std::shared_ptr<void> RtmpMediaSource::getRtmpChunkCacheRef() {
+    return getCacheRef(_rtmp_chunk_cache_ref);
+}
+
+std::shared_ptr<void> RtmpMediaSource::getCacheRef(std::atomic<int> &ref) {
+    ++ref;
+    std::weak_ptr<RtmpMediaSource> weak_self = std::static_pointer_cast<RtmpMediaSource>(shared_from_this());
+    auto ptr = &ref;
+    return std::shared_ptr<void>((void *)0x01, [weak_self, ptr](void *) {
+        // 媒体源存活时成员变量才有效
+        // The member variable is only valid while the media source is alive
+        if (auto strong_self = weak_self.lock()) {
+            --(*ptr);
+        }
+    });
+}
+
 RtmpMediaSourceImp::RtmpMediaSourceImp(const MediaTuple &tuple, int ringSize)
     : RtmpMediaSource(tuple, ringSize) {
     _demuxer = std::make_shared<RtmpDemuxer>();
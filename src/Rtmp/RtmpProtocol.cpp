@@ -109,6 +109,8 @@ void RtmpProtocol::reset() {
     _map_chunk_data.clear();
     _now_stream_index = 0;
     _now_chunk_id = 0;
+    _chunk_remain = 0;
+    _chunk_stamp = 0;
     //////////Invoke Request//////////
     _send_req_id = 0;
     //////////Rtmp parser//////////
@@ -298,7 +300,41 @@ void RtmpProtocol::sendRtmp(uint8_t type, uint32_t stream_index, const Buffer::P
         totalSize += chunk;
         offset += chunk;
     }
-    _bytes_sent += (uint32_t)totalSize;
+    onSendBytes(totalSize);
+}
+
+void RtmpProtocol::sendRtmp(const RtmpPacket::Ptr &pkt, uint32_t stream_index, int chunk_id) {
+    auto &cache = pkt->chunk_cache;
+    if (!cache.header || cache.chunk_size != _chunk_size_out || cache.chunk_id != chunk_id || cache.stream_index != stream_index) {
+        // 未预先分块或分块参数不一致，回退到逐会话分块
+        // Not pre-chunked or the chunk parameters do not match, fall back to per-session chunking
+        sendRtmp(pkt->type_id, stream_index, pkt, pkt->time_stamp, chunk_id);
+        return;
+    }
+    // 共享的分块头与负载切片交错发送，负载不拷贝
+    // Send the shared chunk headers interleaved with the payload slices, the payload is not copied
+    onSendRawData(cache.header);
+    size_t total_size = cache.header->size();
+    size_t offset = 0;
+    while (offset < pkt->size()) {
+        if (offset) {
+            onSendRawData(cache.chunk_header);
+            total_size += cache.chunk_header->size();
+        }
+        size_t chunk = min(cache.chunk_size, pkt->size() - offset);
+        if (chunk == pkt->size()) {
+            onSendRawData(pkt);
+        } else {
+            onSendRawData(std::make_shared<BufferPartial>(pkt, offset, chunk));
+        }
+        total_size += chunk;
+        offset += chunk;
+    }
+    onSendBytes(total_size);
+}
+
+void RtmpProtocol::onSendBytes(size_t size) {
+    _bytes_sent += (uint32_t)size;
     if (_windows_size > 0 && _bytes_sent - _bytes_sent_last >= _windows_size) {
         _bytes_sent_last = _bytes_sent;
         sendAcknowledgement(_bytes_sent);
@@ -675,6 +711,14 @@ static constexpr size_t HEADER_LENGTH[] = {12, 8, 4, 1};
 
 const char* RtmpProtocol::handle_rtmp(const char *data, size_t len) {
     auto ptr = data;
+    if (_chunk_remain) {
+        // 上次未收齐的chunk负载，直接追加到消息缓存
+        // The chunk payload not fully received last time, append it to the message buffer directly
+        auto size = min(_chunk_remain, len);
+        handle_chunk_payload(ptr, size);
+        ptr += size;
+        len -= size;
+    }
     while (len) {
         size_t offset = 0;
         auto header = (RtmpHeader *) ptr;
@@ -760,33 +804,59 @@ const char* RtmpProtocol::handle_rtmp(const char *data, size_t len) {
             throw std::runtime_error("非法的bodySize");
         }
 
-        auto more = min(_chunk_size_in, (size_t) (chunk_data.body_size - chunk_data.buffer.size()));
-        if (len < header_len + offset + more) {
-            //need more data
-            return ptr;
-        }
-        if (more) {
-            chunk_data.buffer.append(ptr + header_len + offset, more);
-        }
-        ptr += header_len + offset + more;
-        len -= header_len + offset + more;
-        if (chunk_data.buffer.size() == chunk_data.body_size) {
-            //frame is ready
-            _now_stream_index = chunk_data.stream_index;
-            chunk_data.time_stamp = time_stamp + (chunk_data.is_abs_stamp ? 0 : chunk_data.time_stamp);
-            // 保存chunk上下文  [AUTO-TRANSLATED:4ed4fbb0]
-            // Save chunk context
-            last_packet = now_packet;
-            if (chunk_data.body_size) {
-                handle_chunk(std::move(now_packet));
-            } else {
-                now_packet = nullptr;
-            }
+        if (chunk_data.buffer.empty()) {
+            // 按消息长度预分配，减少逐个chunk追加时的扩容拷贝；bodySize来自未经校验的chunk头，
+            // 故最多预分配kMaxReserveChunks个chunk(且不超过kMaxReserveSize)，超出部分随数据到达再扩容，防止对端以多个csid声明大消息耗尽内存
+            // Pre-allocate by the message length to reduce reallocation copies when appending chunk by chunk; the bodySize comes from an
+            // unverified chunk header, so at most kMaxReserveChunks chunks (and no more than kMaxReserveSize) are pre-allocated and the rest grows as the data arrives,
+            // preventing the peer from exhausting memory by declaring large messages on many csids
+            static constexpr size_t kMaxReserveChunks = 16;
+            static constexpr size_t kMaxReserveSize = 1024 * 1024;
+            chunk_data.buffer.reserve(min((size_t)chunk_data.body_size, min(_chunk_size_in * kMaxReserveChunks, kMaxReserveSize)));
         }
+        // chunk头完整后即消费之，负载有多少追加多少，剩余负载在后续数据中继续追加，
+        // 避免不完整的chunk被HttpRequestSplitter缓存并在下次输入时再次拷贝
+        // Consume the chunk header once it is complete and append as much payload as available, the remaining payload is appended
+        // from the subsequent data, to avoid the incomplete chunk being cached by HttpRequestSplitter and copied again on the next input
+        ptr += header_len + offset;
+        len -= header_len + offset;
+        _chunk_remain = min(_chunk_size_in, (size_t) (chunk_data.body_size - chunk_data.buffer.size()));
+        _chunk_stamp = time_stamp;
+        auto size = min(_chunk_remain, len);
+        handle_chunk_payload(ptr, size);
+        ptr += size;
+        len -= size;
     }
     return ptr;
 }
 
+void RtmpProtocol::handle_chunk_payload(const char *data, size_t len) {
+    auto &pr = _map_chunk_data[_now_chunk_id];
+    auto &now_packet = pr.first;
+    auto &last_packet = pr.second;
+    auto &chunk_data = *now_packet;
+    if (len) {
+        chunk_data.buffer.append(data, len);
+        _chunk_remain -= len;
+    }
+    if (_chunk_remain || chunk_data.buffer.size() != chunk_data.body_size) {
+        // chunk或消息还未收齐
+        // The chunk or message has not been fully received yet
+        return;
+    }
+    //frame is ready
+    _now_stream_index = chunk_data.stream_index;
+    chunk_data.time_stamp = _chunk_stamp + (chunk_data.is_abs_stamp ? 0 : chunk_data.time_stamp);
+    // 保存chunk上下文  [AUTO-TRANSLATED:4ed4fbb0]
+    // Save chunk context
+    last_packet = now_packet;
+    if (chunk_data.body_size) {
+        handle_chunk(std::move(now_packet));
+    } else {
+        now_packet = nullptr;
+    }
+}
+
 void RtmpProtocol::handle_chunk(RtmpPacket::Ptr packet) {
     auto &chunk_data = *packet;
     switch (chunk_data.type_id) {
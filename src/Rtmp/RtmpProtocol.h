@@ -62,6 +62,9 @@ protected:
     void sendResponse(int type, const std::string &str);
     void sendRtmp(uint8_t type, uint32_t stream_index, const std::string &buffer, uint32_t stamp, int chunk_id);
     void sendRtmp(uint8_t type, uint32_t stream_index, const toolkit::Buffer::Ptr &buffer, uint32_t stamp, int chunk_id);
+    // 发送媒体源中的rtmp包，分块参数一致时直接转发预先分块好的数据
+    // Send the rtmp packet from the media source, forward the pre-chunked data directly when the chunk parameters match
+    void sendRtmp(const RtmpPacket::Ptr &pkt, uint32_t stream_index, int chunk_id);
     toolkit::BufferRaw::Ptr obtainBuffer(const void *data = nullptr, size_t len = 0);
     
 private:
@@ -80,7 +83,9 @@ private:
     const char* handle_C0C1(const char *data, size_t len);
     const char* handle_C2(const char *data, size_t len);
     const char* handle_rtmp(const char *data, size_t len);
+    void handle_chunk_payload(const char *data, size_t len);
     void handle_chunk(RtmpPacket::Ptr chunk_data);
+    void onSendBytes(size_t size);
 
 protected:
     int _send_req_id = 0;
@@ -90,6 +95,10 @@ protected:
 private:
     bool _data_started = false;
     int _now_chunk_id = 0;
+    // 当前chunk还未收到的负载长度及其时间戳
+    // Length of the payload of the current chunk not received yet and its timestamp
+    size_t _chunk_remain = 0;
+    uint32_t _chunk_stamp = 0;
     ////////////ChunkSize////////////
     size_t _chunk_size_in = DEFAULT_CHUNK_LEN;
     size_t _chunk_size_out = DEFAULT_CHUNK_LEN;
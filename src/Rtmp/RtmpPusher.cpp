@@ -125,7 +125,7 @@ void RtmpPusher::onConnect(const SockException &err){
             return;
         }
 
-        strong_self->sendChunkSize(60000);
+        strong_self->sendChunkSize(SERVER_CHUNK_LEN);
         strong_self->send_connect();
     });
 }
@@ -73,7 +73,7 @@ void RtmpSession::onRecv(const Buffer::Ptr &buf) {
 void RtmpSession::onCmd_connect(AMFDecoder &dec) {
     auto params = dec.load<AMFValue>();
     ///////////set chunk size////////////////
-    sendChunkSize(60000);
+    sendChunkSize(SERVER_CHUNK_LEN);
     ////////////window Acknowledgement size/////
     sendAcknowledgementSize(5000000);
     ///////////set peerBandwidth////////////////
@@ -294,6 +294,7 @@ void RtmpSession::sendPlayResponse(const string &err, const RtmpMediaSource::Ptr
     });
 
     src->pause(false);
+    _chunk_cache_ref = src->getRtmpChunkCacheRef();
     _ring_reader = src->getRing()->attach(getPoller());
     weak_ptr<RtmpSession> weak_self = static_pointer_cast<RtmpSession>(shared_from_this());
     _ring_reader->setGetInfoCB([weak_self]() {
@@ -314,6 +315,10 @@ void RtmpSession::sendPlayResponse(const string &err, const RtmpMediaSource::Ptr
                 strong_self->setSendFlushFlag(true);
             }
             strong_self->onSendMedia(rtmp);
+            if (!rtmp->isConfigFrame()) {
+                auto type = rtmp->type_id == MSG_VIDEO ? TrackVideo : (rtmp->type_id == MSG_AUDIO ? TrackAudio : TrackInvalid);
+                strong_self->_latency.onSend(type, rtmp->time_stamp, false);
+            }
         });
     });
     _ring_reader->setDetachCB([weak_self]() {
@@ -326,6 +331,7 @@ void RtmpSession::sendPlayResponse(const string &err, const RtmpMediaSource::Ptr
     });
     src->pause(false);
     _play_src = src;
+    _latency.attach(*src);
     //提高服务器发送性能
     setSocketFlags();
 }
@@ -577,17 +583,10 @@ void RtmpSession::onCmd_seek(AMFDecoder &dec) {
 }
 
 void RtmpSession::onSendMedia(const RtmpPacket::Ptr &pkt) {
-    switch (pkt->type_id) {
-        case MSG_AUDIO:
-            sendRtmp(pkt->type_id, STREAM_MEDIA, pkt, pkt->time_stamp, CHUNK_AUDIO);
-            break;
-        case MSG_VIDEO:
-            sendRtmp(pkt->type_id, STREAM_MEDIA, pkt, pkt->time_stamp, CHUNK_VIDEO);
-            break;
-        default:
-            sendRtmp(pkt->type_id, pkt->stream_index, pkt, pkt->time_stamp, pkt->chunk_id);
-            break;
-    }
+    int chunk_id;
+    uint32_t stream_index;
+    pkt->getPlayChunkInfo(chunk_id, stream_index);
+    sendRtmp(pkt, stream_index, chunk_id);
 }
 
 bool RtmpSession::close(MediaSource &sender) {
@@ -17,6 +17,7 @@
 #include "utils.h"
 #include "RtmpProtocol.h"
 #include "RtmpMediaSourceImp.h"
+#include "Common/LatencyStat.h"
 #include "Util/TimeTicker.h"
 #include "Network/Session.h"
 
@@ -108,7 +109,13 @@ private:
     std::map<uint8_t, RtmpPacket::Ptr> _push_config_packets;
     RtmpMediaSourceImp::Ptr _push_src;
     std::shared_ptr<void> _push_src_ownership;
+    // 播放时持有媒体源rtmp分块共享缓存的引用
+    // Hold a reference to the shared rtmp chunk cache of the media source while playing
+    std::shared_ptr<void> _chunk_cache_ref;
     RtmpMediaSource::RingType::RingReader::Ptr _ring_reader;
+    // 播放延迟统计
+    // Playback latency statistics
+    LatencyRecorder _latency { "rtmp" };
 };
 
 /**
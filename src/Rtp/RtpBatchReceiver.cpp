@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if defined(ENABLE_RTPPROXY)
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include "RtpBatchReceiver.h"
+#include "Rtsp/Rtsp.h"
+#include "Common/config.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 单次批量读取最大包数
+// Maximum number of packets per batch read
+static constexpr size_t kMaxBatchCount = 32;
+
+static atomic<uint64_t> s_packets { 0 };
+static atomic<uint64_t> s_syscalls { 0 };
+static atomic<uint64_t> s_groups { 0 };
+
+RtpBatchReceiver::RtpBatchReceiver(Socket::Ptr sock) : _sock(std::move(sock)) {}
+
+RtpBatchReceiver::~RtpBatchReceiver() {
+    _sock->setOnRead(nullptr);
+#if !defined(_WIN32)
+    if (_fd != -1) {
+        auto fd = _fd;
+        _sock->getPoller()->delEvent(fd, [fd](bool) { close(fd); });
+    }
+#endif
+}
+
+void RtpBatchReceiver::start(onRecvCB cb) {
+    _on_recv = std::move(cb);
+    weak_ptr<RtpBatchReceiver> weak_self = shared_from_this();
+    // Socket自身的读事件作为兜底(windows或批量读取不可用时)，同样按组回调
+    // The read event of the Socket itself is used as a fallback (windows or batch read is unavailable), also called back by group
+    _sock->setOnRead([weak_self](const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onRecvOne(buf, addr, addr_len);
+        }
+    });
+
+#if !defined(_WIN32)
+    GET_CONFIG(bool, batchRecv, RtpProxy::kUdpBatchRecv);
+    if (!batchRecv) {
+        return;
+    }
+    // 复制一个fd单独监听读事件，socket的fd仍由Socket对象管理(用于发送与统计)
+    // Duplicate an fd to listen for read events separately, the fd of the socket is still managed by the Socket object (for sending and statistics)
+    auto fd = dup(_sock->rawFD());
+    if (fd == -1) {
+        WarnL << "dup udp socket failed, batch receive disabled: " << get_uv_errmsg();
+        return;
+    }
+    auto poller = _sock->getPoller();
+    if (-1 == poller->addEvent(fd, EventPoller::Event_Read | EventPoller::Event_Error, [weak_self](int event) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onRead();
+        }
+    })) {
+        WarnL << "add udp socket to poller failed, batch receive disabled: " << get_uv_errmsg();
+        close(fd);
+        return;
+    }
+    _fd = fd;
+    _sock->enableRecv(false);
+#endif
+}
+
+RtpBatchReceiver::Statistic RtpBatchReceiver::getStatistic() {
+    Statistic ret;
+    ret.packets = s_packets.load();
+    ret.syscalls = s_syscalls.load();
+    ret.groups = s_groups.load();
+    return ret;
+}
+
+void RtpBatchReceiver::onRecvOne(const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+    _pkts.resize(1);
+    auto &pkt = _pkts[0];
+    pkt.buffer = buf;
+    pkt.addr_len = std::min<int>(addr_len, sizeof(pkt.addr));
+    memcpy(&pkt.addr, addr, pkt.addr_len);
+    ++s_packets;
+    ++s_syscalls;
+    dispatch(1);
+}
+
+void RtpBatchReceiver::onRead() {
+    // 边沿触发，必须读到无数据为止
+    // Edge triggered, must read until there is no data
+    while (true) {
+        auto count = recvBatch();
+        if (!count) {
+            break;
+        }
+        dispatch(count);
+    }
+}
+
+#if defined(__linux__) || defined(__linux)
+
+size_t RtpBatchReceiver::recvBatch() {
+    GET_CONFIG(uint32_t, rtpMaxSize, Rtp::kRtpMaxSize);
+    size_t buffer_size = 1024 * rtpMaxSize;
+    _pkts.resize(kMaxBatchCount);
+    _buffers.resize(kMaxBatchCount);
+
+    struct mmsghdr msgs[kMaxBatchCount];
+    struct iovec iovs[kMaxBatchCount];
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = 0; i < kMaxBatchCount; ++i) {
+        auto &buf = _buffers[i];
+        // 被上层持有的缓存不能复用
+        // Buffers held by the upper layer cannot be reused
+        if (!buf || buf.use_count() > 1 || buf->getCapacity() < buffer_size) {
+            buf = BufferRaw::create();
+            buf->setCapacity(buffer_size);
+        }
+        iovs[i].iov_base = buf->data();
+        iovs[i].iov_len = buffer_size;
+        auto &hdr = msgs[i].msg_hdr;
+        hdr.msg_name = &_pkts[i].addr;
+        hdr.msg_namelen = sizeof(_pkts[i].addr);
+        hdr.msg_iov = &iovs[i];
+        hdr.msg_iovlen = 1;
+    }
+
+    int ret;
+    do {
+        ret = recvmmsg(_fd, msgs, kMaxBatchCount, 0, nullptr);
+    } while (ret < 0 && errno == EINTR);
+    ++s_syscalls;
+
+    if (ret <= 0) {
+        return 0;
+    }
+    for (int i = 0; i < ret; ++i) {
+        auto &pkt = _pkts[i];
+        auto &buf = _buffers[i];
+        // 超过rtpMaxSize的包被截断，丢弃之
+        // Packets exceeding rtpMaxSize are truncated, discard them
+        buf->setSize((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : msgs[i].msg_len);
+        pkt.addr_len = msgs[i].msg_hdr.msg_namelen;
+        pkt.buffer = buf;
+    }
+    s_packets += ret;
+    return ret;
+}
+
+#elif !defined(_WIN32)
+
+size_t RtpBatchReceiver::recvBatch() {
+    GET_CONFIG(uint32_t, rtpMaxSize, Rtp::kRtpMaxSize);
+    size_t buffer_size = 1024 * rtpMaxSize;
+    _pkts.resize(kMaxBatchCount);
+    _buffers.resize(kMaxBatchCount);
+
+    size_t count = 0;
+    for (; count < kMaxBatchCount; ++count) {
+        auto &pkt = _pkts[count];
+        auto &buf = _buffers[count];
+        if (!buf || buf.use_count() > 1 || buf->getCapacity() < buffer_size) {
+            buf = BufferRaw::create();
+            buf->setCapacity(buffer_size);
+        }
+        socklen_t addr_len = sizeof(pkt.addr);
+        ssize_t ret;
+        do {
+            ret = recvfrom(_fd, buf->data(), buffer_size, 0, (struct sockaddr *)&pkt.addr, &addr_len);
+        } while (ret < 0 && errno == EINTR);
+        ++s_syscalls;
+        if (ret < 0) {
+            break;
+        }
+        buf->setSize(ret);
+        pkt.addr_len = addr_len;
+        pkt.buffer = buf;
+    }
+    s_packets += count;
+    return count;
+}
+
+#else
+
+size_t RtpBatchReceiver::recvBatch() {
+    return 0;
+}
+
+#endif // defined(__linux__) || defined(__linux)
+
+void RtpBatchReceiver::dispatch(size_t count) {
+    _group.clear();
+    for (size_t i = 0; i < count; ++i) {
+        auto &pkt = _pkts[i];
+        auto data = pkt.buffer->data();
+        auto size = pkt.buffer->size();
+        if (!isRtp(data, size) || !getSSRC(data, size, pkt.ssrc)) {
+            // 忽略非rtp数据
+            // Ignore non-rtp data
+            continue;
+        }
+        _group.emplace_back(&pkt);
+    }
+    // 稳定排序，同一ssrc的包保持接收顺序
+    // Stable sort, packets with the same ssrc keep the receiving order
+    std::stable_sort(_group.begin(), _group.end(), [](const Packet *a, const Packet *b) { return a->ssrc < b->ssrc; });
+
+    for (size_t begin = 0; begin < _group.size();) {
+        auto ssrc = _group[begin]->ssrc;
+        auto end = begin + 1;
+        while (end < _group.size() && _group[end]->ssrc == ssrc) {
+            ++end;
+        }
+        ++s_groups;
+        try {
+            _on_recv(ssrc, _group.data() + begin, end - begin);
+        } catch (std::exception &ex) {
+            WarnL << "dispatch rtp of ssrc " << printSSRC(ssrc) << " failed: " << ex.what();
+        }
+        begin = end;
+    }
+
+    // 释放对缓存的引用，以便下次读取时复用
+    // Release references to the buffers so that they can be reused on the next read
+    for (size_t i = 0; i < count; ++i) {
+        _pkts[i].buffer = nullptr;
+    }
+}
+
+} // namespace mediakit
+#endif // defined(ENABLE_RTPPROXY)
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_RTPBATCHRECEIVER_H
+#define ZLMEDIAKIT_RTPBATCHRECEIVER_H
+
+#if defined(ENABLE_RTPPROXY)
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include "Network/Socket.h"
+
+namespace mediakit {
+
+/**
+ * rtp udp批量接收器，linux下使用recvmmsg一次读取多个udp包，并按ssrc分组后回调
+ * 接收缓存池化复用，回调中未被持有的缓存在下次读取时直接复用，不产生内存分配
+ * Rtp udp batch receiver, uses recvmmsg on linux to read multiple udp packets at once, and calls back after grouping by ssrc
+ * Receive buffers are pooled, buffers not held by the callback will be reused directly on the next read without memory allocation
+ */
+class RtpBatchReceiver : public std::enable_shared_from_this<RtpBatchReceiver> {
+public:
+    using Ptr = std::shared_ptr<RtpBatchReceiver>;
+
+    struct Packet {
+        uint32_t ssrc = 0;
+        int addr_len = 0;
+        struct sockaddr_storage addr;
+        toolkit::Buffer::Ptr buffer;
+    };
+
+    /**
+     * 同一ssrc的一组rtp包回调，组内包保持接收顺序
+     * Callback of a group of rtp packets with the same ssrc, packets in the group keep the receiving order
+     */
+    using onRecvCB = std::function<void(uint32_t ssrc, Packet *const *pkts, size_t count)>;
+
+    struct Statistic {
+        // 接收的udp包个数
+        // Number of udp packets received
+        uint64_t packets = 0;
+        // 批量接收产生的系统调用次数
+        // Number of system calls made by batch receiving
+        uint64_t syscalls = 0;
+        // 按ssrc分组后的回调次数
+        // Number of callbacks after grouping by ssrc
+        uint64_t groups = 0;
+    };
+
+    /**
+     * @param sock 已绑定端口的udp socket，其读事件将被本对象接管
+     * @param sock Udp socket with bound port, its read event will be taken over by this object
+     */
+    RtpBatchReceiver(toolkit::Socket::Ptr sock);
+    ~RtpBatchReceiver();
+
+    /**
+     * 开始接收，可在任意线程调用
+     * Start receiving, can be called from any thread
+     */
+    void start(onRecvCB cb);
+
+    const toolkit::Socket::Ptr &getSock() const { return _sock; }
+
+    /**
+     * 获取全局统计信息
+     * Get global statistics
+     */
+    static Statistic getStatistic();
+
+private:
+    void onRead();
+    size_t recvBatch();
+    void onRecvOne(const toolkit::Buffer::Ptr &buf, struct sockaddr *addr, int addr_len);
+    void dispatch(size_t count);
+
+private:
+    int _fd = -1;
+    onRecvCB _on_recv;
+    toolkit::Socket::Ptr _sock;
+    std::vector<Packet> _pkts;
+    std::vector<toolkit::BufferRaw::Ptr> _buffers;
+    std::vector<Packet *> _group;
+};
+
+} // namespace mediakit
+#endif // defined(ENABLE_RTPPROXY)
+#endif // ZLMEDIAKIT_RTPBATCHRECEIVER_H
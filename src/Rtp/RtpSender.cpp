@@ -423,10 +423,18 @@ void RtpSender::onFlushRtpList(shared_ptr<List<Buffer::Ptr>> rtp_list) {
             switch (_args.con_type) {
                 case MediaSourceEvent::SendRtpArgs::kUdpActive:
                 case MediaSourceEvent::SendRtpArgs::kUdpPassive: {
+                    if (!_udp_sender || _udp_sender->getSock() != _socket_rtp) {
+                        _udp_sender = std::make_shared<UdpBatchSender>(_socket_rtp);
+                    }
                     onSendRtpUdp(packet, i == 0);
                     // udp模式，rtp over tcp前4个字节可以忽略  [AUTO-TRANSLATED:5d648f4b]
                     // UDP mode, the first 4 bytes of rtp over tcp can be ignored
-                    _socket_rtp->send(std::make_shared<BufferRtp>(std::move(packet), RtpPacket::kRtpTcpHeaderSize), nullptr, 0, ++i == size);
+                    _udp_sender->send(std::make_shared<BufferRtp>(std::move(packet), RtpPacket::kRtpTcpHeaderSize));
+                    if (++i == size) {
+                        // 批量发送，减少系统调用次数
+                        // Send in batch to reduce the number of system calls
+                        _udp_sender->flush();
+                    }
                     break;
                 }
                 case MediaSourceEvent::SendRtpArgs::kTcpActive:
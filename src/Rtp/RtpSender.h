@@ -16,6 +16,7 @@
 #include "Rtcp/RtcpContext.h"
 #include "Common/MediaSource.h"
 #include "Common/MediaSink.h"
+#include "Common/UdpBatchSender.h"
 
 namespace mediakit{
 
@@ -119,6 +120,9 @@ private:
     MediaSourceEvent::SendRtpArgs _args;
     toolkit::Socket::Ptr _socket_rtp;
     toolkit::Socket::Ptr _socket_rtcp;
+    // udp模式下rtp批量发送器
+    // Rtp batch sender in udp mode
+    UdpBatchSender::Ptr _udp_sender;
     toolkit::EventPoller::Ptr _poller;
     MediaSinkInterface::Ptr _interface;
     std::shared_ptr<RtcpContext> _rtcp_context;
@@ -9,9 +9,11 @@
  */
 
 #if defined(ENABLE_RTPPROXY)
+#include <unordered_map>
 #include "Util/uv_errno.h"
 #include "RtpServer.h"
 #include "RtpProcess.h"
+#include "RtpBatchReceiver.h"
 #include "Rtcp/RtcpContext.h"
 #include "Common/config.h"
 
@@ -134,6 +136,91 @@ private:
     std::shared_ptr<struct sockaddr_storage> _rtcp_addr;
 };
 
+/**
+ * 单端口多路复用时按ssrc区分流，所有流在同一个poller线程处理，配合RtpBatchReceiver批量接收
+ * When a single port is multiplexed, streams are distinguished by ssrc, all streams are processed in the same poller thread, working with RtpBatchReceiver batch receiving
+ */
+class RtpMultiplexHelper : public std::enable_shared_from_this<RtpMultiplexHelper> {
+public:
+    using Ptr = std::shared_ptr<RtpMultiplexHelper>;
+
+    RtpMultiplexHelper(Socket::Ptr sock, MediaTuple tuple, int only_track) {
+        _sock = std::move(sock);
+        _tuple = std::move(tuple);
+        _only_track = only_track;
+    }
+
+    void onRecvRtp(uint32_t ssrc, RtpBatchReceiver::Packet *const *pkts, size_t count) {
+        auto &ctx = _contexts[ssrc];
+        if (!ctx.process) {
+            // 未指定流id，使用ssrc为流id
+            // Stream id is not specified, use ssrc as stream id
+            auto tuple = _tuple;
+            tuple.stream = printSSRC(ssrc);
+            ctx.process = RtpProcess::createProcess(tuple);
+            ctx.process->setOnlyTrack((RtpProcess::OnlyTrack)_only_track);
+            ctx.addr_len = pkts[0]->addr_len;
+            memcpy(&ctx.addr, &pkts[0]->addr, ctx.addr_len);
+
+            weak_ptr<RtpMultiplexHelper> weak_self = shared_from_this();
+            weak_ptr<RtpProcess> weak_process = ctx.process;
+            ctx.process->setOnDetach([weak_self, weak_process, ssrc](const SockException &ex) {
+                auto strong_self = weak_self.lock();
+                if (!strong_self) {
+                    return;
+                }
+                // 可能在其他线程或rtp处理过程中触发，切换到poller线程再移除
+                // May be triggered in other threads or during rtp processing, switch to the poller thread before removing
+                strong_self->_sock->getPoller()->async([weak_self, weak_process, ssrc]() {
+                    auto strong_self = weak_self.lock();
+                    if (!strong_self) {
+                        return;
+                    }
+                    auto it = strong_self->_contexts.find(ssrc);
+                    if (it != strong_self->_contexts.end() && it->second.process == weak_process.lock()) {
+                        strong_self->_contexts.erase(it);
+                    }
+                }, false);
+            });
+        }
+
+        auto process = ctx.process;
+        for (size_t i = 0; i < count; ++i) {
+            auto &pkt = *pkts[i];
+            if (pkt.addr_len != ctx.addr_len || memcmp(&pkt.addr, &ctx.addr, ctx.addr_len)) {
+                // 同一ssrc只接收第一个对端的数据，防止多个设备使用相同ssrc推流
+                // Only receive data from the first peer for the same ssrc, preventing multiple devices from pushing with the same ssrc
+                if (!ctx.dropped++) {
+                    WarnL << "rtp of ssrc " << printSSRC(ssrc) << " from another peer dropped: "
+                          << SockUtil::inet_ntoa((struct sockaddr *)&pkt.addr);
+                }
+                continue;
+            }
+            try {
+                // 与RtpSession保持一致，避免改变hook中的协议类型
+                // Keep consistent with RtpSession to avoid changing the protocol type in hooks
+                process->inputRtp(false, _sock, pkt.buffer->data(), pkt.buffer->size(), (struct sockaddr *)&pkt.addr);
+            } catch (std::exception &ex) {
+                process->onDetach(SockException(Err_shutdown, ex.what()));
+                return;
+            }
+        }
+    }
+
+private:
+    struct Context {
+        int addr_len = 0;
+        size_t dropped = 0;
+        struct sockaddr_storage addr;
+        RtpProcess::Ptr process;
+    };
+
+    int _only_track = 0;
+    Socket::Ptr _sock;
+    MediaTuple _tuple;
+    std::unordered_map<uint32_t, Context> _contexts;
+};
+
 void RtpServer::start(uint16_t local_port, const char *local_ip, const MediaTuple &tuple, TcpMode tcp_mode, bool re_use_port, uint32_t ssrc, int only_track, bool multiplex) {
     // 创建udp服务器  [AUTO-TRANSLATED:99619428]
     // Create UDP server
@@ -165,6 +252,8 @@ void RtpServer::start(uint16_t local_port, const char *local_ip, const MediaTupl
     // Create UDP server
     UdpServer::Ptr udp_server;
     RtcpHelper::Ptr helper;
+    RtpBatchReceiver::Ptr batch_receiver;
+    GET_CONFIG(bool, udpBatchRecv, RtpProxy::kUdpBatchRecv);
     // 增加了多路复用判断，如果多路复用为true，就走else逻辑，同时保留了原来stream_id为空走else逻辑  [AUTO-TRANSLATED:114690b1]
     // Added multiplexing judgment. If multiplexing is true, then go to the else logic, while retaining the original stream_id is empty to go to the else logic
     if (!tuple.stream.empty() && !multiplex) {
@@ -176,9 +265,7 @@ void RtpServer::start(uint16_t local_port, const char *local_ip, const MediaTupl
         bool bind_peer_addr = false;
         auto ssrc_ptr = std::make_shared<uint32_t>(ssrc);
         _ssrc = ssrc_ptr;
-        rtp_socket->setOnRead([rtp_socket, helper, ssrc_ptr, bind_peer_addr](const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) mutable {
-            RtpHeader *header = (RtpHeader *)buf->data();
-            auto rtp_ssrc = ntohl(header->ssrc);
+        auto on_rtp = [rtp_socket, helper, ssrc_ptr, bind_peer_addr](uint32_t rtp_ssrc, const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) mutable {
             auto ssrc = *ssrc_ptr;
             if (ssrc && rtp_ssrc != ssrc) {
                 WarnL << "ssrc mismatched, rtp dropped: " << rtp_ssrc << " != " << ssrc;
@@ -191,7 +278,31 @@ void RtpServer::start(uint16_t local_port, const char *local_ip, const MediaTupl
                 }
                 helper->onRecvRtp(rtp_socket, buf, addr);
             }
+        };
+        if (tcp_mode != ACTIVE) {
+            // tcp主动模式会复用rtp socket发起连接，此时不能批量接收
+            // Tcp active mode reuses the rtp socket to connect, batch receiving is not allowed at this time
+            batch_receiver = std::make_shared<RtpBatchReceiver>(rtp_socket);
+            batch_receiver->start([on_rtp](uint32_t rtp_ssrc, RtpBatchReceiver::Packet *const *pkts, size_t count) mutable {
+                for (size_t i = 0; i < count; ++i) {
+                    on_rtp(rtp_ssrc, pkts[i]->buffer, (struct sockaddr *)&pkts[i]->addr, pkts[i]->addr_len);
+                }
+            });
+        } else {
+            rtp_socket->setOnRead([on_rtp](const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) mutable {
+                RtpHeader *header = (RtpHeader *)buf->data();
+                on_rtp(ntohl(header->ssrc), buf, addr, addr_len);
+            });
+        }
+    } else if (udpBatchRecv) {
+        // 单端口单线程批量接收多个流，根据ssrc区分流
+        // Single-port single-threaded batch reception of multiple streams, distinguishing streams based on SSRC
+        auto multiplex_helper = std::make_shared<RtpMultiplexHelper>(rtp_socket, tuple, only_track);
+        batch_receiver = std::make_shared<RtpBatchReceiver>(rtp_socket);
+        batch_receiver->start([multiplex_helper](uint32_t ssrc, RtpBatchReceiver::Packet *const *pkts, size_t count) {
+            multiplex_helper->onRecvRtp(ssrc, pkts, count);
         });
+        rtp_socket = nullptr;
     } else {
         // 单端口多线程接收多个流，根据ssrc区分流  [AUTO-TRANSLATED:e11c3ca8]
         // Single-port multi-threaded reception of multiple streams, distinguishing streams based on SSRC
@@ -238,6 +349,7 @@ void RtpServer::start(uint16_t local_port, const char *local_ip, const MediaTupl
     _tcp_server = tcp_server;
     _udp_server = udp_server;
     _rtp_socket = rtp_socket;
+    _batch_receiver = batch_receiver;
     _rtcp_helper = helper;
     _tcp_mode = tcp_mode;
 }
@@ -249,7 +361,10 @@ void RtpServer::setOnDetach(RtpProcess::onDetachCB cb) {
 }
 
 uint16_t RtpServer::getPort() {
-    return _udp_server ? _udp_server->getPort() : _rtp_socket->get_local_port();
+    if (_udp_server) {
+        return _udp_server->getPort();
+    }
+    return _batch_receiver ? _batch_receiver->getSock()->get_local_port() : _rtp_socket->get_local_port();
 }
 
 void RtpServer::connectToServer(const std::string &url, uint16_t port, const function<void(const SockException &ex)> &cb) {
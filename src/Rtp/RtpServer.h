@@ -21,6 +21,7 @@
 namespace mediakit {
 
 class RtcpHelper;
+class RtpBatchReceiver;
 
 /**
  * RTP服务器，支持UDP/TCP
@@ -109,6 +110,7 @@ protected:
     toolkit::Socket::Ptr _rtp_socket;
     toolkit::UdpServer::Ptr _udp_server;
     toolkit::TcpServer::Ptr _tcp_server;
+    std::shared_ptr<RtpBatchReceiver> _batch_receiver;
     std::shared_ptr<uint32_t> _ssrc;
     std::shared_ptr<RtcpHelper> _rtcp_helper;
     std::function<void()> _on_cleanup;
@@ -136,17 +136,18 @@ RtpMultiCaster::RtpMultiCaster(SocketHelper &helper, const string &local_ip, con
         peer.sin_addr.s_addr = htonl(*_multicast_ip);
         bzero(&(peer.sin_zero), sizeof peer.sin_zero);
         _udp_sock[i]->bindPeerAddr((struct sockaddr *) &peer);
+        _udp_sender[i] = std::make_shared<UdpBatchSender>(_udp_sock[i]);
     }
 
     src->pause(false);
     _rtp_reader = src->getRing()->attach(helper.getPoller());
     _rtp_reader->setReadCB([this](const RtspMediaSource::RingDataType &pkt) {
-        size_t i = 0;
-        auto size = pkt->size();
         pkt->for_each([&](const RtpPacket::Ptr &rtp) {
-            auto &sock = _udp_sock[rtp->type];
-            sock->send(std::make_shared<BufferRtp>(rtp, 4), nullptr, 0, ++i == size);
+            _udp_sender[rtp->type]->send(std::make_shared<BufferRtp>(rtp, 4));
         });
+        for (auto &sender : _udp_sender) {
+            sender->flush();
+        }
     });
 
     string strKey = StrPrinter << local_ip << " " << tuple.vhost << " " << tuple.app << " " << tuple.stream << endl;
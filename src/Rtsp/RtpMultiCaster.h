@@ -17,6 +17,7 @@
 #include <unordered_map>
 #include "RtspMediaSource.h"
 #include "Network/Socket.h"
+#include "Common/UdpBatchSender.h"
 
 namespace mediakit{
 
@@ -57,6 +58,7 @@ private:
 private:
     std::recursive_mutex _mtx;
     toolkit::Socket::Ptr _udp_sock[2];
+    UdpBatchSender::Ptr _udp_sender[2];
     std::shared_ptr<uint32_t> _multicast_ip;
     std::unordered_map<void * , onDetach > _detach_map;
     RtspMediaSource::RingType::RingReader::Ptr _rtp_reader;
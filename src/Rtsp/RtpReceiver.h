@@ -13,7 +13,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <memory>
+#include <limits>
+#include <algorithm>
 #include "Rtsp/Rtsp.h"
 #include "Extension/Frame.h"
 // for NtpStamp
@@ -22,12 +25,169 @@
 
 namespace mediakit {
 
+/**
+ * 以seq % capacity为下标的定长环形缓存，bitmap标记有效槽位，插入与删除均不分配内存
+ * Fixed-capacity ring buffer indexed by seq % capacity, a bitmap marks the valid slots, no memory allocation on insertion or deletion
+ */
+template<typename T, typename SEQ = uint16_t>
+class SeqRingBuffer {
+public:
+    static constexpr size_t npos = (size_t)-1;
+
+    /**
+     * 设置容量，向上取整为2的幂(最小64)，已有数据将按新容量重新排布
+     * Set the capacity, rounded up to a power of 2 (minimum 64), existing data will be rearranged according to the new capacity
+     */
+    void setCapacity(size_t capacity) {
+        size_t size = 64;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        if (size == _slots.size()) {
+            return;
+        }
+        SeqRingBuffer ring;
+        ring._slots.resize(size);
+        ring._seqs.resize(size);
+        ring._bitmap.resize(size >> 6);
+        forEach([&](size_t index) { ring.emplace(_seqs[index], take(index), false); });
+        *this = std::move(ring);
+    }
+
+    size_t capacity() const { return _slots.size(); }
+    size_t size() const { return _size; }
+    bool empty() const { return !_size; }
+
+    /**
+     * 插入数据
+     * @param overwrite 槽位被其他seq占用时是否覆盖之，相同seq总是保留先插入的数据
+     * @return 是否插入成功
+     * Insert data
+     * @param overwrite Whether to overwrite the slot occupied by another seq, the first inserted data is always kept for the same seq
+     * @return Whether the insertion is successful
+     */
+    bool emplace(SEQ seq, T packet, bool overwrite) {
+        auto index = seq & (_slots.size() - 1);
+        if (test(index)) {
+            if (!overwrite || _seqs[index] == seq) {
+                return false;
+            }
+        } else {
+            _bitmap[index >> 6] |= (uint64_t)1 << (index & 63);
+            ++_size;
+        }
+        _seqs[index] = seq;
+        _slots[index] = std::move(packet);
+        return true;
+    }
+
+    /**
+     * 查找seq所在槽位，不存在时返回npos
+     * Find the slot of seq, return npos if it does not exist
+     */
+    size_t find(SEQ seq) const {
+        auto index = seq & (_slots.size() - 1);
+        return test(index) && _seqs[index] == seq ? index : npos;
+    }
+
+    /**
+     * 从seq对应槽位开始环形查找第一个有效槽位，为空时返回npos
+     * Circularly find the first valid slot starting from the slot of seq, return npos if empty
+     */
+    size_t findNext(SEQ seq) const {
+        if (!_size) {
+            return npos;
+        }
+        auto start = seq & (_slots.size() - 1);
+        auto mask = _bitmap.size() - 1;
+        auto word = start >> 6;
+        auto bits = _bitmap[word] & (~(uint64_t)0 << (start & 63));
+        // 多扫描一次起始word，覆盖其低位部分
+        // Scan the starting word once more to cover its low bits
+        for (size_t i = 0; i <= _bitmap.size(); ++i) {
+            if (bits) {
+                return (word << 6) + ctz(bits);
+            }
+            word = (word + 1) & mask;
+            bits = _bitmap[word];
+        }
+        return npos;
+    }
+
+    SEQ seqAt(size_t index) const { return _seqs[index]; }
+    T &at(size_t index) { return _slots[index]; }
+
+    /**
+     * 取出槽位数据并释放该槽位
+     * Take out the slot data and release the slot
+     */
+    T take(size_t index) {
+        _bitmap[index >> 6] &= ~((uint64_t)1 << (index & 63));
+        --_size;
+        T ret = std::move(_slots[index]);
+        _slots[index] = T();
+        return ret;
+    }
+
+    template<typename FUNC>
+    void forEach(FUNC &&func) const {
+        for (size_t word = 0; word < _bitmap.size() && _size; ++word) {
+            auto bits = _bitmap[word];
+            while (bits) {
+                auto index = (word << 6) + ctz(bits);
+                bits &= bits - 1;
+                func(index);
+            }
+        }
+    }
+
+    template<typename FUNC>
+    void eraseIf(FUNC &&func) {
+        forEach([&](size_t index) {
+            if (func(_seqs[index])) {
+                take(index);
+            }
+        });
+    }
+
+    void clear() {
+        if (!_size) {
+            return;
+        }
+        forEach([&](size_t index) { _slots[index] = T(); });
+        std::fill(_bitmap.begin(), _bitmap.end(), 0);
+        _size = 0;
+    }
+
+private:
+    bool test(size_t index) const { return _bitmap[index >> 6] & ((uint64_t)1 << (index & 63)); }
+
+    static size_t ctz(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(bits);
+#else
+        size_t ret = 0;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            ++ret;
+        }
+        return ret;
+#endif
+    }
+
+private:
+    size_t _size = 0;
+    std::vector<T> _slots;
+    std::vector<SEQ> _seqs;
+    std::vector<uint64_t> _bitmap;
+};
+
 template<typename T, typename SEQ = uint16_t>
 class PacketSortor {
 public:
     static constexpr SEQ SEQ_MAX = (std::numeric_limits<SEQ>::max)();
-    using iterator = typename std::map<SEQ, T>::iterator;
 
+    PacketSortor() { setCapacity(); }
     virtual ~PacketSortor() = default;
 
     void setOnSort(std::function<void(SEQ seq, T packet)> cb) { _cb = std::move(cb); }
@@ -41,7 +201,8 @@ public:
     void clear() {
         _started = false;
         _ticker.resetTime();
-        _pkt_sort_cache_map.clear();
+        _pkt_sort_cache.clear();
+        _pkt_drop_cache.clear();
     }
 
     /**
@@ -50,7 +211,7 @@ public:
      
      * [AUTO-TRANSLATED:8e05a703]
      */
-    size_t getJitterSize() const { return _pkt_sort_cache_map.size(); }
+    size_t getJitterSize() const { return _pkt_sort_cache.size(); }
 
     /**
      * 输入并排序
@@ -77,36 +238,62 @@ public:
             // 清空连续包列表  [AUTO-TRANSLATED:fdaafd3b]
             // Clear the continuous packet list
             flushPacket();
-            _pkt_drop_cache_map.clear();
+            _pkt_drop_cache.clear();
             return;
         }
 
         if (seq < _next_seq && !mayLooped(_next_seq, seq)) {
             // 无回环风险, 缓存seq回退包  [AUTO-TRANSLATED:4200dd1b]
             // No loop risk, cache seq rollback packets
-            _pkt_drop_cache_map.emplace(seq, std::move(packet));
-            if (_pkt_drop_cache_map.size() > _max_distance || _ticker.elapsedTime() > _max_buffer_ms) {
+            _pkt_drop_cache.emplace(seq, std::move(packet), true);
+            if (_pkt_drop_cache.size() > _max_distance || _ticker.elapsedTime() > _max_buffer_ms) {
                 // seq回退包太多，可能源端重置seq计数器，这部分数据需要输出  [AUTO-TRANSLATED:d31aead7]
                 // Too many seq rollback packets, the source may reset the seq counter, this part of data needs to be output
-                forceFlush(_next_seq);
+                forceFlush();
                 // 旧的seq计数器的数据清空后把新seq计数器的数据赋值给排序列队  [AUTO-TRANSLATED:f69f864c]
                 // After clearing the data of the old seq counter, assign the data of the new seq counter to the sorting queue
-                _pkt_sort_cache_map = std::move(_pkt_drop_cache_map);
-                popIterator(_pkt_sort_cache_map.begin());
+                std::swap(_pkt_sort_cache, _pkt_drop_cache);
+                _pkt_drop_cache.clear();
+                popMinSeq();
             }
             return;
         }
-        _pkt_sort_cache_map.emplace(seq, std::move(packet));
 
-        if (needForceFlush(seq)) {
-            forceFlush(_next_seq);
+        if (isAhead(seq)) {
+            _pkt_sort_cache.emplace(seq, std::move(packet), false);
+            if (needForceFlush(seq)) {
+                forceFlush();
+            }
+            return;
         }
+
+        if (distance(seq) <= _max_distance) {
+            // 回环附近的迟到包，next_seq已越过它，无法再按序输出，丢弃之
+            // Late packet near the loop, next_seq has passed it and it can no longer be output in order, discard it
+            return;
+        }
+
+        // seq跳跃太大，先输出已缓存的包
+        // The seq jump is too large, output the cached packets first
+        if (!_pkt_sort_cache.empty()) {
+            forceFlush();
+            if (!isAhead(seq) || distance(seq) > _max_distance) {
+                // 距离next_seq太大的包，丢弃之
+                // Packets that are too far away from next_seq are discarded
+                return;
+            }
+            _pkt_sort_cache.emplace(seq, std::move(packet), false);
+            return;
+        }
+        // 丢包无法恢复，把这个包当做next_seq
+        // Packet loss cannot be recovered, treat this packet as next_seq
+        output(seq, std::move(packet));
     }
 
     void flush() {
-        if (!_pkt_sort_cache_map.empty()) {
-            forceFlush(_next_seq);
-            _pkt_sort_cache_map.clear();
+        if (!_pkt_sort_cache.empty()) {
+            forceFlush();
+            _pkt_sort_cache.clear();
         }
     }
 
@@ -114,9 +301,18 @@ public:
         _max_buffer_size = max_buffer_size;
         _max_buffer_ms = max_buffer_ms;
         _max_distance = max_distance;
+        setCapacity();
     }
 
 private:
+    void setCapacity() {
+        // 距离next_seq超过_max_distance的包会被删除，所以环形缓存只需容纳_max_distance个seq
+        // Packets more than _max_distance away from next_seq will be deleted, so the ring buffer only needs to hold _max_distance seqs
+        auto capacity = (std::min<size_t>)(_max_distance + 1, (size_t)SEQ_MAX + 1);
+        _pkt_sort_cache.setCapacity(capacity);
+        _pkt_drop_cache.setCapacity(capacity);
+    }
+
     SEQ distance(SEQ seq) {
         SEQ ret;
         if (seq > _next_seq) {
@@ -130,79 +326,83 @@ private:
         return ret;
     }
 
+    // seq是否在next_seq之后且在环形缓存可容纳的范围内
+    // Whether seq is after next_seq and within the range that the ring buffer can hold
+    bool isAhead(SEQ seq) {
+        SEQ ahead = seq - _next_seq;
+        return ahead && ahead <= (SEQ_MAX >> 1) && ahead < _pkt_sort_cache.capacity();
+    }
+
     bool needForceFlush(SEQ seq) {
-        return _pkt_sort_cache_map.size() > _max_buffer_size || distance(seq) > _max_distance || _ticker.elapsedTime() > _max_buffer_ms;
+        // 排序缓存只保留距离next_seq不超过_max_distance的包，最多_max_distance个，
+        // 所以个数限制仅在_max_buffer_size小于_max_distance时生效，否则由距离限制兜底
+        // The sorting cache only keeps packets no more than _max_distance away from next_seq, at most _max_distance of them,
+        // so the count limit only takes effect when _max_buffer_size is less than _max_distance, otherwise the distance limit applies
+        return _pkt_sort_cache.size() > _max_buffer_size || distance(seq) > _max_distance || _ticker.elapsedTime() > _max_buffer_ms;
     }
 
-    void forceFlush(SEQ next_seq) {
-        if (_pkt_sort_cache_map.empty()) {
+    void forceFlush() {
+        // 排序缓存中的seq都在next_seq之后，从next_seq开始环形查找即得到最近的seq
+        // The seqs in the sorting cache are all after next_seq, circularly search from next_seq to get the nearest seq
+        auto index = _pkt_sort_cache.findNext(_next_seq);
+        if (index == _pkt_sort_cache.npos) {
             return;
         }
-        // 寻找距离比next_seq大的最近的seq  [AUTO-TRANSLATED:d2de6f5b]
-        // Find the nearest seq that is greater than next_seq
-        auto it = _pkt_sort_cache_map.lower_bound(next_seq);
-        if (it == _pkt_sort_cache_map.end()) {
-            // 没有比next_seq更大的seq，应该是回环时丢包导致  [AUTO-TRANSLATED:d0d6970b]
-            // There is no seq greater than next_seq, it should be caused by packet loss during loopback
-            it = _pkt_sort_cache_map.begin();
-        }
         // 丢包无法恢复，把这个包当做next_seq  [AUTO-TRANSLATED:2d8c0b9e]
         // Packet loss cannot be recovered, treat this packet as next_seq
-        popIterator(it);
+        popIndex(index);
         // 清空连续包列表  [AUTO-TRANSLATED:fdaafd3b]
         // Clear the continuous packet list
         flushPacket();
         // 删除距离next_seq太大的包  [AUTO-TRANSLATED:9e774c5e]
         // Delete packets that are too far away from next_seq
-        for (auto it = _pkt_sort_cache_map.begin(); it != _pkt_sort_cache_map.end();) {
-            if (distance(it->first) > _max_distance) {
-                it = _pkt_sort_cache_map.erase(it);
-            } else {
-                ++it;
+        _pkt_sort_cache.eraseIf([this](SEQ seq) { return distance(seq) > _max_distance; });
+    }
+
+    void popMinSeq() {
+        // 从回退包中取出最小的seq作为新的next_seq
+        // Take out the smallest seq from the rollback packets as the new next_seq
+        size_t min_index = _pkt_sort_cache.npos;
+        _pkt_sort_cache.forEach([&](size_t index) {
+            if (min_index == _pkt_sort_cache.npos || _pkt_sort_cache.seqAt(index) < _pkt_sort_cache.seqAt(min_index)) {
+                min_index = index;
             }
+        });
+        if (min_index == _pkt_sort_cache.npos) {
+            return;
         }
+        popIndex(min_index);
+        // 环形缓存只保留next_seq之后可容纳的包
+        // The ring buffer only keeps the packets after next_seq that it can hold
+        _pkt_sort_cache.eraseIf([this](SEQ seq) { return !isAhead(seq); });
     }
 
     bool mayLooped(SEQ last_seq, SEQ now_seq) { return last_seq > SEQ_MAX - _max_distance || now_seq < _max_distance; }
 
     void flushPacket() {
-        if (_pkt_sort_cache_map.empty()) {
-            return;
-        }
-        auto it = _pkt_sort_cache_map.lower_bound(_next_seq);
-        if (!mayLooped(_next_seq, _next_seq)) {
-            // 无回环风险, 清空 < next_seq的值  [AUTO-TRANSLATED:10c77bf9]
-            // No loop risk, clear values less than next_seq
-            it = _pkt_sort_cache_map.erase(_pkt_sort_cache_map.begin(), it);
-        }
-
-        while (it != _pkt_sort_cache_map.end()) {
+        while (!_pkt_sort_cache.empty()) {
             // 找到下一个包  [AUTO-TRANSLATED:8e20ab9f]
             // Find the next packet
-            if (it->first == _next_seq) {
-                it = popIterator(it);
-                continue;
+            auto index = _pkt_sort_cache.find(_next_seq);
+            if (index == _pkt_sort_cache.npos) {
+                break;
             }
-            break;
+            popIndex(index);
         }
     }
 
-    iterator popIterator(iterator it) {
-        try {
-            output(it->first, std::move(it->second));
-            return _pkt_sort_cache_map.erase(it);
-        } catch (...) {
-            // 防止抛异常未移除迭代器，导致rtp包为空
-            _pkt_sort_cache_map.erase(it);
-            throw;
-        }
+    void popIndex(size_t index) {
+        // 先移除再输出，防止抛异常时未移除导致rtp包为空
+        // Remove first and then output, to prevent the rtp packet from being empty when an exception is thrown without removal
+        auto seq = _pkt_sort_cache.seqAt(index);
+        output(seq, _pkt_sort_cache.take(index));
     }
 
     void output(SEQ seq, T packet) {
         if (seq != _next_seq) {
             WarnL << "packet dropped: " << _next_seq << " -> " << static_cast<SEQ>(seq - 1)
                   << ", latest seq: " << _latest_seq
-                  << ", jitter buffer size: " << _pkt_sort_cache_map.size()
+                  << ", jitter buffer size: " << _pkt_sort_cache.size()
                   << ", jitter buffer ms: " << _ticker.elapsedTime();
         }
         _next_seq = static_cast<SEQ>(seq + 1);
@@ -217,6 +417,8 @@ private:
     size_t _max_buffer_ms = 1000;
     // 排序缓存最大保存数据个数  [AUTO-TRANSLATED:9cfa91b4]
     // Maximum number of data in sorting cache
+    // 实际上限为min(_max_buffer_size, _max_distance)
+    // The actual limit is min(_max_buffer_size, _max_distance)
     size_t _max_buffer_size = 1024;
     // seq最大跳跃距离  [AUTO-TRANSLATED:bb663e41]
     // Maximum seq jump distance
@@ -232,10 +434,10 @@ private:
     SEQ _next_seq = 0;
     // pkt排序缓存，根据seq排序  [AUTO-TRANSLATED:3787f9a6]
     // pkt sorting cache, sorted by seq
-    std::map<SEQ, T> _pkt_sort_cache_map;
+    SeqRingBuffer<T, SEQ> _pkt_sort_cache;
     // 预丢弃包列表  [AUTO-TRANSLATED:67e57ebc]
     // Pre-discard packet list
-    std::map<SEQ, T> _pkt_drop_cache_map;
+    SeqRingBuffer<T, SEQ> _pkt_drop_cache;
     // 回调  [AUTO-TRANSLATED:03bad27d]
     // Callback
     std::function<void(SEQ seq, T packet)> _cb;
@@ -1,6 +1,10 @@
 ﻿#include "RtspMediaSourceImp.h"
 #include "RtspDemuxer.h"
 #include "Common/config.h"
+#include "Codec/Transcode.h"
+
+using namespace toolkit;
+
 namespace mediakit {
 void RtspMediaSource::setSdp(const std::string &sdp) {
     SdpParser sdp_parser(sdp);
@@ -90,15 +94,99 @@ void RtspMediaSourceImp::setProtocolOption(const ProtocolOption &option)
     MediaSource::setListener(_muxer);
 
     for (auto &track : _demuxer->getTracks(false)) {
-        _muxer->addTrack(track);
+        addMuxerTrack(track);
+    }
+}
+
+#if defined(ENABLE_FFMPEG)
+/**
+ * 转协议前的音频转码，复用器不是线程安全的，转码结果需切回输入帧所在的源流线程再输入复用器
+ * Audio transcoding before protocol conversion, the muxer is not thread safe,
+ * the transcoding result needs to be switched back to the source stream thread of the input frame before being input to the muxer
+ */
+class RtspMediaSourceImp::AudioTranscode {
+public:
+    AudioTranscode(const Track::Ptr &track, CodecId codec, const std::string &name) {
+        _transcoder = TaskManager::create<FFmpegAudioTranscoder>(track, codec);
+        _transcoder->setTaskName(name);
+        _track = _transcoder->getTrack();
+        _track->setIndex(track->getIndex());
+        std::weak_ptr<Track> weak_track = _track;
+        _transcoder->setOnOutput([this, weak_track](const Frame::Ptr &frame) {
+            EventPoller::Ptr poller;
+            {
+                std::lock_guard<std::mutex> lck(_mtx);
+                poller = _poller;
+            }
+            auto output = [weak_track, frame]() {
+                if (auto track = weak_track.lock()) {
+                    track->inputFrame(frame);
+                }
+            };
+            if (poller) {
+                poller->async(output, false);
+            } else {
+                output();
+            }
+        });
+    }
+
+    bool inputFrame(const Frame::Ptr &frame) {
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            _poller = EventPoller::getCurrentPoller();
+        }
+        return _transcoder->inputFrame(frame);
+    }
+
+    const Track::Ptr &getTrack() const { return _track; }
+
+private:
+    std::mutex _mtx;
+    EventPoller::Ptr _poller;
+    Track::Ptr _track;
+    // 最先析构，停止转码后其他成员才能释放
+    // Destroyed first, other members can be released only after the transcoding is stopped
+    FFmpegAudioTranscoder::Ptr _transcoder;
+};
+#endif // ENABLE_FFMPEG
+
+bool RtspMediaSourceImp::addMuxerTrack(const Track::Ptr &track) {
+#if defined(ENABLE_FFMPEG)
+    if (track->getTrackType() == TrackAudio && _transcode_to != CodecInvalid && track->getCodecId() == _transcode_from) {
+        try {
+            auto transcode = std::make_shared<AudioTranscode>(track, _transcode_to, getMediaTuple().shortUrl());
+            if (!_muxer->addTrack(transcode->getTrack())) {
+                return false;
+            }
+            transcode->getTrack()->addDelegate(_muxer);
+            std::weak_ptr<AudioTranscode> weak_transcode = transcode;
+            track->addDelegate([weak_transcode](const Frame::Ptr &frame) {
+                auto transcode = weak_transcode.lock();
+                return transcode ? transcode->inputFrame(frame) : false;
+            });
+            _audio_transcode = std::move(transcode);
+            InfoL << "transcode audio " << track->getCodecName() << " -> " << getCodecName(_transcode_to) << " for protocol conversion: " << getMediaTuple().shortUrl();
+            return true;
+        } catch (std::exception &ex) {
+            // 转码失败时按原格式转协议
+            // Convert protocols in the original format when transcoding fails
+            WarnL << "create audio transcoder failed, use the original audio: " << ex.what();
+        }
+    }
+#endif
+    if (_muxer->addTrack(track)) {
         track->addDelegate(_muxer);
+        return true;
     }
+    return false;
 }
 
 RtspMediaSource::Ptr RtspMediaSourceImp::clone(const std::string &stream) {
     auto tuple = _tuple;
     tuple.stream = stream;
     auto src_imp = std::make_shared<RtspMediaSourceImp>(tuple);
+    src_imp->setAudioTranscode(_transcode_from, _transcode_to);
     src_imp->setSdp(getSdp());
     src_imp->setProtocolOption(getProtocolOption());
     return src_imp;
@@ -75,6 +75,18 @@ public:
         return _option;
     }
 
+    /**
+     * 设置转协议时的音频转码，from格式的音频转码为to格式后再输入复用器(需开启ffmpeg)，rtsp直接代理的rtp不受影响
+     * 需在添加track前设置
+     * Set the audio transcoding when converting protocols, the audio of the from format is transcoded to the to format before being input
+     * to the muxer (ffmpeg required), the rtp of rtsp direct proxy is not affected
+     * Must be set before adding tracks
+     */
+    void setAudioTranscode(CodecId from, CodecId to) {
+        _transcode_from = from;
+        _transcode_to = to;
+    }
+
     /**
      * _demuxer触发的添加Track事件
      * _demuxer triggered add Track event
@@ -82,13 +94,7 @@ public:
      * [AUTO-TRANSLATED:80dbcf16]
      */
     bool addTrack(const Track::Ptr &track) override {
-        if (_muxer) {
-            if (_muxer->addTrack(track)) {
-                track->addDelegate(_muxer);
-                return true;
-            }
-        }
-        return false;
+        return _muxer ? addMuxerTrack(track) : false;
     }
 
     /**
@@ -140,8 +146,17 @@ public:
     }
 
     RtspMediaSource::Ptr clone(const std::string& stream) override;
+
 private:
+    bool addMuxerTrack(const Track::Ptr &track);
+
+private:
+    class AudioTranscode;
+
     bool _all_track_ready = false;
+    CodecId _transcode_from = CodecInvalid;
+    CodecId _transcode_to = CodecInvalid;
+    std::shared_ptr<AudioTranscode> _audio_transcode;
     ProtocolOption _option;
     RtspDemuxer::Ptr _demuxer;
     MultiMediaSourceMuxer::Ptr _muxer;
@@ -735,6 +735,7 @@ void RtspSession::handleReq_Setup(const Parser &parser) {
 
         _rtp_socks[trackIdx] = pr.first;
         _rtcp_socks[trackIdx] = pr.second;
+        _rtp_senders[trackIdx] = std::make_shared<UdpBatchSender>(pr.first);
 
         //设置客户端内网端口信息
         string strClientPort = findSubString(parser["Transport"].data(), "client_port=", NULL);
@@ -935,6 +936,7 @@ void RtspSession::handleReq_Play(const Parser &parser) {
     play_src->pause(false);
 
     setSocketFlags();
+    _latency.attach(*play_src);
 
     if (!_play_reader && _rtp_type != Rtsp::RTP_MULTICAST) {
         weak_ptr<RtspSession> weak_self = static_pointer_cast<RtspSession>(shared_from_this());
@@ -1077,6 +1079,9 @@ void RtspSession::onRcvPeerUdpData(int interleaved, const Buffer::Ptr &buf, cons
             if (_rtp_socks[interleaved / 2]) {
                 _rtp_socks[interleaved / 2]->bindPeerAddr((struct sockaddr *)&addr);
             }
+            if (_rtp_senders[interleaved / 2]) {
+                _rtp_senders[interleaved / 2]->resetPeerAddr();
+            }
         }
     } else {
         //rtcp包
@@ -1339,24 +1344,26 @@ void RtspSession::sendRtpPacket(const RtspMediaSource::RingDataType &pkt) {
             break;
         case Rtsp::RTP_UDP: {
             //下标0表示视频，1表示音频
-            Socket::Ptr rtp_socks[2];
-            rtp_socks[TrackVideo] = _rtp_socks[getTrackIndexByTrackType(TrackVideo)];
-            rtp_socks[TrackAudio] = _rtp_socks[getTrackIndexByTrackType(TrackAudio)];
+            UdpBatchSender::Ptr rtp_senders[2];
+            rtp_senders[TrackVideo] = _rtp_senders[getTrackIndexByTrackType(TrackVideo)];
+            rtp_senders[TrackAudio] = _rtp_senders[getTrackIndexByTrackType(TrackAudio)];
             pkt->for_each([&](const RtpPacket::Ptr &rtp) {
                 if (_target_play_track == TrackInvalid || _target_play_track == rtp->type) {
                     updateRtcpContext(rtp);
-                    auto &sock = rtp_socks[rtp->type];
-                    if (!sock) {
+                    auto &sender = rtp_senders[rtp->type];
+                    if (!sender) {
                         shutdown(SockException(Err_shutdown, "udp sock not opened yet"));
                         return;
                     }
                     _bytes_usage += rtp->size() - RtpPacket::kRtpTcpHeaderSize;
-                    sock->send(std::make_shared<BufferRtp>(rtp, RtpPacket::kRtpTcpHeaderSize), nullptr, 0, false);
+                    sender->send(std::make_shared<BufferRtp>(rtp, RtpPacket::kRtpTcpHeaderSize));
                 }
             });
-            for (auto &sock : rtp_socks) {
-                if (sock) {
-                    sock->flushAll();
+            // 批量发送，减少系统调用次数
+            // Send in batch to reduce the number of system calls
+            for (auto &sender : rtp_senders) {
+                if (sender) {
+                    sender->flush();
                 }
             }
         }
@@ -1364,6 +1371,10 @@ void RtspSession::sendRtpPacket(const RtspMediaSource::RingDataType &pkt) {
         default:
             break;
     }
+    if (!pkt->empty()) {
+        auto &rtp = pkt->back();
+        _latency.onSendRtp(rtp->type, rtp->getStamp(), rtp->sample_rate);
+    }
 }
 
 void RtspSession::setSocketFlags(){
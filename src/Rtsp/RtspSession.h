@@ -21,6 +21,8 @@
 #include "RtspMediaSource.h"
 #include "RtspMediaSourceImp.h"
 #include "RtpMultiCaster.h"
+#include "Common/UdpBatchSender.h"
+#include "Common/LatencyStat.h"
 
 namespace mediakit {
 
@@ -242,6 +244,9 @@ private:
     // 直播源读取器  [AUTO-TRANSLATED:e1edc193]
     // Live source reader
     RtspMediaSource::RingType::RingReader::Ptr _play_reader;
+    // 播放延迟统计
+    // Playback latency statistics
+    LatencyRecorder _latency { "rtsp" };
     // sdp里面有效的track,包含音频或视频  [AUTO-TRANSLATED:64e2fcdf]
     // Valid track in SDP, including audio or video
     std::vector<SdpTrack::Ptr> _sdp_track;
@@ -256,6 +261,9 @@ private:
     // RTCP端口,trackid idx 为数组下标  [AUTO-TRANSLATED:446a7861]
     // RTCP port, trackid idx is the array index
     toolkit::Socket::Ptr _rtcp_socks[2];
+    // RTP批量发送器,trackid idx 为数组下标
+    // RTP batch sender, trackid idx is the array index
+    UdpBatchSender::Ptr _rtp_senders[2];
     // 标记是否收到播放的udp打洞包,收到播放的udp打洞包后才能知道其外网udp端口号  [AUTO-TRANSLATED:ad039c25]
     // Flag whether the UDP hole punching packet for playback has been received. The external UDP port number can only be known after receiving the UDP hole punching packet for playback.
     std::unordered_set<int> _udp_connected_flags;
@@ -16,12 +16,13 @@
 
 namespace mediakit {
 
-class TSMediaSourceMuxer final : public MpegMuxer, public MediaSourceEventInterceptor,
+class TSMediaSourceMuxer final : public MpegMuxer, public SharedMuxer, public MediaSourceEventInterceptor,
                                  public std::enable_shared_from_this<TSMediaSourceMuxer> {
 public:
     using Ptr = std::shared_ptr<TSMediaSourceMuxer>;
 
     TSMediaSourceMuxer(const MediaTuple& tuple, const ProtocolOption &option) : MpegMuxer(false) {
+        _tuple = tuple;
         _option = option;
         _media_src = std::make_shared<TSMediaSource>(tuple);
     }
@@ -36,11 +37,39 @@ public:
 
     void setListener(const std::weak_ptr<MediaSourceEvent> &listener){
         setDelegate(listener);
-        _media_src->setListener(shared_from_this());
+        if (_media_src) {
+            _media_src->setListener(shared_from_this());
+        }
     }
 
     int readerCount() const{
-        return _media_src->readerCount();
+        return _media_src ? _media_src->readerCount() : 0;
+    }
+
+    /**
+     * 关闭http-ts/ws-ts：释放TSMediaSource(注销并断开其播放器)，复用器继续为共享消费者(hls)复用
+     * Stop http-ts/ws-ts: release the TSMediaSource (unregister it and disconnect its players), the muxer keeps muxing for the sharing consumers (hls)
+     */
+    void detachMediaSource() {
+        _media_src = nullptr;
+    }
+
+    /**
+     * 重新开启http-ts/ws-ts，TSMediaSource在写入首个ts包时注册
+     * Restart http-ts/ws-ts, the TSMediaSource is registered when the first ts packet is written
+     */
+    void attachMediaSource() {
+        if (_media_src) {
+            return;
+        }
+        _enabled = true;
+        _clear_cache = false;
+        _media_src = std::make_shared<TSMediaSource>(_tuple);
+        _media_src->setListener(shared_from_this());
+    }
+
+    bool isMediaSourceAttached() const {
+        return _media_src.operator bool();
     }
 
     void onReaderChanged(MediaSource &sender, int size) override {
@@ -52,17 +81,25 @@ public:
     }
 
     bool inputFrame(const Frame::Ptr &frame) override {
+        if (!_media_src) {
+            return isSinkEnabled() ? MpegMuxer::inputFrame(frame) : false;
+        }
         if (_clear_cache && _option.ts_demand) {
             _clear_cache = false;
             _media_src->clearCache();
         }
-        if (_enabled || !_option.ts_demand) {
+        if (_enabled || !_option.ts_demand || isSinkEnabled()) {
             return MpegMuxer::inputFrame(frame);
         }
         return false;
     }
 
     bool isEnabled() {
+        if (!_media_src) {
+            // 共享消费者自己计入MultiMediaSourceMuxer::isEnabled
+            // The sharing consumers count themselves in MultiMediaSourceMuxer::isEnabled
+            return false;
+        }
         // 缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存  [AUTO-TRANSLATED:7cfd4d49]
         // Allow the inputFrame function to be triggered even when the cache is not yet cleared, so that the cache can be cleared in time.
         return _option.ts_demand ? (_clear_cache ? true : _enabled) : true;
@@ -74,7 +111,10 @@ public:
 
 protected:
     void onWrite(std::shared_ptr<toolkit::Buffer> buffer, uint64_t timestamp, bool key_pos) override {
-        if (!buffer) {
+        writeToSinks(buffer, timestamp, key_pos);
+        if (!buffer || !_media_src || (!_enabled && _option.ts_demand)) {
+            // 仅为共享消费者复用时，不写入TSMediaSource
+            // When muxing only for the sharing consumers, do not write into TSMediaSource
             return;
         }
         auto packet = std::make_shared<TSPacket>(std::move(buffer));
@@ -85,6 +125,7 @@ protected:
 private:
     bool _enabled = true;
     bool _clear_cache = false;
+    MediaTuple _tuple;
     ProtocolOption _option;
     TSMediaSource::Ptr _media_src;
 };
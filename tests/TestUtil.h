@@ -0,0 +1,39 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_TESTUTIL_H
+#define ZLMEDIAKIT_TESTUTIL_H
+
+#include <string>
+#include <stdexcept>
+
+namespace mediakit {
+namespace test {
+
+// 断言失败时抛异常，由测试程序的main函数捕获并返回失败
+// Throw an exception when the assertion fails, it is caught by the main function of the test program which then returns failure
+inline void expect(bool cond, const std::string &msg) {
+    if (!cond) {
+        throw std::runtime_error(msg);
+    }
+}
+
+inline void expect(bool cond, const char *exp, const char *file, int line) {
+    if (!cond) {
+        expect(false, std::string(file) + ":" + std::to_string(line) + " check failed: " + exp);
+    }
+}
+
+} // namespace test
+} // namespace mediakit
+
+#define EXPECT(exp) ::mediakit::test::expect(!!(exp), #exp, __FILE__, __LINE__)
+
+#endif // ZLMEDIAKIT_TESTUTIL_H
@@ -0,0 +1,192 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include "FMP4/DashPackager.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+static string be32(uint32_t val) {
+    string ret(4, '\0');
+    for (int i = 0; i < 4; ++i) {
+        ret[i] = (char)(val >> (24 - 8 * i));
+    }
+    return ret;
+}
+
+static string box(const string &type, const string &payload) {
+    return be32((uint32_t)payload.size() + 8) + type + payload;
+}
+
+static string fullBox(const string &type, const string &payload) {
+    return box(type, be32(0) + payload);
+}
+
+/**
+ * 生成h264(track 1, timescale 90000) + aac(track 2, timescale 44100)的init segment
+ * Generate the init segment of h264 (track 1, timescale 90000) + aac (track 2, timescale 44100)
+ */
+static string makeInitSegment() {
+    auto trak = [](uint32_t track_id, uint32_t timescale, bool video) {
+        auto tkhd = fullBox("tkhd", be32(0) + be32(0) + be32(track_id) + string(60, '\0') + be32((video ? 1280 : 0) << 16) + be32((video ? 720 : 0) << 16));
+        auto mdhd = fullBox("mdhd", be32(0) + be32(0) + be32(timescale) + be32(0) + be32(0));
+        auto hdlr = fullBox("hdlr", be32(0) + (video ? "vide" : "soun") + string(12, '\0') + string(1, '\0'));
+        string entry;
+        if (video) {
+            entry = box("avc1", string(78, '\0') + box("avcC", string("\x01\x64\x00\x1f\xff", 5)));
+        } else {
+            // ES_Descriptor -> DecoderConfigDescriptor(mpeg4 audio) -> DecoderSpecificInfo(aac lc)
+            string dsi = string("\x05\x02\x12\x10", 4);
+            string dcd = string("\x04\x11\x40\x15", 4) + string(11, '\0') + dsi;
+            string esd = string("\x03\x19\x00\x01\x00", 5) + dcd + string("\x06\x01\x02", 3);
+            entry = box("mp4a", string(28, '\0') + fullBox("esds", esd));
+        }
+        auto stsd = fullBox("stsd", be32(1) + entry);
+        auto minf = box("minf", box("stbl", stsd));
+        return box("trak", tkhd + box("mdia", mdhd + hdlr + minf));
+    };
+    return box("ftyp", "isom" + be32(0)) + box("moov", fullBox("mvhd", string(96, '\0')) + trak(1, 90000, true) + trak(2, 44100, false));
+}
+
+/**
+ * 生成一个只含一个track的moof+mdat片段
+ * Generate a moof+mdat fragment containing only one track
+ */
+static string makeFragment(uint32_t track_id, uint64_t decode_time, const string &payload) {
+    auto tfdt = box("tfdt", string("\x01\x00\x00\x00", 4) + be32((uint32_t)(decode_time >> 32)) + be32((uint32_t)decode_time));
+    auto traf = box("traf", fullBox("tfhd", be32(track_id)) + tfdt + fullBox("trun", be32(1) + be32(payload.size())));
+    return box("moof", fullBox("mfhd", be32(1)) + traf) + box("mdat", payload);
+}
+
+/**
+ * 输入25fps视频，每25帧一个关键帧，视频时间戳从10秒开始
+ * Input 25fps video, one key frame every 25 frames, the video timestamp starts from 10 seconds
+ */
+static void inputFrames(DashPackager &dash, size_t start, size_t count) {
+    for (auto i = start; i < start + count; ++i) {
+        auto stamp = 10000 + i * 40;
+        dash.inputFragment(std::make_shared<BufferString>(makeFragment(1, stamp * 90, "v" + to_string(i))), stamp, i % 25 == 0);
+    }
+}
+
+static void testMpd() {
+    DashPackager dash(1, 3, false);
+    dash.setInitSegment(makeInitSegment());
+    bool ready = false;
+    dash.waitReady([&](bool flag) { ready = flag; });
+    inputFrames(dash, 3, 22);
+    // 等待首个关键帧，且尚无完整切片
+    // Wait for the first key frame, and there is no complete segment yet
+    EXPECT(!ready);
+    EXPECT(!dash.getSegment(1));
+    inputFrames(dash, 25, 26);
+    EXPECT(ready);
+
+    inputFrames(dash, 51, 100);
+    // 切片1~5为完整切片，切片6正在生成
+    // Segments 1~5 are complete, and segment 6 is being generated
+    auto segment = dash.getSegment(2);
+    EXPECT(segment);
+    EXPECT(segment->toString().find(makeFragment(1, (10000 + 50 * 40) * 90, "v50")) == 0);
+    EXPECT(!dash.getSegment(6));
+    EXPECT(!dash.readSegment(6, [](const Buffer::Ptr &) {}));
+
+    auto mpd = dash.makeMpd("test", "token=1&a=b");
+    EXPECT(mpd.find("type=\"dynamic\"") != string::npos);
+    EXPECT(mpd.find("codecs=\"avc1.64001F,mp4a.40.2\"") != string::npos);
+    EXPECT(mpd.find("width=\"1280\" height=\"720\"") != string::npos);
+    EXPECT(mpd.find("audioSamplingRate=\"44100\"") != string::npos);
+    EXPECT(mpd.find("timescale=\"90000\"") != string::npos);
+    EXPECT(mpd.find("initialization=\"test.live.init.m4s?token=1&amp;a=b\"") != string::npos);
+    EXPECT(mpd.find("media=\"test.live.$Number$.m4s?token=1&amp;a=b\"") != string::npos);
+    // 时间轴与tfdt一致，只列出最近3个完整切片
+    // The timeline is consistent with tfdt, only the latest 3 complete segments are listed
+    EXPECT(mpd.find("startNumber=\"3\"") != string::npos);
+    EXPECT(mpd.find("<S t=\"1170000\" d=\"90000\"/>") != string::npos);
+    EXPECT(mpd.find("<S t=\"1350000\" d=\"90000\"/>") != string::npos);
+    EXPECT(mpd.find("t=\"1080000\"") == string::npos);
+    EXPECT(mpd.find("t=\"1440000\"") == string::npos);
+    EXPECT(mpd.find("availabilityTimeOffset") == string::npos);
+}
+
+static void testLowLatency() {
+    DashPackager dash(1, 3, true);
+    dash.setInitSegment(makeInitSegment());
+    bool ready = false;
+    dash.waitReady([&](bool flag) { ready = flag; });
+    inputFrames(dash, 0, 10);
+    // 时间轴只列出完整切片，首个切片完成前不可播放
+    // The timeline only lists complete segments, it can not be played before the first segment is completed
+    EXPECT(!ready);
+
+    string current, next;
+    bool current_end = false, next_end = false;
+    auto reader = [](string &data, bool &end) {
+        return [&data, &end](const Buffer::Ptr &chunk) {
+            if (chunk) {
+                data.append(chunk->data(), chunk->size());
+            } else {
+                end = true;
+            }
+        };
+    };
+    EXPECT(dash.readSegment(1, reader(current, current_end)));
+    EXPECT(dash.readSegment(2, reader(next, next_end)));
+    EXPECT(!dash.readSegment(3, [](const Buffer::Ptr &) {}));
+    // 已生成的片段立即回调
+    // The generated fragments are called back immediately
+    EXPECT(current.find(makeFragment(1, 900000 + 9 * 3600, "v9")) != string::npos);
+    inputFrames(dash, 10, 20);
+    EXPECT(ready);
+    EXPECT(current_end && !next_end);
+    // 正在生成的切片2不在时间轴中，由availabilityTimeOffset提前开放
+    // Segment 2 being generated is not in the timeline, and is opened in advance by availabilityTimeOffset
+    auto mpd = dash.makeMpd("test", "");
+    EXPECT(mpd.find("availabilityTimeComplete=\"false\"") != string::npos);
+    EXPECT(mpd.find("startNumber=\"1\"") != string::npos);
+    EXPECT(mpd.find("<S t=\"900000\" d=\"90000\"/>") != string::npos);
+    EXPECT(mpd.find("t=\"990000\"") == string::npos);
+    EXPECT(mpd.find("<ServiceDescription") != string::npos);
+    EXPECT(current == dash.getSegment(1)->toString());
+    EXPECT(next.find(makeFragment(1, 900000 + 25 * 3600, "v25")) == 0);
+    dash.flush();
+    EXPECT(next_end);
+    EXPECT(next == dash.getSegment(2)->toString());
+}
+
+static void testSegmentName() {
+    uint64_t number;
+    EXPECT(DashPackager::parseSegmentName("/live/test.live.123.m4s", number));
+    EXPECT(number == 123);
+    EXPECT(!DashPackager::parseSegmentName("/live/test.live.init.m4s", number));
+    EXPECT(!DashPackager::parseSegmentName("/live/test.live..m4s", number));
+    EXPECT(!DashPackager::parseSegmentName("/live/test.12.m4s", number));
+    EXPECT(!DashPackager::parseSegmentName("/live/test.live.12.mp4", number));
+}
+
+// 该测试程序用于验证dash切片、mpd时间轴与低延迟分块读取
+// This test program is used to verify dash segments, mpd timeline and low-latency chunked reading
+int main(int argc, char *argv[]) {
+    try {
+        testMpd();
+        testLowLatency();
+        testSegmentName();
+        cout << "test_dash passed" << endl;
+        return 0;
+    } catch (const exception &ex) {
+        cerr << "test_dash failed: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
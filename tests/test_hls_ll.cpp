@@ -0,0 +1,173 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <map>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include "Record/HlsMaker.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace mediakit;
+
+/**
+ * 记录HlsMaker所有回调的实现，切片与部分切片均保存在内存中
+ * An implementation recording all callbacks of HlsMaker, segments and partial segments are kept in memory
+ */
+class HlsMakerTest : public HlsMaker {
+public:
+    using HlsMaker::HlsMaker;
+
+    void finish() { flushLastSegment(true); }
+
+    std::map<uint64_t, string> segments;
+    std::map<pair<uint64_t, uint32_t>, string> parts;
+    string index;
+    string delta_index;
+    uint64_t hint_msn = 0;
+    uint32_t hint_part = 0;
+
+protected:
+    string onOpenSegment(uint64_t index) override {
+        _cur = index;
+        return "seg_" + to_string(index) + ".ts";
+    }
+    void onDelSegment(uint64_t index) override { segments.erase(index); }
+    void onWriteInitSegment(const char *data, size_t len) override {}
+    void onWriteSegment(const char *data, size_t len) override { segments[_cur].append(data, len); }
+    void onWriteHls(const string &data, bool include_delay) override {}
+    void onWritePart(uint64_t msn, uint32_t part, string data) override { parts[make_pair(msn, part)] = std::move(data); }
+    void onDelPart(uint64_t msn) override {
+        for (auto it = parts.begin(); it != parts.end();) {
+            it = it->first.first <= msn ? parts.erase(it) : std::next(it);
+        }
+    }
+    void onWriteLowLatencyHls(const string &index, const string &delta_index, uint64_t msn, uint32_t part) override {
+        this->index = index;
+        this->delta_index = delta_index;
+        hint_msn = msn;
+        hint_part = part;
+    }
+
+private:
+    uint64_t _cur = 0;
+};
+
+/**
+ * 输入25fps视频，每50帧一个关键帧，每帧后跟一个音频包
+ * Input 25fps video, one key frame every 50 frames, each frame followed by an audio packet
+ */
+static void inputFrames(HlsMakerTest &maker, size_t start, size_t count) {
+    for (auto i = start; i < start + count; ++i) {
+        auto stamp = i * 40;
+        auto video = "v" + to_string(i) + ";";
+        auto audio = "a" + to_string(i) + ";";
+        maker.inputData(video.data(), video.size(), stamp, i % 50 == 0);
+        maker.inputData(audio.data(), audio.size(), stamp, false);
+    }
+}
+
+static void testParts() {
+    HlsMakerTest maker(false, 2, 3, false, 0.2f);
+    EXPECT(maker.isLowLatency());
+    // 3个完整切片加正在生成的切片中的4个部分切片
+    // 3 complete segments plus 4 partial segments of the segment being generated
+    inputFrames(maker, 0, 50 * 3 + 22);
+    EXPECT(maker.hint_msn == 3);
+    EXPECT(maker.hint_part == 4);
+
+    // 每个切片由10个200ms的部分切片组成，拼接后与切片内容一致
+    // Each segment consists of 10 partial segments of 200ms, which are the same as the segment content after splicing
+    for (uint64_t msn = 1; msn < 3; ++msn) {
+        string joined;
+        for (uint32_t part = 0; part < 10; ++part) {
+            auto it = maker.parts.find(make_pair(msn, part));
+            EXPECT(it != maker.parts.end());
+            joined += it->second;
+        }
+        EXPECT(maker.parts.find(make_pair(msn, 10)) == maker.parts.end());
+        EXPECT(joined == maker.segments[msn]);
+    }
+    // 只保留最近3个切片的部分切片
+    // Only the partial segments of the latest 3 segments are kept
+    EXPECT(maker.parts.find(make_pair(0, 0)) == maker.parts.end());
+    EXPECT(maker.parts.find(make_pair(1, 0)) != maker.parts.end());
+
+    auto &index = maker.index;
+    EXPECT(index.find("#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=0.6,CAN-SKIP-UNTIL=12\n") != string::npos);
+    EXPECT(index.find("#EXT-X-PART-INF:PART-TARGET=0.2\n") != string::npos);
+    EXPECT(index.find("#EXT-X-MEDIA-SEQUENCE:0\n") != string::npos);
+    EXPECT(index.find("#EXT-X-PART:DURATION=0.2,URI=\"part_1_0.ts\",INDEPENDENT=YES\n") != string::npos);
+    EXPECT(index.find("#EXT-X-PART:DURATION=0.2,URI=\"part_1_1.ts\"\n") != string::npos);
+    EXPECT(index.find("#EXT-X-PART:DURATION=0.2,URI=\"part_3_3.ts\"\n") != string::npos);
+    EXPECT(index.find("part_0_0.ts") == string::npos);
+    // 部分切片位于所属切片的EXTINF之前
+    // Partial segments are located before the EXTINF of their parent segment
+    EXPECT(index.find("part_2_9.ts") < index.find("seg_2.ts"));
+    EXPECT(index.find("seg_2.ts") < index.find("part_3_0.ts"));
+    EXPECT(index.rfind("#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part_3_4.ts\"\n") + strlen("#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part_3_4.ts\"\n") == index.size());
+    // 总时长不足CAN-SKIP-UNTIL，无增量m3u8
+    // The total duration is less than CAN-SKIP-UNTIL, no delta m3u8
+    EXPECT(maker.delta_index.empty());
+
+    // 结束后不再有预加载提示
+    // No more preload hint after the end
+    maker.finish();
+    EXPECT(maker.index.find("#EXT-X-PRELOAD-HINT") == string::npos);
+    EXPECT(maker.index.find("#EXT-X-ENDLIST") != string::npos);
+    EXPECT(maker.index.find("part_3_4.ts") != string::npos);
+}
+
+static void testDelta() {
+    HlsMakerTest maker(true, 2, 10, false, 0.5f);
+    inputFrames(maker, 0, 50 * 11 + 10);
+    EXPECT(maker.hint_msn == 11);
+    EXPECT(maker.index.find("#EXT-X-VERSION:9\n") != string::npos);
+    EXPECT(maker.index.find("#EXT-X-MAP:URI=\"init.mp4\"\n") != string::npos);
+    EXPECT(maker.index.find("#EXT-X-MEDIA-SEQUENCE:1\n") != string::npos);
+    EXPECT(maker.index.find("part_11_0.m4s") != string::npos);
+    // 10个2秒切片，其后时长不少于12秒的切片(1~4)可被跳过
+    // 10 segments of 2 seconds, the segments (1~4) followed by no less than 12 seconds can be skipped
+    auto &delta = maker.delta_index;
+    EXPECT(delta.find("#EXT-X-SKIP:SKIPPED-SEGMENTS=4\n") != string::npos);
+    EXPECT(delta.find("#EXT-X-MEDIA-SEQUENCE:1\n") != string::npos);
+    EXPECT(delta.find("seg_4.ts") == string::npos);
+    EXPECT(delta.find("seg_5.ts") != string::npos);
+    EXPECT(maker.index.find("seg_1.ts") != string::npos);
+}
+
+static void testPartName() {
+    uint64_t msn;
+    uint32_t part;
+    EXPECT(HlsMaker::parsePartName("/live/test/" + HlsMaker::makePartName(123, 4, false), msn, part));
+    EXPECT(msn == 123 && part == 4);
+    EXPECT(HlsMaker::parsePartName(HlsMaker::makePartName(5, 0, true), msn, part));
+    EXPECT(msn == 5 && part == 0);
+    EXPECT(!HlsMaker::parsePartName("/live/test/part_1_2.mp4", msn, part));
+    EXPECT(!HlsMaker::parsePartName("/live/test/part_1.ts", msn, part));
+    EXPECT(!HlsMaker::parsePartName("/live/test/2024-01-01/12/00-00_1.ts", msn, part));
+}
+
+// 该测试程序用于验证低延迟hls的部分切片、预加载提示与增量m3u8
+// This test program is used to verify the partial segments, preload hint and delta m3u8 of low-latency hls
+int main(int argc, char *argv[]) {
+    try {
+        testParts();
+        testDelta();
+        testPartName();
+        cout << "test_hls_ll passed" << endl;
+        return 0;
+    } catch (const exception &ex) {
+        cerr << "test_hls_ll failed: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
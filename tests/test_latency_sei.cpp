@@ -0,0 +1,170 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include "Common/LatencyStat.h"
+#include "Extension/Factory.h"
+#include "Util/util.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+static Frame::Ptr makeFrame(CodecId codec, const string &nal, uint64_t dts, uint64_t pts) {
+    auto prefix = codec == CodecH264 || codec == CodecH265 ? string("\x00\x00\x00\x01", 4) : string();
+    return Factory::getFrameFromBuffer(codec, std::make_shared<BufferString>(prefix + nal), dts, pts);
+}
+
+static void testSei() {
+    for (auto codec : { CodecH264, CodecH265 }) {
+        // 时间中含多个0字节，需要防竞争处理
+        // The time contains multiple 0 bytes, which requires emulation prevention
+        for (uint64_t stamp : { (uint64_t)0, (uint64_t)1, (uint64_t)0x0000000100000002, (uint64_t)1700000000123, UINT64_MAX }) {
+            auto sei = LatencyStat::makeSei(codec, stamp);
+            for (size_t i = 2; i < sei.size(); ++i) {
+                EXPECT(!(sei[i - 2] == 0 && sei[i - 1] == 0 && (uint8_t)sei[i] <= 2));
+            }
+            uint64_t parsed = 0;
+            EXPECT(LatencyStat::parseSei(codec, sei.data(), sei.size(), parsed));
+            EXPECT(parsed == stamp);
+            // 其他codec或其他uuid的sei不解析
+            // The sei of other codecs or other uuids is not parsed
+            EXPECT(!LatencyStat::parseSei(CodecAAC, sei.data(), sei.size(), parsed));
+            sei[sei.size() / 2] ^= 0x40;
+            EXPECT(!LatencyStat::parseSei(codec, sei.data(), sei.size(), parsed));
+        }
+    }
+    auto sei = LatencyStat::makeSei(CodecH264, 1);
+    EXPECT((uint8_t)sei[0] == 0x06);
+    sei = LatencyStat::makeSei(CodecH265, 1);
+    EXPECT((uint8_t)sei[0] == 0x4E && (uint8_t)sei[1] == 0x01);
+}
+
+static void testHistogram() {
+    LatencyStat::Histogram hist;
+    EXPECT(hist.percentile(0.5) == 0);
+    // 90个15ms，9个150ms，1个8000ms
+    // 90 of 15ms, 9 of 150ms, 1 of 8000ms
+    for (int i = 0; i < 90; ++i) {
+        hist.add(15);
+    }
+    for (int i = 0; i < 9; ++i) {
+        hist.add(150);
+    }
+    hist.add(8000);
+    EXPECT(hist.count == 100);
+    EXPECT(hist.sum_ms == 90 * 15 + 9 * 150 + 8000);
+    EXPECT(hist.max_ms == 8000);
+    EXPECT(hist.buckets[1] == 90 && hist.buckets[4] == 9 && hist.buckets[LatencyStat::kBuckets - 1] == 1);
+    EXPECT(hist.percentile(0.5) == 20);
+    EXPECT(hist.percentile(0.9) == 20);
+    EXPECT(hist.percentile(0.99) == 200);
+    EXPECT(hist.percentile(1) == 8000);
+}
+
+static void testMatch() {
+    auto stat = std::make_shared<LatencyStat>(true);
+    // 修正后的时间戳为1000，原始时间戳为5000
+    // The revised timestamp is 1000, and the original timestamp is 5000
+    auto origin = makeFrame(CodecH264, "\x41\x9a", 5000, 5040);
+    auto frame = makeFrame(CodecH264, "\x41\x9a", 1000, 1040);
+    auto now = getCurrentMillisecond(true);
+    auto sei = stat->inputFrame(origin, frame);
+    EXPECT(sei);
+    EXPECT(sei->dts() == 1000 && sei->pts() == 1040);
+    uint64_t stamp;
+    EXPECT(LatencyStat::parseSei(CodecH264, sei->data() + sei->prefixSize(), sei->size() - sei->prefixSize(), stamp));
+    EXPECT(stamp >= now && stamp < now + 1000);
+    // 同一dts的其他slice不再插入
+    // Other slices of the same dts are no longer inserted
+    EXPECT(!stat->inputFrame(origin, frame));
+    auto audio = makeFrame(CodecOpus, "opus", 1010, 1010);
+    EXPECT(!stat->inputFrame(audio, audio));
+
+    LatencyRecorder rtmp("rtmp");
+    rtmp.attach(stat);
+    EXPECT(rtmp.onSend(TrackVideo, 1000, false));
+    // 同一帧的多个包只记录一次
+    // Multiple packets of the same frame are recorded only once
+    EXPECT(!rtmp.onSend(TrackVideo, 1000, false));
+    EXPECT(rtmp.onSend(TrackAudio, 1010, false));
+    EXPECT(!rtmp.onSend(TrackVideo, 3000, false));
+    LatencyRecorder flv("flv");
+    flv.attach(stat);
+    // 直接转发原始时间戳的协议按原始时间戳匹配
+    // Protocols forwarding the original timestamp are matched by the original timestamp
+    EXPECT(flv.onSend(TrackVideo, 5000, false));
+    stat->onSendRtp("rtsp", TrackVideo, 1040 * 90, 90000);
+    stat->onSendRtp("rtsp", TrackAudio, 1010 * 44100 / 1000 + 10, 44100);
+    stat->onSendRtp("rtsp", TrackVideo, 2000 * 90, 90000);
+
+    auto histograms = stat->getHistograms();
+    EXPECT(histograms["rtmp"].count == 2);
+    EXPECT(histograms["flv"].count == 1);
+    EXPECT(histograms["rtsp"].count == 2);
+    EXPECT(histograms["rtmp"].max_ms < 1000);
+    EXPECT(histograms.find("upstream") == histograms.end());
+    EXPECT(LatencyStat::getTotalHistograms()["rtmp"].count >= 2);
+
+    // 级联的下游服务器从上游sei统计源头延迟，且不重复插入sei
+    // The downstream server in cascade measures the origin latency from the upstream sei, and does not insert the sei again
+    auto downstream = std::make_shared<LatencyStat>(true);
+    auto upstream_sei = makeFrame(CodecH264, LatencyStat::makeSei(CodecH264, getCurrentMillisecond(true) - 100), 2000, 2000);
+    EXPECT(!downstream->inputFrame(upstream_sei, upstream_sei));
+    auto video = makeFrame(CodecH264, "\x41\x9a", 2000, 2000);
+    EXPECT(!downstream->inputFrame(video, video));
+    auto upstream = downstream->getHistograms()["upstream"];
+    EXPECT(upstream.count == 1);
+    EXPECT(upstream.max_ms >= 100 && upstream.max_ms < 1100);
+}
+
+static void testKeyFrame() {
+    // sps、pps与idr同dts，sei插在idr前
+    // Sps, pps and idr have the same dts, the sei is inserted before the idr
+    auto stat = std::make_shared<LatencyStat>(true);
+    auto sps = makeFrame(CodecH264, "\x67\x42\x00\x1e", 3000, 3000);
+    auto pps = makeFrame(CodecH264, "\x68\xce\x3c\x80", 3000, 3000);
+    auto idr = makeFrame(CodecH264, "\x65\x88", 3000, 3000);
+    EXPECT(sps->configFrame() && pps->configFrame() && idr->keyFrame());
+    EXPECT(!stat->inputFrame(sps, sps));
+    EXPECT(!stat->inputFrame(pps, pps));
+    auto sei = stat->inputFrame(idr, idr);
+    EXPECT(sei);
+    EXPECT(sei->dts() == 3000);
+
+    // 级联时关键帧也统计源头延迟
+    // The origin latency is also measured for key frames in cascade
+    auto downstream = std::make_shared<LatencyStat>(true);
+    auto upstream_sei = makeFrame(CodecH264, LatencyStat::makeSei(CodecH264, getCurrentMillisecond(true) - 100), 3000, 3000);
+    EXPECT(!downstream->inputFrame(upstream_sei, upstream_sei));
+    EXPECT(!downstream->inputFrame(sps, sps));
+    EXPECT(!downstream->inputFrame(pps, pps));
+    EXPECT(!downstream->inputFrame(idr, idr));
+    EXPECT(downstream->getHistograms()["upstream"].count == 1);
+}
+
+// 该测试程序用于验证延迟统计的时间sei、直方图与接收/发送匹配
+// This test program is used to verify the timing sei, histogram and receiving/sending matching of the latency statistics
+int main(int argc, char *argv[]) {
+    try {
+        testSei();
+        testHistogram();
+        testMatch();
+        testKeyFrame();
+        cout << "test_latency_sei passed" << endl;
+        return 0;
+    } catch (const exception &ex) {
+        cerr << "test_latency_sei failed: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,83 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <limits>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include "Common/MetricsWriter.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace mediakit;
+
+static void testGrouping() {
+    MetricsWriter writer;
+    // 分批写入时不同指标交错出现
+    // Different metrics are interleaved when written in batches
+    for (int i = 0; i < 2; ++i) {
+        auto stream = "s" + to_string(i);
+        writer.gauge("zlm_stream_readers", "Players", { { "stream", stream }, { "schema", "rtsp" } }, i + 1);
+        writer.counter("zlm_stream_bytes_total", "Bytes", { { "stream", stream } }, 1234567890123.0);
+    }
+    writer.gauge("zlm_stream_readers", "Players", { { "stream", "s2" }, { "schema", "rtmp" } }, 0.25);
+    writer.gauge("zlm_up", "Up", {}, 1);
+
+    auto text = writer.str();
+    EXPECT(text == "# HELP zlm_stream_readers Players\n"
+                   "# TYPE zlm_stream_readers gauge\n"
+                   "zlm_stream_readers{stream=\"s0\",schema=\"rtsp\"} 1\n"
+                   "zlm_stream_readers{stream=\"s1\",schema=\"rtsp\"} 2\n"
+                   "zlm_stream_readers{stream=\"s2\",schema=\"rtmp\"} 0.25\n"
+                   "# HELP zlm_stream_bytes_total Bytes\n"
+                   "# TYPE zlm_stream_bytes_total counter\n"
+                   "zlm_stream_bytes_total{stream=\"s0\"} 1234567890123\n"
+                   "zlm_stream_bytes_total{stream=\"s1\"} 1234567890123\n"
+                   "# HELP zlm_up Up\n"
+                   "# TYPE zlm_up gauge\n"
+                   "zlm_up 1\n");
+}
+
+static void testEscape() {
+    EXPECT(MetricsWriter::escapeLabel("a\"b\\c\nd") == "a\\\"b\\\\c\\nd");
+    MetricsWriter writer;
+    writer.gauge("zlm_test", "Test", { { "stream", "x\"y" } }, std::numeric_limits<double>::infinity());
+    EXPECT(writer.str().find("zlm_test{stream=\"x\\\"y\"} +Inf\n") != string::npos);
+}
+
+static void testHistogram() {
+    MetricsWriter writer;
+    writer.histogram("zlm_latency_ms", "Latency", { { "egress", "rtmp" } }, { 10, 20, 50 }, { 3, 0, 5, 2 }, 456);
+    auto text = writer.str();
+    // 桶计数为累计值
+    // The bucket counts are cumulative
+    EXPECT(text.find("# TYPE zlm_latency_ms histogram\n") != string::npos);
+    EXPECT(text.find("zlm_latency_ms_bucket{egress=\"rtmp\",le=\"10\"} 3\n") != string::npos);
+    EXPECT(text.find("zlm_latency_ms_bucket{egress=\"rtmp\",le=\"20\"} 3\n") != string::npos);
+    EXPECT(text.find("zlm_latency_ms_bucket{egress=\"rtmp\",le=\"50\"} 8\n") != string::npos);
+    EXPECT(text.find("zlm_latency_ms_bucket{egress=\"rtmp\",le=\"+Inf\"} 10\n") != string::npos);
+    EXPECT(text.find("zlm_latency_ms_sum{egress=\"rtmp\"} 456\n") != string::npos);
+    EXPECT(text.find("zlm_latency_ms_count{egress=\"rtmp\"} 10\n") != string::npos);
+}
+
+// 该测试程序用于验证prometheus文本格式的生成
+// This test program is used to verify the generation of the prometheus text format
+int main(int argc, char *argv[]) {
+    try {
+        testGrouping();
+        testEscape();
+        testHistogram();
+        cout << "test_metrics_writer passed" << endl;
+        return 0;
+    } catch (const exception &ex) {
+        cerr << "test_metrics_writer failed: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
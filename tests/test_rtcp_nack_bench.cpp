@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <iostream>
+#include "Network/sockutil.h"
+#include "../webrtc/Nack.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 生成接收到的rtp seq序列
+ * @param count 包个数
+ * @param loss 丢包概率(千分比)
+ * @param burst 每次丢包的最大连续个数
+ * Generate the received rtp seq sequence
+ * @param count Number of packets
+ * @param loss Packet loss probability (per thousand)
+ * @param burst Maximum number of consecutive packets lost each time
+ */
+static vector<uint16_t> makeInput(size_t count, int loss, int burst) {
+    mt19937 rng(12345);
+    vector<uint16_t> ret;
+    ret.reserve(count);
+    // 从回环附近开始
+    // Start near the loop
+    uint16_t seq = 0xFFFF - 1000;
+    for (size_t i = 0; i < count; ++i, ++seq) {
+        if ((int)(rng() % 1000) < loss) {
+            seq += rng() % burst;
+            continue;
+        }
+        ret.emplace_back(seq);
+    }
+    return ret;
+}
+
+static void benchContext(const char *name, int loss, int burst) {
+    static constexpr size_t kCount = 1000000;
+    auto input = makeInput(kCount, loss, burst);
+    double min_ns = 0;
+    size_t nack_count = 0;
+    // 多轮运行取最小值，减少缓存预热与调度的影响
+    // Run multiple rounds and take the minimum to reduce the impact of cache warm-up and scheduling
+    for (int round = 0; round < 3; ++round) {
+        NackContext ctx;
+        nack_count = 0;
+        ctx.setOnNack([&](const FCI_NACK &nack) { ++nack_count; });
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < input.size(); ++i) {
+            ctx.received(input[i]);
+            if (i % 100 == 0) {
+                ctx.reSendNack();
+            }
+        }
+        auto ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / input.size();
+        min_ns = round ? (std::min)(min_ns, ns) : ns;
+    }
+    cout << "NackContext " << name << ": 输入(input):" << input.size() << " nack:" << nack_count << " " << min_ns << "ns/pkt" << endl;
+}
+
+static void benchList(size_t count) {
+    vector<RtpPacket::Ptr> rtps;
+    rtps.reserve(count);
+    uint16_t seq = 0xFFFF - 1000;
+    for (size_t i = 0; i < count; ++i, ++seq) {
+        auto rtp = RtpPacket::create();
+        rtp->setCapacity(RtpPacket::kRtpTcpHeaderSize + RtpPacket::kRtpHeaderSize);
+        rtp->setSize(RtpPacket::kRtpTcpHeaderSize + RtpPacket::kRtpHeaderSize);
+        memset(rtp->data(), 0, rtp->size());
+        rtp->getHeader()->seq = htons(seq);
+        // 模拟每毫秒一个包
+        // Simulate one packet per millisecond
+        rtp->ntp_stamp = i;
+        rtps.emplace_back(std::move(rtp));
+    }
+
+    mt19937 rng(12345);
+    double min_ns = 0;
+    size_t hit = 0;
+    for (int round = 0; round < 3; ++round) {
+        NackList list;
+        hit = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < rtps.size(); ++i) {
+            list.pushBack(rtps[i]);
+            if (i % 50 == 0) {
+                // 随机请求最近一段时间内的rtp重传
+                // Randomly request retransmission of recent rtp
+                uint16_t pid = rtps[i]->getSeq() - rng() % 1000;
+                list.forEach(FCI_NACK(pid, (uint16_t)rng()), [&](const RtpPacket::Ptr &rtp) { ++hit; });
+            }
+        }
+        auto ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / rtps.size();
+        min_ns = round ? (std::min)(min_ns, ns) : ns;
+    }
+    cout << "NackList: 输入(input):" << rtps.size() << " 命中(hit):" << hit << " " << min_ns << "ns/pkt" << endl;
+}
+
+// 该测试程序用于测试nack收发两端的性能
+// This test program is used to test the performance of nack receiver and sender
+int main(int argc, char *argv[]) {
+    benchContext("no loss      ", 0, 1);
+    benchContext("random 1%    ", 10, 1);
+    benchContext("burst 1%x16  ", 10, 16);
+    benchContext("burst 5%x64  ", 50, 64);
+    benchList(1000000);
+    return 0;
+}
@@ -0,0 +1,150 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include "Rtmp/RtmpProtocol.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 内存中的rtmp端点，发送的数据记录在wire中，收到的消息保存起来
+ * In-memory rtmp endpoint, the sent data is recorded in the wire, and the received messages are saved
+ */
+class RtmpPeer : public RtmpProtocol {
+public:
+    using RtmpProtocol::sendChunkSize;
+    using RtmpProtocol::sendRtmp;
+
+    string wire;
+    bool keep = true;
+    size_t bytes = 0;
+    vector<RtmpPacket::Ptr> packets;
+
+protected:
+    void onSendRawData(Buffer::Ptr buffer) override { wire.append(buffer->data(), buffer->size()); }
+    void onRtmpChunk(RtmpPacket::Ptr packet) override {
+        bytes += packet->size();
+        if (keep) {
+            packets.emplace_back(std::move(packet));
+        }
+    }
+};
+
+/**
+ * 在两个端点间交换数据直到握手完成
+ * Exchange data between the two endpoints until the handshake is completed
+ */
+static void handshake(RtmpPeer &client, RtmpPeer &server) {
+    client.startClientSession([]() {}, false);
+    while (!client.wire.empty() || !server.wire.empty()) {
+        string data;
+        data.swap(client.wire);
+        server.onParseRtmp(data.data(), data.size());
+        data.clear();
+        data.swap(server.wire);
+        client.onParseRtmp(data.data(), data.size());
+    }
+}
+
+/**
+ * 生成25fps、约6Mbps的视频消息，每50帧一个较大的关键帧
+ * Generate video messages of 25fps and about 6Mbps, with a larger key frame every 50 frames
+ */
+static vector<string> makeFrames(mt19937 &rng, size_t count) {
+    vector<string> ret;
+    for (size_t i = 0; i < count; ++i) {
+        string frame(i % 50 ? 15000 + rng() % 30000 : 200000, '\0');
+        for (auto &ch : frame) {
+            ch = (char)rng();
+        }
+        ret.emplace_back(std::move(frame));
+    }
+    return ret;
+}
+
+/**
+ * 把分块后的数据按随机大小切片输入，模拟socket每次收到的数据
+ * Input the chunked data in slices of random size, simulating the data received by the socket each time
+ */
+static double feed(RtmpPeer &server, const string &wire, size_t recv_size) {
+    mt19937 rng(recv_size);
+    auto start = chrono::steady_clock::now();
+    for (size_t pos = 0; pos < wire.size();) {
+        auto size = (std::min)(wire.size() - pos, (size_t)(1 + rng() % (2 * recv_size)));
+        server.onParseRtmp(wire.data() + pos, size);
+        pos += size;
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void bench(size_t chunk_size, size_t recv_size) {
+    mt19937 rng(12345);
+    auto frames = makeFrames(rng, 500);
+    RtmpPeer client, server;
+    handshake(client, server);
+    client.sendChunkSize((uint32_t)chunk_size);
+    size_t bytes = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        client.sendRtmp(MSG_VIDEO, 1, frames[i], (uint32_t)(i * 40), CHUNK_VIDEO);
+        bytes += frames[i].size();
+    }
+
+    // 校验重组结果，chunk会随机跨越多次输入
+    // Verify the reassembly result, chunks randomly span multiple inputs
+    feed(server, client.wire, recv_size);
+    EXPECT(server.packets.size() == frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        auto &packet = server.packets[i];
+        EXPECT(packet->type_id == MSG_VIDEO);
+        EXPECT(packet->time_stamp == i * 40);
+        EXPECT(packet->size() == frames[i].size());
+        EXPECT(memcmp(packet->data(), frames[i].data(), frames[i].size()) == 0);
+    }
+
+    // 多轮运行取最小值，减少缓存预热与调度的影响
+    // Run multiple rounds and take the minimum to reduce the impact of cache warm-up and scheduling
+    double min_sec = 0;
+    for (int round = 0; round < 5; ++round) {
+        RtmpPeer client_bench, server_bench;
+        handshake(client_bench, server_bench);
+        server_bench.keep = false;
+        auto sec = feed(server_bench, client.wire, recv_size);
+        EXPECT(server_bench.bytes == bytes);
+        min_sec = round ? (std::min)(min_sec, sec) : sec;
+    }
+    cout << "chunk大小(chunk size):" << chunk_size << " 平均每次接收(average recv):" << recv_size << " 重组(reassembly):" << bytes / min_sec / 1e9
+         << "GB/s" << endl;
+}
+
+// 该测试程序用于验证rtmp chunk重组的正确性并测试其吞吐量
+// This test program is used to verify the correctness of rtmp chunk reassembly and test its throughput
+int main(int argc, char *argv[]) {
+    try {
+        for (auto chunk_size : { 128, 4096, 60000 }) {
+            for (auto recv_size : { 1460, 16384, 65536 }) {
+                bench(chunk_size, recv_size);
+            }
+        }
+        cout << "test_rtmp_chunk_bench passed" << endl;
+        return 0;
+    } catch (const exception &ex) {
+        cerr << "test_rtmp_chunk_bench failed: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <functional>
+#include "Rtsp/RtpReceiver.h"
+
+using namespace std;
+using namespace mediakit;
+
+/**
+ * 基于std::map的旧版排序器，仅用于性能与正确性对比
+ * The old sorter based on std::map, only used for performance and correctness comparison
+ */
+template<typename T, typename SEQ = uint16_t>
+class MapPacketSortor {
+public:
+    static constexpr SEQ SEQ_MAX = (std::numeric_limits<SEQ>::max)();
+    using iterator = typename std::map<SEQ, T>::iterator;
+
+    void setOnSort(std::function<void(SEQ seq, T packet)> cb) { _cb = std::move(cb); }
+
+    size_t getJitterSize() const { return _pkt_sort_cache_map.size(); }
+
+    void sortPacket(SEQ seq, T packet) {
+        _latest_seq = seq;
+        if (!_started) {
+            _started = true;
+            _next_seq = seq;
+        }
+        if (seq == _next_seq) {
+            output(seq, std::move(packet));
+            flushPacket();
+            _pkt_drop_cache_map.clear();
+            return;
+        }
+
+        if (seq < _next_seq && !mayLooped(_next_seq, seq)) {
+            _pkt_drop_cache_map.emplace(seq, std::move(packet));
+            if (_pkt_drop_cache_map.size() > _max_distance || _ticker.elapsedTime() > _max_buffer_ms) {
+                forceFlush(_next_seq);
+                _pkt_sort_cache_map = std::move(_pkt_drop_cache_map);
+                popIterator(_pkt_sort_cache_map.begin());
+            }
+            return;
+        }
+        _pkt_sort_cache_map.emplace(seq, std::move(packet));
+
+        if (needForceFlush(seq)) {
+            forceFlush(_next_seq);
+        }
+    }
+
+    void flush() {
+        if (!_pkt_sort_cache_map.empty()) {
+            forceFlush(_next_seq);
+            _pkt_sort_cache_map.clear();
+        }
+    }
+
+    void setParams(size_t max_buffer_size, size_t max_buffer_ms, size_t max_distance) {
+        _max_buffer_size = max_buffer_size;
+        _max_buffer_ms = max_buffer_ms;
+        _max_distance = max_distance;
+    }
+
+private:
+    SEQ distance(SEQ seq) {
+        SEQ ret;
+        if (seq > _next_seq) {
+            ret = seq - _next_seq;
+        } else {
+            ret = _next_seq - seq;
+        }
+        if (ret > SEQ_MAX >> 1) {
+            return SEQ_MAX - ret;
+        }
+        return ret;
+    }
+
+    bool needForceFlush(SEQ seq) {
+        return _pkt_sort_cache_map.size() > _max_buffer_size || distance(seq) > _max_distance || _ticker.elapsedTime() > _max_buffer_ms;
+    }
+
+    void forceFlush(SEQ next_seq) {
+        if (_pkt_sort_cache_map.empty()) {
+            return;
+        }
+        auto it = _pkt_sort_cache_map.lower_bound(next_seq);
+        if (it == _pkt_sort_cache_map.end()) {
+            it = _pkt_sort_cache_map.begin();
+        }
+        popIterator(it);
+        flushPacket();
+        for (auto it = _pkt_sort_cache_map.begin(); it != _pkt_sort_cache_map.end();) {
+            if (distance(it->first) > _max_distance) {
+                it = _pkt_sort_cache_map.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    bool mayLooped(SEQ last_seq, SEQ now_seq) { return last_seq > SEQ_MAX - _max_distance || now_seq < _max_distance; }
+
+    void flushPacket() {
+        if (_pkt_sort_cache_map.empty()) {
+            return;
+        }
+        auto it = _pkt_sort_cache_map.lower_bound(_next_seq);
+        if (!mayLooped(_next_seq, _next_seq)) {
+            it = _pkt_sort_cache_map.erase(_pkt_sort_cache_map.begin(), it);
+        }
+
+        while (it != _pkt_sort_cache_map.end()) {
+            if (it->first == _next_seq) {
+                it = popIterator(it);
+                continue;
+            }
+            break;
+        }
+    }
+
+    iterator popIterator(iterator it) {
+        output(it->first, std::move(it->second));
+        return _pkt_sort_cache_map.erase(it);
+    }
+
+    void output(SEQ seq, T packet) {
+        _next_seq = static_cast<SEQ>(seq + 1);
+        _cb(seq, std::move(packet));
+        _ticker.resetTime();
+    }
+
+private:
+    bool _started = false;
+    size_t _max_buffer_ms = 1000;
+    size_t _max_buffer_size = 1024;
+    size_t _max_distance = 256;
+    toolkit::Ticker _ticker;
+    SEQ _latest_seq = 0;
+    SEQ _next_seq = 0;
+    std::map<SEQ, T> _pkt_sort_cache_map;
+    std::map<SEQ, T> _pkt_drop_cache_map;
+    std::function<void(SEQ seq, T packet)> _cb;
+};
+
+using Packet = std::shared_ptr<uint16_t>;
+
+/**
+ * 生成输入序列
+ * @param count 包个数
+ * @param reorder 乱序概率(百分比)，乱序包与后面最多8个包交换位置
+ * @param loss 丢包概率(千分比)
+ * Generate input sequence
+ * @param count Number of packets
+ * @param reorder Out-of-order probability (percentage), the out-of-order packet swaps with one of up to 8 following packets
+ * @param loss Packet loss probability (per thousand)
+ */
+static vector<pair<uint16_t, Packet>> makeInput(size_t count, int reorder, int loss) {
+    mt19937 rng(12345);
+    vector<pair<uint16_t, Packet>> ret;
+    ret.reserve(count);
+    // 从回环附近开始
+    // Start near the loop
+    uint16_t seq = 0xFFFF - 1000;
+    for (size_t i = 0; i < count; ++i, ++seq) {
+        if ((int)(rng() % 1000) < loss) {
+            continue;
+        }
+        ret.emplace_back(seq, std::make_shared<uint16_t>(seq));
+    }
+    for (size_t i = 0; i + 8 < ret.size(); ++i) {
+        if ((int)(rng() % 100) < reorder) {
+            std::swap(ret[i], ret[i + 1 + rng() % 8]);
+        }
+    }
+    return ret;
+}
+
+template<typename SORTOR>
+static double runOnce(const vector<pair<uint16_t, Packet>> &input, vector<uint16_t> &output) {
+    SORTOR sortor;
+    output.clear();
+    output.reserve(input.size());
+    sortor.setOnSort([&](uint16_t seq, Packet packet) { output.push_back(seq); });
+    auto start = chrono::steady_clock::now();
+    for (auto &pr : input) {
+        sortor.sortPacket(pr.first, pr.second);
+    }
+    sortor.flush();
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / input.size();
+}
+
+static void bench(const char *name, int reorder, int loss) {
+    static constexpr size_t kCount = 1000000;
+    auto input = makeInput(kCount, reorder, loss);
+    vector<uint16_t> map_out, ring_out;
+    double map_ns = 0, ring_ns = 0;
+    // 交替运行多轮取最小值，减少缓存预热与调度的影响
+    // Run multiple rounds alternately and take the minimum to reduce the impact of cache warm-up and scheduling
+    for (int i = 0; i < 3; ++i) {
+        auto ns = runOnce<MapPacketSortor<Packet>>(input, map_out);
+        map_ns = i ? (std::min)(map_ns, ns) : ns;
+        ns = runOnce<PacketSortor<Packet>>(input, ring_out);
+        ring_ns = i ? (std::min)(ring_ns, ns) : ns;
+    }
+    cout << name << ": 输入(input):" << input.size()
+         << " map:" << map_ns << "ns/pkt(" << map_out.size() << ")"
+         << " ring:" << ring_ns << "ns/pkt(" << ring_out.size() << ")"
+         << " 加速比(speedup):" << map_ns / ring_ns
+         << " 输出一致(same output):" << (map_out == ring_out ? "yes" : "no") << endl;
+    // 旧版实现在回环附近会把迟到包留在缓存中，之后可能将其当做next_seq而跳过正常包，所以丢包时输出可能略有差异
+    // The old implementation keeps late packets near the loop in the cache, and may later treat them as next_seq and skip normal packets,
+    // so the output may differ slightly when packets are lost
+}
+
+// 该测试程序用于对比rtp排序器新旧实现的性能
+// This test program is used to compare the performance of the new and old rtp sorter implementations
+int main(int argc, char *argv[]) {
+    bench("in order       ", 0, 0);
+    bench("reorder 5%     ", 5, 0);
+    bench("reorder 30%    ", 30, 0);
+    bench("loss 1%        ", 0, 10);
+    bench("reorder+loss   ", 10, 10);
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "ext-codec/H264.h"
+
+using namespace std;
+using namespace mediakit;
+
+using NaluList = vector<pair<size_t /*offset*/, size_t /*size*/>>;
+
+// 逐字节查找的参考实现，与优化前的splitH264一致
+// Byte-by-byte reference implementation, consistent with splitH264 before optimization
+static const char *findStartCodeRef(const char *ptr, const char *end) {
+    for (auto p = ptr; end - p >= 3; ++p) {
+        if (memcmp(p, "\x00\x00\x01", 3) == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+static NaluList splitRef(const string &data, size_t prefix) {
+    NaluList ret;
+    auto ptr = data.data();
+    auto start = ptr + prefix;
+    auto end = ptr + data.size();
+    while (true) {
+        auto next_start = findStartCodeRef(start, end - 1);
+        if (!next_start) {
+            ret.emplace_back(start - prefix - ptr, end - start + prefix);
+            break;
+        }
+        size_t next_prefix = 3;
+        if (next_start > ptr && *(next_start - 1) == 0x00) {
+            next_start -= 1;
+            next_prefix = 4;
+        }
+        ret.emplace_back(start - prefix - ptr, next_start - start + prefix);
+        start = next_start + next_prefix;
+        prefix = next_prefix;
+    }
+    return ret;
+}
+
+static NaluList split(const string &data, size_t prefix) {
+    NaluList ret;
+    splitH264(data.data(), data.size(), prefix, [&](const char *ptr, size_t len, size_t) { ret.emplace_back(ptr - data.data(), len); });
+    return ret;
+}
+
+/**
+ * 追加一个nalu，负载为随机数据并做防竞争处理，与真实码流一样不会出现00 00 0x(x<=3)
+ * Append a nalu, the payload is random data with emulation prevention, like the real stream there is no 00 00 0x(x<=3)
+ */
+static void appendNalu(string &out, mt19937 &rng, uint8_t header, size_t size, bool long_prefix) {
+    out.append(long_prefix ? "\x00\x00\x00\x01" : "\x00\x00\x01", long_prefix ? 4 : 3);
+    out.push_back((char)header);
+    int zeros = 0;
+    for (size_t i = 1; i < size; ++i) {
+        auto r = rng();
+        // 提高0出现的概率，模拟熵编码后的零值游程
+        // Increase the probability of 0, simulating zero runs after entropy coding
+        uint8_t byte = (r & 0x700) == 0 ? 0 : (uint8_t)r;
+        if (zeros >= 2 && byte <= 3) {
+            out.push_back(0x03);
+            zeros = 0;
+        }
+        out.push_back((char)byte);
+        zeros = byte ? 0 : zeros + 1;
+    }
+    // nalu不能以0结尾
+    // Nalu cannot end with 0
+    if (!out.back()) {
+        out.push_back((char)0x80);
+    }
+}
+
+/**
+ * 生成一个gop的h264访问单元，idr帧带sps/pps/sei并切分为多个slice
+ * Generate the h264 access units of a gop, the idr frame carries sps/pps/sei and is divided into multiple slices
+ */
+static vector<string> makeGop(size_t idr_size, size_t p_size, size_t slices, size_t gop) {
+    mt19937 rng(12345);
+    vector<string> ret;
+    for (size_t i = 0; i < gop; ++i) {
+        string au;
+        appendNalu(au, rng, 0x09, 2, true);
+        auto size = i ? p_size : idr_size;
+        if (!i) {
+            appendNalu(au, rng, 0x67, 24, true);
+            appendNalu(au, rng, 0x68, 4, true);
+            appendNalu(au, rng, 0x06, 32, true);
+        }
+        // 码率有一定波动
+        // The bitrate fluctuates to some extent
+        size = size * (80 + rng() % 40) / 100;
+        for (size_t s = 0; s < slices; ++s) {
+            appendNalu(au, rng, i ? 0x41 : 0x65, size / slices, s == 0);
+        }
+        ret.emplace_back(std::move(au));
+    }
+    return ret;
+}
+
+static bool checkFinder() {
+    mt19937 rng(54321);
+    string buf;
+    for (int round = 0; round < 200000; ++round) {
+        // 只包含0/1的短数据，覆盖各种对齐与边界情况
+        // Short data containing only 0/1, covering all kinds of alignment and boundary cases
+        buf.resize(rng() % 100);
+        for (auto &ch : buf) {
+            ch = (char)(rng() % 3 ? 0 : 1);
+        }
+        size_t begin = buf.empty() ? 0 : rng() % buf.size();
+        auto ptr = buf.data() + begin;
+        auto end = buf.data() + buf.size();
+        if (findStartCode(ptr, end) != findStartCodeRef(ptr, end)) {
+            cout << "findStartCode mismatch, size:" << buf.size() << " begin:" << begin << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkSplit(const vector<string> &aus) {
+    for (auto &au : aus) {
+        if (split(au, prefixSize(au.data(), au.size())) != splitRef(au, prefixSize(au.data(), au.size()))) {
+            cout << "splitH264 mismatch, size:" << au.size() << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename FUNC>
+static double measure(const vector<string> &aus, size_t bytes, FUNC &&func) {
+    double min_sec = 0;
+    // 多轮运行取最小值，减少缓存预热与调度的影响
+    // Run multiple rounds and take the minimum to reduce the impact of cache warm-up and scheduling
+    for (int round = 0; round < 5; ++round) {
+        size_t count = 0;
+        auto start = chrono::steady_clock::now();
+        for (auto &au : aus) {
+            count += func(au);
+        }
+        auto sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (!count) {
+            return 0;
+        }
+        min_sec = round ? (std::min)(min_sec, sec) : sec;
+    }
+    return bytes / min_sec / 1e9;
+}
+
+static bool bench(const char *name, const vector<string> &aus) {
+    if (!checkSplit(aus)) {
+        return false;
+    }
+    size_t bytes = 0;
+    for (auto &au : aus) {
+        bytes += au.size();
+    }
+    auto legacy = measure(aus, bytes, [](const string &au) { return splitRef(au, prefixSize(au.data(), au.size())).size(); });
+    auto simd = measure(aus, bytes, [](const string &au) {
+        size_t count = 0;
+        splitH264(au.data(), au.size(), prefixSize(au.data(), au.size()), [&](const char *, size_t, size_t) { ++count; });
+        return count;
+    });
+    cout << name << ": 访问单元(access units):" << aus.size() << " 字节(bytes):" << bytes << " 逐字节(byte by byte):" << legacy
+         << "GB/s splitH264:" << simd << "GB/s" << endl;
+    return true;
+}
+
+// 该测试程序用于验证annexb起始码查找的正确性并测试其吞吐量，可传入h264/h265裸流文件测试真实码流
+// This test program is used to verify the correctness of the annexb start code finder and test its throughput,
+// a raw h264/h265 file can be passed in to test the real stream
+int main(int argc, char *argv[]) {
+    if (!checkFinder()) {
+        return 1;
+    }
+    bool ok = true;
+    // 1080p约6Mbps、4K约25Mbps，25fps，gop为50帧
+    // 1080p is about 6Mbps and 4K is about 25Mbps, 25fps, the gop is 50 frames
+    ok = bench("1080p", makeGop(200 * 1024, 25 * 1024, 4, 50)) && ok;
+    ok = bench("4K   ", makeGop(800 * 1024, 110 * 1024, 8, 50)) && ok;
+    if (argc > 1) {
+        ifstream file(argv[1], ios::binary);
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (data.empty()) {
+            cout << "open file failed: " << argv[1] << endl;
+            return 1;
+        }
+        ok = bench(argv[1], vector<string> { std::move(data) }) && ok;
+    }
+    return ok ? 0 : 1;
+}
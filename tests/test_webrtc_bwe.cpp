@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "Rtcp/RtcpFCI.h"
+#include "../webrtc/SendSideBwe.h"
+
+using namespace std;
+using namespace mediakit;
+
+/**
+ * 模拟一条瓶颈链路：按发送端估计的码率发包，链路按其带宽排队转发，排队超过300ms丢包，对端每100ms回复一次twcc
+ * Simulate a bottleneck link: send packets at the bitrate estimated by the sender, the link forwards them in a queue according to its bandwidth,
+ * packets are dropped when queued for more than 300ms, and the peer replies twcc every 100ms
+ */
+class LinkSimulator {
+public:
+    void setLinkBitrate(double bps) { _link_bps = bps; }
+
+    void run(SendSideBwe &bwe, int64_t until_us) {
+        static constexpr size_t kPacketSize = 1200;
+        static constexpr int64_t kMaxQueueUS = 300 * 1000;
+        static constexpr int64_t kPropagationUS = 20 * 1000;
+        for (; _now_us < until_us; _now_us += 100) {
+            if (_now_us >= _next_send_us) {
+                auto seq = bwe.onSendRtp(kPacketSize, _now_us);
+                _next_send_us = _now_us + (int64_t)(kPacketSize * 8 * 1e6 / bwe.getTargetBitrate());
+                auto start = (std::max)(_now_us, _link_free_us);
+                if (start - _now_us > kMaxQueueUS) {
+                    _pending.emplace_back(seq, -1);
+                } else {
+                    _link_free_us = start + (int64_t)(kPacketSize * 8 * 1e6 / _link_bps);
+                    _pending.emplace_back(seq, _link_free_us + kPropagationUS);
+                }
+            }
+            if (_now_us >= _next_feedback_us) {
+                _next_feedback_us = _now_us + 100 * 1000;
+                sendFeedback(bwe);
+            }
+        }
+    }
+
+private:
+    void sendFeedback(SendSideBwe &bwe) {
+        size_t count = 0;
+        while (count < _pending.size() && _pending[count].second <= _now_us) {
+            ++count;
+        }
+        if (!count) {
+            return;
+        }
+        int64_t first_recv_us = _now_us;
+        for (size_t i = 0; i < count; ++i) {
+            if (_pending[i].second >= 0) {
+                first_recv_us = _pending[i].second;
+                break;
+            }
+        }
+        auto ref_time = (uint32_t)(first_recv_us / (64 * 1000));
+        int64_t last_us = (int64_t)ref_time * 64 * 1000;
+        FCI_TWCC::TwccPacketStatus status;
+        for (size_t i = 0; i < count; ++i) {
+            auto &pr = _pending[i];
+            if (pr.second < 0) {
+                status.emplace(pr.first, std::make_pair(SymbolStatus::not_received, 0));
+                continue;
+            }
+            // recv delta单位为250us
+            // The unit of recv delta is 250us
+            auto delta = (int16_t)((pr.second - last_us) / 250);
+            last_us += delta * 250;
+            status.emplace(pr.first, std::make_pair(delta < 0 || delta > 0xFF ? SymbolStatus::large_delta : SymbolStatus::small_delta, delta));
+        }
+        _pending.erase(_pending.begin(), _pending.begin() + count);
+        auto fci = FCI_TWCC::create(ref_time, _fb_count++, status);
+        bwe.onTwccFeedback(*((FCI_TWCC *)fci.data()), fci.size(), _now_us);
+    }
+
+private:
+    uint8_t _fb_count = 0;
+    double _link_bps = 1000 * 1000;
+    int64_t _now_us = 0;
+    int64_t _next_send_us = 0;
+    int64_t _next_feedback_us = 100 * 1000;
+    int64_t _link_free_us = 0;
+    std::vector<std::pair<uint16_t /*seq*/, int64_t /*recv us, -1 means lost*/>> _pending;
+};
+
+static bool check(const char *name, const SendSideBwe &bwe, double link_bps) {
+    auto target = bwe.getTargetBitrate();
+    // 估计值应落在链路带宽的[0.6, 1.3]倍之间
+    // The estimated value should fall between [0.6, 1.3] times the link bandwidth
+    auto ok = target >= link_bps * 0.6 && target <= link_bps * 1.3;
+    cout << name << ": link:" << link_bps / 1000 << "kbps target:" << target / 1000 << "kbps acked:" << bwe.getAckedBitrate() / 1000
+         << "kbps loss:" << bwe.getLossRate() << " usage:" << SendSideBwe::BandwidthUsageStr(bwe.getBandwidthUsage())
+         << (ok ? " ok" : " failed") << endl;
+    return ok;
+}
+
+// 该测试程序用于验证发送端带宽估计能否跟随链路带宽变化
+// This test program is used to verify whether the send-side bandwidth estimation can follow the change of link bandwidth
+int main(int argc, char *argv[]) {
+    SendSideBwe bwe;
+    LinkSimulator link;
+    bool ok = true;
+
+    link.setLinkBitrate(1000 * 1000);
+    link.run(bwe, 20 * 1000 * 1000);
+    ok = check("1Mbps  ", bwe, 1000 * 1000) && ok;
+
+    link.setLinkBitrate(3000 * 1000);
+    link.run(bwe, 40 * 1000 * 1000);
+    ok = check("3Mbps  ", bwe, 3000 * 1000) && ok;
+
+    link.setLinkBitrate(500 * 1000);
+    link.run(bwe, 60 * 1000 * 1000);
+    ok = check("500kbps", bwe, 500 * 1000) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include "../webrtc/RtpExt.h"
+#include "../webrtc/RtcLayerSelector.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace mediakit;
+
+/**
+ * 构造视频rtp，ext不为空时添加只包含该ext的two-byte rtp ext
+ * Construct video rtp, add a two-byte rtp ext that only contains the ext when ext is not empty
+ */
+static RtpPacket::Ptr makeRtp(uint16_t seq, uint32_t stamp, const vector<uint8_t> &payload, uint8_t ext_id = 0, const vector<uint8_t> &ext = {}) {
+    vector<uint8_t> ext_data;
+    if (!ext.empty()) {
+        ext_data = { 0x10, 0x00, 0, 0, ext_id, (uint8_t)ext.size() };
+        ext_data.insert(ext_data.end(), ext.begin(), ext.end());
+        while (ext_data.size() % 4) {
+            ext_data.emplace_back(0);
+        }
+        auto words = (ext_data.size() - 4) / 4;
+        ext_data[2] = (uint8_t)(words >> 8);
+        ext_data[3] = (uint8_t)words;
+    }
+    auto len = RtpPacket::kRtpHeaderSize + ext_data.size() + payload.size();
+    auto rtp = RtpPacket::create();
+    rtp->setCapacity(RtpPacket::kRtpTcpHeaderSize + len);
+    rtp->setSize(RtpPacket::kRtpTcpHeaderSize + len);
+    rtp->type = TrackVideo;
+    rtp->sample_rate = 90000;
+    rtp->ntp_stamp = stamp / 90;
+    auto ptr = (uint8_t *)rtp->data();
+    memset(ptr, 0, RtpPacket::kRtpTcpHeaderSize + RtpPacket::kRtpHeaderSize);
+    auto header = rtp->getHeader();
+    header->version = RtpPacket::kRtpVersion;
+    header->ext = !ext_data.empty();
+    header->pt = 96;
+    header->seq = htons(seq);
+    header->stamp = htonl(stamp);
+    header->ssrc = htonl(0x12345678);
+    ptr += RtpPacket::kRtpTcpHeaderSize + RtpPacket::kRtpHeaderSize;
+    if (!ext_data.empty()) {
+        memcpy(ptr, ext_data.data(), ext_data.size());
+        ptr += ext_data.size();
+    }
+    memcpy(ptr, payload.data(), payload.size());
+    return rtp;
+}
+
+static void testKeyFrame() {
+    // h264: idr, sps, stap-a(sps+pps), fu-a起始idr, fu-a中间idr, 非idr
+    // h264: idr, sps, stap-a(sps+pps), fu-a start idr, fu-a middle idr, non-idr
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecH264, makeRtp(0, 0, { 0x65, 0x88 })));
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecH264, makeRtp(0, 0, { 0x67, 0x42 })));
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecH264, makeRtp(0, 0, { 0x78, 0x00, 0x02, 0x67, 0x42, 0x00, 0x02, 0x68, 0xce })));
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecH264, makeRtp(0, 0, { 0x7c, 0x85, 0x88 })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecH264, makeRtp(0, 0, { 0x7c, 0x05, 0x88 })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecH264, makeRtp(0, 0, { 0x41, 0x9a })));
+
+    // h265: idr_w_radl, vps, fu起始idr, 非irap
+    // h265: idr_w_radl, vps, fu start idr, non-irap
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecH265, makeRtp(0, 0, { 0x26, 0x01, 0xaf })));
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecH265, makeRtp(0, 0, { 0x40, 0x01, 0x0c })));
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecH265, makeRtp(0, 0, { 0x62, 0x01, 0x93, 0xaf })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecH265, makeRtp(0, 0, { 0x02, 0x01, 0xd0 })));
+
+    // vp8: 带picture id的关键帧，非关键帧，非帧起始包
+    // vp8: key frame with picture id, non key frame, packet that is not the start of a frame
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecVP8, makeRtp(0, 0, { 0x90, 0x80, 0x81, 0x23, 0x10 })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecVP8, makeRtp(0, 0, { 0x90, 0x80, 0x81, 0x23, 0x11 })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecVP8, makeRtp(0, 0, { 0x80, 0x80, 0x81, 0x23, 0x10 })));
+
+    // vp9: 关键帧起始包，帧间预测帧，关键帧的非起始包
+    // vp9: start packet of key frame, inter predicted frame, non-start packet of key frame
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecVP9, makeRtp(0, 0, { 0x88, 0x12, 0x82 })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecVP9, makeRtp(0, 0, { 0xc8, 0x12, 0x82 })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecVP9, makeRtp(0, 0, { 0x80, 0x12, 0x82 })));
+
+    // av1: N位
+    // av1: N bit
+    EXPECT(RtpLayerHelper::isKeyFrameStart(CodecAV1, makeRtp(0, 0, { 0x18, 0x0a })));
+    EXPECT(!RtpLayerHelper::isKeyFrameStart(CodecAV1, makeRtp(0, 0, { 0x10, 0x32 })));
+}
+
+// L1T3时域层模式：0,2,1,2,0,2,1,2...
+// L1T3 temporal layer pattern: 0,2,1,2,0,2,1,2...
+static uint8_t l1t3Tid(size_t frame) {
+    static const uint8_t kPattern[] = { 0, 2, 1, 2 };
+    return kPattern[frame % 4];
+}
+
+static void testTemporalFilterVP9() {
+    TemporalLayerFilter filter;
+    filter.setCodec(CodecVP9);
+    auto input = [&](size_t frame) {
+        // 负载描述符: I|L|B|E, 7位picture id, TID|U|SID|D
+        // Payload descriptor: I|L|B|E, 7-bit picture id, TID|U|SID|D
+        return filter.input(makeRtp((uint16_t)frame, (uint32_t)frame * 3000, { 0xac, (uint8_t)(frame & 0x7f), (uint8_t)(l1t3Tid(frame) << 5), 0x00 }));
+    };
+    size_t frame = 0;
+    for (; frame < 4; ++frame) {
+        EXPECT(input(frame));
+    }
+    filter.setMaxTemporalId(0);
+    for (; frame < 12; ++frame) {
+        EXPECT(input(frame) == (l1t3Tid(frame) == 0));
+    }
+    // 在tid 2的帧处恢复，需要等到下一个tid 0帧才生效
+    // Restore at a tid 2 frame, it takes effect at the next tid 0 frame
+    EXPECT(input(frame++));
+    filter.setMaxTemporalId(TemporalLayerFilter::kAllLayers);
+    for (; frame < 16; ++frame) {
+        EXPECT(!input(frame));
+    }
+    for (; frame < 24; ++frame) {
+        EXPECT(input(frame));
+    }
+}
+
+static void testTemporalFilterAV1() {
+    TemporalLayerFilter filter;
+    filter.setCodec(CodecAV1);
+    filter.setMaxTemporalId(0);
+    // 关键帧携带dependency descriptor模板结构(L1T2)：模板0、1为tid 0，模板2为tid 1
+    // The key frame carries the dependency descriptor template structure (L1T2): templates 0 and 1 are tid 0, template 2 is tid 1
+    // start|end|template_id(6) frame_number(16) structure_present|flags(4)|template_id_offset(6) dt_cnt_minus_one(5)|next_layer_idc...
+    vector<uint8_t> structure = { 0x80, 0x00, 0x01, 0x80, 0x00, 0x1c };
+    EXPECT(filter.input(makeRtp(0, 0, { 0x18, 0x0a }, (uint8_t)RtpExtType::av1, structure)));
+    for (uint16_t i = 1; i < 10; ++i) {
+        uint8_t template_id = i % 2 ? 2 : 1;
+        auto ok = filter.input(makeRtp(i, i * 3000, { 0x10, 0x32 }, (uint8_t)RtpExtType::av1, { (uint8_t)(0xc0 | template_id), 0x00, (uint8_t)i }));
+        EXPECT(ok == (template_id != 2));
+    }
+
+    // 无dependency descriptor时根据obu扩展头获取时域层，分片包沿用同一帧的时域层
+    // Get the temporal layer from the obu extension header without dependency descriptor, fragmented packets use the temporal layer of the same frame
+    filter.reset();
+    EXPECT(!filter.input(makeRtp(10, 30000, { 0x10, 0x34, 0x20 })));
+    EXPECT(!filter.input(makeRtp(11, 30000, { 0x90, 0x00 })));
+    EXPECT(filter.input(makeRtp(12, 33000, { 0x10, 0x34, 0x00 })));
+    EXPECT(filter.input(makeRtp(13, 33000, { 0x90, 0x00 })));
+}
+
+static void testRewriter() {
+    RtpStreamRewriter rewriter;
+    uint16_t last_seq = 0;
+    uint32_t last_stamp = 0;
+    auto check = [&](const RtpPacket::Ptr &in, bool first = false) {
+        auto out = rewriter.rewrite(in);
+        if (!first) {
+            EXPECT((uint16_t)(last_seq + 1) == out->getSeq());
+            EXPECT(out->getStamp() - last_stamp <= 10000);
+        }
+        last_seq = out->getSeq();
+        last_stamp = out->getStamp();
+        return out;
+    };
+
+    // 未切换时不改写也不拷贝
+    // No rewriting or copying before switching
+    auto rtp = makeRtp(65530, 90000, { 0x41 });
+    EXPECT(check(rtp, true) == rtp);
+    for (uint16_t i = 1; i < 10; ++i) {
+        check(makeRtp(65530 + i, 90000 + i * 3000, { 0x41 }));
+    }
+
+    // 切换到seq与时间戳完全不同的层
+    // Switch to a layer with completely different seq and timestamp
+    rewriter.switchSource();
+    for (uint16_t i = 0; i < 10; ++i) {
+        rtp = makeRtp(1000 + i, 5000000 + i * 3000, { 0x41 });
+        // 各层的ntp时间戳是同步的
+        // The ntp timestamps of each layer are synchronized
+        rtp->ntp_stamp = (90000 + (10 + i) * 3000) / 90;
+        auto out = check(rtp);
+        EXPECT(out != rtp);
+        // 不修改原包
+        // Do not modify the original packet
+        EXPECT(rtp->getSeq() == 1000 + i);
+    }
+
+    // 丢包后seq依然连续
+    // The seq is still continuous after dropping packets
+    rewriter.drop();
+    rewriter.drop();
+    for (uint16_t i = 12; i < 20; ++i) {
+        check(makeRtp(1000 + i, 5000000 + i * 3000, { 0x41 }));
+    }
+}
+
+static void testSelector() {
+    RtcLayerSelector selector;
+    vector<uint32_t> layers = { 300 * 1000, 1000 * 1000, 2500 * 1000 };
+    // 首次选择直接选取带宽允许的最高层
+    // Select the highest layer allowed by the bandwidth directly for the first time
+    EXPECT(selector.selectLayer(layers, layers.size(), 1500 * 1000, 0) == 1);
+    // 未开启带宽估计时选择最高层
+    // Select the highest layer when bandwidth estimation is not enabled
+    EXPECT(selector.selectLayer(layers, 1, 0, 0) == 2);
+    // 带宽不足时立即降档
+    // Switch down immediately when the bandwidth is insufficient
+    EXPECT(selector.selectLayer(layers, 1, 500 * 1000, 0) == 0);
+    // 带宽充足时需持续一段时间才逐级升档
+    // Switch up step by step only after the bandwidth stays sufficient for a while
+    EXPECT(selector.selectLayer(layers, 0, 5000 * 1000, 1000) == 0);
+    EXPECT(selector.selectLayer(layers, 0, 5000 * 1000, 3000) == 0);
+    EXPECT(selector.selectLayer(layers, 0, 5000 * 1000, 4000) == 1);
+    EXPECT(selector.selectLayer(layers, 1, 5000 * 1000, 4500) == 1);
+    // 带宽回落后升档计时重新开始
+    // The upgrade timing restarts after the bandwidth falls back
+    EXPECT(selector.selectLayer(layers, 1, 1500 * 1000, 5000) == 1);
+    EXPECT(selector.selectLayer(layers, 1, 5000 * 1000, 6000) == 1);
+    EXPECT(selector.selectLayer(layers, 1, 5000 * 1000, 8000) == 1);
+    EXPECT(selector.selectLayer(layers, 1, 5000 * 1000, 9000) == 2);
+
+    EXPECT(RtcLayerSelector::selectTemporalId(300 * 1000, 0) == TemporalLayerFilter::kAllLayers);
+    EXPECT(RtcLayerSelector::selectTemporalId(300 * 1000, 1000 * 1000) == TemporalLayerFilter::kAllLayers);
+    EXPECT(RtcLayerSelector::selectTemporalId(300 * 1000, 300 * 1000) == 1);
+    EXPECT(RtcLayerSelector::selectTemporalId(300 * 1000, 100 * 1000) == 0);
+}
+
+// 该测试程序用于验证webrtc播放simulcast/svc流时的关键帧识别、时域层过滤、rtp改写与层选择逻辑
+// This test program is used to verify the key frame detection, temporal layer filtering, rtp rewriting and layer selection logic when playing simulcast/svc streams by webrtc
+int main(int argc, char *argv[]) {
+    try {
+        testKeyFrame();
+        testTemporalFilterVP9();
+        testTemporalFilterAV1();
+        testRewriter();
+        testSelector();
+        cout << "test_webrtc_layer passed" << endl;
+        return 0;
+    } catch (const exception &ex) {
+        cerr << "test_webrtc_layer failed: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
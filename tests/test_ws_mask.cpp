@@ -0,0 +1,156 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <string>
+#include <random>
+#include <cstdlib>
+#include <iostream>
+#include "Http/WebSocketSplitter.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 逐字节异或的参考实现，与优化前的WebSocketSplitter一致
+// Byte-by-byte xor reference implementation, consistent with WebSocketSplitter before optimization
+static void maskRef(uint8_t *data, size_t len, const uint8_t *mask, size_t offset) {
+    for (size_t i = 0; i < len; ++i) {
+        data[i] ^= mask[(i + offset) % 4];
+    }
+}
+
+static string randomData(mt19937 &rng, size_t size) {
+    string ret(size, '\0');
+    for (auto &ch : ret) {
+        ch = (char)rng();
+    }
+    return ret;
+}
+
+/**
+ * 收集解码出的负载，并把编码数据拼接起来
+ * Collect the decoded payloads and join the encoded data
+ */
+class WebSocketSplitterTest : public WebSocketSplitter {
+public:
+    string payload;
+    string encoded;
+    size_t frames = 0;
+
+protected:
+    void onWebSocketDecodePayload(const WebSocketHeader &header, const uint8_t *ptr, size_t len, size_t recved) override {
+        payload.append((const char *)ptr, len);
+    }
+    void onWebSocketDecodeComplete(const WebSocketHeader &header) override { ++frames; }
+    void onWebSocketEncodeData(Buffer::Ptr buffer) override { encoded.append(buffer->data(), buffer->size()); }
+};
+
+static void testMask() {
+    mt19937 rng(12345);
+    for (int round = 0; round < 100000; ++round) {
+        // 覆盖各种长度、指针对齐与掩码偏移
+        // Cover all kinds of lengths, pointer alignments and mask offsets
+        auto data = randomData(rng, rng() % 100);
+        size_t begin = data.empty() ? 0 : rng() % data.size();
+        size_t offset = rng() % 7;
+        uint8_t mask[4] = { (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng() };
+        auto expect = data;
+        maskRef((uint8_t *)&expect[begin], expect.size() - begin, mask, offset);
+        maskWebSocketPayload((uint8_t *)&data[begin], data.size() - begin, mask, offset);
+        EXPECT(data == expect);
+    }
+}
+
+static void testSplitter() {
+    mt19937 rng(54321);
+    for (int round = 0; round < 2000; ++round) {
+        WebSocketSplitterTest splitter;
+        WebSocketHeader header;
+        header._fin = true;
+        header._reserved = 0;
+        header._opcode = WebSocketHeader::BINARY;
+        header._mask_flag = true;
+        header._mask.assign({ (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng() });
+
+        string payload;
+        auto frames = 1 + rng() % 3;
+        for (size_t i = 0; i < frames; ++i) {
+            auto data = randomData(rng, 1 + (rng() % 3 ? rng() % 200 : rng() % 70000));
+            payload += data;
+            auto expect = data;
+            maskRef((uint8_t *)&expect[0], expect.size(), header._mask.data(), 0);
+            auto size = splitter.encoded.size();
+            splitter.encode(header, std::make_shared<BufferString>(data));
+            // 编码后的负载与逐字节掩码一致
+            // The encoded payload is consistent with the byte-by-byte mask
+            EXPECT(splitter.encoded.compare(splitter.encoded.size() - expect.size(), expect.size(), expect) == 0);
+            EXPECT(splitter.encoded.size() > size);
+        }
+
+        // 随机拆分输入，验证_mask_offset在多次输入间衔接正确
+        // Split the input randomly to verify that _mask_offset continues correctly across multiple inputs
+        auto encoded = splitter.encoded;
+        for (size_t pos = 0; pos < encoded.size();) {
+            auto size = (std::min)(encoded.size() - pos, (size_t)(1 + rng() % 1000));
+            string slice = encoded.substr(pos, size);
+            splitter.decode((uint8_t *)&slice[0], slice.size());
+            pos += size;
+        }
+        EXPECT(splitter.frames == frames);
+        EXPECT(splitter.payload == payload);
+    }
+}
+
+template <typename FUNC>
+static double measure(string &data, FUNC &&func) {
+    double min_sec = 0;
+    // 多轮运行取最小值，减少缓存预热与调度的影响
+    // Run multiple rounds and take the minimum to reduce the impact of cache warm-up and scheduling
+    for (int round = 0; round < 5; ++round) {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < 20; ++i) {
+            func((uint8_t *)&data[0], data.size());
+        }
+        auto sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        min_sec = round ? (std::min)(min_sec, sec) : sec;
+    }
+    return data.size() * 20 / min_sec / 1e9;
+}
+
+static void bench(size_t size) {
+    mt19937 rng(size);
+    auto data = randomData(rng, size + 1);
+    uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    // 从奇数地址开始，模拟负载紧跟在websocket头之后的非对齐情况
+    // Start from an odd address to simulate the misalignment of the payload right after the websocket header
+    auto payload = data.substr(1);
+    auto legacy = measure(payload, [&](uint8_t *ptr, size_t len) { maskRef(ptr, len, mask, 1); });
+    auto fast = measure(payload, [&](uint8_t *ptr, size_t len) { maskWebSocketPayload(ptr, len, mask, 1); });
+    cout << "负载(payload):" << size << " 逐字节(byte by byte):" << legacy << "GB/s maskWebSocketPayload:" << fast << "GB/s" << endl;
+}
+
+// 该测试程序用于验证websocket负载掩码的正确性并测试其吞吐量
+// This test program is used to verify the correctness of the websocket payload mask and test its throughput
+int main(int argc, char *argv[]) {
+    try {
+        testMask();
+        testSplitter();
+        bench(1024);
+        bench(64 * 1024);
+        bench(4 * 1024 * 1024);
+        cout << "test_ws_mask passed" << endl;
+        return 0;
+    } catch (const exception &ex) {
+        cerr << "test_ws_mask failed: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
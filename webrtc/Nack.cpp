@@ -8,6 +8,8 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <atomic>
+#include <cstring>
 #include "Nack.h"
 #include "Common/config.h"
 
@@ -61,19 +63,44 @@ static onceToken token([]() {
 
 } // namespace Rtc
 
+static atomic<uint64_t> s_nack_requested { 0 };
+static atomic<uint64_t> s_nack_retransmitted { 0 };
+static atomic<uint64_t> s_nack_missed { 0 };
+
+NackList::Statistic NackList::getStatistic() {
+    Statistic ret;
+    ret.requested = s_nack_requested.load(memory_order_relaxed);
+    ret.retransmitted = s_nack_retransmitted.load(memory_order_relaxed);
+    ret.missed = s_nack_missed.load(memory_order_relaxed);
+    return ret;
+}
+
 void NackList::pushBack(RtpPacket::Ptr rtp) {
     GET_CONFIG(uint32_t, max_rtp_cache_ms, Rtc::kMaxRtpCacheMS);
     GET_CONFIG(uint32_t, max_rtp_cache_size, Rtc::kMaxRtpCacheSize);
 
+    // seq跨度不能超过其取值范围的一半，否则无法判断先后
+    // The seq span cannot exceed half of its value range, otherwise the order cannot be determined
+    auto max_size = std::max<uint32_t>(1, std::min<uint32_t>(max_rtp_cache_size, UINT16_MAX >> 1));
+    if (_nack_cache_pkt.capacity() < max_size) {
+        _nack_cache_pkt.setCapacity(max_size);
+    }
+
     // 记录rtp  [AUTO-TRANSLATED:f08e12e2]
     // Record rtp
     auto seq = rtp->getSeq();
-    _nack_cache_seq.emplace_back(seq);
-    _nack_cache_pkt.emplace(seq, std::move(rtp));
+    if (_nack_cache_pkt.empty() || (uint16_t)(seq - _end_seq) >= _nack_cache_pkt.capacity()) {
+        // seq回退或跳跃太大，之前的缓存都已失效
+        // Seq rolls back or jumps too far, all previous caches are invalid
+        _nack_cache_pkt.clear();
+        _begin_seq = seq;
+    }
+    _end_seq = seq + 1;
+    _nack_cache_pkt.emplace(seq, std::move(rtp), true);
 
     // 限制rtp缓存最大个数  [AUTO-TRANSLATED:a6bb50f5]
     // Limit the maximum number of rtp cache
-    if (_nack_cache_seq.size() > max_rtp_cache_size) {
+    while ((uint16_t)(_end_seq - _begin_seq) > max_size) {
         popFront();
     }
 
@@ -92,74 +119,94 @@ void NackList::pushBack(RtpPacket::Ptr rtp) {
 
 void NackList::forEach(const FCI_NACK &nack, const function<void(const RtpPacket::Ptr &rtp)> &func) {
     auto seq = nack.getPid();
-    for (auto bit : nack.getBitArray()) {
-        if (bit) {
-            // 丢包  [AUTO-TRANSLATED:ac2c9d55]
-            // Packet loss
-            RtpPacket::Ptr *ptr = getRtp(seq);
-            if (ptr) {
-                func(*ptr);
-            }
+    auto blp = nack.getBlp();
+    // pid对应的包必丢，blp记录其后16个包的丢包情况
+    // The packet of pid must be lost, blp records the loss of the following 16 packets
+    for (size_t i = 0; i <= FCI_NACK::kBitSize; ++i, ++seq) {
+        if (i && !(blp & (1 << (i - 1)))) {
+            continue;
+        }
+        // 丢包  [AUTO-TRANSLATED:ac2c9d55]
+        // Packet loss
+        RtpPacket::Ptr *ptr = getRtp(seq);
+        if (ptr) {
+            s_nack_retransmitted.fetch_add(1, memory_order_relaxed);
+            func(*ptr);
+        } else {
+            s_nack_missed.fetch_add(1, memory_order_relaxed);
         }
-        ++seq;
     }
 }
 
 void NackList::popFront() {
-    if (_nack_cache_seq.empty()) {
+    if (_nack_cache_pkt.empty()) {
+        _begin_seq = _end_seq;
         return;
     }
-    _nack_cache_pkt.erase(_nack_cache_seq.front());
-    _nack_cache_seq.pop_front();
+    auto index = _nack_cache_pkt.find(_begin_seq++);
+    if (index != _nack_cache_pkt.npos) {
+        _nack_cache_pkt.take(index);
+    }
+    // 跳过seq不连续产生的空槽位，保证_begin_seq总是指向最早的rtp
+    // Skip the empty slots caused by discontinuous seq, ensuring that _begin_seq always points to the earliest rtp
+    while (_begin_seq != _end_seq && _nack_cache_pkt.find(_begin_seq) == _nack_cache_pkt.npos) {
+        ++_begin_seq;
+    }
 }
 
 RtpPacket::Ptr *NackList::getRtp(uint16_t seq) {
-    auto it = _nack_cache_pkt.find(seq);
-    if (it == _nack_cache_pkt.end()) {
+    if ((uint16_t)(seq - _begin_seq) >= (uint16_t)(_end_seq - _begin_seq)) {
+        return nullptr;
+    }
+    auto index = _nack_cache_pkt.find(seq);
+    if (index == _nack_cache_pkt.npos) {
         return nullptr;
     }
-    return &it->second;
+    return &_nack_cache_pkt.at(index);
 }
 
 uint32_t NackList::getCacheMS() {
-    while (_nack_cache_seq.size() > 2) {
-        auto back_stamp = getNtpStamp(_nack_cache_seq.back());
-        if (back_stamp == -1) {
-            _nack_cache_seq.pop_back();
-            continue;
-        }
-
-        auto front_stamp = getNtpStamp(_nack_cache_seq.front());
-        if (front_stamp == -1) {
-            _nack_cache_seq.pop_front();
-            continue;
+    while (_nack_cache_pkt.size() > 2) {
+        auto back = getRtp(_end_seq - 1);
+        auto front = getRtp(_begin_seq);
+        if (!back || !front) {
+            break;
         }
-
+        // 使用ntp时间戳，不会回退  [AUTO-TRANSLATED:2d509f8f]
+        // Use ntp timestamp, will not roll back
+        auto back_stamp = (*back)->getStampMS(true);
+        auto front_stamp = (*front)->getStampMS(true);
         if (back_stamp >= front_stamp) {
             return back_stamp - front_stamp;
         }
         // ntp时间戳回退了，非法数据，丢掉  [AUTO-TRANSLATED:79ddf252]
         // Ntp timestamp has been rolled back, illegal data, discard
-        _nack_cache_seq.pop_front();
+        popFront();
     }
     return 0;
 }
 
-int64_t NackList::getNtpStamp(uint16_t seq) {
-    auto it = _nack_cache_pkt.find(seq);
-    if (it == _nack_cache_pkt.end()) {
-        return -1;
-    }
-    // 使用ntp时间戳，不会回退  [AUTO-TRANSLATED:2d509f8f]
-    // Use ntp timestamp, will not roll back
-    return it->second->getStampMS(true);
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 NackContext::NackContext(TrackType type) {
     _type = type;
     setOnNack(nullptr);
+    GET_CONFIG(uint32_t, nack_maxsize, Rtc::kNackMaxSize);
+    _nack_send_status.setCapacity(std::min<uint32_t>(nack_maxsize, UINT16_MAX >> 1));
+}
+
+bool NackContext::isReceived(uint16_t seq) const {
+    auto index = seq & (kReceivedWindow - 1);
+    return _received[index >> 6] & ((uint64_t)1 << (index & 63));
+}
+
+void NackContext::setReceived(uint16_t seq, bool received) {
+    auto index = seq & (kReceivedWindow - 1);
+    if (received) {
+        _received[index >> 6] |= (uint64_t)1 << (index & 63);
+    } else {
+        _received[index >> 6] &= ~((uint64_t)1 << (index & 63));
+    }
 }
 
 void NackContext::received(uint16_t seq, bool is_rtx) {
@@ -168,48 +215,43 @@ void NackContext::received(uint16_t seq, bool is_rtx) {
         // Record the first seq
         _started = true;
         _nack_seq = seq - 1;
+        _max_seq = _nack_seq;
     }
 
-    if (seq < _nack_seq && _nack_seq != UINT16_MAX && seq < 1024 && _nack_seq > UINT16_MAX - 1024) {
-        // seq回环,清空回环前状态  [AUTO-TRANSLATED:4cb8027e]
-        // Seq loop, clear the state before the loop
-        makeNack(UINT16_MAX, true);
-        _seq.emplace(seq);
+    uint16_t offset = seq - _nack_seq;
+    if (is_rtx || !offset || offset > (UINT16_MAX >> 1)) {
+        // seq回退包(已考虑回环)，猜测其为重传包，清空其nack状态
+        // Seq rollback packet (loop considered), guess it is a retransmission packet, clear its nack state
+        clearNackStatus(seq);
         return;
     }
 
-    if (is_rtx || (seq < _nack_seq && _nack_seq != UINT16_MAX)) {
-        // seq非回环回退包，猜测其为重传包，清空其nack状态  [AUTO-TRANSLATED:74c7b706]
-        // Seq non-loop rollback packet, guess it is a retransmission packet, clear its nack state
-        clearNackStatus(seq);
-        return;
+    if (offset >= kReceivedWindow) {
+        // seq跳跃太大，先发送已有的nack，超出窗口的丢包已无法重传，直接跳过
+        // The seq jump is too large, send the existing nack first, the packet loss beyond the window can no longer be retransmitted, skip it directly
+        makeNack(_max_seq, true);
+        memset(_received, 0, sizeof(_received));
+        _nack_seq = seq - 1;
+        _max_seq = _nack_seq;
     }
 
-    auto pr = _seq.emplace(seq);
-    if (!pr.second) {
+    if (isReceived(seq)) {
         // seq重复, 忽略  [AUTO-TRANSLATED:95ec10db]
         // Seq duplicate, ignore
         return;
     }
-
-    auto max_seq = *_seq.rbegin();
-    auto min_seq = *_seq.begin();
-    auto diff = max_seq - min_seq;
-    if (diff > (UINT16_MAX >> 1)) {
-        // 回环后，收到回环前的大值seq, 忽略掉  [AUTO-TRANSLATED:6a30b91f]
-        // After the loop, receive a large seq value before the loop, ignore it
-        _seq.erase(max_seq);
-        return;
+    setReceived(seq, true);
+    if ((uint16_t)(seq - _nack_seq) > (uint16_t)(_max_seq - _nack_seq)) {
+        _max_seq = seq;
     }
-    if (min_seq == (uint16_t)(_nack_seq + 1) && _seq.size() == (size_t)diff + 1) {
-        // 都是连续的seq，未丢包  [AUTO-TRANSLATED:62d3ffbd]
-        // All are continuous seq, no packet loss
-        _seq.clear();
-        _nack_seq = max_seq;
-    } else {
+
+    // 尝试移除前面部分连续的seq
+    // Try to remove the continuous seq in front
+    eraseFrontSeq();
+    if (_nack_seq != _max_seq) {
         // seq不连续，有丢包  [AUTO-TRANSLATED:ba1bfbc2]
         // Seq is not continuous, there is packet loss
-        makeNack(max_seq, false);
+        makeNack(_max_seq, false);
     }
 }
 
@@ -234,19 +276,18 @@ void NackContext::makeNack(uint16_t max_seq, bool flush) {
             // In non-flush state, the number of seq is not enough to send a nack
             break;
         }
-        vector<bool> vec;
-        vec.resize(nack_rtp_count, false);
+        uint16_t blp = 0;
         for (size_t i = 0; i < nack_rtp_count; ++i) {
-            vec[i] = _seq.find((uint16_t)(_nack_seq + i + 2)) == _seq.end();
+            if (!isReceived(_nack_seq + i + 2)) {
+                blp |= 1 << i;
+            }
+        }
+        doNack(FCI_NACK(_nack_seq + 1, blp), true);
+        // 移除 <=_nack_seq 的seq
+        // Remove seq <= _nack_seq
+        for (size_t i = 0; i <= nack_rtp_count; ++i) {
+            setReceived(++_nack_seq, false);
         }
-        doNack(FCI_NACK(_nack_seq + 1, vec), true);
-        _nack_seq += nack_rtp_count + 1;
-        // 返回第一个比_last_max_seq大的元素  [AUTO-TRANSLATED:425c4e63]
-        // Return the first element greater than _last_max_seq
-        auto it = _seq.upper_bound(_nack_seq);
-        // 移除 <=_last_max_seq 的seq  [AUTO-TRANSLATED:a64ff3fd]
-        // Remove seq <= _last_max_seq
-        _seq.erase(_seq.begin(), it);
     }
 }
 
@@ -259,6 +300,11 @@ void NackContext::setOnNack(onNack cb) {
 }
 
 void NackContext::doNack(const FCI_NACK &nack, bool record_nack) {
+    size_t count = 1;
+    for (auto blp = nack.getBlp(); blp; blp &= blp - 1) {
+        ++count;
+    }
+    s_nack_requested.fetch_add(count, memory_order_relaxed);
     if (record_nack) {
         recordNack(nack);
     }
@@ -268,26 +314,20 @@ void NackContext::doNack(const FCI_NACK &nack, bool record_nack) {
 void NackContext::eraseFrontSeq() {
     // 前面部分seq是连续的，未丢包，移除之  [AUTO-TRANSLATED:ef3eed87]
     // The previous part of the sequence is continuous and has no packet loss, remove it.
-    for (auto it = _seq.begin(); it != _seq.end();) {
-        if (*it != (uint16_t)(_nack_seq + 1)) {
-            // seq不连续，丢包了  [AUTO-TRANSLATED:dcee49fe]
-            // The sequence is not continuous, there is packet loss.
-            break;
-        }
-        _nack_seq = *it;
-        it = _seq.erase(it);
+    while (_nack_seq != _max_seq && isReceived(_nack_seq + 1)) {
+        setReceived(++_nack_seq, false);
     }
 }
 
 void NackContext::clearNackStatus(uint16_t seq) {
-    auto it = _nack_send_status.find(seq);
-    if (it == _nack_send_status.end()) {
+    auto index = _nack_send_status.find(seq);
+    if (index == _nack_send_status.npos) {
         return;
     }
     // 收到重传包与第一个nack包间的时间约等于rtt时间  [AUTO-TRANSLATED:f702811e]
     // The time between receiving the retransmitted packet and the first nack packet is approximately equal to the rtt time.
-    auto rtt = getCurrentMillisecond() - it->second.first_stamp;
-    _nack_send_status.erase(it);
+    auto rtt = getCurrentMillisecond() - _nack_send_status.at(index).first_stamp;
+    _nack_send_status.take(index);
 
     // 限定rtt在合理有效范围内  [AUTO-TRANSLATED:42fbed04]
     // Limit the rtt within a reasonable and valid range.
@@ -298,82 +338,119 @@ void NackContext::clearNackStatus(uint16_t seq) {
 
 void NackContext::recordNack(const FCI_NACK &nack) {
     auto now = getCurrentMillisecond();
-    auto i = nack.getPid();
-    for (auto flag : nack.getBitArray()) {
-        if (flag) {
-            auto &ref = _nack_send_status[i];
-            ref.first_stamp = now;
-            ref.update_stamp = now;
-            ref.nack_count = 1;
+    auto seq = nack.getPid();
+    auto blp = nack.getBlp();
+    recordNack(seq, now);
+    for (size_t i = 0; i < FCI_NACK::kBitSize; ++i) {
+        ++seq;
+        if (blp & (1 << i)) {
+            recordNack(seq, now);
         }
-        ++i;
     }
     // 记录太多了，移除一部分早期的记录  [AUTO-TRANSLATED:6f4ea62d]
     // There are too many records, remove some of the earlier records.
     GET_CONFIG(uint32_t, nack_maxsize, Rtc::kNackMaxSize);
     while (_nack_send_status.size() > nack_maxsize) {
-        _nack_send_status.erase(_nack_send_status.begin());
+        auto index = _nack_send_status.findNext(_status_begin);
+        _status_begin = _nack_send_status.seqAt(index) + 1;
+        _nack_send_status.take(index);
+    }
+}
+
+void NackContext::recordNack(uint16_t seq, uint64_t now) {
+    if (_nack_send_status.empty() || (uint16_t)(seq - _status_begin) > (UINT16_MAX >> 1)) {
+        // seq回退，之前的记录都已失效
+        // Seq rolls back, all previous records are invalid
+        _nack_send_status.clear();
+        _status_begin = seq;
+    }
+    // 环形缓存只能容纳capacity个seq，优先扩容(不超过seq取值范围的一半)，否则移除过早的记录
+    // The ring buffer can only hold capacity seqs, expand it first (no more than half of the seq value range), otherwise remove the records that are too early
+    while (!_nack_send_status.empty() && (uint16_t)(seq - _status_begin) >= _nack_send_status.capacity()
+           && _nack_send_status.capacity() <= (UINT16_MAX >> 2)) {
+        _nack_send_status.setCapacity(_nack_send_status.capacity() << 1);
+    }
+    while (!_nack_send_status.empty() && (uint16_t)(seq - _status_begin) >= _nack_send_status.capacity()) {
+        auto index = _nack_send_status.findNext(_status_begin);
+        auto front = _nack_send_status.seqAt(index);
+        if ((uint16_t)(seq - front) < _nack_send_status.capacity()) {
+            _status_begin = front;
+            break;
+        }
+        _nack_send_status.take(index);
+        _status_begin = front + 1;
+    }
+    if (_nack_send_status.empty()) {
+        _status_begin = seq;
+    }
+
+    NackStatus status;
+    status.first_stamp = now;
+    status.update_stamp = now;
+    status.nack_count = 1;
+    auto index = _nack_send_status.find(seq);
+    if (index != _nack_send_status.npos) {
+        _nack_send_status.at(index) = status;
+    } else {
+        _nack_send_status.emplace(seq, status, false);
     }
 }
 
 uint64_t NackContext::reSendNack() {
-    set<uint16_t> nack_rtp;
     auto now = getCurrentMillisecond();
     GET_CONFIG(uint32_t, nack_maxms, Rtc::kNackMaxMS);
     GET_CONFIG(uint32_t, nack_maxcount, Rtc::kNackMaxCount);
     GET_CONFIG(float, nack_intervalratio, Rtc::kNackIntervalRatio);
-    for (auto it = _nack_send_status.begin(); it != _nack_send_status.end();) {
-        if (now - it->second.first_stamp > nack_maxms) {
+
+    int pid = -1;
+    uint16_t blp = 0;
+    auto seq = _status_begin;
+    // 从最早的记录开始按seq顺序遍历
+    // Traverse in seq order starting from the earliest record
+    for (auto count = _nack_send_status.size(); count; --count) {
+        auto index = _nack_send_status.findNext(seq);
+        seq = _nack_send_status.seqAt(index);
+        auto &status = _nack_send_status.at(index);
+        if (now - status.first_stamp > nack_maxms) {
             // 该rtp丢失太久了，不再要求重传  [AUTO-TRANSLATED:a0a1e471]
             // This rtp has been lost for too long, no longer require retransmission.
-            it = _nack_send_status.erase(it);
+            _nack_send_status.take(index);
+            ++seq;
             continue;
         }
-        if (now - it->second.update_stamp < nack_intervalratio * _rtt) {
+        if (now - status.update_stamp < nack_intervalratio * _rtt) {
             // 距离上次nack不足2倍的rtt，不用再发送nack  [AUTO-TRANSLATED:0e7edf4d]
             // The distance from the last nack is less than 2 times the rtt, no need to send nack again.
-            ++it;
+            ++seq;
             continue;
         }
         // 此rtp需要请求重传  [AUTO-TRANSLATED:c29d8eb5]
         // This rtp needs to request retransmission.
-        nack_rtp.emplace(it->first);
+        if (pid != -1 && (uint16_t)(seq - pid) <= FCI_NACK::kBitSize) {
+            // 这个包丢了  [AUTO-TRANSLATED:60f91f2f]
+            // This packet is lost.
+            blp |= 1 << ((uint16_t)(seq - pid) - 1);
+        } else {
+            if (pid != -1) {
+                // 新的nack包  [AUTO-TRANSLATED:aec9b818]
+                // New nack packet.
+                doNack(FCI_NACK(pid, blp), false);
+            }
+            pid = seq;
+            blp = 0;
+        }
         // 更新nack发送时间戳  [AUTO-TRANSLATED:16ef9fac]
         // Update the nack sending timestamp.
-        it->second.update_stamp = now;
-        if (++(it->second.nack_count) == nack_maxcount) {
+        status.update_stamp = now;
+        if (++status.nack_count == nack_maxcount) {
             // nack次数太多，移除之  [AUTO-TRANSLATED:1b684a9c]
             // Too many nack times, remove it.
-            it = _nack_send_status.erase(it);
-            continue;
+            _nack_send_status.take(index);
         }
-        ++it;
-    }
-
-    int pid = -1;
-    vector<bool> vec;
-    for (auto it = nack_rtp.begin(); it != nack_rtp.end();) {
-        if (pid == -1) {
-            pid = *it;
-            vec.assign(FCI_NACK::kBitSize, false);
-            ++it;
-            continue;
-        }
-        auto inc = *it - pid;
-        if (inc > (ssize_t)FCI_NACK::kBitSize) {
-            // 新的nack包  [AUTO-TRANSLATED:aec9b818]
-            // New nack packet.
-            doNack(FCI_NACK(pid, vec), false);
-            pid = -1;
-            continue;
-        }
-        // 这个包丢了  [AUTO-TRANSLATED:60f91f2f]
-        // This packet is lost.
-        vec[inc - 1] = true;
-        ++it;
+        ++seq;
     }
     if (pid != -1) {
-        doNack(FCI_NACK(pid, vec), false);
+        doNack(FCI_NACK(pid, blp), false);
     }
 
     // 没有任何包需要重传时返回0，否则返回下次重传间隔(不得低于5ms)  [AUTO-TRANSLATED:c326264d]
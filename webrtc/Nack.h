@@ -11,11 +11,8 @@
 #ifndef ZLMEDIAKIT_NACK_H
 #define ZLMEDIAKIT_NACK_H
 
-#include <set>
-#include <map>
-#include <deque>
-#include <unordered_map>
 #include "Rtsp/Rtsp.h"
+#include "Rtsp/RtpReceiver.h"
 #include "Rtcp/RtcpFCI.h"
 
 namespace mediakit {
@@ -35,19 +32,37 @@ extern const std::string kNackMaxMS;
 
 class NackList {
 public:
+    // nack统计，所有连接累计
+    // Nack statistics, accumulated over all connections
+    struct Statistic {
+        // 向对端请求重传的rtp个数(含重复请求)
+        // Number of rtp requested from the peer for retransmission (including repeated requests)
+        uint64_t requested = 0;
+        // 对端请求重传的rtp中，已重传的个数与已不在缓存中的个数
+        // Among the rtp requested by the peer, the number retransmitted and the number no longer in the cache
+        uint64_t retransmitted = 0;
+        uint64_t missed = 0;
+    };
+
+    static Statistic getStatistic();
+
     void pushBack(RtpPacket::Ptr rtp);
     void forEach(const FCI_NACK &nack, const std::function<void(const RtpPacket::Ptr &rtp)> &cb);
 
 private:
     void popFront();
     uint32_t getCacheMS();
-    int64_t getNtpStamp(uint16_t seq);
     RtpPacket::Ptr *getRtp(uint16_t seq);
 
 private:
     uint32_t _cache_ms_check = 0;
-    std::deque<uint16_t> _nack_cache_seq;
-    std::unordered_map<uint16_t, RtpPacket::Ptr> _nack_cache_pkt;
+    // 缓存中最早与最新的rtp seq  [begin, end)
+    // The earliest and latest rtp seq in the cache [begin, end)
+    uint16_t _begin_seq = 0;
+    uint16_t _end_seq = 0;
+    // 以seq为下标的rtp重传缓存，不产生内存分配
+    // Rtp retransmission cache indexed by seq, no memory allocation
+    SeqRingBuffer<RtpPacket::Ptr> _nack_cache_pkt;
 };
 
 class NackContext {
@@ -65,25 +80,41 @@ private:
     void eraseFrontSeq();
     void doNack(const FCI_NACK &nack, bool record_nack);
     void recordNack(const FCI_NACK &nack);
+    void recordNack(uint16_t seq, uint64_t now);
     void clearNackStatus(uint16_t seq);
     void makeNack(uint16_t max, bool flush = false);
 
+    bool isReceived(uint16_t seq) const;
+    void setReceived(uint16_t seq, bool received);
+
 private:
+    // 已收到的rtp seq位图窗口大小，超过此距离的丢包已无法重传
+    // Bitmap window size of received rtp seq, packet loss beyond this distance can no longer be retransmitted
+    static constexpr size_t kReceivedWindow = 2048;
+
     bool _started = false;
     int _rtt = 50;
     TrackType _type;
     onNack _cb;
-    std::set<uint16_t> _seq;
     // 最新nack包中的rtp seq值  [AUTO-TRANSLATED:6984d95a]
     // RTP seq value in the latest nack packet
     uint16_t _nack_seq = 0;
+    // 已收到的最大rtp seq
+    // The largest rtp seq received
+    uint16_t _max_seq = 0;
+    // (_nack_seq, _nack_seq + kReceivedWindow)范围内已收到的rtp seq位图
+    // Bitmap of rtp seq received in the range of (_nack_seq, _nack_seq + kReceivedWindow)
+    uint64_t _received[kReceivedWindow / 64] = { 0 };
 
     struct NackStatus {
         uint64_t first_stamp;
         uint64_t update_stamp;
         uint32_t nack_count = 0;
     };
-    std::map<uint16_t /*seq*/, NackStatus> _nack_send_status;
+    // 最早的nack状态seq
+    // The earliest seq of nack status
+    uint16_t _status_begin = 0;
+    SeqRingBuffer<NackStatus> _nack_send_status;
 };
 
 } // namespace mediakit
@@ -0,0 +1,182 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <mutex>
+#include <unordered_map>
+#include "RtcAudioTranscoder.h"
+#include "WebRtcTransport.h"
+#include "Common/config.h"
+#include "Extension/Factory.h"
+#include "Rtsp/RtspMuxer.h"
+#include "Codec/Transcode.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+#if defined(ENABLE_FFMPEG)
+
+// 转码后opus的payload type，发送前会被改写为协商值
+// Payload type of the transcoded opus, it will be rewritten to the negotiated value before sending
+static constexpr uint8_t kOpusPayloadType = 111;
+
+bool RtcAudioTranscoder::needTranscode(const string &sdp) {
+    GET_CONFIG(bool, transcode_aac, Rtc::kTranscodeAac);
+    GET_CONFIG(bool, transcode_g711, Rtc::kTranscodeG711);
+    if (!transcode_aac && !transcode_g711) {
+        return false;
+    }
+    auto audio_sdp = SdpParser(sdp).getTrack(TrackAudio);
+    auto audio = audio_sdp ? Factory::getTrackBySdp(audio_sdp) : nullptr;
+    if (!audio) {
+        return false;
+    }
+    switch (audio->getCodecId()) {
+        case CodecAAC: return transcode_aac;
+        case CodecG711A:
+        case CodecG711U: return transcode_g711;
+        default: return false;
+    }
+}
+
+string RtcAudioTranscoder::makePlaySdp(const string &sdp) {
+    SdpParser parser(sdp);
+    auto title = parser.getTrack(TrackTitle);
+    auto video = parser.getTrack(TrackVideo);
+    auto audio = parser.getTrack(TrackAudio);
+    auto opus = Factory::getTrackByCodecId(CodecOpus, 48000, 2, 16);
+    auto opus_sdp = opus ? opus->getSdp(kOpusPayloadType) : nullptr;
+    if (!audio || !opus_sdp) {
+        return sdp;
+    }
+    string ret = (title ? title->toString() : "") + (video ? video->toString() : "") + opus_sdp->getSdp();
+    if (!audio->_control.empty()) {
+        ret += "a=control:" + audio->_control + "\r\n";
+    }
+    return ret;
+}
+
+RtcAudioTranscoder::Ptr RtcAudioTranscoder::get(const RtspMediaSource::Ptr &src) {
+    static mutex s_mtx;
+    static unordered_map<const void *, weak_ptr<RtcAudioTranscoder>> s_transcoders;
+
+    lock_guard<mutex> lck(s_mtx);
+    for (auto it = s_transcoders.begin(); it != s_transcoders.end();) {
+        it = it->second.expired() ? s_transcoders.erase(it) : std::next(it);
+    }
+    auto &ref = s_transcoders[src.get()];
+    auto ret = ref.lock();
+    // 源流对象地址可能被新的源流复用，需核对源流
+    // The address of the source stream object may be reused by a new source stream, the source stream needs to be checked
+    if (ret && ret->_src.lock() == src) {
+        return ret;
+    }
+    try {
+        ret.reset(new RtcAudioTranscoder(src));
+    } catch (std::exception &ex) {
+        WarnL << "create webrtc audio transcoder failed: " << src->getMediaTuple().shortUrl() << ", " << ex.what();
+        return nullptr;
+    }
+    ref = ret;
+    ret->start();
+    return ret;
+}
+
+RtcAudioTranscoder::RtcAudioTranscoder(const RtspMediaSource::Ptr &src) {
+    _src = src;
+    _ring = std::make_shared<RtpRing::RingType>();
+    // 与RtspMuxer一样在写入环形缓存前设置ntp时间戳
+    // Set the ntp timestamp before writing to the ring buffer, the same as RtspMuxer
+    _rtp_interceptor = std::make_shared<RtpRing::RingType>();
+    _rtp_interceptor->setDelegate(std::make_shared<RingDelegateHelper>([this](RtpPacket::Ptr in, bool is_key) {
+        in->ntp_stamp += _ntp_stamp_offset.load();
+        _ring->write(std::move(in), is_key);
+    }));
+
+    // 同步创建转码器与rtp打包器，失败时抛异常，以便播放器在协商前回退为源流音频
+    // Create the transcoder and rtp packer synchronously, throw an exception on failure so that the player can fall back to the source audio before negotiation
+    auto audio = src->getTrack(TrackAudio);
+    if (!audio) {
+        throw std::runtime_error("the source stream has no audio track");
+    }
+    _transcoder = TaskManager::create<FFmpegAudioTranscoder>(audio, CodecOpus);
+    _transcoder->setTaskName(src->getMediaTuple().shortUrl());
+    _encoder = Factory::getRtpEncoderByCodecId(CodecOpus, kOpusPayloadType);
+    if (!_encoder) {
+        throw std::runtime_error("create opus rtp encoder failed");
+    }
+    GET_CONFIG(uint32_t, audio_mtu, Rtp::kAudioMtuSize);
+    _encoder->setRtpInfo(1, audio_mtu, 48000, kOpusPayloadType, 2 * TrackAudio, audio->getIndex());
+    _encoder->setRtpRing(_rtp_interceptor);
+    // 转码输出在编解码线程中串行触发，rtp打包器只在该线程中使用
+    // The transcoding output is triggered serially in the codec thread, and the rtp packer is only used in that thread
+    auto encoder = _encoder.get();
+    _transcoder->setOnOutput([encoder](const Frame::Ptr &frame) { encoder->inputFrame(frame); });
+    _audio_index = audio->getIndex();
+    InfoL << "webrtc audio transcoder created: " << src->getMediaTuple().shortUrl() << ", " << audio->getCodecName() << " -> opus";
+}
+
+RtcAudioTranscoder::~RtcAudioTranscoder() {
+    // 先停止读取源流与转码，再释放rtp打包器与环形缓存
+    // Stop reading the source stream and transcoding first, then release the rtp packer and ring buffer
+    _reader = nullptr;
+    _transcoder = nullptr;
+    InfoL << "webrtc audio transcoder released";
+}
+
+void RtcAudioTranscoder::start() {
+    auto src = _src.lock();
+    if (!src) {
+        return;
+    }
+    weak_ptr<RtcAudioTranscoder> weak_self = shared_from_this();
+    try {
+        // 帧环形缓存只能在源流线程中读取
+        // The frame ring buffer can only be read in the source stream thread
+        src->getOwnerPoller()->async([weak_self]() {
+            auto strong_self = weak_self.lock();
+            auto src = strong_self ? strong_self->_src.lock() : nullptr;
+            if (!src) {
+                return;
+            }
+            auto muxer = src->getMuxer();
+            if (!muxer) {
+                WarnL << "start webrtc audio transcoder failed: " << src->getMediaTuple().shortUrl() << ", the source stream has no muxer";
+                return;
+            }
+            strong_self->_reader = muxer->getFrameReader();
+            strong_self->_reader->setReadCB([weak_self](const Frame::Ptr &frame) {
+                if (auto strong_self = weak_self.lock()) {
+                    strong_self->onFrame(frame);
+                }
+            });
+        });
+    } catch (std::exception &ex) {
+        WarnL << "start webrtc audio transcoder failed: " << ex.what();
+    }
+}
+
+void RtcAudioTranscoder::onFrame(const Frame::Ptr &frame) {
+    if (frame->getIndex() != _audio_index) {
+        return;
+    }
+    if (!_ntp_stamp_inited) {
+        // 以首帧的接收时间近似源流时间戳对应的ntp时间
+        // Approximate the ntp time corresponding to the source stream timestamp with the receiving time of the first frame
+        _ntp_stamp_inited = true;
+        _ntp_stamp_offset = (int64_t)getCurrentMillisecond(true) - (int64_t)frame->dts();
+    }
+    _transcoder->inputFrame(frame);
+}
+
+#endif // ENABLE_FFMPEG
+
+} // namespace mediakit
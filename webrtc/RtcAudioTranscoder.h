@@ -0,0 +1,92 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_RTCAUDIOTRANSCODER_H
+#define ZLMEDIAKIT_RTCAUDIOTRANSCODER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "Rtsp/RtpCodec.h"
+#include "Rtsp/RtspMediaSource.h"
+#include "Common/MultiMediaSourceMuxer.h"
+
+namespace mediakit {
+
+#if defined(ENABLE_FFMPEG)
+
+class FFmpegAudioTranscoder;
+
+/**
+ * webrtc播放时的音频转码，把源流的aac/g711音频转码为opus并打包为rtp
+ * 每个源流只有一个实例，由该流的所有webrtc播放器共享，首个需要转码的播放器创建，最后一个播放器离开时销毁
+ * 源流音频帧在源流线程中读取，转码在共享编解码线程池中执行，转码后的rtp通过环形缓存分发给各播放器
+ * Audio transcoding for webrtc playback, transcode the aac/g711 audio of the source stream to opus and pack it into rtp
+ * There is only one instance per source stream, shared by all webrtc players of the stream, created by the first player that needs transcoding
+ * and destroyed when the last player leaves
+ * The audio frames of the source stream are read in the source stream thread, the transcoding is executed in the shared codec thread pool,
+ * and the transcoded rtp is distributed to each player through the ring buffer
+ */
+class RtcAudioTranscoder : public std::enable_shared_from_this<RtcAudioTranscoder> {
+public:
+    using Ptr = std::shared_ptr<RtcAudioTranscoder>;
+
+    ~RtcAudioTranscoder();
+
+    /**
+     * 根据配置判断播放该sdp的流时是否需要音频转码
+     * Determine whether audio transcoding is required when playing the stream of the sdp according to the configuration
+     */
+    static bool needTranscode(const std::string &sdp);
+
+    /**
+     * 把sdp中的音频替换为opus，用于webrtc协商
+     * Replace the audio in the sdp with opus for webrtc negotiation
+     */
+    static std::string makePlaySdp(const std::string &sdp);
+
+    /**
+     * 获取源流的音频转码器，不存在时创建，创建失败返回nullptr
+     * Get the audio transcoder of the source stream, create it if it does not exist, return nullptr if the creation fails
+     */
+    static Ptr get(const RtspMediaSource::Ptr &src);
+
+    /**
+     * 转码后的opus rtp
+     * The transcoded opus rtp
+     */
+    const RtpRing::RingType::Ptr &getRing() const { return _ring; }
+
+private:
+    // 创建转码器失败时抛异常
+    // Throw an exception when the transcoder creation fails
+    RtcAudioTranscoder(const RtspMediaSource::Ptr &src);
+
+    void start();
+    void onFrame(const Frame::Ptr &frame);
+
+private:
+    // 源流时间戳与ntp时间戳的差值，单位毫秒
+    // The difference between the source stream timestamp and the ntp timestamp, in milliseconds
+    std::atomic<int64_t> _ntp_stamp_offset { 0 };
+    bool _ntp_stamp_inited = false;
+    int _audio_index = -1;
+    std::weak_ptr<RtspMediaSource> _src;
+    RtpRing::RingType::Ptr _ring;
+    RtpRing::RingType::Ptr _rtp_interceptor;
+    RtpCodec::Ptr _encoder;
+    std::shared_ptr<FFmpegAudioTranscoder> _transcoder;
+    MultiMediaSourceMuxer::RingType::RingReader::Ptr _reader;
+};
+
+#endif // ENABLE_FFMPEG
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_RTCAUDIOTRANSCODER_H
@@ -0,0 +1,390 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "RtcLayerSelector.h"
+#include "RtpExt.h"
+#include "WebRtcTransport.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 选择层时为估计带宽保留的余量
+// The margin reserved for the estimated bandwidth when selecting layers
+static constexpr float kBandwidthHeadroom = 0.85f;
+
+static bool isH264KeyNal(uint8_t type) {
+    // idr或sps
+    // idr or sps
+    return type == 5 || type == 7;
+}
+
+static bool isH265KeyNal(uint8_t type) {
+    // irap或vps/sps/pps
+    // irap or vps/sps/pps
+    return (type >= 16 && type <= 21) || (type >= 32 && type <= 34);
+}
+
+static bool isH264KeyFrameStart(const uint8_t *ptr, size_t size) {
+    if (size < 2) {
+        return false;
+    }
+    auto type = ptr[0] & 0x1F;
+    switch (type) {
+        case 24: {
+            // STAP-A
+            size_t offset = 1;
+            while (offset + 3 <= size) {
+                if (isH264KeyNal(ptr[offset + 2] & 0x1F)) {
+                    return true;
+                }
+                offset += 2 + (ptr[offset] << 8 | ptr[offset + 1]);
+            }
+            return false;
+        }
+        // FU-A
+        case 28: return (ptr[1] & 0x80) && isH264KeyNal(ptr[1] & 0x1F);
+        default: return isH264KeyNal(type);
+    }
+}
+
+static bool isH265KeyFrameStart(const uint8_t *ptr, size_t size) {
+    if (size < 3) {
+        return false;
+    }
+    auto type = (ptr[0] >> 1) & 0x3F;
+    switch (type) {
+        case 48: {
+            // AP
+            size_t offset = 2;
+            while (offset + 4 <= size) {
+                if (isH265KeyNal((ptr[offset + 2] >> 1) & 0x3F)) {
+                    return true;
+                }
+                offset += 2 + (ptr[offset] << 8 | ptr[offset + 1]);
+            }
+            return false;
+        }
+        // FU
+        case 49: return (ptr[2] & 0x80) && isH265KeyNal(ptr[2] & 0x3F);
+        default: return isH265KeyNal(type);
+    }
+}
+
+// https://datatracker.ietf.org/doc/html/rfc7741#section-4.2
+static bool isVP8KeyFrameStart(const uint8_t *ptr, size_t size) {
+    // S位为1且分区号为0时才是帧的第一个包
+    // Only when the S bit is 1 and the partition index is 0 is it the first packet of a frame
+    if (size < 1 || !(ptr[0] & 0x10) || (ptr[0] & 0x07)) {
+        return false;
+    }
+    size_t offset = 1;
+    if (ptr[0] & 0x80) {
+        if (size < 2) {
+            return false;
+        }
+        auto ext = ptr[1];
+        offset = 2;
+        if (ext & 0x80) {
+            // picture id, M位为1时占两个字节
+            // picture id, occupies two bytes when the M bit is 1
+            if (offset >= size) {
+                return false;
+            }
+            offset += (ptr[offset] & 0x80) ? 2 : 1;
+        }
+        if (ext & 0x40) {
+            // TL0PICIDX
+            ++offset;
+        }
+        if (ext & 0x30) {
+            // TID/KEYIDX
+            ++offset;
+        }
+    }
+    // vp8负载头P位为0表示关键帧
+    // The P bit of the vp8 payload header is 0 for key frames
+    return offset < size && !(ptr[offset] & 0x01);
+}
+
+// https://datatracker.ietf.org/doc/html/draft-ietf-payload-vp9#section-4.2
+static bool isVP9KeyFrameStart(const uint8_t *ptr, size_t size) {
+    // P位为0(不依赖之前的帧)且B位为1(帧的第一个包)
+    // The P bit is 0 (does not depend on previous frames) and the B bit is 1 (first packet of the frame)
+    if (size < 1 || (ptr[0] & 0x40) || !(ptr[0] & 0x08)) {
+        return false;
+    }
+    if (!(ptr[0] & 0x20)) {
+        return true;
+    }
+    // 存在层信息时，只在最低空间层切换
+    // When layer information exists, only switch at the lowest spatial layer
+    size_t offset = 1;
+    if (ptr[0] & 0x80) {
+        if (offset >= size) {
+            return false;
+        }
+        offset += (ptr[offset] & 0x80) ? 2 : 1;
+    }
+    return offset < size && ((ptr[offset] >> 1) & 0x07) == 0;
+}
+
+// https://aomediacodec.github.io/av1-rtp-spec/#44-av1-aggregation-header
+static bool isAV1KeyFrameStart(const uint8_t *ptr, size_t size) {
+    // N位为1表示新的编码视频序列的第一个包
+    // The N bit is 1 for the first packet of a new coded video sequence
+    return size >= 1 && (ptr[0] & 0x08);
+}
+
+bool RtpLayerHelper::isKeyFrameStart(CodecId codec, const RtpPacket::Ptr &rtp) {
+    auto ptr = rtp->getPayload();
+    auto size = rtp->getPayloadSize();
+    switch (codec) {
+        case CodecH264: return isH264KeyFrameStart(ptr, size);
+        case CodecH265: return isH265KeyFrameStart(ptr, size);
+        case CodecVP8: return isVP8KeyFrameStart(ptr, size);
+        case CodecVP9: return isVP9KeyFrameStart(ptr, size);
+        case CodecAV1: return isAV1KeyFrameStart(ptr, size);
+        default: return false;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t readBits(const uint8_t *ptr, size_t size, size_t &pos, size_t bits) {
+    uint32_t ret = 0;
+    for (size_t i = 0; i < bits; ++i, ++pos) {
+        ret <<= 1;
+        if (pos < size * 8) {
+            ret |= (ptr[pos / 8] >> (7 - pos % 8)) & 0x01;
+        }
+    }
+    return ret;
+}
+
+void TemporalLayerFilter::setMaxTemporalId(uint8_t tid) {
+    _target_tid = tid;
+    if (tid < _max_tid) {
+        // 丢弃高时域层不影响低时域层解码，立即生效
+        // Discarding high temporal layers does not affect the decoding of low temporal layers, takes effect immediately
+        _max_tid = tid;
+    }
+}
+
+void TemporalLayerFilter::reset() {
+    _template_id_offset = 0;
+    _template_tid.clear();
+    _av1_tid = -1;
+}
+
+bool TemporalLayerFilter::input(const RtpPacket::Ptr &rtp) {
+    if (_codec != CodecVP9 && _codec != CodecAV1) {
+        return true;
+    }
+    auto tid = getTemporalId(rtp);
+    if (tid < 0) {
+        return true;
+    }
+    if (tid == 0 && _target_tid > _max_tid) {
+        // 后续高时域层帧只参考该基础层帧及之后的帧，可以恢复
+        // Subsequent high temporal layer frames only refer to this base layer frame and later frames, can be restored
+        _max_tid = _target_tid;
+    }
+    return tid <= _max_tid;
+}
+
+int TemporalLayerFilter::getTemporalId(const RtpPacket::Ptr &rtp) {
+    int tid = -1;
+    if (rtp->getHeader()->ext) {
+        tid = getDependencyDescriptorTemporalId(rtp);
+    }
+    if (tid < 0) {
+        tid = _codec == CodecVP9 ? getVP9TemporalId(rtp) : getAV1TemporalId(rtp);
+    }
+    return tid;
+}
+
+int TemporalLayerFilter::getVP9TemporalId(const RtpPacket::Ptr &rtp) const {
+    auto ptr = rtp->getPayload();
+    auto size = rtp->getPayloadSize();
+    // L位为0时不存在层信息
+    // There is no layer information when the L bit is 0
+    if (size < 1 || !(ptr[0] & 0x20)) {
+        return -1;
+    }
+    size_t offset = 1;
+    if (ptr[0] & 0x80) {
+        if (offset >= size) {
+            return -1;
+        }
+        offset += (ptr[offset] & 0x80) ? 2 : 1;
+    }
+    return offset < size ? ptr[offset] >> 5 : -1;
+}
+
+// https://aomediacodec.github.io/av1-rtp-spec/#5-packetization-rules
+int TemporalLayerFilter::getAV1TemporalId(const RtpPacket::Ptr &rtp) {
+    auto ptr = rtp->getPayload();
+    auto size = rtp->getPayloadSize();
+    auto stamp = rtp->getStamp();
+    // Z位为1表示第一个obu是上一个包的延续，沿用同一帧已解析的时域层
+    // The Z bit is 1 means the first obu is the continuation of the previous packet, use the temporal layer parsed for the same frame
+    if (size >= 2 && !(ptr[0] & 0x80)) {
+        size_t offset = 1;
+        if (((ptr[0] >> 4) & 0x03) != 1) {
+            // 跳过leb128编码的obu长度
+            // Skip the leb128 encoded obu length
+            while (offset < size && (ptr[offset++] & 0x80)) {}
+        }
+        // obu扩展头中包含temporal_id
+        // The obu extension header contains temporal_id
+        if (offset + 1 < size && (ptr[offset] & 0x04)) {
+            _av1_tid = ptr[offset + 1] >> 5;
+            _av1_stamp = stamp;
+            return _av1_tid;
+        }
+    }
+    return stamp == _av1_stamp ? _av1_tid : -1;
+}
+
+// https://aomediacodec.github.io/av1-rtp-spec/#dependency-descriptor-format
+int TemporalLayerFilter::getDependencyDescriptorTemporalId(const RtpPacket::Ptr &rtp) {
+    auto ext_map = RtpExt::getExtValue(rtp->getHeader());
+    auto it = ext_map.find((uint8_t)RtpExtType::av1);
+    if (it == ext_map.end()) {
+        return -1;
+    }
+    it->second.setType(RtpExtType::av1);
+    size_t size;
+    auto ptr = it->second.getDependencyDescriptor(size);
+    if (size < 3) {
+        return -1;
+    }
+    size_t pos = 0;
+    // start_of_frame, end_of_frame
+    readBits(ptr, size, pos, 2);
+    auto template_id = readBits(ptr, size, pos, 6);
+    // frame_number
+    readBits(ptr, size, pos, 16);
+    if (size > 3) {
+        auto structure_present = readBits(ptr, size, pos, 1);
+        // active_decode_targets_present_flag, custom_dtis_flag, custom_fdiffs_flag, custom_chains_flag
+        readBits(ptr, size, pos, 4);
+        if (structure_present) {
+            // 只解析template_layers，获取各模板的时域层
+            // Only parse template_layers to get the temporal layer of each template
+            _template_id_offset = readBits(ptr, size, pos, 6);
+            // dt_cnt_minus_one
+            readBits(ptr, size, pos, 5);
+            _template_tid.clear();
+            uint8_t tid = 0;
+            uint32_t next_layer_idc;
+            do {
+                _template_tid.emplace_back(tid);
+                next_layer_idc = readBits(ptr, size, pos, 2);
+                if (next_layer_idc == 1) {
+                    ++tid;
+                } else if (next_layer_idc == 2) {
+                    tid = 0;
+                }
+            } while (next_layer_idc != 3 && _template_tid.size() < 64 && pos < size * 8);
+        }
+    }
+    auto index = (template_id + 64 - _template_id_offset) % 64;
+    return index < _template_tid.size() ? _template_tid[index] : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+RtpPacket::Ptr RtpStreamRewriter::rewrite(const RtpPacket::Ptr &rtp) {
+    auto seq = rtp->getSeq();
+    auto stamp = rtp->getStamp();
+    if (_switching && _started) {
+        // 新数据源的第一个包紧接上一个输出包，时间戳增量按ntp时间差推算，无法推算时按30fps计算
+        // The first packet of the new data source follows the last output packet, the timestamp increment is calculated according to the ntp time difference, or 30fps if it cannot be calculated
+        uint32_t delta = rtp->sample_rate / 30;
+        if (_last_ntp_stamp && rtp->ntp_stamp > _last_ntp_stamp) {
+            delta = (uint32_t)(std::min)((rtp->ntp_stamp - _last_ntp_stamp) * rtp->sample_rate / 1000, (uint64_t)rtp->sample_rate);
+            delta = (std::max)(delta, 1u);
+        }
+        _seq_offset = (uint16_t)(_last_seq + 1 - seq);
+        _stamp_offset = _last_stamp + delta - stamp;
+    }
+    _switching = false;
+    _started = true;
+    _last_seq = seq + _seq_offset;
+    _last_stamp = stamp + _stamp_offset;
+    _last_ntp_stamp = rtp->ntp_stamp;
+    if (!_seq_offset && !_stamp_offset) {
+        return rtp;
+    }
+
+    auto ret = RtpPacket::create();
+    ret->assign(rtp->data(), rtp->size());
+    ret->type = rtp->type;
+    ret->sample_rate = rtp->sample_rate;
+    ret->ntp_stamp = rtp->ntp_stamp;
+    ret->track_index = rtp->track_index;
+    auto header = ret->getHeader();
+    header->seq = htons(_last_seq);
+    header->stamp = htonl(_last_stamp);
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+size_t RtcLayerSelector::selectLayer(const vector<uint32_t> &layers_bps, size_t cur, uint32_t target_bps, uint64_t now_ms) {
+    GET_CONFIG(uint32_t, upgrade_delay_ms, Rtc::kLayerUpgradeDelayMS);
+    if (layers_bps.empty()) {
+        return 0;
+    }
+    if (!target_bps) {
+        // 未开启带宽估计，选择最高层
+        // Bandwidth estimation is not enabled, select the highest layer
+        _upgrade_start_ms = 0;
+        return layers_bps.size() - 1;
+    }
+    auto budget = target_bps * kBandwidthHeadroom;
+    size_t best = 0;
+    for (size_t i = 1; i < layers_bps.size(); ++i) {
+        if (layers_bps[i] <= budget) {
+            best = i;
+        }
+    }
+    if (cur >= layers_bps.size() || best <= cur) {
+        _upgrade_start_ms = 0;
+        return best;
+    }
+    if (!_upgrade_start_ms) {
+        _upgrade_start_ms = now_ms;
+    }
+    if (now_ms - _upgrade_start_ms < upgrade_delay_ms) {
+        return cur;
+    }
+    _upgrade_start_ms = 0;
+    return cur + 1;
+}
+
+uint8_t RtcLayerSelector::selectTemporalId(uint32_t layer_bps, uint32_t target_bps) {
+    if (!layer_bps || !target_bps) {
+        return TemporalLayerFilter::kAllLayers;
+    }
+    auto ratio = target_bps * kBandwidthHeadroom / layer_bps;
+    if (ratio >= 1) {
+        return TemporalLayerFilter::kAllLayers;
+    }
+    // 常见的L1T2/L1T3编码中，基础层约占一半码率，前两层约占3/4码率
+    // In common L1T2/L1T3 encoding, the base layer accounts for about half of the bitrate, and the first two layers account for about 3/4
+    return ratio < 0.5f ? 0 : 1;
+}
+
+} // namespace mediakit
@@ -0,0 +1,149 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_RTCLAYERSELECTOR_H
+#define ZLMEDIAKIT_RTCLAYERSELECTOR_H
+
+#include <vector>
+#include <string>
+#include "Rtsp/Rtsp.h"
+#include "Extension/Frame.h"
+
+namespace mediakit {
+
+class RtpLayerHelper {
+public:
+    /**
+     * 判断rtp是否为关键帧(或其前置的sps/vps等配置帧)的第一个包，用于simulcast层无缝切换
+     * Determine whether the rtp is the first packet of a key frame (or the sps/vps config frames before it), used for seamless simulcast layer switching
+     */
+    static bool isKeyFrameStart(CodecId codec, const RtpPacket::Ptr &rtp);
+};
+
+/**
+ * svc时域层过滤器，优先根据dependency descriptor rtp ext获取时域层id，不存在时vp9根据rtp负载描述符，av1根据obu扩展头获取
+ * 降低时域层立即生效；提高时域层在下一个基础层(tid为0)帧时生效，保证解码参考帧完整
+ * Svc temporal layer filter, the temporal layer id is preferentially obtained from the dependency descriptor rtp ext, otherwise vp9 gets it from the rtp payload descriptor and av1 from the obu extension header
+ * Lowering the temporal layer takes effect immediately; raising it takes effect at the next base layer (tid 0) frame, ensuring that the decoding reference frames are complete
+ */
+class TemporalLayerFilter {
+public:
+    static constexpr uint8_t kAllLayers = 0xFF;
+
+    void setCodec(CodecId codec) { _codec = codec; }
+    void setMaxTemporalId(uint8_t tid);
+    uint8_t getMaxTemporalId() const { return _max_tid; }
+
+    /**
+     * 切换数据源后调用，清空dependency descriptor模板
+     * Called after switching the data source, clear the dependency descriptor templates
+     */
+    void reset();
+
+    /**
+     * 输入视频rtp
+     * @return false表示该包属于被丢弃的时域层
+     * Input video rtp
+     * @return false means the packet belongs to a discarded temporal layer
+     */
+    bool input(const RtpPacket::Ptr &rtp);
+
+private:
+    int getTemporalId(const RtpPacket::Ptr &rtp);
+    int getVP9TemporalId(const RtpPacket::Ptr &rtp) const;
+    int getAV1TemporalId(const RtpPacket::Ptr &rtp);
+    int getDependencyDescriptorTemporalId(const RtpPacket::Ptr &rtp);
+
+private:
+    CodecId _codec = CodecInvalid;
+    uint8_t _max_tid = kAllLayers;
+    uint8_t _target_tid = kAllLayers;
+    uint8_t _template_id_offset = 0;
+    // dependency descriptor各模板对应的时域层id
+    // The temporal layer id of each dependency descriptor template
+    std::vector<uint8_t> _template_tid;
+    // av1分片包沿用同一帧第一个包的时域层
+    // Av1 fragmented packets use the temporal layer of the first packet of the same frame
+    int _av1_tid = -1;
+    uint32_t _av1_stamp = 0;
+};
+
+/**
+ * 改写rtp的seq与时间戳，使切换数据源或丢弃部分rtp后，对端收到的rtp依然连续
+ * ssrc在发送时已统一改写为answer sdp中的ssrc，故此处无需处理
+ * Rewrite the seq and timestamp of rtp, so that the rtp received by the peer is still continuous after switching data sources or discarding some rtp
+ * The ssrc has been uniformly rewritten to the ssrc in the answer sdp when sending, so it does not need to be handled here
+ */
+class RtpStreamRewriter {
+public:
+    /**
+     * 切换数据源，下一个输入的rtp将紧接上一个输出的rtp
+     * Switch the data source, the next input rtp will follow the last output rtp
+     */
+    void switchSource() { _switching = true; }
+
+    /**
+     * 丢弃一个rtp，后续rtp的seq前移
+     * Discard one rtp, the seq of subsequent rtp moves forward
+     */
+    void drop() { --_seq_offset; }
+
+    /**
+     * 改写rtp，无需改写时返回原包，否则返回拷贝，不修改被其他播放器共享的原包
+     * Rewrite rtp, return the original packet if no rewriting is needed, otherwise return a copy, without modifying the original packet shared by other players
+     */
+    RtpPacket::Ptr rewrite(const RtpPacket::Ptr &rtp);
+
+private:
+    bool _started = false;
+    bool _switching = false;
+    uint16_t _seq_offset = 0;
+    uint16_t _last_seq = 0;
+    uint32_t _stamp_offset = 0;
+    uint32_t _last_stamp = 0;
+    uint64_t _last_ntp_stamp = 0;
+};
+
+/**
+ * 根据估计带宽选择simulcast层与svc时域层
+ * 带宽不足时立即降档，带宽持续充足kLayerUpgradeDelayMS后逐级升档，避免频繁切换
+ * Select the simulcast layer and svc temporal layer according to the estimated bandwidth
+ * Switch down immediately when the bandwidth is insufficient, and switch up step by step after the bandwidth stays sufficient for kLayerUpgradeDelayMS, avoiding frequent switching
+ */
+class RtcLayerSelector {
+public:
+    /**
+     * 选择simulcast层
+     * @param layers_bps 各层码率，按从低到高排序
+     * @param cur 当前层下标，尚未选择时为layers_bps.size()
+     * @param target_bps 估计带宽
+     * @param now_ms 当前时间
+     * @return 目标层下标
+     * Select the simulcast layer
+     * @param layers_bps The bitrate of each layer, sorted from low to high
+     * @param cur The current layer index, layers_bps.size() if not selected yet
+     * @param target_bps Estimated bandwidth
+     * @param now_ms Current time
+     * @return Target layer index
+     */
+    size_t selectLayer(const std::vector<uint32_t> &layers_bps, size_t cur, uint32_t target_bps, uint64_t now_ms);
+
+    /**
+     * 选择最高svc时域层，当前层码率超出估计带宽时丢弃高时域层
+     * Select the highest svc temporal layer, discard the high temporal layers when the bitrate of the current layer exceeds the estimated bandwidth
+     */
+    static uint8_t selectTemporalId(uint32_t layer_bps, uint32_t target_bps);
+
+private:
+    uint64_t _upgrade_start_ms = 0;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_RTCLAYERSELECTOR_H
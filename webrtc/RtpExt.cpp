@@ -363,6 +363,13 @@ uint16_t RtpExt::getTransportCCSeq() const {
     return ret;
 }
 
+void RtpExt::setTransportCCSeq(uint16_t seq) {
+    CHECK(_type == RtpExtType::transport_cc && size() >= 2);
+    auto ptr = (uint8_t *)_data;
+    ptr[0] = seq >> 8;
+    ptr[1] = seq & 0xFF;
+}
+
 //https://tools.ietf.org/html/draft-ietf-avtext-sdes-hdr-ext-07
 //    0                   1                   2                   3
 //    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -521,6 +528,13 @@ uint8_t RtpExt::getFramemarkingTID() const {
     return (*this)[0] & 0x07;
 }
 
+// https://aomediacodec.github.io/av1-rtp-spec/#dependency-descriptor-rtp-header-extension
+const uint8_t *RtpExt::getDependencyDescriptor(size_t &size) const {
+    CHECK(_type == RtpExtType::av1);
+    size = _size;
+    return (const uint8_t *)_data;
+}
+
 void RtpExt::setExtId(uint8_t ext_id) {
     assert(ext_id > (int) RtpExtType::padding && _ext);
     if (_one_byte_ext) {
@@ -580,6 +594,11 @@ void RtpExtContext::setRid(uint32_t ssrc, const string &rid) {
     _ssrc_to_rid[ssrc] = rid;
 }
 
+uint8_t RtpExtContext::getExtId(RtpExtType type) const {
+    auto it = _rtp_ext_type_to_id.find(type);
+    return it == _rtp_ext_type_to_id.end() ? 0 : it->second;
+}
+
 RtpExt RtpExtContext::changeRtpExtId(const RtpHeader *header, bool is_recv, string *rid_ptr, RtpExtType type) {
     string rid, repaired_rid;
     RtpExt ret;
@@ -67,6 +67,7 @@ public:
     uint8_t getAudioLevel(bool *vad) const;
     uint32_t getAbsSendTime() const;
     uint16_t getTransportCCSeq() const;
+    void setTransportCCSeq(uint16_t seq);
     std::string getSdesMid() const;
     std::string getRtpStreamId() const;
     std::string getRepairedRtpStreamId() const;
@@ -92,6 +93,10 @@ public:
 
     uint8_t getFramemarkingTID() const;
 
+    // av1 dependency descriptor原始数据，需自行按比特解析
+    // Raw data of av1 dependency descriptor, needs to be parsed bit by bit by the caller
+    const uint8_t *getDependencyDescriptor(size_t &size) const;
+
     void setExtId(uint8_t ext_id);
     void clearExt();
     operator bool () const;
@@ -123,6 +128,9 @@ public:
     void setOnGetRtp(OnGetRtp cb);
     std::string getRid(uint32_t ssrc) const;
     void setRid(uint32_t ssrc, const std::string &rid);
+    // 获取对端sdp中该rtp ext类型对应的id，不支持时返回0
+    // Get the id corresponding to the rtp ext type in the peer sdp, return 0 if not supported
+    uint8_t getExtId(RtpExtType type) const;
     RtpExt changeRtpExtId(const RtpHeader *header, bool is_recv, std::string *rid_ptr = nullptr, RtpExtType type = RtpExtType::padding);
 
 private:
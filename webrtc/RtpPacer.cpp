@@ -0,0 +1,146 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "RtpPacer.h"
+#include "WebRtcTransport.h"
+#include "Common/config.h"
+#include "Util/TimeTicker.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 排队时的发送间隔
+// Sending interval when queuing
+static constexpr uint64_t kProcessIntervalMS = 5;
+// 允许的最大突发发送时长
+// The maximum allowed burst sending duration
+static constexpr uint64_t kMaxBurstMS = 40;
+// 最小突发发送字节数，保证至少能发送两个mtu大小的包
+// The minimum burst sending bytes, ensuring that at least two mtu-sized packets can be sent
+static constexpr int64_t kMinBurstBytes = 3000;
+
+RtpPacer::RtpPacer(EventPoller::Ptr poller) : _poller(std::move(poller)) {}
+
+void RtpPacer::setOnSend(onSendCB cb) {
+    _cb = std::move(cb);
+}
+
+void RtpPacer::setBitrate(uint32_t bps) {
+    GET_CONFIG(float, pacing_factor, Rtc::kPacingFactor);
+    refillBudget();
+    auto first = !_pacing_bps;
+    _pacing_bps = (uint32_t)(bps * (std::max)(pacing_factor, 1.0f));
+    if (first) {
+        // 起始时允许一次突发发送
+        // Allow one burst sending at the beginning
+        _budget_bytes = (std::max)((int64_t)(_pacing_bps / 8 * kMaxBurstMS / 1000), kMinBurstBytes);
+    }
+}
+
+uint64_t RtpPacer::getQueueMS() const {
+    uint64_t oldest = 0;
+    if (!_high.empty()) {
+        oldest = _high.front().enqueue_ms;
+    }
+    if (!_normal.empty() && (!oldest || _normal.front().enqueue_ms < oldest)) {
+        oldest = _normal.front().enqueue_ms;
+    }
+    return oldest ? getCurrentMillisecond() - oldest : 0;
+}
+
+void RtpPacer::inputRtp(const RtpPacket::Ptr &rtp, bool flush, bool rtx) {
+    if (!_pacing_bps) {
+        _cb(rtp, flush, rtx);
+        return;
+    }
+    refillBudget();
+    if (_high.empty() && _normal.empty() && _budget_bytes > 0) {
+        // 未排队且预算充足，直接发送
+        // Not queued and the budget is sufficient, send directly
+        _budget_bytes -= rtp->size();
+        _cb(rtp, flush, rtx);
+        return;
+    }
+
+    auto &queue = (rtx || rtp->type != TrackVideo) ? _high : _normal;
+    queue.emplace_back(Item { rtp, rtx, getCurrentMillisecond() });
+    _queue_bytes += rtp->size();
+    process();
+
+    if (_timer_started || !getQueueSize()) {
+        return;
+    }
+    _timer_started = true;
+    weak_ptr<RtpPacer> weak_self = shared_from_this();
+    _poller->doDelayTask(kProcessIntervalMS, [weak_self]() -> uint64_t {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return 0;
+        }
+        strong_self->process();
+        if (strong_self->getQueueSize()) {
+            return kProcessIntervalMS;
+        }
+        strong_self->_timer_started = false;
+        return 0;
+    });
+}
+
+void RtpPacer::refillBudget() {
+    auto now_us = getCurrentMicrosecond();
+    if (_last_refill_us && now_us > _last_refill_us) {
+        _budget_bytes += (int64_t)((now_us - _last_refill_us) * _pacing_bps / 8 / 1000000);
+        auto max_budget = (std::max)((int64_t)(_pacing_bps / 8 * kMaxBurstMS / 1000), kMinBurstBytes);
+        _budget_bytes = (std::min)(_budget_bytes, max_budget);
+    }
+    _last_refill_us = now_us;
+}
+
+void RtpPacer::process() {
+    refillBudget();
+    dropExpired(getCurrentMillisecond());
+    while (_budget_bytes > 0) {
+        // 音频与重传包优先
+        // Audio and retransmission packets first
+        auto &queue = !_high.empty() ? _high : _normal;
+        if (queue.empty()) {
+            break;
+        }
+        auto item = std::move(queue.front());
+        queue.pop_front();
+        _queue_bytes -= item.rtp->size();
+        _budget_bytes -= item.rtp->size();
+        // 本轮最后一个包时刷新发送缓存
+        // Flush the send cache when it is the last packet of this round
+        _cb(item.rtp, _budget_bytes <= 0 || (_high.empty() && _normal.empty()), item.rtx);
+    }
+}
+
+void RtpPacer::dropExpired(uint64_t now_ms) {
+    GET_CONFIG(uint32_t, max_queue_ms, Rtc::kPacerMaxQueueMS);
+    size_t count = 0;
+    while (!_normal.empty() && now_ms - _normal.front().enqueue_ms > max_queue_ms) {
+        _queue_bytes -= _normal.front().rtp->size();
+        _normal.pop_front();
+        ++count;
+    }
+    if (count) {
+        // 带宽不足，丢弃排队过久的视频包，等待对端通过nack或关键帧恢复
+        // Insufficient bandwidth, discard video packets queued for too long, waiting for the peer to recover by nack or key frame
+        if (!_dropped) {
+            WarnL << "pacer queue is full, pacing rate: " << _pacing_bps << "bps, drop video rtp: " << count;
+        }
+        _dropped += count;
+    }
+}
+
+} // namespace mediakit
@@ -0,0 +1,86 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_RTPPACER_H
+#define ZLMEDIAKIT_RTPPACER_H
+
+#include <deque>
+#include <memory>
+#include <functional>
+#include "Rtsp/Rtsp.h"
+#include "Poller/EventPoller.h"
+
+namespace mediakit {
+
+/**
+ * rtp发送平滑器，按漏桶算法限制发送速率，避免突发发送导致弱网下丢包与发送队列堆积
+ * 音频与重传包优先发送；码率不足时视频包在此排队，排队超时的视频包将被丢弃，保证服务器内存不会无限增长
+ * 队列为空且发送预算充足时直接发送，不增加延时
+ * Rtp pacer, limits the sending rate according to the leaky bucket algorithm, avoiding packet loss and send queue accumulation caused by burst sending on weak networks
+ * Audio and retransmission packets are sent first; when the bitrate is insufficient, video packets are queued here, and video packets that exceed the queuing time will be discarded, ensuring that the server memory will not grow infinitely
+ * Send directly without adding delay when the queue is empty and the sending budget is sufficient
+ */
+class RtpPacer : public std::enable_shared_from_this<RtpPacer> {
+public:
+    using Ptr = std::shared_ptr<RtpPacer>;
+    using onSendCB = std::function<void(const RtpPacket::Ptr &rtp, bool flush, bool rtx)>;
+
+    RtpPacer(toolkit::EventPoller::Ptr poller);
+
+    void setOnSend(onSendCB cb);
+
+    /**
+     * 设置估计带宽，单位bit/s，实际发送速率为其kPacingFactor倍
+     * Set the estimated bandwidth, in bit/s, the actual sending rate is kPacingFactor times of it
+     */
+    void setBitrate(uint32_t bps);
+
+    /**
+     * 输入待发送的rtp
+     * Input the rtp to be sent
+     */
+    void inputRtp(const RtpPacket::Ptr &rtp, bool flush, bool rtx);
+
+    uint32_t getPacingRate() const { return _pacing_bps; }
+    size_t getQueueSize() const { return _high.size() + _normal.size(); }
+    size_t getQueueBytes() const { return _queue_bytes; }
+    uint64_t getQueueMS() const;
+    uint64_t getDroppedCount() const { return _dropped; }
+
+private:
+    struct Item {
+        RtpPacket::Ptr rtp;
+        bool rtx;
+        uint64_t enqueue_ms;
+    };
+
+    void refillBudget();
+    void process();
+    void dropExpired(uint64_t now_ms);
+
+private:
+    bool _timer_started = false;
+    uint32_t _pacing_bps = 0;
+    int64_t _budget_bytes = 0;
+    uint64_t _last_refill_us = 0;
+    size_t _queue_bytes = 0;
+    uint64_t _dropped = 0;
+    onSendCB _cb;
+    toolkit::EventPoller::Ptr _poller;
+    // 音频与重传包
+    // Audio and retransmission packets
+    std::deque<Item> _high;
+    // 视频包
+    // Video packets
+    std::deque<Item> _normal;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_RTPPACER_H
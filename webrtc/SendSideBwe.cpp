@@ -0,0 +1,289 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include "SendSideBwe.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 发送记录缓存个数，twcc回复通常在100ms内到达
+// Number of cached sending records, twcc feedback usually arrives within 100ms
+static constexpr size_t kSentHistorySize = 1024;
+// 发送时间间隔在5ms内的包视为同一组
+// Packets sent within 5ms are regarded as the same group
+static constexpr int64_t kBurstDeltaUS = 5000;
+// trendline滤波器参数
+// Trendline filter parameters
+static constexpr size_t kTrendlineWindowSize = 20;
+static constexpr double kTrendlineSmoothing = 0.9;
+static constexpr double kTrendlineThresholdGain = 4.0;
+static constexpr size_t kMaxNumDeltas = 60;
+// 自适应阈值参数
+// Adaptive threshold parameters
+static constexpr double kThresholdUp = 0.0087;
+static constexpr double kThresholdDown = 0.039;
+static constexpr double kMinThreshold = 6;
+static constexpr double kMaxThreshold = 600;
+static constexpr double kMaxAdaptOffset = 15;
+static constexpr int64_t kOverusingTimeThresholdMS = 10;
+// 码率控制参数
+// Bitrate control parameters
+static constexpr double kDecreaseFactor = 0.85;
+static constexpr double kIncreaseFactorPerSecond = 1.08;
+static constexpr uint64_t kMinDecreaseIntervalUS = 200 * 1000;
+static constexpr uint64_t kLossUpdateIntervalUS = 200 * 1000;
+static constexpr uint32_t kMinLossStatisticCount = 20;
+static constexpr int64_t kAckedWindowUS = 1000 * 1000;
+
+const char *SendSideBwe::BandwidthUsageStr(BandwidthUsage usage) {
+    switch (usage) {
+        case BandwidthUsage::normal: return "normal";
+        case BandwidthUsage::underusing: return "underusing";
+        case BandwidthUsage::overusing: return "overusing";
+        default: return "invalid";
+    }
+}
+
+SendSideBwe::SendSideBwe() {
+    _sent_pkts.setCapacity(kSentHistorySize);
+    setBitrate(0, 0, 0);
+}
+
+void SendSideBwe::setBitrate(uint32_t start_bps, uint32_t min_bps, uint32_t max_bps) {
+    _min_bps = min_bps ? min_bps : 100 * 1000;
+    _max_bps = max_bps ? max_bps : 20 * 1000 * 1000;
+    _max_bps = (std::max)(_max_bps, _min_bps);
+    if (!start_bps) {
+        start_bps = 2 * 1000 * 1000;
+    }
+    _target_bps = _delay_bps = _loss_bps = (std::min)((std::max)(start_bps, _min_bps), _max_bps);
+}
+
+uint16_t SendSideBwe::onSendRtp(size_t size, uint64_t send_us) {
+    auto seq = _send_seq++;
+    _sent_pkts.emplace(seq, SentPacket { (uint32_t)size, send_us }, true);
+    return seq;
+}
+
+void SendSideBwe::onTwccFeedback(const FCI_TWCC &fci, size_t fci_size, uint64_t now_us) {
+    FCI_TWCC::TwccPacketStatus status;
+    try {
+        status = fci.getPacketChunkList(fci_size);
+    } catch (std::exception &ex) {
+        WarnL << "invalid twcc rtcp: " << ex.what();
+        return;
+    }
+
+    // 参考时间戳单位为64ms，接收时间差单位为250us
+    // The unit of the reference timestamp is 64ms, and the unit of the receive delta is 250us
+    int64_t recv_us = (int64_t)fci.getReferenceTime() * 64 * 1000;
+    uint32_t lost = 0, total = 0;
+    auto seq = fci.getBaseSeq();
+    for (uint16_t i = 0; i < fci.getPacketCount(); ++i, ++seq) {
+        auto it = status.find(seq);
+        if (it == status.end()) {
+            continue;
+        }
+        auto received = it->second.first != SymbolStatus::not_received;
+        if (received) {
+            recv_us += it->second.second * 250;
+        }
+        auto index = _sent_pkts.find(seq);
+        if (index == _sent_pkts.npos) {
+            // 非本端发送或已过期的记录
+            // Records not sent by this end or expired
+            continue;
+        }
+        auto pkt = _sent_pkts.take(index);
+        ++total;
+        if (!received) {
+            ++lost;
+            continue;
+        }
+        onPacketAcked(pkt, recv_us);
+    }
+
+    updateLossBased(lost, total, now_us);
+    updateDelayBased(now_us);
+    _target_bps = (std::min)(_delay_bps, _loss_bps);
+}
+
+void SendSideBwe::onPacketAcked(const SentPacket &pkt, int64_t recv_us) {
+    updateAckedBitrate(pkt.size, recv_us);
+    if (_cur_group.empty()) {
+        _cur_group.first_send_us = _cur_group.send_us = pkt.send_us;
+        _cur_group.recv_us = recv_us;
+        return;
+    }
+    if (pkt.send_us >= _cur_group.first_send_us && pkt.send_us - _cur_group.first_send_us <= (uint64_t)kBurstDeltaUS) {
+        _cur_group.send_us = (std::max)(_cur_group.send_us, pkt.send_us);
+        _cur_group.recv_us = (std::max)(_cur_group.recv_us, recv_us);
+        return;
+    }
+    if (!_prev_group.empty()) {
+        updateTrendline(_cur_group.recv_us - _prev_group.recv_us, (int64_t)(_cur_group.send_us - _prev_group.send_us), _cur_group.recv_us);
+    }
+    _prev_group = _cur_group;
+    _cur_group.first_send_us = _cur_group.send_us = pkt.send_us;
+    _cur_group.recv_us = recv_us;
+}
+
+void SendSideBwe::updateTrendline(int64_t recv_delta_us, int64_t send_delta_us, int64_t recv_us) {
+    if (_first_recv_us < 0) {
+        _first_recv_us = recv_us;
+    }
+    _num_of_deltas = (std::min)(_num_of_deltas + 1, kMaxNumDeltas);
+    _accumulated_delay_ms += (recv_delta_us - send_delta_us) / 1000.0;
+    _smoothed_delay_ms = kTrendlineSmoothing * _smoothed_delay_ms + (1 - kTrendlineSmoothing) * _accumulated_delay_ms;
+    _delay_hist.emplace_back((recv_us - _first_recv_us) / 1000.0, _smoothed_delay_ms);
+    if (_delay_hist.size() > kTrendlineWindowSize) {
+        _delay_hist.pop_front();
+    }
+    if (_delay_hist.size() < kTrendlineWindowSize) {
+        return;
+    }
+
+    // 最小二乘法拟合排队延时的变化趋势
+    // Fit the trend of queuing delay by least squares
+    double sum_x = 0, sum_y = 0;
+    for (auto &pr : _delay_hist) {
+        sum_x += pr.first;
+        sum_y += pr.second;
+    }
+    auto avg_x = sum_x / _delay_hist.size();
+    auto avg_y = sum_y / _delay_hist.size();
+    double numerator = 0, denominator = 0;
+    for (auto &pr : _delay_hist) {
+        numerator += (pr.first - avg_x) * (pr.second - avg_y);
+        denominator += (pr.first - avg_x) * (pr.first - avg_x);
+    }
+    auto trend = denominator ? numerator / denominator : _prev_trend;
+
+    auto now_ms = recv_us / 1000;
+    auto modified_trend = _num_of_deltas * trend * kTrendlineThresholdGain;
+    if (modified_trend > _threshold) {
+        if (_overuse_start_ms < 0) {
+            _overuse_start_ms = now_ms;
+        }
+        ++_overuse_count;
+        // 持续过载且延时仍在增加才判定为过载
+        // Only judged as overusing when it continues to overuse and the delay is still increasing
+        if (now_ms - _overuse_start_ms >= kOverusingTimeThresholdMS && _overuse_count > 1 && trend >= _prev_trend) {
+            _overuse_start_ms = -1;
+            _overuse_count = 0;
+            _usage = BandwidthUsage::overusing;
+        }
+    } else if (modified_trend < -_threshold) {
+        _overuse_start_ms = -1;
+        _overuse_count = 0;
+        _usage = BandwidthUsage::underusing;
+    } else {
+        _overuse_start_ms = -1;
+        _overuse_count = 0;
+        _usage = BandwidthUsage::normal;
+    }
+    _prev_trend = trend;
+    updateThreshold(modified_trend, now_ms);
+}
+
+void SendSideBwe::updateThreshold(double modified_trend, int64_t now_ms) {
+    if (_last_threshold_update_ms < 0) {
+        _last_threshold_update_ms = now_ms;
+    }
+    auto abs_trend = std::fabs(modified_trend);
+    if (abs_trend > _threshold + kMaxAdaptOffset) {
+        // 突发的延时尖峰不参与阈值调整
+        // Sudden delay spikes do not participate in threshold adjustment
+        _last_threshold_update_ms = now_ms;
+        return;
+    }
+    auto k = abs_trend < _threshold ? kThresholdDown : kThresholdUp;
+    auto delta_ms = (std::min)(now_ms - _last_threshold_update_ms, (int64_t)100);
+    _threshold += k * (abs_trend - _threshold) * delta_ms;
+    _threshold = (std::min)((std::max)(_threshold, kMinThreshold), kMaxThreshold);
+    _last_threshold_update_ms = now_ms;
+}
+
+void SendSideBwe::updateAckedBitrate(size_t size, int64_t recv_us) {
+    _acked_hist.emplace_back(recv_us, size);
+    _acked_bytes += size;
+    while (_acked_hist.size() > 1 && recv_us - _acked_hist.front().first > kAckedWindowUS) {
+        _acked_bytes -= _acked_hist.front().second;
+        _acked_hist.pop_front();
+    }
+    auto span_us = recv_us - _acked_hist.front().first;
+    if (span_us >= kAckedWindowUS / 5) {
+        _acked_bps = (uint32_t)(_acked_bytes * 8 * 1000000 / span_us);
+    }
+}
+
+void SendSideBwe::updateDelayBased(uint64_t now_us) {
+    auto delta_us = _last_delay_update_us ? now_us - _last_delay_update_us : 0;
+    _last_delay_update_us = now_us;
+    switch (_usage) {
+        case BandwidthUsage::overusing: {
+            if (now_us - _last_decrease_us < kMinDecreaseIntervalUS) {
+                break;
+            }
+            // 降低至对端实际接收码率的0.85倍
+            // Reduce to 0.85 times the bitrate actually received by the peer
+            auto base = _acked_bps ? _acked_bps : _delay_bps;
+            _delay_bps = (std::min)(_delay_bps, (uint32_t)(base * kDecreaseFactor));
+            _last_decrease_us = now_us;
+            break;
+        }
+        case BandwidthUsage::underusing: {
+            // 队列正在排空，保持码率
+            // The queue is draining, keep the bitrate
+            break;
+        }
+        default: {
+            auto factor = std::pow(kIncreaseFactorPerSecond, (std::min)(delta_us, (uint64_t)1000000) / 1000000.0);
+            auto bps = _delay_bps * factor + 1000;
+            if (_acked_bps) {
+                // 码率不能远超实际发送的码率，防止应用受限时估计值无限增长
+                // The bitrate cannot far exceed the actual sending bitrate, preventing the estimate from growing infinitely when application limited
+                bps = (std::min)(bps, 1.5 * _acked_bps + 10000);
+            }
+            if (bps > _delay_bps) {
+                _delay_bps = (uint32_t)bps;
+            }
+            break;
+        }
+    }
+    _delay_bps = (std::min)((std::max)(_delay_bps, _min_bps), _max_bps);
+}
+
+void SendSideBwe::updateLossBased(uint32_t lost, uint32_t total, uint64_t now_us) {
+    _lost_count += lost;
+    _total_count += total;
+    if (_total_count < kMinLossStatisticCount || now_us - _last_loss_update_us < kLossUpdateIntervalUS) {
+        return;
+    }
+    _last_loss_update_us = now_us;
+    _loss_rate = (float)_lost_count / _total_count;
+    _lost_count = _total_count = 0;
+
+    if (_loss_rate > 0.1f) {
+        _loss_bps = (uint32_t)(_loss_bps * (1 - 0.5 * _loss_rate));
+    } else if (_loss_rate < 0.02f) {
+        _loss_bps = (uint32_t)(_loss_bps * 1.05 + 1000);
+        if (_acked_bps) {
+            _loss_bps = (std::min)(_loss_bps, (uint32_t)(1.5 * _acked_bps + 10000));
+        }
+    }
+    _loss_bps = (std::min)((std::max)(_loss_bps, _min_bps), _max_bps);
+}
+
+} // namespace mediakit
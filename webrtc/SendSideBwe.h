@@ -0,0 +1,150 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_SENDSIDEBWE_H
+#define ZLMEDIAKIT_SENDSIDEBWE_H
+
+#include <deque>
+#include <string>
+#include "Rtcp/RtcpFCI.h"
+#include "Rtsp/RtpReceiver.h"
+
+namespace mediakit {
+
+/**
+ * 发送端带宽估计，根据对端回复的twcc rtcp包估算可用带宽
+ * 基于延时的估计参考GCC的trendline滤波器，基于丢包的估计在丢包率高于10%时降低码率，低于2%时提高码率，最终码率取两者最小值
+ * Send-side bandwidth estimation, estimates the available bandwidth according to the twcc rtcp packets replied by the peer
+ * The delay-based estimation refers to the trendline filter of GCC, the loss-based estimation decreases the bitrate when the loss rate is higher than 10%
+ * and increases it when lower than 2%, the final bitrate is the minimum of the two
+ */
+class SendSideBwe {
+public:
+    enum class BandwidthUsage : int {
+        normal = 0,
+        underusing,
+        overusing,
+    };
+
+    SendSideBwe();
+
+    /**
+     * 设置码率范围，单位bit/s
+     * Set the bitrate range, in bit/s
+     */
+    void setBitrate(uint32_t start_bps, uint32_t min_bps, uint32_t max_bps);
+
+    /**
+     * 发送rtp时调用，分配twcc ext seq并记录发送信息
+     * @param size rtp包大小
+     * @param send_us 发送时间，单位微秒
+     * @return 分配的twcc ext seq
+     * Called when sending rtp, allocate twcc ext seq and record the sending information
+     * @param size Rtp packet size
+     * @param send_us Send time, in microseconds
+     * @return The allocated twcc ext seq
+     */
+    uint16_t onSendRtp(size_t size, uint64_t send_us);
+
+    /**
+     * 收到twcc rtcp包时调用
+     * @param fci twcc fci
+     * @param fci_size fci大小
+     * @param now_us 当前时间，单位微秒
+     * Called when receiving twcc rtcp packet
+     * @param fci Twcc fci
+     * @param fci_size Fci size
+     * @param now_us Current time, in microseconds
+     */
+    void onTwccFeedback(const FCI_TWCC &fci, size_t fci_size, uint64_t now_us);
+
+    /**
+     * 获取估计的可用带宽，单位bit/s
+     * Get the estimated available bandwidth, in bit/s
+     */
+    uint32_t getTargetBitrate() const { return _target_bps; }
+    uint32_t getDelayBasedBitrate() const { return _delay_bps; }
+    uint32_t getLossBasedBitrate() const { return _loss_bps; }
+    uint32_t getAckedBitrate() const { return _acked_bps; }
+    float getLossRate() const { return _loss_rate; }
+    BandwidthUsage getBandwidthUsage() const { return _usage; }
+    static const char *BandwidthUsageStr(BandwidthUsage usage);
+
+private:
+    struct SentPacket {
+        uint32_t size;
+        uint64_t send_us;
+    };
+
+    struct PacketGroup {
+        uint64_t first_send_us = 0;
+        uint64_t send_us = 0;
+        int64_t recv_us = 0;
+        bool empty() const { return !send_us; }
+    };
+
+    void onPacketAcked(const SentPacket &pkt, int64_t recv_us);
+    void updateTrendline(int64_t recv_delta_us, int64_t send_delta_us, int64_t recv_us);
+    void updateThreshold(double modified_trend, int64_t now_ms);
+    void updateAckedBitrate(size_t size, int64_t recv_us);
+    void updateDelayBased(uint64_t now_us);
+    void updateLossBased(uint32_t lost, uint32_t total, uint64_t now_us);
+
+private:
+    uint16_t _send_seq = 0;
+    uint32_t _min_bps;
+    uint32_t _max_bps;
+    uint32_t _target_bps;
+    uint32_t _delay_bps;
+    uint32_t _loss_bps;
+    uint32_t _acked_bps = 0;
+    float _loss_rate = 0;
+    uint64_t _last_delay_update_us = 0;
+    uint64_t _last_loss_update_us = 0;
+    uint64_t _last_decrease_us = 0;
+    // 以twcc ext seq为下标的发送记录
+    // Sending records indexed by twcc ext seq
+    SeqRingBuffer<SentPacket> _sent_pkts;
+
+    // 按发送时间突发(5ms内)分组
+    // Grouped by sending time burst (within 5ms)
+    PacketGroup _cur_group;
+    PacketGroup _prev_group;
+
+    // trendline滤波器
+    // Trendline filter
+    double _accumulated_delay_ms = 0;
+    double _smoothed_delay_ms = 0;
+    int64_t _first_recv_us = -1;
+    size_t _num_of_deltas = 0;
+    std::deque<std::pair<double /*recv time ms*/, double /*smoothed delay ms*/>> _delay_hist;
+
+    // 过载检测
+    // Overuse detection
+    double _threshold = 12.5;
+    double _prev_trend = 0;
+    int64_t _last_threshold_update_ms = -1;
+    int64_t _overuse_start_ms = -1;
+    size_t _overuse_count = 0;
+    BandwidthUsage _usage = BandwidthUsage::normal;
+
+    // 对端确认接收的码率统计窗口
+    // Statistics window of the bitrate acknowledged by the peer
+    size_t _acked_bytes = 0;
+    std::deque<std::pair<int64_t /*recv us*/, size_t /*bytes*/>> _acked_hist;
+
+    // 丢包统计
+    // Packet loss statistics
+    uint32_t _lost_count = 0;
+    uint32_t _total_count = 0;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_SENDSIDEBWE_H
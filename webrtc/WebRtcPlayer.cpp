@@ -11,6 +11,7 @@
 #include "WebRtcPlayer.h"
 
 #include "Common/config.h"
+#include "Common/Parser.h"
 #include "Extension/Factory.h"
 #include "Util/base64.h"
 
@@ -25,6 +26,10 @@ const string kBfilter = RTC_FIELD "bfilter";
 static onceToken token([]() { mINI::Instance()[kBfilter] = 0; });
 } // namespace Rtc
 
+// simulcast层与svc时域层的选择间隔
+// The selection interval of simulcast layer and svc temporal layer
+static constexpr uint64_t kLayerUpdateIntervalMS = 500;
+
 H264BFrameFilter::H264BFrameFilter()
     : _last_seq(0)
     , _last_stamp(0)
@@ -197,6 +202,15 @@ WebRtcPlayer::WebRtcPlayer(const EventPoller::Ptr &poller,
     _bfliter_flag = enable;
     _is_h264 = false;
     _bfilter = std::make_shared<H264BFrameFilter>();
+    _preferred_rid = Parser::parseArgs(info.params)["rid"];
+#if defined(ENABLE_FFMPEG)
+    if (RtcAudioTranscoder::needTranscode(src->getSdp())) {
+        // 应答sdp前创建共享转码器，失败时按源流音频协商
+        // Create the shared transcoder before answering the sdp, negotiate with the audio of the source stream on failure
+        _audio_transcoder = RtcAudioTranscoder::get(src);
+        _transcode_audio = (bool)_audio_transcoder;
+    }
+#endif
 }
 
 void WebRtcPlayer::onStartWebRTC() {
@@ -208,6 +222,7 @@ void WebRtcPlayer::onStartWebRTC() {
     WebRtcTransportImp::onStartWebRTC();
     if (canSendRtp()) {
         playSrc->pause(false);
+        _latency.attach(*playSrc);
         _reader = playSrc->getRing()->attach(getPoller(), true);
         weak_ptr<WebRtcPlayer> weak_self = static_pointer_cast<WebRtcPlayer>(shared_from_this());
         weak_ptr<Session> weak_session = static_pointer_cast<Session>(getSession());
@@ -234,13 +249,13 @@ void WebRtcPlayer::onStartWebRTC() {
                     if (TrackVideo == rtp->type && strong_self->_is_h264) {
                         auto rtp_filter = strong_self->_bfilter->processPacket(rtp);
                         if (rtp_filter) {
-                            strong_self->onSendRtp(rtp_filter, ++i == pkt->size());
+                            strong_self->sendMediaRtp(rtp_filter, ++i == pkt->size());
                         }
                     } else {
-                        strong_self->onSendRtp(rtp, ++i == pkt->size());
+                        strong_self->sendMediaRtp(rtp, ++i == pkt->size());
                     }
                 } else {
-                    strong_self->onSendRtp(rtp, ++i == pkt->size());
+                    strong_self->sendMediaRtp(rtp, ++i == pkt->size());
                 }
             });
         });
@@ -268,6 +283,38 @@ void WebRtcPlayer::onStartWebRTC() {
                 WarnL << "Send unknown message type to webrtc player: " << data.type_name();
             }
         });
+
+        SdpParser parser(playSrc->getSdp());
+        auto video_sdp = parser.getTrack(TrackVideo);
+        auto video_track = video_sdp ? Factory::getTrackBySdp(video_sdp) : nullptr;
+        _video_codec = video_track ? video_track->getCodecId() : CodecInvalid;
+        _temporal_filter.setCodec(_video_codec);
+
+#if defined(ENABLE_FFMPEG)
+        if (_transcode_audio) {
+            // 同一源流的所有webrtc播放器共享一个转码器
+            // All webrtc players of the same source stream share one transcoder
+            _audio_reader = _audio_transcoder->getRing()->attach(getPoller(), false);
+            _audio_reader->setReadCB([weak_self](const RtpPacket::Ptr &rtp) {
+                if (auto strong_self = weak_self.lock()) {
+                    strong_self->onSendRtp(rtp, true);
+                }
+            });
+        }
+#endif
+
+        // 定时根据估计带宽选择simulcast层与svc时域层
+        // Regularly select the simulcast layer and svc temporal layer according to the estimated bandwidth
+        listenLayerSources(playSrc);
+        updateLayers();
+        getPoller()->doDelayTask(kLayerUpdateIntervalMS, [weak_self]() -> uint64_t {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return 0;
+            }
+            strong_self->updateLayers();
+            return kLayerUpdateIntervalMS;
+        });
     }
 }
 void WebRtcPlayer::onDestory() {
@@ -282,6 +329,7 @@ void WebRtcPlayer::onDestory() {
             NOTICE_EMIT(BroadcastFlowReportArgs, Broadcast::kBroadcastFlowReport, _media_info, bytes_usage, duration, true, *getSession());
         }
     }
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastMediaChanged);
     WebRtcTransportImp::onDestory();
 }
 
@@ -294,9 +342,256 @@ void WebRtcPlayer::onRtcConfigure(RtcConfigure &configure) const {
     // 这是播放  [AUTO-TRANSLATED:d93c019e]
     // This is playing
     configure.audio.direction = configure.video.direction = RtpDirection::sendonly;
+#if defined(ENABLE_FFMPEG)
+    if (_transcode_audio) {
+        // 以转码后的opus协商音频
+        // Negotiate the audio with the transcoded opus
+        configure.setPlayRtspInfo(RtcAudioTranscoder::makePlaySdp(playSrc->getSdp()));
+        return;
+    }
+#endif
     configure.setPlayRtspInfo(playSrc->getSdp());
 }
 
+void WebRtcPlayer::onGetTransportInfo(Json::Value &result) const {
+    WebRtcTransportImp::onGetTransportInfo(result);
+    if (_layer_rid.empty() && _temporal_filter.getMaxTemporalId() == TemporalLayerFilter::kAllLayers) {
+        return;
+    }
+    Json::Value layer;
+    layer["rid"] = _layer_rid;
+    layer["pending_rid"] = _pending_rid;
+    layer["max_temporal_id"] = (int)_temporal_filter.getMaxTemporalId();
+    result["simulcast"] = layer;
+}
+
+void WebRtcPlayer::sendMediaRtp(const RtpPacket::Ptr &rtp, bool flush) {
+    if (flush) {
+        // 以改写前的时间戳统计延迟
+        // Measure the latency with the timestamp before rewriting
+        _latency.onSendRtp(rtp->type, rtp->getStamp(), rtp->sample_rate);
+    }
+    if (rtp->type == TrackVideo) {
+        if (!_temporal_filter.input(rtp)) {
+            _video_rewriter.drop();
+            return;
+        }
+        onSendRtp(_video_rewriter.rewrite(rtp), flush);
+        return;
+    }
+    if (_transcode_audio) {
+        // 源流音频由转码器的opus代替
+        // The audio of the source stream is replaced by the opus of the transcoder
+        return;
+    }
+    if (_layer_reader) {
+        auto seq = rtp->getSeq();
+        auto diff = (int16_t)(seq - _last_audio_seq);
+        if (_audio_started && diff <= 0 && diff > -1000) {
+            // 切换层时新旧层重复的音频包
+            // Duplicate audio packets of the old and new layers when switching layers
+            return;
+        }
+        _audio_started = true;
+        _last_audio_seq = seq;
+    }
+    onSendRtp(rtp, flush);
+}
+
+void WebRtcPlayer::updateLayers() {
+    auto play_src = _play_src.lock();
+    if (!play_src) {
+        return;
+    }
+    auto target_bps = getTargetBitrate();
+
+    struct Layer {
+        std::string rid;
+        RtspMediaSource::Ptr src;
+        uint32_t bps;
+    };
+    std::vector<Layer> layers;
+    if (play_src->getOriginType() == MediaOriginType::rtc_push) {
+        if (_layer_sources_dirty) {
+            // simulcast推流时，各层为同一推流器产生的名为stream_rid的流
+            // When pushing simulcast, each layer is a stream named stream_rid generated by the same pusher
+            _layer_sources_dirty = false;
+            _layer_sources.clear();
+            auto &tuple = play_src->getMediaTuple();
+            auto prefix = tuple.stream + '_';
+            auto origin_url = play_src->getOriginUrl();
+            MediaSource::for_each_media([&](const MediaSource::Ptr &src) {
+                auto rtsp_src = dynamic_pointer_cast<RtspMediaSource>(src);
+                auto &stream = src->getMediaTuple().stream;
+                if (!rtsp_src || rtsp_src == play_src || stream.size() <= prefix.size() || stream.compare(0, prefix.size(), prefix)
+                    || src->getOriginType() != MediaOriginType::rtc_push || src->getOriginUrl() != origin_url) {
+                    return;
+                }
+                _layer_sources.emplace_back(LayerSource { stream.substr(prefix.size()), rtsp_src });
+            }, RTSP_SCHEMA, tuple.vhost, tuple.app);
+        }
+        for (auto &layer_src : _layer_sources) {
+            if (auto src = layer_src.src.lock()) {
+                auto bps = (uint32_t)(src->getBytesSpeed(TrackVideo) * 8);
+                layers.emplace_back(Layer { layer_src.rid, std::move(src), bps });
+            }
+        }
+    }
+
+    if (layers.empty()) {
+        // 非simulcast，只控制svc时域层
+        // Not simulcast, only control the svc temporal layer
+        _temporal_filter.setMaxTemporalId(RtcLayerSelector::selectTemporalId((uint32_t)(play_src->getBytesSpeed(TrackVideo) * 8), target_bps));
+        return;
+    }
+
+    std::sort(layers.begin(), layers.end(), [](const Layer &a, const Layer &b) { return a.bps < b.bps; });
+    std::vector<uint32_t> layers_bps;
+    // 有等待切换的层时，以其为当前层，避免升档计时被重置
+    // When there is a layer waiting to be switched, take it as the current layer to avoid resetting the upgrade timing
+    auto &cur_rid = _pending_reader ? _pending_rid : _layer_rid;
+    auto cur = layers.size();
+    auto want = layers.size();
+    uint32_t playing_bps = 0;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        layers_bps.emplace_back(layers[i].bps);
+        if (layers[i].rid == cur_rid) {
+            cur = i;
+        }
+        if (layers[i].rid == _layer_rid) {
+            playing_bps = layers[i].bps;
+        }
+        if (layers[i].rid == _preferred_rid) {
+            want = i;
+        }
+    }
+    if (want == layers.size()) {
+        want = _layer_selector.selectLayer(layers_bps, cur, target_bps, getCurrentMillisecond());
+    }
+
+    auto &layer = layers[want];
+    if (!_layer_reader) {
+        attachLayer(layer.src, layer.rid, true);
+    } else if (layer.rid == _layer_rid) {
+        // 取消尚未完成的切换
+        // Cancel the unfinished switching
+        _pending_reader = nullptr;
+        _pending_rid.clear();
+    } else if (layer.rid != _pending_rid) {
+        attachLayer(layer.src, layer.rid, false);
+    }
+    // 当前层码率依然超出估计带宽时(比如已是最低层，或者等待关键帧切换期间)，丢弃svc高时域层
+    // When the bitrate of the current layer still exceeds the estimated bandwidth (for example, it is already the lowest layer, or during waiting for the key frame to switch), discard the svc high temporal layers
+    _temporal_filter.setMaxTemporalId(RtcLayerSelector::selectTemporalId(playing_bps, target_bps));
+}
+
+void WebRtcPlayer::listenLayerSources(const RtspMediaSource::Ptr &src) {
+    if (src->getOriginType() != MediaOriginType::rtc_push) {
+        return;
+    }
+    // simulcast各层的流在收到该层rtp后才创建，需监听注册事件以发现后来的层
+    // The stream of each simulcast layer is created only after receiving the rtp of that layer,
+    // the registration events need to be listened to discover the later layers
+    auto tuple = src->getMediaTuple();
+    auto prefix = tuple.stream + '_';
+    weak_ptr<WebRtcPlayer> weak_self = static_pointer_cast<WebRtcPlayer>(shared_from_this());
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastMediaChanged, [weak_self, tuple, prefix](BroadcastMediaChangedArgs) {
+        auto &sender_tuple = sender.getMediaTuple();
+        if (sender.getSchema() != RTSP_SCHEMA || sender_tuple.vhost != tuple.vhost || sender_tuple.app != tuple.app
+            || sender_tuple.stream.compare(0, prefix.size(), prefix)) {
+            return;
+        }
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        strong_self->getPoller()->async([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->_layer_sources_dirty = true;
+            }
+        }, false);
+    });
+}
+
+void WebRtcPlayer::attachLayer(const RtspMediaSource::Ptr &src, const std::string &rid, bool use_cache) {
+    auto reader = src->getRing()->attach(getPoller(), use_cache);
+    const void *ptr = reader.get();
+    weak_ptr<WebRtcPlayer> weak_self = static_pointer_cast<WebRtcPlayer>(shared_from_this());
+    weak_ptr<Session> weak_session = static_pointer_cast<Session>(getSession());
+    reader->setGetInfoCB([weak_session]() {
+        Any ret;
+        ret.set(static_pointer_cast<Session>(weak_session.lock()));
+        return ret;
+    });
+    reader->setReadCB([weak_self, ptr](const RtspMediaSource::RingDataType &pkt) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onLayerRtp(ptr, pkt);
+        }
+    });
+    reader->setDetachCB([weak_self, ptr]() {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onLayerDetach(ptr);
+        }
+    });
+
+    if (_layer_reader) {
+        // 等待新层的关键帧再切换，期间继续播放旧层
+        // Wait for the key frame of the new layer before switching, and continue to play the old layer during this period
+        _pending_reader = std::move(reader);
+        _pending_rid = rid;
+        return;
+    }
+    // 首次播放使用gop缓存，从关键帧开始
+    // The first playback uses the gop cache, starting from the key frame
+    InfoL << "play simulcast layer:" << rid << ", " << _media_info.shortUrl();
+    _layer_reader = std::move(reader);
+    _layer_rid = rid;
+    _video_rewriter.switchSource();
+    _temporal_filter.reset();
+}
+
+void WebRtcPlayer::onLayerRtp(const void *reader, const RtspMediaSource::RingDataType &pkt) {
+    size_t i = 0;
+    if (reader == _pending_reader.get()) {
+        bool switched = false;
+        pkt->for_each([&](const RtpPacket::Ptr &rtp) {
+            ++i;
+            if (!switched) {
+                if (rtp->type != TrackVideo || !RtpLayerHelper::isKeyFrameStart(_video_codec, rtp)) {
+                    return;
+                }
+                // 新层关键帧到达，完成切换
+                // The key frame of the new layer arrives, complete the switching
+                InfoL << "switch simulcast layer:" << _layer_rid << " -> " << _pending_rid << ", " << _media_info.shortUrl();
+                switched = true;
+                _layer_reader = std::move(_pending_reader);
+                _layer_rid = std::move(_pending_rid);
+                _pending_rid.clear();
+                _video_rewriter.switchSource();
+                _temporal_filter.reset();
+            }
+            sendMediaRtp(rtp, i == pkt->size());
+        });
+        return;
+    }
+    if (reader != _layer_reader.get()) {
+        return;
+    }
+    pkt->for_each([&](const RtpPacket::Ptr &rtp) { sendMediaRtp(rtp, ++i == pkt->size()); });
+}
+
+void WebRtcPlayer::onLayerDetach(const void *reader) {
+    if (reader == _pending_reader.get()) {
+        _pending_reader = nullptr;
+        _pending_rid.clear();
+    } else if (reader == _layer_reader.get()) {
+        // 该层已注销，下次选择时重新挂载
+        // The layer has been unregistered, reattach at the next selection
+        _layer_reader = nullptr;
+        _layer_rid.clear();
+    }
+}
+
 void WebRtcPlayer::sendConfigFrames(uint32_t before_seq, uint32_t sample_rate, uint32_t timestamp, uint64_t ntp_timestamp) {
     auto play_src = _play_src.lock();
     if (!play_src) {
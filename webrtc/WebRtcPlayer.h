@@ -12,7 +12,10 @@
 #define ZLMEDIAKIT_WEBRTCPLAYER_H
 
 #include "WebRtcTransport.h"
+#include "RtcLayerSelector.h"
+#include "RtcAudioTranscoder.h"
 #include "Rtsp/RtspMediaSource.h"
+#include "Common/LatencyStat.h"
 
 namespace mediakit {
 /**
@@ -134,11 +137,21 @@ protected:
     void onStartWebRTC() override;
     void onDestory() override;
     void onRtcConfigure(RtcConfigure &configure) const override;
+    void onGetTransportInfo(Json::Value &result) const override;
 
 private:
     WebRtcPlayer(const toolkit::EventPoller::Ptr &poller, const RtspMediaSource::Ptr &src, const MediaInfo &info);
 
     void sendConfigFrames(uint32_t before_seq, uint32_t sample_rate, uint32_t timestamp, uint64_t ntp_timestamp);
+    void sendMediaRtp(const RtpPacket::Ptr &rtp, bool flush);
+
+    // simulcast层切换相关
+    // Simulcast layer switching related
+    void updateLayers();
+    void listenLayerSources(const RtspMediaSource::Ptr &src);
+    void attachLayer(const RtspMediaSource::Ptr &src, const std::string &rid, bool use_cache);
+    void onLayerRtp(const void *reader, const RtspMediaSource::RingDataType &pkt);
+    void onLayerDetach(const void *reader);
 
 private:
     // 媒体相关元数据  [AUTO-TRANSLATED:f4cf8045]
@@ -159,6 +172,43 @@ private:
     bool _is_h264 { false };
     bool _bfliter_flag { false };
     std::shared_ptr<H264BFrameFilter> _bfilter;
+
+    CodecId _video_codec { CodecInvalid };
+    // url参数rid指定的simulcast层，为空时根据估计带宽自动选择
+    // The simulcast layer specified by the url parameter rid, automatically selected according to the estimated bandwidth when empty
+    std::string _preferred_rid;
+    // 正在播放的simulcast层，以及等待关键帧以便切换的simulcast层
+    // The simulcast layer being played, and the simulcast layer waiting for a key frame to switch to
+    std::string _layer_rid;
+    std::string _pending_rid;
+    // simulcast各层源流，播放开始及同app下有rtsp流注册或注销时才重新查找，避免定时遍历所有媒体源
+    // The source streams of the simulcast layers, searched again only when playing starts and when an rtsp stream of the same app
+    // is registered or unregistered, avoiding traversing all media sources regularly
+    struct LayerSource {
+        std::string rid;
+        std::weak_ptr<RtspMediaSource> src;
+    };
+    bool _layer_sources_dirty { true };
+    std::vector<LayerSource> _layer_sources;
+    RtspMediaSource::RingType::RingReader::Ptr _layer_reader;
+    RtspMediaSource::RingType::RingReader::Ptr _pending_reader;
+    // 各层音频相同，切换层时据此去除重复的音频包
+    // The audio of each layer is the same, remove duplicate audio packets according to this when switching layers
+    bool _audio_started { false };
+    uint16_t _last_audio_seq { 0 };
+    RtcLayerSelector _layer_selector;
+    TemporalLayerFilter _temporal_filter;
+    RtpStreamRewriter _video_rewriter;
+    // 播放延迟统计
+    // Playback latency statistics
+    LatencyRecorder _latency { "webrtc" };
+    // 源流音频浏览器不支持(aac等)时，改为发送共享转码器输出的opus
+    // When the browser does not support the audio of the source stream (aac, etc.), send the opus output by the shared transcoder instead
+    bool _transcode_audio { false };
+#if defined(ENABLE_FFMPEG)
+    RtcAudioTranscoder::Ptr _audio_transcoder;
+    RtpRing::RingType::RingReader::Ptr _audio_reader;
+#endif
 };
 
 }// namespace mediakit
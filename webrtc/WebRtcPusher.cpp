@@ -11,6 +11,7 @@
 #include "WebRtcPusher.h"
 #include "Common/config.h"
 #include "Rtsp/RtspMediaSourceImp.h"
+#include "RtcAudioTranscoder.h"
 
 using namespace std;
 using namespace toolkit;
@@ -45,6 +46,15 @@ WebRtcPusher::WebRtcPusher(const EventPoller::Ptr &poller,
     _push_src_ownership = ownership;
     _continue_push_ms = option.continue_push_ms;
     CHECK(_push_src);
+#if defined(ENABLE_FFMPEG)
+    GET_CONFIG(bool, transcode_opus, Rtc::kTranscodeOpus);
+    auto src_imp = dynamic_pointer_cast<RtspMediaSourceImp>(_push_src);
+    if (transcode_opus && src_imp) {
+        // rtmp/hls/mp4等多数协议与播放器不支持opus，转协议时转码为aac
+        // Most protocols and players such as rtmp/hls/mp4 do not support opus, transcode to aac when converting protocols
+        src_imp->setAudioTranscode(CodecOpus, CodecAAC);
+    }
+#endif
 }
 
 bool WebRtcPusher::close(MediaSource &sender) {
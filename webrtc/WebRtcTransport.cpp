@@ -84,6 +84,22 @@ const string kMinBitrate = RTC_FIELD "min_bitrate";
 const string kDataChannelEcho = RTC_FIELD "datachannel_echo";
 const string kPreferredTcp = RTC_FIELD "preferred_tcp";
 
+// 发送端带宽估计与发送平滑设置
+// Send-side bandwidth estimation and pacing setting
+const string kSendSideBwe = RTC_FIELD "sendSideBwe";
+const string kPacingFactor = RTC_FIELD "pacingFactor";
+const string kPacerMaxQueueMS = RTC_FIELD "pacerMaxQueueMS";
+
+// simulcast层选择设置
+// Simulcast layer selection setting
+const string kLayerUpgradeDelayMS = RTC_FIELD "layerUpgradeDelayMS";
+
+// 音频转码设置
+// Audio transcoding setting
+const string kTranscodeAac = RTC_FIELD "transcodeAac";
+const string kTranscodeG711 = RTC_FIELD "transcodeG711";
+const string kTranscodeOpus = RTC_FIELD "transcodeOpus";
+
 static onceToken token([]() {
     mINI::Instance()[kTimeOutSec] = 15;
     mINI::Instance()[kExternIP] = "";
@@ -107,6 +123,15 @@ static onceToken token([]() {
     mINI::Instance()[kIceUfrag] = "ZLMediaKit";
     mINI::Instance()[kIcePwd] = "ZLMediaKit";
     mINI::Instance()[kPreferredTcp] = 0;
+
+    mINI::Instance()[kSendSideBwe] = 1;
+    mINI::Instance()[kPacingFactor] = 2.5f;
+    mINI::Instance()[kPacerMaxQueueMS] = 1000;
+    mINI::Instance()[kLayerUpgradeDelayMS] = 3000;
+
+    mINI::Instance()[kTranscodeAac] = 1;
+    mINI::Instance()[kTranscodeG711] = 0;
+    mINI::Instance()[kTranscodeOpus] = 1;
 });
 
 } // namespace Rtc
@@ -352,6 +377,7 @@ void WebRtcTransport::getTransportInfo(const std::function<void(Json::Value)>& c
                 result["ice_checklists"] = Json::nullValue;
             }
 
+            strong_self->onGetTransportInfo(result);
 
         } catch (const std::exception& ex) {
             result["error"] = std::string("Exception occurred: ") + ex.what();
@@ -791,9 +817,9 @@ void WebRtcTransport::inputSockData(const char *buf, int len, const IceTransport
 void WebRtcTransport::sendRtpPacket(const char *buf, int len, bool flush, void *ctx) {
     if (_srtp_session_send) {
         auto pkt = _packet_pool.obtain2();
-        // 预留rtx加入的两个字节  [AUTO-TRANSLATED:d1eb5cd7]
-        // Reserve two bytes for rtx joining
-        pkt->setCapacity((size_t)len + SRTP_MAX_TRAILER_LEN + 2);
+        // 预留rtx加入的两个字节与twcc rtp ext的8个字节
+        // Reserve two bytes for rtx joining and 8 bytes for twcc rtp ext
+        pkt->setCapacity((size_t)len + SRTP_MAX_TRAILER_LEN + 2 + 8);
         memcpy(pkt->data(), buf, len);
         onBeforeEncryptRtp(pkt->data(), len, ctx);
         if (_srtp_session_send->EncryptRtp(reinterpret_cast<uint8_t *>(pkt->data()), &len)) {
@@ -975,6 +1001,20 @@ void WebRtcTransportImp::onStartWebRTC() {
             ++index;
         }
     }
+
+    GET_CONFIG(bool, send_side_bwe, Rtc::kSendSideBwe);
+    if (send_side_bwe && canSendRtp()
+        && (_answer_sdp->supportRtcpFb(SdpConst::kTWCCRtcpFb, TrackVideo) || _answer_sdp->supportRtcpFb(SdpConst::kTWCCRtcpFb, TrackAudio))) {
+        // 对端支持twcc，开启发送端带宽估计，并根据估计带宽平滑发送rtp
+        // The peer supports twcc, enable send-side bandwidth estimation, and pace rtp sending according to the estimated bandwidth
+        GET_CONFIG(uint32_t, max_bitrate, Rtc::kMaxBitrate);
+        GET_CONFIG(uint32_t, min_bitrate, Rtc::kMinBitrate);
+        GET_CONFIG(uint32_t, start_bitrate, Rtc::kStartBitrate);
+        _bwe.setBitrate(start_bitrate * 1000, min_bitrate * 1000, max_bitrate * 1000);
+        _pacer = std::make_shared<RtpPacer>(getPoller());
+        _pacer->setOnSend([this](const RtpPacket::Ptr &rtp, bool flush, bool rtx) { sendRtp(rtp, flush, rtx); });
+        _pacer->setBitrate(_bwe.getTargetBitrate());
+    }
 }
 
 void WebRtcTransportImp::onCheckAnswer(RtcSession &sdp) {
@@ -1293,6 +1333,17 @@ void WebRtcTransportImp::onRtcp(const char *buf, size_t len) {
                 });
                 break;
             }
+            case RTPFBType::RTCP_RTPFB_TWCC: {
+                if (!_pacer) {
+                    break;
+                }
+                // 对端回复的twcc，更新估计带宽与发送速率
+                // Twcc replied by the peer, update the estimated bandwidth and sending rate
+                RtcpFB *fb = (RtcpFB *)rtcp;
+                _bwe.onTwccFeedback(fb->getFci<FCI_TWCC>(), fb->getFciSize(), getCurrentMicrosecond());
+                _pacer->setBitrate(_bwe.getTargetBitrate());
+                break;
+            }
             default:
                 break;
             }
@@ -1462,10 +1513,12 @@ void WebRtcTransportImp::onSendTwcc(uint32_t ssrc, const string &twcc_fci) {
 ///////////////////////////////////////////////////////////////////
 
 void WebRtcTransportImp::onSortedRtp(MediaTrack &track, const string &rid, RtpPacket::Ptr rtp) {
-    if (track.media->type == TrackVideo && _pli_ticker.elapsedTime() > 2000) {
+    if (track.media->type == TrackVideo && _pli_ticker[rid].elapsedTime() > 2000) {
         // 定期发送pli请求关键帧，方便非rtc等协议  [AUTO-TRANSLATED:b992f020]
         // Regularly send pli requests for key frames, which is convenient for non-rtc protocols
-        _pli_ticker.resetTime();
+        // simulcast时各层分别请求，rtc播放器只在关键帧切换simulcast层
+        // Request each layer separately for simulcast, rtc players only switch simulcast layers at key frames
+        _pli_ticker[rid].resetTime();
         sendRtcpPli(rtp->getSSRC());
 
         // 开启remb，则发送remb包调节比特率  [AUTO-TRANSLATED:20e98cea]
@@ -1489,11 +1542,8 @@ void WebRtcTransportImp::onSendRtp(const RtpPacket::Ptr &rtp, bool flush, bool r
         return;
     }
     if (!rtx) {
-        // 统计rtp发送情况，好做sr汇报  [AUTO-TRANSLATED:142028b2]
-        // Statistics of RTP sending, for SR reporting
-        track->rtcp_context_send->onRtp(
-            rtp->getSeq(), rtp->getStamp(), rtp->ntp_stamp, rtp->sample_rate,
-            rtp->size() - RtpPacket::kRtpTcpHeaderSize);
+        // 被发送平滑器丢弃的包仍可通过nack重传
+        // Packets dropped by the pacer can still be retransmitted through nack
         track->nack_list.pushBack(rtp);
 #if 0
         // 此处模拟发送丢包  [AUTO-TRANSLATED:9612f08e]
@@ -1507,9 +1557,11 @@ void WebRtcTransportImp::onSendRtp(const RtpPacket::Ptr &rtp, bool flush, bool r
         // Send RTX retransmission packets
         // TraceL << "send rtx rtp:" << rtp->getSeq();
     }
-    pair<bool /*rtx*/, MediaTrack *> ctx { rtx, track.get() };
-    sendRtpPacket(rtp->data() + RtpPacket::kRtpTcpHeaderSize, rtp->size() - RtpPacket::kRtpTcpHeaderSize, flush, &ctx);
-    _bytes_usage += rtp->size() - RtpPacket::kRtpTcpHeaderSize;
+    if (_pacer) {
+        _pacer->inputRtp(rtp, flush, rtx);
+    } else {
+        sendRtp(rtp, flush, rtx);
+    }
 
     if (_rtcp_sr_send_ticker.elapsedTime() > 5000) {
         _rtcp_sr_send_ticker.resetTime();
@@ -1522,20 +1574,58 @@ void WebRtcTransportImp::onSendRtp(const RtpPacket::Ptr &rtp, bool flush, bool r
     }
 }
 
+void WebRtcTransportImp::sendRtp(const RtpPacket::Ptr &rtp, bool flush, bool rtx) {
+    auto &track = _type_to_track[rtp->type];
+    if (!track) {
+        return;
+    }
+    if (!rtx) {
+        // 统计rtp发送情况，好做sr汇报  [AUTO-TRANSLATED:142028b2]
+        // Statistics of RTP sending, for SR reporting
+        // 在真正发送时统计，不计入发送平滑器丢弃的包
+        // Counted when actually sent, excluding packets dropped by the pacer
+        track->rtcp_context_send->onRtp(
+            rtp->getSeq(), rtp->getStamp(), rtp->ntp_stamp, rtp->sample_rate,
+            rtp->size() - RtpPacket::kRtpTcpHeaderSize);
+    }
+    pair<bool /*rtx*/, MediaTrack *> ctx { rtx, track.get() };
+    sendRtpPacket(rtp->data() + RtpPacket::kRtpTcpHeaderSize, rtp->size() - RtpPacket::kRtpTcpHeaderSize, flush, &ctx);
+    _bytes_usage += rtp->size() - RtpPacket::kRtpTcpHeaderSize;
+}
+
+// 在rtp头后插入只包含transport-cc的one-byte rtp ext
+// Insert a one-byte rtp ext that only contains transport-cc after the rtp header
+static void addTwccExt(RtpHeader *header, int &len, uint8_t ext_id, uint16_t seq) {
+    auto offset = RtpPacket::kRtpHeaderSize + header->getCsrcSize();
+    auto ptr = (uint8_t *)header + offset;
+    memmove(ptr + 8, ptr, len - offset);
+    ptr[0] = 0xBE;
+    ptr[1] = 0xDE;
+    ptr[2] = 0;
+    ptr[3] = 1;
+    ptr[4] = ext_id << 4 | 1;
+    ptr[5] = seq >> 8;
+    ptr[6] = seq & 0xFF;
+    ptr[7] = 0;
+    header->ext = 1;
+    len += 8;
+}
+
 void WebRtcTransportImp::onBeforeEncryptRtp(const char *buf, int &len, void *ctx) {
     auto pr = (pair<bool /*rtx*/, MediaTrack *> *)ctx;
     auto header = (RtpHeader *)buf;
+    // 修改rtp ext id为对端sdp声明的id，并获取twcc ext(转发rtc推流时存在)
+    // Modify the rtp ext id to the id declared in the peer sdp, and get the twcc ext (exists when forwarding rtc push stream)
+    auto twcc_ext = pr->second->rtp_ext_ctx->changeRtpExtId(header, false, nullptr, RtpExtType::transport_cc);
 
     if (!pr->first || !pr->second->plan_rtx) {
         // 普通的rtp,或者不支持rtx, 修改目标pt和ssrc  [AUTO-TRANSLATED:e1264971]
         // Ordinary RTP, or does not support RTX, modify the target PT and SSRC
-        pr->second->rtp_ext_ctx->changeRtpExtId(header, false);
         header->pt = pr->second->plan_rtp->pt;
         header->ssrc = htonl(pr->second->answer_ssrc_rtp);
     } else {
         // 重传的rtp, rtx  [AUTO-TRANSLATED:e863a518]
         // Retransmitted RTP, RTX
-        pr->second->rtp_ext_ctx->changeRtpExtId(header, false);
         header->pt = pr->second->plan_rtx->pt;
         if (pr->second->answer_ssrc_rtx) {
             // 有rtx单独的ssrc,有些情况下，浏览器支持rtx，但是未指定rtx单独的ssrc  [AUTO-TRANSLATED:181cee9a]
@@ -1565,6 +1655,43 @@ void WebRtcTransportImp::onBeforeEncryptRtp(const char *buf, int &len, void *ctx
         payload[1] = origin_seq & 0xFF;
         len += 2;
     }
+
+    if (!_pacer) {
+        return;
+    }
+    // 发送端带宽估计，为每个发出的rtp分配本端的transport-wide seq
+    // Send-side bandwidth estimation, allocate the transport-wide seq of this end for each rtp sent
+    if (twcc_ext) {
+        twcc_ext.setTransportCCSeq(_bwe.onSendRtp(len, getCurrentMicrosecond()));
+    } else if (!header->ext) {
+        auto ext_id = pr->second->rtp_ext_ctx->getExtId(RtpExtType::transport_cc);
+        if (ext_id && ext_id < (uint8_t)RtpExtType::reserved) {
+            addTwccExt(header, len, ext_id, _bwe.onSendRtp(len + 8, getCurrentMicrosecond()));
+        }
+    }
+}
+
+void WebRtcTransportImp::onGetTransportInfo(Json::Value &result) const {
+    if (!_pacer) {
+        return;
+    }
+    Json::Value bwe;
+    bwe["target_bitrate"] = _bwe.getTargetBitrate();
+    bwe["delay_based_bitrate"] = _bwe.getDelayBasedBitrate();
+    bwe["loss_based_bitrate"] = _bwe.getLossBasedBitrate();
+    bwe["acked_bitrate"] = _bwe.getAckedBitrate();
+    bwe["loss_rate"] = _bwe.getLossRate();
+    bwe["bandwidth_usage"] = SendSideBwe::BandwidthUsageStr(_bwe.getBandwidthUsage());
+    bwe["pacing_rate"] = _pacer->getPacingRate();
+    bwe["pacer_queue_size"] = (Json::UInt64)_pacer->getQueueSize();
+    bwe["pacer_queue_bytes"] = (Json::UInt64)_pacer->getQueueBytes();
+    bwe["pacer_queue_ms"] = (Json::UInt64)_pacer->getQueueMS();
+    bwe["pacer_dropped"] = (Json::UInt64)_pacer->getDroppedCount();
+    result["bwe"] = bwe;
+}
+
+uint32_t WebRtcTransportImp::getTargetBitrate() const {
+    return _pacer ? _bwe.getTargetBitrate() : 0;
 }
 
 void WebRtcTransportImp::safeShutdown(const SockException &ex) {
@@ -25,6 +25,8 @@
 #include "Network/Session.h"
 #include "Nack.h"
 #include "TwccContext.h"
+#include "SendSideBwe.h"
+#include "RtpPacer.h"
 #include "SctpAssociation.hpp"
 #include "Rtcp/RtcpContext.h"
 #include "Rtsp/RtspMediaSource.h"
@@ -55,6 +57,27 @@ extern const std::string kIceUfrag;
 extern const std::string kIcePwd;
 extern const std::string kExternIP;
 extern const std::string kInterfaces;
+// 是否开启发送端带宽估计(twcc)与发送平滑，对zlm发送的rtc流有效
+// Whether to enable send-side bandwidth estimation (twcc) and pacing, valid for rtc streams sent by zlm
+extern const std::string kSendSideBwe;
+// 发送平滑速率为估计带宽的倍数
+// The pacing rate is a multiple of the estimated bandwidth
+extern const std::string kPacingFactor;
+// 发送平滑队列中视频包最长排队时间，超过后丢弃，单位毫秒
+// The maximum queuing time of video packets in the pacing queue, discarded after exceeding, in milliseconds
+extern const std::string kPacerMaxQueueMS;
+// webrtc播放simulcast流时，切换到更高层前要求估计带宽持续充足的时间，单位毫秒
+// When playing simulcast stream by webrtc, the duration that the estimated bandwidth must stay sufficient before switching to a higher layer, in milliseconds
+extern const std::string kLayerUpgradeDelayMS;
+// webrtc播放aac音频的流时是否转码为opus
+// Whether to transcode to opus when webrtc plays a stream with aac audio
+extern const std::string kTranscodeAac;
+// webrtc播放g711音频的流时是否转码为opus
+// Whether to transcode to opus when webrtc plays a stream with g711 audio
+extern const std::string kTranscodeG711;
+// webrtc推流的opus音频在转其他协议时是否转码为aac
+// Whether to transcode the opus audio of webrtc push stream to aac when converting to other protocols
+extern const std::string kTranscodeOpus;
 }//namespace RTC
 
 class WebRtcInterface {
@@ -222,6 +245,7 @@ protected:
     virtual void onBeforeEncryptRtp(const char *buf, int &len, void *ctx) = 0;
     virtual void onBeforeEncryptRtcp(const char *buf, int &len, void *ctx) = 0;
     virtual void onRtcpBye() = 0;
+    virtual void onGetTransportInfo(Json::Value &result) const {}
 
 protected:
     void sendRtcpRemb(uint32_t ssrc, size_t bit_rate);
@@ -353,11 +377,16 @@ protected:
     void updateTicker();
     float getLossRate(TrackType type);
     void onRtcpBye() override;
+    void onGetTransportInfo(Json::Value &result) const override;
+    // 获取发送端估计的可用带宽，单位bit/s，未开启带宽估计时返回0
+    // Get the available bandwidth estimated by the sender, in bit/s, return 0 if bandwidth estimation is not enabled
+    uint32_t getTargetBitrate() const;
 
 private:
     void onSortedRtp(MediaTrack &track, const std::string &rid, RtpPacket::Ptr rtp);
     void onSendNack(MediaTrack &track, const FCI_NACK &nack, uint32_t ssrc);
     void onSendTwcc(uint32_t ssrc, const std::string &twcc_fci);
+    void sendRtp(const RtpPacket::Ptr &rtp, bool flush, bool rtx);
 
     void registerSelf();
     void unregisterSelf();
@@ -381,7 +410,9 @@ private:
     toolkit::Ticker _alive_ticker;
     // pli rtcp计时器  [AUTO-TRANSLATED:a1a5fd18]
     // pli rtcp timer
-    toolkit::Ticker _pli_ticker;
+    // simulcast时每个rid单独计时，保证各层都能定期产生关键帧
+    // Each rid is timed separately for simulcast, ensuring that every layer generates key frames regularly
+    std::unordered_map<std::string/*rid*/, toolkit::Ticker> _pli_ticker;
 
     toolkit::Ticker _rtcp_sr_send_ticker;
     toolkit::Ticker _rtcp_rr_send_ticker;
@@ -389,6 +420,10 @@ private:
     // twcc rtcp发送上下文对象  [AUTO-TRANSLATED:aef6476a]
     // twcc rtcp send context object
     TwccContext _twcc_ctx;
+    // 发送端带宽估计与发送平滑，未开启时_pacer为空
+    // Send-side bandwidth estimation and pacing, _pacer is null when not enabled
+    SendSideBwe _bwe;
+    RtpPacer::Ptr _pacer;
     // 根据发送rtp的track类型获取相关信息  [AUTO-TRANSLATED:ff31c272]
     // Get relevant information based on the track type of the sent rtp
     MediaTrack::Ptr _type_to_track[2];